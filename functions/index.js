@@ -10,7 +10,127 @@ exports.fixBidirectionalContacts = require('./fixContacts').fixBidirectionalCont
 
 // ===== CONFIGURACIÓN =====
 const MAX_FCM_TOKENS_PER_USER = 10;  // Máximo de dispositivos por usuario
-const PSK_SECRET = 'wilobu_psk_secret_2025';  // Pre-shared key para auth
+const PSK_SECRET = process.env.PSK_SECRET || '';                  // Auth 'psk' del heartbeat ("" = se rechaza)
+const SMS_SOS_PSK = process.env.SMS_SOS_PSK || '';                // Raíz de las claves SMS (la misma del build del firmware)
+const SMS_GATEWAY_NUMBER = process.env.SMS_GATEWAY_NUMBER || '';  // Número que recibe los SOS por SMS
+const TWILIO_AUTH_TOKEN = process.env.TWILIO_AUTH_TOKEN || '';    // Firma X-Twilio-Signature del webhook SMS
+const SMS_WEBHOOK_URL = process.env.SMS_WEBHOOK_URL || '';        // URL exacta configurada en Twilio ("" = la de la petición)
+const FIRMWARE_CACHE_MS = 5 * 60 * 1000;  // firmware/latest se relee cada 5 min por instancia
+
+// ===== FIRMWARE PUBLICADO (OTA) =====
+/**
+ * Lee firmware/latest: { enabled, version, url, size, sha256, sig }. La imagen
+ * se sirve por https desde una URL que acepte "Range" (Cloud Storage lo hace):
+ * el firmware la baja por rangos y verifica size y sha256 (hex) antes de
+ * arrancarla. sig es la firma ECDSA P-256 (DER en hex) de
+ * "<version>|<url>|<size>|<sha256>" que escribe scripts/sign_firmware.js con la
+ * clave privada fuera de línea; el firmware la verifica con la pública de su
+ * build y descarta el manifiesto sin firma válida. Este servidor no firma.
+ * Devuelve null si no hay versión publicada o el documento está incompleto.
+ */
+let firmwareCache = { at: 0, value: null };
+async function getLatestFirmware() {
+    if (Date.now() - firmwareCache.at < FIRMWARE_CACHE_MS) return firmwareCache.value;
+    const doc = await admin.firestore().collection('firmware').doc('latest').get();
+    const data = doc.exists ? doc.data() : null;
+    let value = null;
+    if (data && data.enabled && typeof data.version === 'string' && typeof data.url === 'string' &&
+        data.url.startsWith('https://') && Number.isInteger(data.size) && data.size > 0 &&
+        /^[0-9a-fA-F]{64}$/.test(data.sha256 || '') && /^([0-9a-fA-F]{2}){8,72}$/.test(data.sig || '')) {
+        value = {
+            v: data.version, url: data.url, size: data.size,
+            sha256: data.sha256.toLowerCase(), sig: data.sig.toLowerCase()
+        };
+    }
+    firmwareCache = { at: Date.now(), value };
+    return value;
+}
+
+// ===== GEOCERCAS (FORMATO COMPACTO PARA FIRMWARE) =====
+/**
+ * Convierte las geocercas del documento del dispositivo al formato que guarda
+ * el firmware: microgrados enteros, círculo {i, c:[lat,lng,radio]} o polígono {i, p:[lat,lng,...]}
+ * Entrada: [{ id, type: 'circle', lat, lng, radius } | { id, type: 'polygon', points: [{lat, lng}] }]
+ */
+function compactGeofences(fences) {
+    if (!Array.isArray(fences)) return [];
+    const e6 = (v) => Math.round(v * 1e6);
+    return fences.slice(0, 8).map((f, idx) => {
+        const id = typeof f.id === 'number' ? f.id : idx + 1;
+        if (f.type === 'polygon' && Array.isArray(f.points)) {
+            return { i: id, p: f.points.slice(0, 12).flatMap((pt) => [e6(pt.lat), e6(pt.lng)]) };
+        }
+        return { i: id, c: [e6(f.lat), e6(f.lng), Math.min(Math.round(f.radius || 100), 65535)] };
+    });
+}
+
+// ===== ALERTA SOS (COMÚN A DATOS Y SMS) =====
+/**
+ * Clave de deduplicación de una alerta: época aleatoria de la bandeja del
+ * firmware + secuencia dentro de ella. La época cambia cada vez que la
+ * secuencia vuelve a 1 (NVS borrada), así que un contador reiniciado no choca
+ * con alertas viejas. Sin época válida no se deduplica.
+ */
+function sosAlertKey(sosEpoch, sosSeq) {
+    if (!Number.isInteger(sosEpoch) || sosEpoch <= 0 || sosEpoch > 0xFFFFFFFF) return null;
+    if (!Number.isInteger(sosSeq) || sosSeq <= 0) return null;
+    return `seq_${sosEpoch.toString(16).padStart(8, '0')}_${sosSeq}`;
+}
+
+/**
+ * Crea la alerta del disparo en devices/{id}/alerts. Con clave (sosAlertKey) el
+ * id es determinista y se usa create(): un reintento cuya respuesta se perdió,
+ * o la misma alerta llegando por SMS y por datos, no crea (ni notifica) otra.
+ * Completa `update` con lo que hay que escribir en el documento del dispositivo.
+ */
+async function recordSosAlert(deviceRef, current, status, lastLocation, sosEpoch, sosSeq, update, via) {
+    const key = sosAlertKey(sosEpoch, sosSeq);
+    const hasSeq = key !== null;
+    const alertRef = hasSeq
+        ? deviceRef.collection('alerts').doc(key)
+        : deviceRef.collection('alerts').doc();
+    const alertData = {
+        type: status,
+        timestamp: admin.firestore.FieldValue.serverTimestamp(),
+        processed: false,
+        via: via
+    };
+
+    if (!lastLocation || !lastLocation.lat || !lastLocation.lng) {
+        // Disparo 1: Usar ubicación histórica
+        console.log(`[SOS] Disparo 1 (sin ubicación, ${via}) -> Usando lastLocation histórica`);
+        alertData.location = current.lastLocation?.geopoint || null;
+        alertData.isPreliminary = true;
+    } else {
+        // Disparo 2: Ubicación precisa
+        console.log(`[SOS] Disparo 2 (con ubicación, ${via}) -> Actualizando lastLocation`);
+        const newLocation = {
+            geopoint: new admin.firestore.GeoPoint(lastLocation.lat, lastLocation.lng),
+            accuracy: lastLocation.accuracy || null,
+            timestamp: admin.firestore.FieldValue.serverTimestamp()
+        };
+        update.lastLocation = newLocation;
+        alertData.location = newLocation.geopoint;
+        alertData.isPreliminary = false;
+    }
+
+    if (hasSeq) {
+        alertData.sosEpoch = sosEpoch;
+        alertData.sosSeq = sosSeq;
+    }
+    try {
+        await (hasSeq ? alertRef.create(alertData) : alertRef.set(alertData));
+    } catch (createErr) {
+        if (createErr.code !== 6 && createErr.code !== 'already-exists') throw createErr;
+        // ALREADY_EXISTS: ya llegó por el otro camino o en un intento anterior
+        console.log(`[SOS] Alerta ${key} duplicada (${via}) - ignorada`);
+        return { duplicate: true, alertId: alertRef.id };
+    }
+    // Nueva alerta: olvidar un cierre anterior desde la app
+    update.sosClearRequested = false;
+    console.log(`[SOS] Alerta creada: ${alertRef.id} (${via})`);
+    return { duplicate: false, alertId: alertRef.id };
+}
 
 // ===== CLOUD FUNCTION: HEARTBEAT (HTTP) =====
 /**
@@ -31,7 +151,7 @@ exports.heartbeat = functions.https.onRequest(async (req, res) => {
     }
     
     try {
-        const { deviceId, ownerUid, auth, lastLocation, status } = req.body;
+        const { deviceId, ownerUid, auth, lastLocation, status, geofenceVer, geofenceEvent, sosTrack, sosTrackEnd, sosEpoch, sosSeq, smsGw, energy, heap, fw } = req.body;
         
         // Validar campos requeridos
         if (!deviceId || !ownerUid) {
@@ -40,6 +160,10 @@ exports.heartbeat = functions.https.onRequest(async (req, res) => {
         
         // Validar auth PSK
         if (auth && auth.mode === 'psk') {
+            if (!PSK_SECRET) {
+                console.warn('[HEARTBEAT] Auth psk sin PSK_SECRET configurado');
+                return res.status(401).json({ error: 'Invalid auth' });
+            }
             const { ts, nonce, sig } = auth;
             const canonical = `${deviceId}|${ownerUid}|${ts}|${nonce}`;
             const expected = crypto.createHmac('sha256', PSK_SECRET).update(canonical).digest('hex');
@@ -91,45 +215,104 @@ exports.heartbeat = functions.https.onRequest(async (req, res) => {
             lastSeen: admin.firestore.FieldValue.serverTimestamp()
         };
         
-        // ===== ESTRATEGIA "DOBLE DISPARO" PARA SOS =====
-        if (status && status.startsWith('sos_')) {
-            // Crear alerta en sub-colección para trigger independiente
-            const alertRef = deviceRef.collection('alerts').doc();
-            const alertData = {
-                type: status,
-                timestamp: admin.firestore.FieldValue.serverTimestamp(),
-                processed: false
-            };
-            
-            if (!lastLocation || !lastLocation.lat || !lastLocation.lng) {
-                // Disparo 1: Usar ubicación histórica
-                console.log(`[HEARTBEAT] Disparo 1 (SOS sin ubicación) -> Usando lastLocation histórica`);
-                alertData.location = current.lastLocation?.geopoint || null;
-                alertData.isPreliminary = true;
-            } else {
-                // Disparo 2: Ubicación precisa
-                console.log(`[HEARTBEAT] Disparo 2 (SOS con ubicación) -> Actualizando lastLocation`);
-                const newLocation = {
-                    geopoint: new admin.firestore.GeoPoint(lastLocation.lat, lastLocation.lng),
-                    accuracy: lastLocation.accuracy || null,
-                    timestamp: admin.firestore.FieldValue.serverTimestamp()
+        let sosCleared = false;
+
+        // ===== SEGUIMIENTO SOS EN VIVO =====
+        // Puntos [latE6, lngE6, precisión_m, antigüedad_s] enviados tras el Disparo 2.
+        // No crea alertas nuevas: solo mantiene el estado SOS y guarda el recorrido.
+        if (Array.isArray(sosTrack)) {
+            const now = Date.now();
+            const points = sosTrack.filter(p => Array.isArray(p) && p.length >= 4);
+            if (points.length > 0) {
+                const batch = admin.firestore().batch();
+                for (const [latE6, lngE6, accuracy, ageSec] of points) {
+                    batch.set(deviceRef.collection('sosTrack').doc(), {
+                        geopoint: new admin.firestore.GeoPoint(latE6 / 1e6, lngE6 / 1e6),
+                        accuracy: accuracy,
+                        type: status || null,
+                        timestamp: admin.firestore.Timestamp.fromMillis(now - ageSec * 1000)
+                    });
+                }
+                await batch.commit();
+
+                const [latE6, lngE6, accuracy, ageSec] = points[points.length - 1];
+                update.lastLocation = {
+                    geopoint: new admin.firestore.GeoPoint(latE6 / 1e6, lngE6 / 1e6),
+                    accuracy: accuracy,
+                    timestamp: admin.firestore.Timestamp.fromMillis(now - ageSec * 1000)
                 };
-                update.lastLocation = newLocation;
-                alertData.location = newLocation.geopoint;
-                alertData.isPreliminary = false;
             }
-            
-            await alertRef.set(alertData);
-            console.log(`[HEARTBEAT] Alerta creada: ${alertRef.id}`);
+            if (sosTrackEnd) {
+                update.status = 'online';
+                console.log(`[HEARTBEAT] Seguimiento SOS terminado (${sosTrackEnd})`);
+            } else if (current.sosClearRequested === true) {
+                // La app cerró la alerta: el dispositivo deja de enviar seguimiento
+                update.status = 'online';
+                update.sosClearRequested = false;
+                sosCleared = true;
+                console.log('[HEARTBEAT] Alerta cerrada desde la app -> sos_clear');
+            }
+            console.log(`[HEARTBEAT] Seguimiento SOS: ${points.length} puntos`);
+        } else if (status && status.startsWith('sos_')) {
+            const result = await recordSosAlert(deviceRef, current, status, lastLocation, sosEpoch, sosSeq, update, 'datos');
+            if (result.duplicate) {
+                return res.status(200).json({ success: true, duplicate: true, cmd_reset: current.cmd_reset === true });
+            }
         } else if (lastLocation && lastLocation.lat && lastLocation.lng) {
             // Heartbeat normal con ubicación: Actualizar
+            // (el firmware solo la adjunta si cambió; sin ella se conserva la anterior)
             update.lastLocation = {
                 geopoint: new admin.firestore.GeoPoint(lastLocation.lat, lastLocation.lng),
                 accuracy: lastLocation.accuracy || null,
                 timestamp: admin.firestore.FieldValue.serverTimestamp()
             };
         }
+
+        // ===== GEOCERCAS: CRUCE DETECTADO EN EL DISPOSITIVO =====
+        if (geofenceEvent && typeof geofenceEvent.id === 'number') {
+            const eventData = {
+                fenceId: geofenceEvent.id,
+                type: geofenceEvent.type === 'enter' ? 'enter' : 'exit',
+                location: update.lastLocation?.geopoint || current.lastLocation?.geopoint || null,
+                timestamp: admin.firestore.FieldValue.serverTimestamp()
+            };
+            await deviceRef.collection('geofenceEvents').add(eventData);
+            update.lastGeofenceEvent = eventData;
+            console.log(`[HEARTBEAT] Geocerca #${eventData.fenceId} ${eventData.type}`);
+        }
         
+        // Reporte de energía estimado por subsistema (mAh/h), opcional
+        if (energy && typeof energy === 'object') {
+            update.lastEnergy = {
+                ...energy,
+                reportedAt: admin.firestore.FieldValue.serverTimestamp()
+            };
+        }
+
+        // Telemetría de heap (libre, bloque mayor, mínimo histórico): seguimiento de fragmentación
+        if (heap && typeof heap === 'object') {
+            update.lastHeap = {
+                free: Number(heap.free) || 0,
+                maxBlock: Number(heap.maxBlock) || 0,
+                minFree: Number(heap.minFree) || 0,
+                reportedAt: admin.firestore.FieldValue.serverTimestamp()
+            };
+        }
+
+        // Versión de firmware que corre el dispositivo (solo si cambió)
+        if (typeof fw === 'string' && fw !== current.fwVersion) {
+            update.fwVersion = fw;
+        }
+
+        // Pedido de diagnóstico BLE (la app escribe diagBle: {pin, min}): se entrega una vez
+        let diagRequest = null;
+        const diagPin = Number(current.diagBle && current.diagBle.pin);
+        if (Number.isInteger(diagPin) && diagPin >= 0 && diagPin <= 999999) {
+            diagRequest = { pin: diagPin, min: Number(current.diagBle.min) || 15 };
+            update.diagBle = admin.firestore.FieldValue.delete();
+            update.diagBleSentAt = admin.firestore.FieldValue.serverTimestamp();
+        }
+
         // Actualizar documento existente
         try {
             await deviceRef.update(update);
@@ -144,7 +327,36 @@ exports.heartbeat = functions.https.onRequest(async (req, res) => {
         }
         
         // Responder con cmd_reset si está activo
-        return res.status(200).json({ success: true, cmd_reset: cmdReset });
+        const response = { success: true, cmd_reset: cmdReset };
+        if (sosCleared) {
+            response.sos_clear = true;
+        }
+        if (diagRequest) {
+            response.diag = diagRequest;
+        }
+
+        // Número del gateway SMS para el despacho multicamino (solo si el dispositivo no lo tiene)
+        if (SMS_GATEWAY_NUMBER && smsGw !== SMS_GATEWAY_NUMBER) {
+            response.sms_gw = SMS_GATEWAY_NUMBER;
+        }
+
+        // OTA: solo el aviso; el firmware pide el manifiesto cuando está libre
+        if (typeof fw === 'string') {
+            const latest = await getLatestFirmware();
+            if (latest && latest.v !== fw) {
+                response.ota = true;
+            }
+        }
+
+        // Geocercas: enviar solo si la versión del dispositivo está desactualizada
+        const fencesVersion = current.geofencesVersion || 0;
+        if (typeof geofenceVer === 'number' && geofenceVer !== fencesVersion) {
+            response.geofences = {
+                v: fencesVersion,
+                f: compactGeofences(current.geofences)
+            };
+        }
+        return res.status(200).json(response);
         
     } catch (error) {
         console.error('[HEARTBEAT] Error:', error);
@@ -152,6 +364,169 @@ exports.heartbeat = functions.https.onRequest(async (req, res) => {
     }
 });
 
+// ===== CLOUD FUNCTION: MANIFIESTO DE FIRMWARE (OTA) =====
+/**
+ * POST { deviceId, fw } -> { v, url, size, sha256 } si hay otra versión
+ * publicada, o { update: false }. El firmware lo consulta tras el aviso
+ * "ota": true del heartbeat.
+ */
+exports.firmwareManifest = functions.https.onRequest(async (req, res) => {
+    if (req.method !== 'POST') {
+        return res.status(405).json({ error: 'Method not allowed' });
+    }
+
+    try {
+        const { deviceId, fw } = req.body || {};
+        if (!deviceId) {
+            return res.status(400).json({ error: 'deviceId required' });
+        }
+        const latest = await getLatestFirmware();
+        if (!latest || latest.v === fw) {
+            return res.status(200).json({ update: false });
+        }
+        console.log(`[OTA] ${deviceId}: ${fw || '?'} -> ${latest.v}`);
+        return res.status(200).json(latest);
+    } catch (error) {
+        console.error('[OTA] Error:', error);
+        return res.status(500).json({ error: error.message });
+    }
+});
+
+// ===== CLOUD FUNCTION: SOS POR SMS (WEBHOOK DEL GATEWAY) =====
+/**
+ * Recibe el SMS compacto que el firmware envía en paralelo al POST de datos:
+ *   "WLB1 <deviceId> <época hex>-<seq> <g|m|s> <lat>,<lng>,<precisión> <tag>"   (o "-" sin fix)
+ * El gateway (formato Twilio: From, To, Body) lo reenvía aquí. Se aceptan solo
+ * peticiones con X-Twilio-Signature válida, dirigidas al número del gateway,
+ * enviadas desde el número SIM registrado en el dispositivo (simNumber) y con
+ * el tag del firmware: HMAC-SHA256 del texto previo con la clave de ese
+ * dispositivo, 16 hex. La alerta se deduplica por (época, seq) contra la que
+ * llegue por datos.
+ */
+const SMS_SOS_TYPES = { g: 'sos_general', m: 'sos_medica', s: 'sos_seguridad' };
+const SMS_SOS_TAG_HEX = 16;
+
+function safeEqual(a, b) {
+    const bufA = Buffer.from(String(a));
+    const bufB = Buffer.from(String(b));
+    return bufA.length === bufB.length && crypto.timingSafeEqual(bufA, bufB);
+}
+
+// Firma de Twilio: HMAC-SHA1 (auth token) de la URL + parámetros POST ordenados, en base64
+function validTwilioSignature(req) {
+    const signature = req.get('X-Twilio-Signature');
+    if (!TWILIO_AUTH_TOKEN || !signature) return false;
+    const url = SMS_WEBHOOK_URL || `https://${req.get('host')}${req.originalUrl}`;
+    const params = req.body || {};
+    const data = Object.keys(params).sort().reduce((acc, key) => acc + key + params[key], url);
+    const expected = crypto.createHmac('sha1', TWILIO_AUTH_TOKEN).update(Buffer.from(data, 'utf-8')).digest('base64');
+    return safeEqual(signature, expected);
+}
+
+// Clave SMS de un dispositivo: HMAC-SHA256(SMS_SOS_PSK, deviceId), 16 bytes en
+// hex. El firmware deriva la misma al aprovisionarse (deriveSmsKey en main.cpp)
+function deriveSmsKey(deviceId) {
+    return crypto.createHmac('sha256', SMS_SOS_PSK).update(deviceId).digest().subarray(0, 16).toString('hex');
+}
+
+// La clave vive en devices/{id}/secrets/sms, que ningún cliente puede leer (el
+// documento del dispositivo sí lo leen contactos y viewers). Un dispositivo
+// vinculado antes de existir la clave la recibe aquí
+async function getSmsKey(deviceRef, deviceId) {
+    const secretRef = deviceRef.collection('secrets').doc('sms');
+    const secret = await secretRef.get();
+    if (secret.exists && /^[0-9a-f]{32}$/.test(secret.data().key || '')) return secret.data().key;
+    if (!SMS_SOS_PSK) return null;
+    const key = deriveSmsKey(deviceId);
+    await secretRef.set({ key });
+    return key;
+}
+
+// Tag del firmware (sosSmsText en main.cpp): prueba que el texto salió de este Wilobu
+function validSmsTag(text, tag, keyHex) {
+    const expected = crypto.createHmac('sha256', Buffer.from(keyHex, 'hex')).update(text).digest('hex').slice(0, SMS_SOS_TAG_HEX);
+    return safeEqual(String(tag).toLowerCase(), expected);
+}
+
+exports.smsSos = functions.https.onRequest(async (req, res) => {
+    const twiml = () => res.status(200).type('text/xml').send('<Response></Response>');
+    if (req.method !== 'POST') {
+        return res.status(405).json({ error: 'Method not allowed' });
+    }
+
+    if (!validTwilioSignature(req)) {
+        console.warn(`[SMS-SOS] Firma de Twilio inválida (${req.ip})`);
+        return res.status(403).json({ error: 'Invalid signature' });
+    }
+    if (!SMS_GATEWAY_NUMBER || req.body.To !== SMS_GATEWAY_NUMBER) {
+        console.warn(`[SMS-SOS] Destino ${req.body.To} no es el gateway`);
+        return res.status(403).json({ error: 'Unknown gateway' });
+    }
+
+    try {
+        const body = String(req.body.Body || req.body.body || '').trim();
+        const parts = body.split(/\s+/);
+        if (parts.length !== 6 || parts[0] !== 'WLB1') {
+            console.warn(`[SMS-SOS] Formato desconocido de ${req.body.From}: ${body}`);
+            return twiml();
+        }
+        const [, deviceId, keyStr, typeChar, locStr, tag] = parts;
+        if (!/^[0-9A-F]{12}$/.test(deviceId)) {
+            console.warn(`[SMS-SOS] deviceId inválido de ${req.body.From}: ${body}`);
+            return twiml();
+        }
+
+        const snapshot = await admin.firestore()
+            .collectionGroup('devices')
+            .where(admin.firestore.FieldPath.documentId(), '==', deviceId)
+            .limit(1)
+            .get();
+        const deviceDoc = snapshot.docs[0];
+        if (!deviceDoc || !deviceDoc.data().ownerUid) {
+            console.warn(`[SMS-SOS] Dispositivo ${deviceId} no encontrado`);
+            return twiml();
+        }
+        const current = deviceDoc.data();
+
+        // Solo la SIM registrada para este dispositivo puede hablar por él
+        if (!current.simNumber || req.body.From !== current.simNumber) {
+            console.warn(`[SMS-SOS] ${req.body.From} no es la SIM registrada de ${deviceId}`);
+            return res.status(403).json({ error: 'Unregistered sender' });
+        }
+        const smsKey = await getSmsKey(deviceDoc.ref, deviceId);
+        if (!smsKey || !validSmsTag(parts.slice(0, 5).join(' '), tag, smsKey)) {
+            console.warn(`[SMS-SOS] Tag inválido de ${req.body.From}: ${body}`);
+            return res.status(403).json({ error: 'Invalid tag' });
+        }
+        const keyMatch = /^([0-9a-f]{8})-(\d{1,10})$/.exec(keyStr);
+        const sosEpoch = keyMatch ? parseInt(keyMatch[1], 16) : NaN;
+        const sosSeq = keyMatch ? parseInt(keyMatch[2], 10) : NaN;
+        const status = SMS_SOS_TYPES[typeChar];
+        if (!status || sosAlertKey(sosEpoch, sosSeq) === null) {
+            console.warn(`[SMS-SOS] Campos inválidos: ${body}`);
+            return twiml();
+        }
+
+        let lastLocation = null;
+        if (locStr !== '-') {
+            const [lat, lng, accuracy] = locStr.split(',').map(Number);
+            if (Number.isFinite(lat) && Number.isFinite(lng)) {
+                lastLocation = { lat, lng, accuracy: Number.isFinite(accuracy) ? accuracy : null };
+            }
+        }
+
+        const update = { status: status, lastSeen: admin.firestore.FieldValue.serverTimestamp() };
+        const result = await recordSosAlert(deviceDoc.ref, current, status, lastLocation, sosEpoch, sosSeq, update, 'sms');
+        if (!result.duplicate) {
+            await deviceDoc.ref.update(update);
+        }
+        return twiml();
+    } catch (error) {
+        console.error('[SMS-SOS] Error:', error);
+        return res.status(500).json({ error: error.message });
+    }
+});
+
 // ===== CLOUD FUNCTION: ALERTA SOS =====
 /**
  * Se ejecuta automáticamente cuando se crea una alerta en la sub-colección
@@ -820,6 +1195,12 @@ exports.onDeviceLinked = functions.firestore
     .onCreate(async (snap, context) => {
         const { userId, deviceId } = context.params;
         const name = snap.data().name || deviceId;
+        // Misma clave SMS que el firmware derivó al aprovisionarse
+        if (SMS_SOS_PSK) {
+            await snap.ref.collection('secrets').doc('sms').set({ key: deriveSmsKey(deviceId) });
+        } else {
+            console.warn(`[LINK] SMS_SOS_PSK sin configurar: ${deviceId} queda sin clave SMS`);
+        }
         await sendOwnerNotification(
             userId,
             'Wilobu vinculado',
@@ -0,0 +1,75 @@
+// Firma OTA fuera de línea: la clave privada queda en esta máquina, el
+// backend solo sirve el manifiesto firmado y el firmware lo verifica con la
+// clave pública de su build (OTA_SIGNING_PUBKEY, desde WILOBU_OTA_PUBKEY).
+//
+//   node sign_firmware.js keygen <clave.pem>
+//     Crea la clave ECDSA P-256 e imprime la pública para WILOBU_OTA_PUBKEY
+//   node sign_firmware.js publish <clave.pem> <versión> <url https> <firmware.bin> [--dry-run]
+//     Firma "<versión>|<url>|<size>|<sha256>" y escribe firmware/latest
+//     (con --dry-run solo imprime el documento)
+const crypto = require('crypto');
+const fs = require('fs');
+
+function publicKeyHex(key) {
+  // SPKI de P-256: los últimos 65 bytes son el punto sin comprimir (0x04 || X || Y)
+  const spki = crypto.createPublicKey(key).export({ type: 'spki', format: 'der' });
+  return spki.subarray(spki.length - 65).toString('hex');
+}
+
+function keygen(keyPath) {
+  if (fs.existsSync(keyPath)) {
+    console.error(`❌ ${keyPath} ya existe: no se pisa una clave de firma`);
+    process.exit(1);
+  }
+  const { privateKey } = crypto.generateKeyPairSync('ec', { namedCurve: 'prime256v1' });
+  fs.writeFileSync(keyPath, privateKey.export({ type: 'pkcs8', format: 'pem' }), { mode: 0o600 });
+  console.log(`✅ Clave privada en ${keyPath} (no se versiona ni se sube al backend)`);
+  console.log(`WILOBU_OTA_PUBKEY=${publicKeyHex(privateKey)}`);
+}
+
+async function publish(keyPath, version, url, binPath, dryRun) {
+  if (!url.startsWith('https://')) {
+    console.error('❌ La URL debe ser https://: el firmware no baja imágenes sin TLS');
+    process.exit(1);
+  }
+  const privateKey = crypto.createPrivateKey(fs.readFileSync(keyPath));
+  const image = fs.readFileSync(binPath);
+  const sha256 = crypto.createHash('sha256').update(image).digest('hex');
+  const signedText = `${version}|${url}|${image.length}|${sha256}`;
+  const sig = crypto.sign('sha256', Buffer.from(signedText), privateKey);
+  if (!crypto.verify('sha256', Buffer.from(signedText), crypto.createPublicKey(privateKey), sig)) {
+    console.error('❌ La firma no verifica con su propia clave pública');
+    process.exit(1);
+  }
+
+  const latest = { enabled: true, version, url, size: image.length, sha256, sig: sig.toString('hex') };
+  console.log(`🔏 ${signedText}`);
+  console.log(`   Clave pública: ${publicKeyHex(privateKey)}`);
+  if (dryRun) {
+    console.log(JSON.stringify(latest, null, 2));
+    return;
+  }
+
+  const admin = require('firebase-admin');
+  const serviceAccount = require('../wilobu-d21b2-firebase-adminsdk-fbsvc-52fafed2bc.json');
+  admin.initializeApp({
+    credential: admin.credential.cert(serviceAccount),
+  });
+  await admin.firestore().collection('firmware').doc('latest').set(latest);
+  console.log(`✅ firmware/latest -> ${version} (${image.length} bytes)`);
+  process.exit(0);
+}
+
+const [command, ...args] = process.argv.slice(2);
+if (command === 'keygen' && args.length === 1) {
+  keygen(args[0]);
+} else if (command === 'publish' && (args.length === 4 || (args.length === 5 && args[4] === '--dry-run'))) {
+  publish(args[0], args[1], args[2], args[3], args[4] === '--dry-run').catch((error) => {
+    console.error('❌ Error:', error);
+    process.exit(1);
+  });
+} else {
+  console.log('Uso: node sign_firmware.js keygen <clave.pem>');
+  console.log('     node sign_firmware.js publish <clave.pem> <versión> <url https> <firmware.bin> [--dry-run]');
+  process.exit(1);
+}
@@ -398,8 +398,20 @@ class SosAlertPage extends ConsumerWidget {
                         const SizedBox(height: 12),
 
                         OutlinedButton.icon(
-                          onPressed: () {
-                            Navigator.of(context).pop();
+                          onPressed: () async {
+                            // Pide al dispositivo terminar el seguimiento en vivo
+                            // (lo recibe en su próximo envío de posición)
+                            try {
+                              await ref.read(firestoreProvider)
+                                  .collection('users')
+                                  .doc(userId)
+                                  .collection('devices')
+                                  .doc(deviceId)
+                                  .update({'sosClearRequested': true});
+                            } catch (e) {
+                              debugPrint('[SOS] No se pudo cerrar la alerta: $e');
+                            }
+                            if (context.mounted) Navigator.of(context).pop();
                           },
                           icon: const Icon(Icons.close),
                           label: const Text('Cerrar Alerta'),
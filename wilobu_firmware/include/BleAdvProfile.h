@@ -0,0 +1,68 @@
+#ifndef BLE_ADV_PROFILE_H
+#define BLE_ADV_PROFILE_H
+
+#include <Arduino.h>
+
+// ===== PERFIL DE RADIO BLE PARA APROVISIONAMIENTO =====
+// Publicidad: intervalos en unidades de 0.625 ms (valores recomendados por Apple)
+#define BLE_ADV_FAST_MS          30000UL // Fase rápida tras pulsar: la app suele estar escaneando ya
+#define BLE_ADV_FAST_MIN_ITVL    32      // 20 ms
+#define BLE_ADV_FAST_MAX_ITVL    48      // 30 ms
+#define BLE_ADV_SLOW_MIN_ITVL    1636    // 1022.5 ms
+#define BLE_ADV_SLOW_MAX_ITVL    2056    // 1285 ms
+
+// Conexión: intervalos en unidades de 1.25 ms, timeout en unidades de 10 ms
+#define BLE_CONN_FAST_MIN_ITVL   6       // 7.5 ms: descubrimiento + escritura del blob
+#define BLE_CONN_FAST_MAX_ITVL   12      // 15 ms
+#define BLE_CONN_FAST_LATENCY    0
+#define BLE_CONN_IDLE_MIN_ITVL   80      // 100 ms: solo quedan notificaciones de progreso
+#define BLE_CONN_IDLE_MAX_ITVL   160     // 200 ms
+#define BLE_CONN_IDLE_LATENCY    4
+#define BLE_CONN_TIMEOUT         400     // 4 s
+
+// Corriente media estimada del radio por fase (mA; sin la CPU, que ya mide EnergyMeter)
+#define BLE_MA_ADV_FAST          8.0f    // +3 dBm cada ~25 ms
+#define BLE_MA_ADV_SLOW          0.4f    // -3 dBm cada ~1.15 s
+#define BLE_MA_CONN_FAST         5.0f
+#define BLE_MA_CONN_IDLE         0.6f
+
+// === CONTABILIDAD DEL PERFIL BLE ===
+// main.cpp aplica intervalos y potencia en NimBLE; aquí se lleva la fase
+// vigente, el tiempo en cada una, el tiempo hasta la conexión según la fase en
+// que llegó y la energía estimada. Las fases de conexión se cuentan aparte
+// para ver cuánto cuesta esperar la confirmación del backend conectado.
+class BleAdvProfile {
+public:
+    enum Phase : uint8_t { ADV_FAST, ADV_SLOW, CONN_FAST, CONN_IDLE, PHASE_COUNT, OFF = PHASE_COUNT };
+
+    void sessionStart(uint32_t nowMs);
+    void sessionEnd(uint32_t nowMs);
+    void advertise(uint32_t nowMs);           // (Re)inicio de publicidad: fase rápida
+    void enter(Phase p, uint32_t nowMs);
+    // Fija CONN_FAST y devuelve ms desde el último inicio de publicidad
+    uint32_t onConnect(uint32_t nowMs);
+    void onDisconnect(uint32_t nowMs) { enter(OFF, nowMs); }
+
+    Phase phase() const { return current; }
+    static const char* phaseName(Phase p);
+    static float phaseMilliamps(Phase p);
+    void print(uint32_t nowMs) const;
+
+private:
+    Phase current = OFF;
+    uint32_t phaseSinceMs = 0;
+    uint32_t advStartMs = 0;
+    uint32_t sessionStartMs = 0;
+    uint16_t sessions = 0;
+    uint32_t totalMs[PHASE_COUNT] = {};
+
+    // Tiempo hasta conectar, por fase de publicidad en que llegó la conexión
+    uint16_t connects[2] = {};
+    uint32_t ttcSumMs[2] = {};
+    uint32_t ttcMinMs[2] = {0xFFFFFFFFUL, 0xFFFFFFFFUL};
+    uint32_t ttcMaxMs[2] = {};
+
+    uint32_t phaseMs(uint8_t p, uint32_t nowMs) const;
+};
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef BOOT_PROFILER_H
+#define BOOT_PROFILER_H
+
+#include <Arduino.h>
+
+// ===== PARÁMETROS DEL PERFIL DE ARRANQUE =====
+#define BOOT_PROFILE_MAX_MARKS  16
+#define BOOT_PROFILE_BAR_MS     250     // Un '#' de la barra por cada tramo de este largo
+#define BOOT_PROFILE_BAR_MAX    40
+
+// === PERFIL DE ARRANQUE ===
+// Cada mark() cierra una fase con su marca de millis() (cuenta desde que arranca
+// la app; ROM y bootloader quedan fuera, ~300 ms). close() congela la línea de
+// tiempo y la imprime; después mark() no hace nada, así las funciones que también
+// corren fuera del arranque (setupModem en una recuperación) pueden marcar sin condiciones.
+// Las fases se nombran con literales: solo se guarda el puntero.
+class BootProfiler {
+public:
+    void mark(const char* phase);
+    void close();
+    bool isOpen() const { return open; }
+    // Marca de una fase ya registrada (0 si no ocurrió)
+    uint32_t at(const char* phase) const;
+    void print() const;
+
+private:
+    struct Mark {
+        const char* phase;
+        uint32_t atMs;
+    };
+    Mark marks[BOOT_PROFILE_MAX_MARKS];
+    uint8_t count = 0;
+    bool open = true;
+};
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef BUTTON_INPUT_H
+#define BUTTON_INPUT_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/timers.h>
+
+// ===== PARÁMETROS DE BOTONES =====
+#define BUTTON_COUNT            3
+#define BUTTON_DEBOUNCE_MS      50UL    // Nivel estable este tiempo tras el último flanco
+#define BUTTON_TICK_MS          10UL    // Periodo del timer de software (solo corre con actividad)
+#define BUTTON_HOLD_SOS_MS      3000UL  // Mantener = alerta SOS
+#define BUTTON_HOLD_PAIR_MS     5000UL  // Mantener SOS sin aprovisionar = vinculación
+#define BUTTON_EDGE_QUEUE       16      // Flancos crudos pendientes (ISR -> timer)
+#define BUTTON_EVENT_QUEUE      8       // Eventos ya filtrados (timer -> tarea de entrada)
+
+// Evento ya filtrado: atMs es el instante real de la detección, no el de lectura
+struct ButtonEvent {
+    enum class Type : uint8_t { PRESS, HOLD, RELEASE };
+    uint8_t button;          // Índice en el arreglo de pines de begin()
+    Type type;
+    uint32_t atMs;
+    uint32_t heldMs;    // HOLD: umbral alcanzado; RELEASE: duración total
+};
+
+// === BOTONES POR INTERRUPCIÓN ===
+// Cada cambio entra por ISR con su timestamp a una cola circular. La interrupción
+// es por nivel y la ISR la invierte en cada disparo: equivale a un flanco y además
+// sirve como fuente de wake de light sleep (el wake por GPIO exige nivel). Un timer de
+// software de FreeRTOS (tarea del sistema, no el loop) aplica el antirrebote y
+// evalúa los umbrales de 3 s / 5 s, así la detección sigue siendo exacta aunque
+// el loop esté bloqueado dentro de una transacción con el módem.
+// La tarea de entrada (main.cpp) consume eventos con poll() y decide la acción.
+class ButtonInput {
+public:
+    void begin(const uint8_t* pins, uint8_t count);
+    bool poll(ButtonEvent& ev, TickType_t wait = 0);
+    bool isPressed(uint8_t button) const;
+    uint32_t droppedEdges() const { return edgesDropped; }
+    bool isBusy() const { return ticking; }     // Antirrebote o mantenido en curso
+    // Primer flanco -> evento PRESS (antirrebote incluido): verifica la respuesta con light sleep
+    uint32_t maxPressLatencyMs() const { return pressLatencyMaxMs; }
+    uint32_t lastPressLatencyMs() const { return pressLatencyLastMs; }
+
+private:
+    struct Edge {
+        uint8_t button;
+        uint8_t level;
+        uint32_t atMs;
+    };
+    struct State {
+        uint8_t pin;
+        uint8_t rawLevel;              // Último nivel visto por la ISR
+        uint8_t stableLevel;           // Nivel tras el antirrebote
+        uint32_t lastEdgeMs;
+        uint32_t pressStartMs;    // Primer flanco de la ráfaga de bajada
+        uint8_t holdsFired;            // Bits: 1 = 3 s, 2 = 5 s
+        bool settling;
+    };
+
+    struct IsrArg {
+        ButtonInput* self;
+        uint8_t button;
+    };
+
+    State buttons[BUTTON_COUNT];
+    IsrArg isrArgs[BUTTON_COUNT];
+    uint8_t buttonCount = 0;
+
+    Edge edges[BUTTON_EDGE_QUEUE];
+    volatile uint8_t edgeHead = 0;
+    volatile uint8_t edgeTail = 0;
+    volatile uint32_t edgesDropped = 0;
+    portMUX_TYPE edgeMux = portMUX_INITIALIZER_UNLOCKED;
+
+    QueueHandle_t events = nullptr;
+    TimerHandle_t tickTimer = nullptr;
+    volatile bool ticking = false;     // Timer armado (one-shot que se re-arma mientras haya actividad)
+    uint32_t pressLatencyMaxMs = 0;
+    uint32_t pressLatencyLastMs = 0;
+
+    static void onEdge(void* arg);
+    static void onTick(TimerHandle_t timer);
+    void pushEdge(uint8_t button, uint8_t level, uint32_t atMs);
+    void tick();
+    void emit(uint8_t button, ButtonEvent::Type type, uint32_t atMs, uint32_t heldMs);
+};
+
+#endif
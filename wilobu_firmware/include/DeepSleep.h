@@ -0,0 +1,54 @@
+#ifndef DEEP_SLEEP_H
+#define DEEP_SLEEP_H
+
+#include "IModem.h"
+
+// ===== PARÁMETROS DE DEEP SLEEP =====
+#define SLEEP_MIN_AWAKE_MS      20000UL   // Ventana mínima despierto (serial, LEDs, botón tras wake)
+#define SLEEP_MAX_AWAKE_MS      180000UL  // Tope por ciclo si el heartbeat no sale: se reintenta al despertar
+#define SLEEP_MIN_SLEEP_MS      5000UL    // No dormir por menos de esto
+#define RTC_RUNTIME_MAGIC       0x57525432UL  // "WRT2" (cambia con el formato)
+
+// Estado de ejecución que sobrevive al deep sleep (RTC slow memory).
+// Se pierde con un corte de energía: en ese caso se arranca en frío desde NVS.
+// La configuración persistente tiene su propio espejo RTC (DeviceConfig).
+struct RtcRuntime {
+    uint32_t magic;
+    uint32_t wakeCount;
+    // Marcas de tiempo en reloj RTC (rtcClockMs): millis() vuelve a 0 al despertar
+    uint64_t lastHeartbeatRtcMs;
+    uint64_t lastLocationUploadRtcMs;
+    uint64_t lastFixRtcMs;
+    uint32_t modemBaud;           // Baudrate que respondió: sin barrido al despertar
+    uint8_t modemRegistered;      // El módem quedó registrado y con PDP activo al dormir
+    uint8_t lastHeartbeatOk;
+    int8_t ext0Pin;               // EXT0 no informa el pin que despertó: se recuerda aquí
+    char deviceId[16];
+    GPSLocation lastLocation;     // timestamp se reconstruye desde lastFixRtcMs
+    GPSLocation lastUploadedLocation;
+};
+
+enum class WakeReason : uint8_t { COLD, TIMER, BUTTON };
+
+// === DEEP SLEEP CON WAKE POR TIMER Y BOTÓN ===
+// El ESP32 (esp32dev) solo puede despertar con pines RTC. Con botones activos
+// en bajo, EXT1 en el ESP32 clásico solo admite ALL_LOW, así que cada botón va
+// por su propia fuente: el primero por EXT0 y el resto como máscara EXT1 de un
+// solo pin. Los pines que no son RTC (p.ej. GPIO5) no pueden despertar.
+class DeepSleep {
+public:
+    // Lee la causa del wake; valid() indica si la copia en RTC es utilizable
+    static WakeReason wakeReason();
+    static int wakePin();                         // GPIO que despertó (-1 si no fue botón)
+    static bool valid();
+    static RtcRuntime& state();
+    static void invalidate();                     // Factory reset: próximo arranque en frío
+
+    // Reloj que sigue corriendo durante el deep sleep (millis() se reinicia)
+    static uint64_t rtcClockMs();
+
+    // Configura fuentes de wake y duerme; no retorna
+    static void start(uint32_t sleepMs, const uint8_t* wakePins, uint8_t count);
+};
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef DEVICE_CONFIG_H
+#define DEVICE_CONFIG_H
+
+#include <Arduino.h>
+
+// ===== PARÁMETROS DE CONFIGURACIÓN PERSISTENTE =====
+#define CONFIG_NVS_NS           "wilobu"
+#define CONFIG_NVS_KEY          "cfg"
+#define CONFIG_MAGIC            0x57434647UL    // "WCFG"
+#define CONFIG_VERSION          1               // Subir al cambiar ConfigData (y migrar en load())
+#define CONFIG_SMS_KEY_BYTES    16
+
+// Configuración tipada: una sola copia en RAM, un solo blob en NVS
+struct ConfigData {
+    uint8_t provisioned;
+    int8_t logLevel;            // 0=ERROR, 1=INFO, 2=DEBUG
+    uint8_t sosMultipath;       // SMS en paralelo al POST de las alertas
+    uint8_t psm;                // PSM/eDRX del módem
+    uint8_t energyInHeartbeat;  // Reporte de energía en cada heartbeat
+    uint8_t reserved[3];
+    int32_t httpStatus;         // Último status HTTP (diagnóstico; -1 = ninguno)
+    char ownerUid[64];
+    char modemApn[32];          // "" = APN universal
+    char smsGateway[20];
+    char endpoint[96];          // Base de las Cloud Functions ("" = la de fábrica)
+    uint8_t smsKey[CONFIG_SMS_KEY_BYTES];   // Clave del tag SMS de este dispositivo (ceros = sin clave)
+};
+
+// Formato en NVS y en RTC: se descarta entero si no coincide magic, versión, tamaño o CRC
+struct ConfigBlob {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t size;
+    uint32_t crc;
+    ConfigData data;
+};
+
+// === CACHÉ DE CONFIGURACIÓN ===
+// load() lee una vez (RTC tras deep sleep, si no el blob de NVS, si no migra
+// las claves sueltas de versiones anteriores) y el resto del firmware trabaja
+// sobre la copia en RAM. Los setters solo marcan cambios; commit() escribe el
+// blob (magic + versión + CRC32) únicamente si el contenido cambió. El status
+// HTTP es diagnóstico: viaja con el siguiente commit en vez de forzar uno.
+class DeviceConfig {
+public:
+    enum class Source : uint8_t { DEFAULTS, RTC, NVS, MIGRATED };
+
+    Source load(const ConfigData& defaults);
+    const ConfigData& get() const { return data; }
+
+    void setOwner(const char* uid);     // También marca aprovisionado
+    void setLogLevel(int8_t level);
+    void setApn(const char* apn);
+    void setSmsGateway(const char* gateway);
+    void setEndpoint(const char* base);
+    void setSmsKey(const uint8_t* key);   // CONFIG_SMS_KEY_BYTES
+    void setSosMultipath(bool on);
+    void setPsm(bool on);
+    void setEnergyInHeartbeat(bool on);
+    void setHttpStatus(int status);
+
+    // true si escribió en NVS; withDiagnostics también guarda un status HTTP pendiente
+    bool commit(bool withDiagnostics = false);
+    void erase();                         // Factory reset: borra el namespace completo
+    static const char* sourceName(Source s);
+    void print() const;
+
+    // CRC32 (IEEE) del blob; también valida el blob de aprovisionamiento BLE
+    static uint32_t crc32(const uint8_t* buf, size_t len);
+
+private:
+    ConfigData data = {};
+    bool dirty = false;
+    bool diagDirty = false;
+    bool legacyKeys = false;      // Migrado: las claves viejas se borran con el primer commit
+    Source source = Source::DEFAULTS;
+    uint32_t writes = 0;
+
+    static bool valid(const ConfigBlob& blob);
+    void seal(ConfigBlob& blob) const;
+    bool migrateLegacy(const ConfigData& defaults);
+    void copyString(char* dst, size_t cap, const char* src);
+};
+
+#endif
@@ -0,0 +1,156 @@
+#ifndef DIAG_FRAME_H
+#define DIAG_FRAME_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// ===== FORMATO DE LAS TRAMAS DE DIAGNÓSTICO BLE =====
+// Compartido con el decodificador del host (tools/diag_decoder.cpp): solo
+// <stdint.h>, sin Arduino. Cada trama mide 20 bytes (cabe en una notificación
+// con el MTU mínimo de 23) y todos los enteros van en little-endian.
+//
+//   tipo (1) | seq (1) | uptime s (uint16, da la vuelta a las ~18 h) | cuerpo (16)
+//
+// El nibble alto del tipo es la versión del formato: un decodificador viejo
+// descarta lo que no conoce en vez de interpretarlo mal.
+#define DIAG_FRAME_LEN          20
+#define DIAG_FRAME_HEADER       4
+#define DIAG_FRAME_VERSION      1
+
+#define DIAG_TYPE_MODEM         0x11
+#define DIAG_TYPE_GNSS          0x12
+#define DIAG_TYPE_SYSTEM        0x13
+
+#define DIAG_AT_RECENT          3
+#define DIAG_HTTP_RECENT        2
+#define DIAG_CSQ_UNKNOWN        99      // Mismo valor que AT+CSQ sin medición
+
+struct DiagHeader {
+    uint8_t type;
+    uint8_t seq;                        // Una sola secuencia para los tres tipos: huecos = notificaciones perdidas
+    uint16_t uptimeS;
+};
+
+// Latencias AT (la más reciente primero), status HTTP y señal
+struct DiagModem {
+    uint16_t atRecentMs[DIAG_AT_RECENT];
+    uint16_t atMaxMs;
+    uint8_t atTimeouts;                 // Saturado en 255
+    uint8_t csq;                        // 0-31, DIAG_CSQ_UNKNOWN = sin dato
+    int16_t httpRecent[DIAG_HTTP_RECENT];   // 0 = sin petición, -1 = sin +HTTPACTION, -2 = no salió
+    uint16_t httpLastMs;                // HTTPACTION -> +HTTPACTION de la última petición
+};
+
+struct DiagGnss {
+    uint8_t state;                      // 0 apagado, 1 adquiriendo, 2 con fix vigente
+    uint8_t motion;                     // 0 desconocido, 1 quieto, 2 en movimiento
+    uint16_t fixes;
+    uint16_t ttffS;                     // Último TTFF medido (o el supuesto inicial)
+    uint16_t fixAgeS;                   // 0xFFFF = nunca hubo fix
+    uint16_t intervalS;                 // Intervalo adaptativo vigente
+    uint16_t accuracyDm;                // Precisión del último fix, decímetros (0xFFFF sin fix)
+    uint32_t onTotalS;                  // GNSS encendido acumulado
+};
+
+struct DiagSystem {
+    uint32_t heapFree;
+    uint32_t heapMaxBlock;
+    uint32_t heapMinFree;
+    uint8_t inputQueue;                 // Acciones de botón esperando a la tarea del módem
+    uint8_t outbox;                     // Alertas SOS sin 2xx
+    uint8_t jobsArmed;
+    uint8_t fsmState;                   // DeviceState
+};
+
+// ===== CODIFICACIÓN =====
+inline void diagPut16(uint8_t* p, uint16_t v) { p[0] = v & 0xFF; p[1] = v >> 8; }
+inline void diagPut32(uint8_t* p, uint32_t v) { diagPut16(p, v & 0xFFFF); diagPut16(p + 2, v >> 16); }
+inline uint16_t diagGet16(const uint8_t* p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+inline uint32_t diagGet32(const uint8_t* p) { return diagGet16(p) | ((uint32_t)diagGet16(p + 2) << 16); }
+
+inline void diagEncodeHeader(const DiagHeader& h, uint8_t* out) {
+    out[0] = h.type;
+    out[1] = h.seq;
+    diagPut16(out + 2, h.uptimeS);
+}
+
+inline void diagEncodeModem(const DiagHeader& h, const DiagModem& m, uint8_t out[DIAG_FRAME_LEN]) {
+    diagEncodeHeader(h, out);
+    uint8_t* p = out + DIAG_FRAME_HEADER;
+    for (uint8_t i = 0; i < DIAG_AT_RECENT; i++, p += 2) diagPut16(p, m.atRecentMs[i]);
+    diagPut16(p, m.atMaxMs); p += 2;
+    *p++ = m.atTimeouts;
+    *p++ = m.csq;
+    for (uint8_t i = 0; i < DIAG_HTTP_RECENT; i++, p += 2) diagPut16(p, (uint16_t)m.httpRecent[i]);
+    diagPut16(p, m.httpLastMs);
+}
+
+inline void diagEncodeGnss(const DiagHeader& h, const DiagGnss& g, uint8_t out[DIAG_FRAME_LEN]) {
+    diagEncodeHeader(h, out);
+    uint8_t* p = out + DIAG_FRAME_HEADER;
+    *p++ = g.state;
+    *p++ = g.motion;
+    diagPut16(p, g.fixes); p += 2;
+    diagPut16(p, g.ttffS); p += 2;
+    diagPut16(p, g.fixAgeS); p += 2;
+    diagPut16(p, g.intervalS); p += 2;
+    diagPut16(p, g.accuracyDm); p += 2;
+    diagPut32(p, g.onTotalS);
+}
+
+inline void diagEncodeSystem(const DiagHeader& h, const DiagSystem& s, uint8_t out[DIAG_FRAME_LEN]) {
+    diagEncodeHeader(h, out);
+    uint8_t* p = out + DIAG_FRAME_HEADER;
+    diagPut32(p, s.heapFree); p += 4;
+    diagPut32(p, s.heapMaxBlock); p += 4;
+    diagPut32(p, s.heapMinFree); p += 4;
+    *p++ = s.inputQueue;
+    *p++ = s.outbox;
+    *p++ = s.jobsArmed;
+    *p = s.fsmState;
+}
+
+// ===== DECODIFICACIÓN =====
+// false si el largo no es el de una trama o la versión no es la conocida
+inline bool diagDecodeHeader(const uint8_t* buf, size_t len, DiagHeader& h) {
+    if (len != DIAG_FRAME_LEN || (buf[0] >> 4) != DIAG_FRAME_VERSION) return false;
+    h.type = buf[0];
+    h.seq = buf[1];
+    h.uptimeS = diagGet16(buf + 2);
+    return true;
+}
+
+inline void diagDecodeModem(const uint8_t* buf, DiagModem& m) {
+    const uint8_t* p = buf + DIAG_FRAME_HEADER;
+    for (uint8_t i = 0; i < DIAG_AT_RECENT; i++, p += 2) m.atRecentMs[i] = diagGet16(p);
+    m.atMaxMs = diagGet16(p); p += 2;
+    m.atTimeouts = *p++;
+    m.csq = *p++;
+    for (uint8_t i = 0; i < DIAG_HTTP_RECENT; i++, p += 2) m.httpRecent[i] = (int16_t)diagGet16(p);
+    m.httpLastMs = diagGet16(p);
+}
+
+inline void diagDecodeGnss(const uint8_t* buf, DiagGnss& g) {
+    const uint8_t* p = buf + DIAG_FRAME_HEADER;
+    g.state = *p++;
+    g.motion = *p++;
+    g.fixes = diagGet16(p); p += 2;
+    g.ttffS = diagGet16(p); p += 2;
+    g.fixAgeS = diagGet16(p); p += 2;
+    g.intervalS = diagGet16(p); p += 2;
+    g.accuracyDm = diagGet16(p); p += 2;
+    g.onTotalS = diagGet32(p);
+}
+
+inline void diagDecodeSystem(const uint8_t* buf, DiagSystem& s) {
+    const uint8_t* p = buf + DIAG_FRAME_HEADER;
+    s.heapFree = diagGet32(p); p += 4;
+    s.heapMaxBlock = diagGet32(p); p += 4;
+    s.heapMinFree = diagGet32(p); p += 4;
+    s.inputQueue = *p++;
+    s.outbox = *p++;
+    s.jobsArmed = *p++;
+    s.fsmState = *p;
+}
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef ENERGY_METER_H
+#define ENERGY_METER_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+// ===== MODELO DE CORRIENTE POR DEFECTO (tier B: ESP32 + A7670SA), mA =====
+#define ENERGY_MA_CPU_AWAKE     50.0f   // ESP32 despierto (240 MHz)
+#define ENERGY_MA_CPU_SLEEP     0.8f    // ESP32 en light sleep
+#define ENERGY_MA_MODEM_IDLE    18.0f   // A7670SA registrado sin tráfico (sin DTR no entra en sleep)
+#define ENERGY_MA_MODEM_TX      180.0f  // Transacción LTE Cat-1 (promedio de ráfagas)
+#define ENERGY_MA_GNSS          35.0f   // Motor GNSS del A7670SA encendido
+#define ENERGY_MA_BLE_ADV       12.0f   // Publicidad BLE (peor caso: fase rápida; el detalle por fase en BleAdvProfile)
+#define ENERGY_NVS_NS           "wilobu_energy"
+
+// === CONTABILIDAD DE ENERGÍA POR SUBSISTEMA ===
+// main.cpp marca cuándo entra/sale cada estado; el medidor acumula tiempos y
+// los pasa por el modelo de corriente (editable y guardado en NVS) para dar
+// mAh por hora de cada subsistema. Solo estimación: no hay medidor de corriente.
+class EnergyMeter {
+public:
+    enum Sub : uint8_t {
+        CPU_SLEEP,      // Lo que no es sleep cuenta como CPU despierta
+        MODEM_REG,      // Registrado (incluye las transacciones)
+        MODEM_TX,
+        GNSS,
+        BLE_ADV,
+        SUB_COUNT
+    };
+
+    void begin(uint32_t nowMs);
+    void set(Sub sub, bool on, uint32_t nowMs);
+    bool isOn(Sub sub) const { return on[sub]; }
+    void reset(uint32_t nowMs);
+
+    // Modelo de corriente: índice SUB_COUNT = CPU despierta
+    bool setModel(const String& name, float mA);
+    void printModel() const;
+
+    // mAh/h por subsistema (= corriente media) en la ventana actual
+    void print(uint32_t nowMs) const;
+    void fillJson(JsonDocument& doc, uint32_t nowMs) const;
+
+private:
+    bool on[SUB_COUNT] = {};
+    uint32_t sinceMs[SUB_COUNT] = {};
+    uint32_t totalMs[SUB_COUNT] = {};
+    uint32_t windowStartMs = 0;
+    float model[SUB_COUNT + 1];
+
+    uint32_t onTime(uint8_t sub, uint32_t nowMs) const;
+    // mAh/h de cada línea del reporte (CPU despierta, sleep, módem idle, TX, GNSS, BLE)
+    void averages(uint32_t nowMs, float* out, uint32_t* windowMs) const;
+};
+
+#endif
@@ -0,0 +1,114 @@
+#ifndef FIXED_STRING_H
+#define FIXED_STRING_H
+
+#include <Arduino.h>
+#include <stdarg.h>
+#include <string.h>
+
+// === CADENA DE CAPACIDAD FIJA ===
+// Reemplazo de String en rutas calientes (respuestas AT, URLs, comandos): el
+// buffer vive dentro del objeto (pila, miembro o estático) y nunca toca el heap.
+// Lo que no entra se descarta y queda marcado en truncated() en vez de crecer.
+template <size_t N>
+class FixedString {
+public:
+    FixedString() { clear(); }
+
+    void clear() {
+        len = 0;
+        buf[0] = '\0';
+        overflow = false;
+    }
+
+    bool append(char c) {
+        if (len + 1 >= N) { overflow = true; return false; }
+        buf[len++] = c;
+        buf[len] = '\0';
+        return true;
+    }
+
+    bool append(const char* s, size_t n) {
+        size_t room = N - 1 - len;
+        bool fits = n <= room;
+        if (!fits) { n = room; overflow = true; }
+        memcpy(buf + len, s, n);
+        len += n;
+        buf[len] = '\0';
+        return fits;
+    }
+
+    bool append(const char* s) { return append(s, strlen(s)); }
+
+    // Reemplaza el contenido (copia; lo que no entra queda truncado)
+    bool assign(const char* s, size_t n) {
+        clear();
+        return append(s, n);
+    }
+    FixedString& operator=(const char* s) {
+        assign(s, strlen(s));
+        return *this;
+    }
+
+    bool appendf(const char* fmt, ...) __attribute__((format(printf, 2, 3))) {
+        va_list args;
+        va_start(args, fmt);
+        int n = vsnprintf(buf + len, N - len, fmt, args);
+        va_end(args);
+        if (n < 0) { buf[len] = '\0'; return false; }
+        if ((size_t)n >= N - len) {
+            len = N - 1;
+            overflow = true;
+            return false;
+        }
+        len += n;
+        return true;
+    }
+
+    // clear() + appendf()
+    bool printf(const char* fmt, ...) __attribute__((format(printf, 2, 3))) {
+        clear();
+        va_list args;
+        va_start(args, fmt);
+        int n = vsnprintf(buf, N, fmt, args);
+        va_end(args);
+        if (n < 0) { buf[0] = '\0'; return false; }
+        if ((size_t)n >= N) {
+            len = N - 1;
+            overflow = true;
+            return false;
+        }
+        len = n;
+        return true;
+    }
+
+    int indexOf(const char* token, size_t from = 0) const {
+        if (from >= len) return -1;
+        const char* p = strstr(buf + from, token);
+        return p ? (int)(p - buf) : -1;
+    }
+    int indexOf(char c, size_t from = 0) const {
+        if (from >= len) return -1;
+        const char* p = strchr(buf + from, c);
+        return p ? (int)(p - buf) : -1;
+    }
+    int lastIndexOf(char c) const {
+        const char* p = strrchr(buf, c);
+        return p ? (int)(p - buf) : -1;
+    }
+    bool contains(const char* token) const { return strstr(buf, token) != nullptr; }
+    bool equals(const char* s) const { return strcmp(buf, s) == 0; }
+
+    const char* c_str() const { return buf; }
+    size_t length() const { return len; }
+    bool isEmpty() const { return len == 0; }
+    bool truncated() const { return overflow; }
+    static size_t capacity() { return N - 1; }
+    char operator[](size_t i) const { return i < len ? buf[i] : '\0'; }
+
+private:
+    char buf[N];
+    size_t len;
+    bool overflow;
+};
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef GEOFENCE_H
+#define GEOFENCE_H
+
+#include "IModem.h"
+
+// ===== LÍMITES DE GEOCERCAS =====
+#define GEOFENCE_MAX             8      // Geocercas por dispositivo
+#define GEOFENCE_MAX_VERTICES    12     // Vértices por polígono
+#define GEOFENCE_MAX_ACCURACY_M  50.0f  // Fixes menos precisos no cambian estado
+#define GEOFENCE_CONFIRM_FIXES   2      // Fixes consecutivos para confirmar un cruce
+#define GEOFENCE_BLOB_VERSION    1      // Formato del blob en NVS
+#define GEOFENCE_NVS_KEY         "geofences"
+
+enum class GeofenceType : uint8_t { CIRCLE = 1, POLYGON = 2 };
+
+// Coordenadas en microgrados (int32): ~0.11 m de resolución y aritmética entera exacta
+struct Geofence {
+    uint16_t id;
+    GeofenceType type;
+    uint8_t vertexCount;                    // 1 para círculo (centro)
+    uint16_t radiusM;                       // Solo círculo
+    int32_t latE6[GEOFENCE_MAX_VERTICES];
+    int32_t lonE6[GEOFENCE_MAX_VERTICES];
+
+    // Derivados en RAM (no se guardan en NVS)
+    int32_t cosQ15;                         // cos(lat centro) en Q15 para escalar longitud
+    int64_t radiusSqE6;                     // radio² en microgrados²
+    int8_t inside;                          // -1 desconocido, 0 fuera, 1 dentro
+    uint8_t pendingCount;                   // Fixes seguidos contradiciendo 'inside'
+};
+
+struct GeofenceEvent {
+    uint16_t id;
+    bool entered;
+};
+
+// === CONJUNTO DE GEOCERCAS DEL DISPOSITIVO ===
+// Llegan en la respuesta del heartbeat ({"geofences":{"v":N,"f":[...]}}) y se
+// guardan como un único blob compacto en NVS. Cada fix se evalúa con enteros.
+class JsonArena;
+
+class GeofenceSet {
+public:
+    bool load();
+    bool save() const;
+    void clear();
+
+    // Aplica la lista enviada por el backend; true si cambió (hay que guardar).
+    // Con arena, el documento toma sus pools de ahí en vez del heap
+    bool applyJson(const char* body, JsonArena* arena = nullptr);
+
+    // Devuelve cuántos cruces confirmados produjo este fix
+    uint8_t evaluate(const GPSLocation& fix, GeofenceEvent* events, uint8_t maxEvents);
+    bool hasPendingCrossing() const;
+
+    uint16_t version() const { return setVersion; }
+    uint8_t count() const { return fenceCount; }
+    void print() const;
+
+    static bool pointInPolygon(int32_t latE6, int32_t lonE6,
+                               const int32_t* latsE6, const int32_t* lonsE6, uint8_t n);
+
+private:
+    Geofence fences[GEOFENCE_MAX];
+    uint8_t fenceCount = 0;
+    uint16_t setVersion = 0;
+
+    bool applyDoc(JsonDocument& doc, const char* json, size_t len);
+    void derive(Geofence& f);
+    bool contains(const Geofence& f, int32_t latE6, int32_t lonE6) const;
+};
+
+#endif
@@ -0,0 +1,95 @@
+#ifndef GNSS_SCHEDULER_H
+#define GNSS_SCHEDULER_H
+
+#include "IModem.h"
+
+// ===== PARÁMETROS DEL CICLO DE TRABAJO GNSS =====
+#define GNSS_INTERVAL_MIN_MS          10000UL  // Intervalo mínimo en movimiento rápido
+#define GNSS_INTERVAL_WALKING_MS      15000UL  // Movimiento sin velocidad fiable (solo desplazamiento)
+#define GNSS_INTERVAL_STATIONARY_MS   30000UL  // Primer intervalo estando quieto
+#define GNSS_INTERVAL_MAX_MS          300000UL // Techo del backoff estacionario (5 min, = heartbeat Tier B)
+#define GNSS_KEEP_ON_MAX_MS           60000UL  // Por encima de esto se apaga el GNSS entre muestras
+#define GNSS_ACQ_POLL_MS              2000UL   // Sondeo mientras se adquiere fix
+#define GNSS_ACQ_TIMEOUT_MS           60000UL  // Máximo encendido buscando fix antes de rendirse
+#define GNSS_TARGET_SPACING_M         25.0f    // Distancia objetivo entre muestras en movimiento
+#define GNSS_MOVING_SPEED_KMH         3.0f     // Velocidad a partir de la cual se considera movimiento
+#define GNSS_MOVING_DISPLACEMENT_M    30.0f    // Desplazamiento mínimo entre fixes para considerar movimiento
+#define GNSS_TURN_DEG                 45.0f    // Cambio de rumbo que fuerza el intervalo mínimo
+#define GNSS_POWER_RETRY_1_MS         5000UL   // Backoff del encendido GNSS: 1er fallo
+#define GNSS_POWER_RETRY_2_MS         30000UL  // 2do fallo
+#define GNSS_POWER_RETRY_MAX_MS       300000UL // 3ro en adelante
+
+// === PLANIFICADOR ADAPTATIVO DE GNSS ===
+// Decide cuándo muestrear y si el GNSS debe quedar encendido entre muestras.
+// No toca el módem: el llamador enciende/apaga el GNSS según wantsPower().
+// Todos los tiempos se inyectan (nowMs) para poder simularlo sin millis().
+class GnssScheduler {
+public:
+    enum class Motion : uint8_t { UNKNOWN, STATIONARY, MOVING };
+
+    void begin(uint32_t nowMs);
+
+    // true si toca intentar una muestra
+    bool isDue(uint32_t nowMs) const { return (nowMs - lastEvalMs) >= waitMs; }
+    uint32_t msUntilDue(uint32_t nowMs) const {
+        uint32_t elapsed = nowMs - lastEvalMs;
+        return elapsed >= waitMs ? 0 : waitMs - elapsed;
+    }
+
+    // Resultado de la muestra
+    void onFix(const GPSLocation& fix, uint32_t nowMs);
+    void onNoFix(uint32_t nowMs);
+
+    // Adelanta la próxima muestra a como mucho withinMs (0 = inmediata).
+    // Nunca la retrasa: ej. ventana previa al heartbeat o cruce de geocerca pendiente.
+    void requestSample(uint32_t nowMs, uint32_t withinMs = 0) {
+        uint32_t elapsed = nowMs - lastEvalMs;
+        if (elapsed >= waitMs || waitMs - elapsed <= withinMs) return;
+        lastEvalMs = nowMs;
+        waitMs = withinMs;
+    }
+
+    // Contabilidad de energía: informar cada cambio real de alimentación del GNSS
+    void setPowered(bool on, uint32_t nowMs);
+
+    bool wantsPower() const { return keepPowered; }
+    bool isPowered() const { return powered; }
+    bool isAcquiring() const { return acquiring; }
+    uint32_t intervalMs() const { return waitMs; }
+    Motion motion() const { return state; }
+
+    uint32_t gnssOnMs(uint32_t nowMs) const { return onAccumMs + (powered ? nowMs - poweredSinceMs : 0); }
+    uint32_t fixCount() const { return fixes; }
+
+    static float distanceMeters(float lat1, float lon1, float lat2, float lon2);
+    // Espera antes de reintentar el encendido del GNSS tras failCount fallos seguidos
+    static uint32_t powerRetryDelayMs(uint8_t failCount);
+
+private:
+    Motion state = Motion::UNKNOWN;
+    uint32_t lastEvalMs = 0;
+    uint32_t waitMs = 0;
+    bool keepPowered = true;
+
+    // Adquisición en curso
+    bool acquiring = false;
+    uint32_t acqStartMs = 0;
+    uint8_t acqFailures = 0;
+
+    // Referencia para desplazamiento (anclada mientras está quieto)
+    bool hasRef = false;
+    float refLat = 0.0f;
+    float refLon = 0.0f;
+    float lastCourse = -1.0f;
+    uint8_t stationaryStreak = 0;
+
+    // Estadísticas
+    bool powered = false;
+    uint32_t poweredSinceMs = 0;
+    uint32_t onAccumMs = 0;
+    uint32_t fixes = 0;
+
+    void schedule(uint32_t nowMs, uint32_t intervalMs);
+};
+
+#endif
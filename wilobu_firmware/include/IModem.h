@@ -2,6 +2,19 @@
 #define IMODEM_H
 
 #include <Arduino.h>
+#include <ArduinoJson.h>
+#include "PowerSaving.h"
+#include "FixedString.h"
+
+#define HTTP_BODY_MAX       2048    // Cuerpo de la última respuesta (con eco AT)
+#define SMS_NUMBER_MAX      20
+#define SMS_TEXT_MAX        161     // Un SMS de 160 caracteres
+
+typedef FixedString<HTTP_BODY_MAX> HttpBody;
+
+struct OtaManifest;
+class OtaUpdater;
+class JsonArena;
 
 // === MÁQUINA DE ESTADOS ===
 enum class DeviceState {
@@ -11,7 +24,8 @@ enum class DeviceState {
     SOS_GENERAL,    // Alerta general
     SOS_MEDICA,     // Alerta médica
     SOS_SEGURIDAD,  // Alerta de seguridad
-    OTA_UPDATE      // Actualizando firmware
+    OTA_UPDATE,     // Actualizando firmware
+    LINKING         // UID recibido por BLE: la app termina la vinculación en Firestore
 };
 
 // === ESTRUCTURA DE POSICIÓN GPS ===
@@ -19,14 +33,43 @@ struct GPSLocation {
     float latitude;
     float longitude;
     float accuracy;
-    unsigned long timestamp;
+    uint32_t timestamp;
     bool isValid;
+    float speedKmh;     // Velocidad sobre el suelo (0 si el módem no la reporta)
+    float courseDeg;    // Rumbo 0-360 (válido solo en movimiento)
+};
+
+// === ESTADÍSTICAS DEL MÓDEM PARA DIAGNÓSTICO ===
+// Latencia de los comandos AT y resultado de las peticiones HTTP recientes;
+// el servicio de diagnóstico BLE las publica tal cual (DiagFrame.h)
+struct ModemDiagStats {
+    uint16_t atRecentMs[3];     // La más reciente primero
+    uint16_t atMaxMs;
+    uint8_t atTimeouts;         // Comandos sin respuesta final (saturado en 255)
+    int16_t httpRecent[2];      // Status HTTP, el más reciente primero (0 = ninguno)
+    uint16_t httpLastMs;        // HTTPACTION -> +HTTPACTION de la última petición
+
+    void recordAt(uint32_t ms, bool timedOut) {
+        uint16_t v = ms > 0xFFFF ? 0xFFFF : (uint16_t)ms;
+        atRecentMs[2] = atRecentMs[1];
+        atRecentMs[1] = atRecentMs[0];
+        atRecentMs[0] = v;
+        if (v > atMaxMs) atMaxMs = v;
+        if (timedOut && atTimeouts < 255) atTimeouts++;
+    }
+    void recordHttp(int status, uint32_t ms) {
+        httpRecent[1] = httpRecent[0];
+        httpRecent[0] = (int16_t)status;
+        httpLastMs = ms > 0xFFFF ? 0xFFFF : (uint16_t)ms;
+    }
 };
 
 // === CLASE ABSTRACTA BASE PARA MÓDEMS ===
 class IModem {
 public:
     virtual ~IModem() = default;
+
+    bool factoryResetPending = false;  // El backend pidió factory reset (cmd_reset)
     
     // ===== MÉTODOS DE INICIALIZACIÓN =====
     virtual bool init() = 0;
@@ -36,11 +79,19 @@ public:
     
     // ===== MÉTODOS DE ENVÍO DE DATOS =====
     virtual bool sendToFirebase(const String& path, const String& jsonData) = 0;
-    virtual bool sendSOSAlert(const String& deviceId, const String& ownerUid, const String& sosType, const GPSLocation& location) = 0;
-    virtual bool sendHeartbeat(const String& ownerUid, const String& deviceId, const GPSLocation& location) = 0;
+    // true solo con respuesta 2xx; extra: campos adicionales (ej. sosEpoch/sosSeq para deduplicar)
+    virtual bool sendSOSAlert(const char* deviceId, const char* ownerUid, const char* sosType, const GPSLocation& location,
+                              const JsonDocument* extra = nullptr) = 0;
+    // extra: campos adicionales que se fusionan en el JSON del heartbeat (opcional)
+    virtual bool sendHeartbeat(const char* ownerUid, const char* deviceId, const GPSLocation& location,
+                               const JsonDocument* extra = nullptr) = 0;
+    // Cuerpo de la última respuesta HTTP (incluye eco AT; buscar el JSON dentro)
+    virtual const HttpBody& getLastHttpBody() const = 0;
+    // Status de la última respuesta HTTP (-1 si no llegó ninguna)
+    virtual int getLastHttpStatus() const = 0;
     
     // ===== MÉTODO DE AUTO-RECUPERACIÓN =====
-    virtual String checkProvisioningStatus(const String& deviceId) = 0;
+    virtual String checkProvisioningStatus(const char* deviceId) = 0;
     
     // ===== MÉTODOS DE POSICIONAMIENTO =====
     virtual bool initGNSS() = 0;
@@ -48,13 +99,89 @@ public:
     virtual void disableGNSS() = 0;
     
     // ===== MÉTODOS DE GESTIÓN DE ENERGÍA =====
-    virtual void enableDeepSleep(unsigned long wakeupTimeSeconds) = 0;
+    // Prepara el módem para el deep sleep del ESP32: cierra sesiones y GNSS
+    // pero conserva registro y contexto PDP para reanudar sin reinicializar
+    virtual void enableDeepSleep(uint32_t wakeupTimeSeconds) = 0;
     virtual bool isDeepSleeping() = 0;
+    // Tras despertar: solo verifica AT y registro. Por defecto, arranque completo
+    virtual bool resume() { return init() && connect(); }
+    // PSM (AT+CPSMS) y eDRX (AT+CEDRXS): el módem conserva el registro entre
+    // envíos. Registra en el log lo que la red otorgó. Por defecto no soportado.
+    virtual bool configurePowerSaving(const PowerSavingRequest& req) { return false; }
+    // Tensión de alimentación medida por el módem (AT+CBC), en mV
+    virtual bool getBatteryMillivolts(uint16_t& mv) = 0;
+
+    // ===== DIAGNÓSTICO =====
+    // RSSI en unidades de AT+CSQ (0-31; 99 = sin medición). Por defecto no soportado.
+    virtual bool getSignalQuality(uint8_t& csq) { return false; }
+    // nullptr si el driver no lleva estadísticas
+    virtual const ModemDiagStats* getDiagStats() const { return nullptr; }
+    // Arena de los JsonDocument del driver (nullptr si usa el heap). Libre
+    // entre peticiones: main.cpp la usa para leer la última respuesta
+    virtual JsonArena* getJsonArena() { return nullptr; }
     
     // ===== MÉTODOS DE OTA (ACTUALIZACIÓN REMOTA) =====
-    virtual bool checkForUpdates() = 0;
-    virtual bool downloadFirmwareUpdate(const String& url) = 0;
-    virtual bool applyFirmwareUpdate() = 0;
+    // true si el backend publica una versión distinta de currentVersion
+    virtual bool checkForUpdates(const char* deviceId, const char* currentVersion, OtaManifest& manifest) = 0;
+    // Un rango de la imagen desde sink.offset(), en trozos de OTA_CHUNK_BYTES.
+    // Si falla, lo ya escrito queda en el sink y la siguiente llamada sigue desde ahí
+    virtual bool downloadFirmwareUpdate(const OtaManifest& manifest, OtaUpdater& sink) = 0;
+    // Cierra la sesión HTTP y verifica la imagen completa (sink.finish())
+    virtual bool applyFirmwareUpdate(OtaUpdater& sink) = 0;
+    
+    // ===== RUTA RÁPIDA SOS =====
+    // "Slot" listo mientras está online: cuerpos SOS pre-serializados y sesión
+    // HTTP con la URL ya configurada; al pulsar solo queda HTTPDATA + HTTPACTION.
+    // Por defecto no soportado: el llamador usa sendSOSAlert().
+    virtual bool prepareSosSlot(const char* deviceId, const char* ownerUid) { return false; }
+    virtual bool checkSosSlot() { return false; }
+    virtual bool sosSlotReady() const { return false; }
+    // Disparo 1 (sin ubicación) por el slot; true solo con 2xx
+    virtual bool sendSOSFast(uint8_t typeCode, uint32_t epoch, uint32_t seq) { return false; }
+
+    // ===== SMS =====
+    virtual bool sendSMS(const char* number, const char* text) = 0;
+
+    // SMS "armado" para despacho multicamino: el driver lo envía en cuanto el
+    // siguiente POST queda en vuelo (el módem acepta AT mientras espera la
+    // respuesta HTTP). Si el POST falla antes de salir, queda ARMED.
+    enum class SmsState : uint8_t { IDLE, ARMED, SENT, FAILED };
+    void armSms(const char* number, const char* text) {
+        smsNumber = number;
+        smsText = text;
+        smsStatus = SmsState::ARMED;
+    }
+    void disarmSms() { smsStatus = SmsState::IDLE; }
+    SmsState smsState() const { return smsStatus; }
+    uint32_t smsDoneMs() const { return smsAtMs; }   // Momento del +CMGS (o del fallo)
+
+    // Envía ya el SMS armado (si sigue pendiente)
+    void sendArmedSms() {
+        if (smsStatus != SmsState::ARMED) return;
+        smsStatus = sendSMS(smsNumber.c_str(), smsText.c_str()) ? SmsState::SENT : SmsState::FAILED;
+        smsAtMs = millis();
+    }
+
+    // ===== HOOK DE ESPERA =====
+    // Se invoca dentro de las esperas largas (HTTPACTION, registro, AT) para que
+    // la aplicación mantenga vivos los LEDs. El hook NO debe usar el módem.
+    void setIdleHook(void (*hook)()) { idleHook = hook; }
+
+protected:
+    void (*idleHook)() = nullptr;
+    FixedString<SMS_NUMBER_MAX> smsNumber;
+    FixedString<SMS_TEXT_MAX> smsText;
+    SmsState smsStatus = SmsState::IDLE;
+    uint32_t smsAtMs = 0;
+    
+    // delay() que sigue atendiendo el hook en tramos de 20 ms
+    void idle(uint32_t ms) {
+        uint32_t start = millis();
+        do {
+            if (idleHook) idleHook();
+            delay(ms < 20 ? ms : 20);
+        } while (millis() - start < ms);
+    }
 };
 
 #endif
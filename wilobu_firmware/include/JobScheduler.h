@@ -0,0 +1,65 @@
+#ifndef JOB_SCHEDULER_H
+#define JOB_SCHEDULER_H
+
+#include <Arduino.h>
+
+// ===== PARÁMETROS DEL PLANIFICADOR =====
+#define JOB_MAX                 12
+#define JOB_NONE                0xFF
+#define JOB_IDLE_FOREVER        0xFFFFFFFFUL    // msUntilNext() sin trabajos programados
+
+// === PLANIFICADOR DE TRABAJOS POR PLAZO ===
+// Min-heap indexado por vencimiento (millis, comparación segura ante el desborde).
+// Cada trabajo decide su próximo plazo: los periódicos se reprograman solos
+// antes de correr (la función puede moverlos con at()/in() o cancelarlos); los
+// de periodo 0 quedan cancelados tras correr hasta que alguien los vuelva a armar.
+// La tarea dueña duerme msUntilNext() en vez de sondear cada 100 ms.
+// Todos los tiempos se inyectan (nowMs) para poder simularlo sin millis().
+class JobScheduler {
+public:
+    typedef void (*JobFn)();
+
+    // Registra un trabajo; firstDelayMs = JOB_IDLE_FOREVER lo deja sin armar
+    uint8_t add(const char* name, JobFn fn, uint32_t periodMs,
+                uint32_t firstDelayMs, uint32_t nowMs);
+    void at(uint8_t id, uint32_t dueMs);
+    void in(uint8_t id, uint32_t delayMs, uint32_t nowMs) { at(id, nowMs + delayMs); }
+    void cancel(uint8_t id);
+    bool isArmed(uint8_t id) const { return id < jobCount && heapPos[id] != JOB_NONE; }
+    uint8_t armedCount() const { return heapSize; }
+
+    // Lo que falta de un intervalo iniciado en sinceMs (0 si venció). Solo
+    // restas sin signo: sigue siendo correcto cuando millis() desborda
+    static uint32_t remaining(uint32_t nowMs, uint32_t sinceMs, uint32_t periodMs) {
+        uint32_t elapsed = nowMs - sinceMs;
+        return elapsed >= periodMs ? 0 : periodMs - elapsed;
+    }
+
+    // Corre los vencidos en orden de plazo; devuelve cuántos corrieron
+    uint8_t runDue(uint32_t nowMs);
+    uint32_t msUntilNext(uint32_t nowMs) const;
+    void print(uint32_t nowMs) const;
+
+private:
+    struct Job {
+        const char* name;
+        JobFn fn;
+        uint32_t periodMs;
+        uint32_t dueMs;
+        uint32_t runs;
+        uint32_t maxLateMs;   // Peor retraso entre plazo y ejecución
+    };
+    Job jobs[JOB_MAX];
+    uint8_t jobCount = 0;
+    uint8_t heap[JOB_MAX];         // Ids ordenados como min-heap por dueMs
+    uint8_t heapPos[JOB_MAX];      // Posición de cada id en heap (JOB_NONE = sin armar)
+    uint8_t heapSize = 0;
+
+    bool earlier(uint8_t a, uint8_t b) const { return (int32_t)(jobs[a].dueMs - jobs[b].dueMs) < 0; }
+    void swapAt(uint8_t i, uint8_t j);
+    void siftUp(uint8_t i);
+    void siftDown(uint8_t i);
+    void removeAt(uint8_t i);
+};
+
+#endif
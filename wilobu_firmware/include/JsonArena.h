@@ -0,0 +1,47 @@
+#ifndef JSON_ARENA_H
+#define JSON_ARENA_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+// === ARENA PARA JsonDocument ===
+// Allocator de ArduinoJson sobre un buffer estático: los documentos de cada
+// heartbeat/SOS toman sus pools de aquí y no del heap. Asignación por avance
+// de puntero; liberar el último bloque lo retrocede y, cuando no queda ningún
+// bloque vivo, la arena vuelve a cero. Un documento a la vez por arena.
+// Si se agota, allocate() devuelve nullptr y ArduinoJson marca overflowed().
+class JsonArena : public ArduinoJson::Allocator {
+public:
+    JsonArena(const char* name, uint8_t* buffer, size_t size)
+        : name(name), buf(buffer), cap(size) {}
+
+    void* allocate(size_t size) override;
+    void deallocate(void* ptr) override;
+    void* reallocate(void* ptr, size_t newSize) override;
+
+    size_t peak() const { return peakBytes; }
+    uint32_t failures() const { return failCount; }
+    void print() const;
+
+private:
+    struct Header {
+        uint32_t size;       // Bytes útiles del bloque (alineados)
+        uint32_t pad;        // Mantiene el bloque alineado a 8
+    };
+
+    const char* name;
+    uint8_t* buf;
+    size_t cap;
+    size_t used = 0;
+    size_t lastOffset = SIZE_MAX;   // Último bloque (el único que puede retroceder)
+    uint16_t live = 0;
+    size_t peakBytes = 0;
+    uint32_t failCount = 0;
+
+    Header* headerOf(void* ptr) const { return (Header*)((uint8_t*)ptr - sizeof(Header)); }
+    bool isLast(void* ptr) const {
+        return lastOffset != SIZE_MAX && (uint8_t*)ptr == buf + lastOffset + sizeof(Header);
+    }
+};
+
+#endif
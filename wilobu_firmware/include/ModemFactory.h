@@ -0,0 +1,24 @@
+#ifndef MODEM_FACTORY_H
+#define MODEM_FACTORY_H
+
+#include <Arduino.h>
+#include "IModem.h"
+
+// ===== SELECCIÓN DE HARDWARE =====
+// Selecciona la variante de hardware y módem a usar
+// Descomentar SOLO UNA de las siguientes líneas:
+// #define HARDWARE_A  // SIM7080G con HTTPS directo
+// #define HARDWARE_B  // A7670SA con batería (Prototipo)
+#define HARDWARE_C  // A7670SA sin batería (Laboratorio)
+
+#ifdef HARDWARE_A
+  #define MODEM_TYPE "SIM7080G (HTTPS)"
+#else
+  #define MODEM_TYPE "A7670SA (Proxy)"
+#endif
+
+// Crea el driver de la variante seleccionada (ModemFactory.cpp). APN y
+// endpoint solo los usa el A7670SA; las pruebas en host enlazan un módem falso
+IModem* createModemDriver(HardwareSerial* serial, const char* apn, const char* endpoint);
+
+#endif
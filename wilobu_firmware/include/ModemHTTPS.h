@@ -11,6 +11,7 @@ private:
     bool connected = false;
     bool deepSleeping = false;
     const char* apn = "hologram";  // APN para SIM7080G
+    bool tlsReady = false;         // CA cargada y convertida para el contexto SSL 1
     
     // Variables GPS
     float latitude = 0.0;
@@ -18,14 +19,21 @@ private:
     float accuracy = 0.0;
     bool gpsEnabled = false;
     
+    // Última respuesta para el llamador (geocercas, comandos)
+    HttpBody lastHttpBody;
+    int lastHttpStatus = -1;       // De la URC +SHREQ (-1 si no llegó)
+    
     // Métodos auxiliares
-    String sendATCommand(const String& cmd, unsigned long timeout);
-    bool waitForResponse(const String& expected, unsigned long timeout);
+    String sendATCommand(const String& cmd, uint32_t timeout);
+    bool waitForResponse(const String& expected, uint32_t timeout);
+    bool configureTls();
+    bool secureConnection(const String& url);
     String httpsPost(const String& url, const String& json);
+    bool readUntil(const char* token, uint32_t timeout, String& out);
+    int shReadChunk(uint32_t pos, uint8_t* buf, size_t want);
+    String smsCapture;                 // Todo lo leído durante el último SMS (puede traer URCs)
     
 public:
-    bool factoryResetPending = false;  // Flag para factory reset desde cloud
-    
     ModemHTTPS(HardwareSerial* serial);
     
     // Implementación de métodos de IModem
@@ -35,21 +43,31 @@ public:
     bool isConnected() override;
     
     bool sendToFirebase(const String& path, const String& jsonData) override;
-    bool sendSOSAlert(const String& deviceId, const String& ownerUid, const String& sosType, const GPSLocation& location) override;
-    bool sendHeartbeat(const String& ownerUid, const String& deviceId, const GPSLocation& location) override;
-    String checkProvisioningStatus(const String& deviceId) override;
+    bool sendSOSAlert(const char* deviceId, const char* ownerUid, const char* sosType, const GPSLocation& location,
+                      const JsonDocument* extra = nullptr) override;
+    bool sendHeartbeat(const char* ownerUid, const char* deviceId, const GPSLocation& location,
+                       const JsonDocument* extra = nullptr) override;
+    String checkProvisioningStatus(const char* deviceId) override;
     bool sendToCloudFunction(const String& functionPath, const String& jsonData);
     
     bool initGNSS() override;
     bool getLocation(GPSLocation& location) override;
     void disableGNSS() override;
     
-    void enableDeepSleep(unsigned long wakeupTimeSeconds) override;
+    void enableDeepSleep(uint32_t wakeupTimeSeconds) override;
     bool isDeepSleeping() override;
+    bool resume() override;
+    bool configurePowerSaving(const PowerSavingRequest& req) override;
+    bool getBatteryMillivolts(uint16_t& mv) override;
+    
+    bool sendSMS(const char* number, const char* text) override;
+    
+    bool checkForUpdates(const char* deviceId, const char* currentVersion, OtaManifest& manifest) override;
+    bool downloadFirmwareUpdate(const OtaManifest& manifest, OtaUpdater& sink) override;
+    bool applyFirmwareUpdate(OtaUpdater& sink) override;
     
-    bool checkForUpdates() override;
-    bool downloadFirmwareUpdate(const String& url) override;
-    bool applyFirmwareUpdate() override;
+    const HttpBody& getLastHttpBody() const override { return lastHttpBody; }
+    int getLastHttpStatus() const override { return lastHttpStatus; }
 };
 
 #endif
@@ -2,8 +2,27 @@
 #define MODEM_PROXY_H
 
 #include "IModem.h"
+#include "SosFastPath.h"
+#include "FixedString.h"
+#include "JsonArena.h"
+#include "GnssScheduler.h"
 #include <HardwareSerial.h>
 
+#define HTTP_NOT_SENT  -2   // httpSend(): el cuerpo no se cargó, la petición no salió
+
+// ===== BUFFERS FIJOS (sin heap en las rutas calientes) =====
+#define AT_RESPONSE_MAX     2048    // Respuesta AT más larga: el cuerpo de HTTPREAD
+#define AT_COMMAND_MAX      192     // Comando AT armado (URL incluida)
+#define HTTP_URL_MAX        128
+#define HTTP_JSON_MAX       1024    // Cuerpo JSON saliente (heartbeat/SOS con extras)
+#define HTTP_JSON_ARENA     3072    // Pools del JsonDocument de heartbeat/SOS
+#define SMS_CAPTURE_MAX     256
+
+typedef FixedString<AT_RESPONSE_MAX> AtResponse;
+
+// Base de fábrica de las Cloud Functions; el blob BLE puede reemplazarla
+#define CLOUD_FUNCTIONS_BASE "https://us-central1-wilobu-d21b2.cloudfunctions.net"
+
 // === IMPLEMENTACIÓN PARA HARDWARE TIER B/C (A7670SA con HTTP via Proxy Cloudflare) ===
 class ModemProxy : public IModem {
 private:
@@ -11,29 +30,60 @@ private:
     bool connected = false;
     bool deepSleeping = false;
     String apn = "";  // APN prepago local (será configurado)
-    const char* proxyUrl = "wilobu-proxy.workers.dev";  // Cloudflare Worker
+    const char* proxyUrl = "wilobu-proxy.workers.dev";  // Cloudflare Worker (solo https)
+    bool tlsReady = false;             // CA cargada y contexto SSL 0 configurado
 
     // Último estado HTTP para diagnósticos/reset remoto
     int lastHttpStatus = -1;
-    String lastHttpBody;
+    HttpBody lastHttpBody;
+    ModemDiagStats diagStats = {};
     
     // Variables GPS
     float latitude = 0.0;
     float longitude = 0.0;
     float accuracy = 0.0;
     bool gpsEnabled = false;
-    int gnssFailCount = 0;
-    unsigned long nextGnssRetryMs = 0;
+    bool gnssConfigured = false;       // Salida NMEA configurada tras READY
+    uint32_t gnssPowerOnMs = 0;
+    uint8_t gnssFailCount = 0;
+    uint32_t gnssFailMs = 0;      // Último fallo de encendido (inicio del backoff)
     
     // Métodos auxiliares
-    String sendATCommand(const String& cmd, unsigned long timeout);
-    bool waitForResponse(const String& expected, unsigned long timeout);
-    String httpPost(const String& path, const String& json);
+    // La respuesta vive en atResp hasta el siguiente comando
+    const AtResponse& sendATCommand(const char* cmd, uint32_t timeout);
+    const AtResponse& sendATCommand(const String& cmd, uint32_t timeout) { return sendATCommand(cmd.c_str(), timeout); }
+    bool waitForResponse(const String& expected, uint32_t timeout);
+    bool configureTls();
+    bool beginHttpsSession();          // HTTPTERM + HTTPINIT sobre el contexto SSL 0
+    bool httpPost(const char* path, const char* json, size_t len);
+    int httpSend(const char* json, size_t len);
+    int httpGet(uint32_t& bodyLen);
+    int httpReadChunk(uint32_t pos, uint8_t* buf, size_t want);
+    size_t serializeBody(const JsonDocument& doc);
+    bool configureGNSSOutput();
+    bool readUntil(const char* token, uint32_t timeout, FixedString<SMS_CAPTURE_MAX>& out);
+    FixedString<SMS_CAPTURE_MAX> smsCapture;   // Todo lo leído durante el último SMS (puede traer URCs)
+
+    AtResponse atResp;                 // Última respuesta AT
+    FixedString<AT_COMMAND_MAX> atCmd; // Comando AT armado con printf()
+    char jsonBody[HTTP_JSON_MAX];      // Cuerpo serializado de la petición en curso
+    uint8_t jsonArenaBuf[HTTP_JSON_ARENA];
+    JsonArena jsonArena;
     
-public:
-    bool factoryResetPending = false;  // Flag para factory reset desde cloud
+    // Slot SOS: sesión HTTP abierta apuntando a la Cloud Function
+    SosPayloadTemplates sosTemplates;
+    bool slotReady = false;
+
+    // URLs armadas una vez desde la base (setEndpoint)
+    FixedString<HTTP_URL_MAX> heartbeatUrl;
+    FixedString<HTTP_URL_MAX> statusUrl;
+    FixedString<HTTP_URL_MAX> otaUrl;
+    FixedString<AT_COMMAND_MAX> slotUrlCmd;   // Se reenvía en cada verificación del slot
     
-    ModemProxy(HardwareSerial* serial, const char* apnParam = nullptr);
+public:
+    ModemProxy(HardwareSerial* serial, const char* apnParam = nullptr, const char* endpointBase = nullptr);
+    // nullptr o "" = CLOUD_FUNCTIONS_BASE; sin barra final
+    void setEndpoint(const char* base);
     
     // Implementación de métodos de IModem
     bool init() override;
@@ -42,24 +92,40 @@ public:
     bool isConnected() override;
     
     bool sendToFirebase(const String& path, const String& jsonData) override;
-    bool sendSOSAlert(const String& deviceId, const String& ownerUid, const String& sosType, const GPSLocation& location) override;
-    bool sendHeartbeat(const String& ownerUid, const String& deviceId, const GPSLocation& location) override;
+    bool sendSOSAlert(const char* deviceId, const char* ownerUid, const char* sosType, const GPSLocation& location,
+                      const JsonDocument* extra = nullptr) override;
+    bool sendHeartbeat(const char* ownerUid, const char* deviceId, const GPSLocation& location,
+                       const JsonDocument* extra = nullptr) override;
     bool sendToFirebaseFunction(const String& functionPath, const String& jsonData);
-    String checkProvisioningStatus(const String& deviceId) override;
+    String checkProvisioningStatus(const char* deviceId) override;
     
     bool initGNSS() override;
     bool getLocation(GPSLocation& location) override;
     void disableGNSS() override;
     
-    void enableDeepSleep(unsigned long wakeupTimeSeconds) override;
+    void enableDeepSleep(uint32_t wakeupTimeSeconds) override;
     bool isDeepSleeping() override;
+    bool resume() override;
+    bool configurePowerSaving(const PowerSavingRequest& req) override;
+    bool getBatteryMillivolts(uint16_t& mv) override;
+    bool getSignalQuality(uint8_t& csq) override;
+    const ModemDiagStats* getDiagStats() const override { return &diagStats; }
+    
+    bool sendSMS(const char* number, const char* text) override;
+    
+    bool prepareSosSlot(const char* deviceId, const char* ownerUid) override;
+    bool checkSosSlot() override;
+    bool sosSlotReady() const override { return slotReady && connected; }
+    bool sendSOSFast(uint8_t typeCode, uint32_t epoch, uint32_t seq) override;
     
-    bool checkForUpdates() override;
-    bool downloadFirmwareUpdate(const String& url) override;
-    bool applyFirmwareUpdate() override;
+    bool checkForUpdates(const char* deviceId, const char* currentVersion, OtaManifest& manifest) override;
+    bool downloadFirmwareUpdate(const OtaManifest& manifest, OtaUpdater& sink) override;
+    bool applyFirmwareUpdate(OtaUpdater& sink) override;
     
     // Getter para diagnóstico
-    int getLastHttpStatus() const { return lastHttpStatus; }
+    int getLastHttpStatus() const override { return lastHttpStatus; }
+    JsonArena* getJsonArena() override { return &jsonArena; }
+    const HttpBody& getLastHttpBody() const override { return lastHttpBody; }
 };
 
 #endif
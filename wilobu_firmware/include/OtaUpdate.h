@@ -0,0 +1,90 @@
+#ifndef OTA_UPDATE_H
+#define OTA_UPDATE_H
+
+#include <Arduino.h>
+#include <esp_ota_ops.h>
+#include <mbedtls/sha256.h>
+
+// ===== ACTUALIZACIÓN REMOTA (OTA) POR EL MÓDEM =====
+// El driver del módem descarga la imagen por rangos HTTP y entrega cada trozo
+// a OtaUpdater, que lo escribe en la partición inactiva (esp_ota_write) y lo
+// va sumando al SHA-256. Lo escrito se conserva si la descarga se corta: el
+// siguiente rango se pide desde offset(). El progreso no sobrevive a un
+// reinicio (esp_ota_begin vuelve a empezar la partición).
+#define OTA_CHUNK_BYTES     1024        // Un HTTPREAD/SHREAD: único buffer de la descarga
+#define OTA_RANGE_BYTES     32768UL     // Un GET con "Range" por llamada a downloadFirmwareUpdate()
+#define OTA_READ_TIMEOUT_MS 5000UL      // Un trozo completo desde el módem
+#define OTA_ACTION_TIMEOUT_MS 30000UL   // Respuesta del servidor a un GET de rango
+#define OTA_URL_MAX         160
+#define OTA_VERSION_MAX     16
+
+// Autenticidad: el manifiesto lleva "sig", ECDSA P-256 (DER en hex) sobre el
+// SHA-256 de "<v>|<url>|<size>|<sha256 en hex minúscula>", firmado fuera de
+// línea (scripts/sign_firmware.js). La clave pública entra en el build
+// (OTA_SIGNING_PUBKEY: punto sin comprimir en hex, de WILOBU_OTA_PUBKEY) y
+// un manifiesto sin firma válida se descarta antes de abrir la partición
+#define OTA_SIG_MAX         72          // DER de una firma P-256, como máximo
+#define OTA_PUBKEY_BYTES    65          // 0x04 || X || Y
+
+// Período de prueba de una imagen nueva: se confirma con el primer heartbeat
+// 2xx. Si antes se reinicia más de OTA_TRIAL_BOOTS veces (crash, watchdog),
+// vuelve a la imagen anterior. Una versión revertida con veredicto o que no
+// pasó la verificación queda rechazada: no se vuelve a descargar aunque siga
+// publicada
+#define OTA_TRIAL_BOOTS     3
+#define OTA_NVS_NS          "ota"
+
+// Lo que publica el backend (firmwareManifest)
+struct OtaManifest {
+    char version[OTA_VERSION_MAX];
+    char url[OTA_URL_MAX];
+    uint32_t size;
+    uint8_t sha256[32];
+};
+
+class JsonArena;
+
+// JSON {"v","url","size","sha256","sig"} dentro de la respuesta del módem
+// (con eco AT); false si falta un campo o la firma no verifica. Con arena, el
+// documento toma sus pools de ahí en vez del heap
+bool parseOtaManifest(const char* body, OtaManifest& out, JsonArena* arena = nullptr);
+
+class OtaUpdater {
+public:
+    // === Descarga ===
+    bool begin(const OtaManifest& m);           // Abre la partición inactiva; descarta una sesión anterior
+    bool write(const uint8_t* data, size_t len); // Un error de flash descarta la sesión
+    // Verifica tamaño y SHA-256, cierra la imagen (esp_ota_end la valida) y
+    // la deja como partición de arranque en período de prueba
+    bool finish();
+    void abort();
+    bool isActive() const { return active; }
+    bool isComplete() const { return active && written == manifest.size; }
+    bool matches(const OtaManifest& m) const;   // Misma imagen: se puede reanudar
+    uint32_t offset() const { return written; }
+    void print(uint32_t nowMs) const;
+
+    // === Período de prueba tras arrancar la imagen nueva ===
+    static void bootCheck();                    // En setup(): cuenta reinicios y revierte si se agotan
+    static bool trialPending() { return trial; }
+    static void confirm();                      // Salud verificada
+    // Vuelve a la imagen anterior y reinicia; rejectVersion = false no la
+    // rechaza (la prueba no llegó a juzgarla) y se puede volver a descargar
+    static void rollback(const char* reason, bool rejectVersion = true);
+    static bool isRejected(const char* version);
+
+private:
+    OtaManifest manifest = {};
+    const esp_partition_t* partition = nullptr;
+    esp_ota_handle_t handle = 0;
+    mbedtls_sha256_context sha;
+    uint32_t written = 0;
+    bool active = false;
+    uint32_t startMs = 0;
+
+    static bool trial;
+    static void clearTrial();
+    static void reject(const char* version);
+};
+
+#endif
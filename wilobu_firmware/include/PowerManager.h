@@ -0,0 +1,53 @@
+#ifndef POWER_MANAGER_H
+#define POWER_MANAGER_H
+
+#include <Arduino.h>
+#include <esp_pm.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/event_groups.h>
+
+// ===== PARÁMETROS DE GESTIÓN DE ENERGÍA =====
+#define PM_MAX_FREQ_MHZ         240
+#define PM_MIN_FREQ_MHZ         80      // APB a 80 MHz: UART del módem y BLE sin error de baudrate
+#define PM_UART_WAKE_EDGES      3       // Flancos RX que despiertan (esos primeros bytes se pierden)
+
+// Consumo estimado del ESP32 por estado (datasheet ESP32-WROOM-32, mA)
+#define PM_MA_ACTIVE            50.0f   // 240 MHz, CPU trabajando
+#define PM_MA_IDLE              20.0f   // 80 MHz en espera (sin light sleep)
+#define PM_MA_LIGHT_SLEEP       0.8f
+
+// === DFS + LIGHT SLEEP AUTOMÁTICO ===
+// Mientras el loop trabaja se sostienen dos locks (CPU al máximo y sin light
+// sleep); solo se sueltan en idle(), la espera al final de cada pasada. Así
+// las transacciones AT nunca duermen a mitad de una respuesta.
+// Si el framework no trae CONFIG_PM_ENABLE, idle() hace light sleep manual
+// con las mismas fuentes de wake (timer, botones por GPIO y RX del módem).
+// Con setWakeEvents() la espera termina antes si otra tarea activa esos bits
+// (el llamador los lee y limpia).
+class PowerManager {
+public:
+    enum class Mode : uint8_t { AUTO, MANUAL, NONE };
+
+    void begin(int modemUart);
+    // allowSleep=false: espera sin dormir (p.ej. antirrebote de botón en curso)
+    void idle(uint32_t ms, bool allowSleep);
+    void setWakeEvents(EventGroupHandle_t group, EventBits_t bits) { wakeGroup = group; wakeBits = bits; }
+    Mode mode() const { return pmMode; }
+    void print(uint32_t pressLastMs, uint32_t pressMaxMs) const;
+
+private:
+    Mode pmMode = Mode::NONE;
+    esp_pm_lock_handle_t cpuLock = nullptr;
+    esp_pm_lock_handle_t sleepLock = nullptr;
+    EventGroupHandle_t wakeGroup = nullptr;
+    EventBits_t wakeBits = 0;
+
+    uint32_t startMs = 0;
+    uint32_t idleMsTotal = 0;    // Ventanas de espera (AUTO: el sistema decide cuánto duerme)
+    uint32_t sleptMsTotal = 0;   // Light sleep medido (MANUAL)
+    uint32_t wakeups = 0;
+
+    void wait(uint32_t ms);
+};
+
+#endif
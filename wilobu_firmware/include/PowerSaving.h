@@ -0,0 +1,42 @@
+#ifndef POWER_SAVING_H
+#define POWER_SAVING_H
+
+#include <Arduino.h>
+
+// ===== PARÁMETROS PSM / eDRX =====
+#define PSM_TAU_FACTOR          2       // T3412 pedido ≈ 2 × intervalo de heartbeat (el heartbeat también renueva)
+#define PSM_ACTIVE_TIME_S       20UL    // T3324: alcanzable tras el último envío (la respuesta HTTP ya llegó)
+#define EDRX_CYCLE_DIVISOR      4       // Ciclo eDRX ≤ intervalo de heartbeat / 4
+#define EDRX_ACT_TYPE           4       // E-UTRAN (WB-S1): LTE Cat-1 en A7670, Cat-M en SIM7080G
+
+// Lo que se pide a la red; los valores reales los decide la red y se leen después
+struct PowerSavingRequest {
+    bool psm;                   // false: solo eDRX (el módem sigue respondiendo por UART)
+    uint32_t tauSec;       // T3412 extendido (periodic TAU)
+    uint32_t activeSec;    // T3324 (active time)
+    uint32_t edrxMaxSec;   // Ciclo eDRX máximo aceptable
+};
+
+// === CODIFICACIÓN DE TEMPORIZADORES 3GPP (TS 24.008 10.5.7.3 / 10.5.7.4a / 10.5.5.32) ===
+// Cadenas de bits tal como las esperan AT+CPSMS / AT+CEDRXS y las devuelve AT+CEREG
+class PowerSaving {
+public:
+    static PowerSavingRequest forHeartbeat(uint32_t heartbeatMs, bool psm);
+
+    // T3412 se redondea hacia arriba (nunca un TAU más corto que el pedido);
+    // T3324 también. eDRX hacia abajo (nunca más latencia que la pedida).
+    static String encodeT3412(uint32_t sec, uint32_t* actualSec = nullptr);
+    static String encodeT3324(uint32_t sec, uint32_t* actualSec = nullptr);
+    static String encodeEdrx(uint32_t maxSec, float* actualSec = nullptr);
+
+    // -1 = desactivado / inválido
+    static long decodeT3412(const String& bits);
+    static long decodeT3324(const String& bits);
+    static float decodeEdrx(const String& bits);
+    static float decodePtw(const String& bits);
+
+    // Log de lo negociado a partir de AT+CEREG? (modo 4) y AT+CEDRXRDP
+    static void logNegotiated(const String& ceregResp, const String& edrxResp);
+};
+
+#endif
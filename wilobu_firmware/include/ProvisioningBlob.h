@@ -0,0 +1,86 @@
+#ifndef PROVISIONING_BLOB_H
+#define PROVISIONING_BLOB_H
+
+#include <Arduino.h>
+
+// ===== FORMATO DEL BLOB DE APROVISIONAMIENTO =====
+// Una sola escritura BLE (tras negociar el MTU) lleva todo lo que antes pedía
+// varias escrituras y comandos seriales:
+//
+//   'W' 'P' | versión (1) | flags (1) | TLV... | CRC32 (4, little-endian)
+//   TLV = tipo (1) | largo (1) | valor (sin terminador)
+//
+// El CRC32 (mismo polinomio que DeviceConfig) cubre todo lo anterior. Los
+// tipos desconocidos se saltan: una app nueva puede hablarle a un firmware viejo.
+#define PROV_BLOB_MAGIC_0       'W'
+#define PROV_BLOB_MAGIC_1       'P'
+#define PROV_BLOB_VERSION       1
+#define PROV_BLOB_HEADER        4
+#define PROV_BLOB_MIN           (PROV_BLOB_HEADER + 2 + 6 + 4)   // Solo owner mínimo
+#define PROV_BLOB_MAX           244     // Cabe en una escritura con MTU 247
+
+#define PROV_TAG_OWNER          0x01    // Obligatorio, 6..63 caracteres
+#define PROV_TAG_APN            0x02    // "" = APN universal
+#define PROV_TAG_PROFILE        0x03    // 1 byte: bit0 PSM, bit1 energía en heartbeat
+#define PROV_TAG_SMS_GW         0x04
+#define PROV_TAG_ENDPOINT       0x05    // Base https:// de las Cloud Functions
+
+#define PROV_PROFILE_PSM        (1 << 0)
+#define PROV_PROFILE_ENERGY_HB  (1 << 1)
+
+#define PROV_OWNER_MIN          6
+#define PROV_OWNER_MAX          63
+#define PROV_APN_MAX            31
+#define PROV_SMS_GW_MAX         19
+#define PROV_ENDPOINT_MAX       95
+
+enum class ProvError : uint8_t {
+    OK = 0,
+    TOO_SHORT,
+    TOO_LONG,
+    BAD_MAGIC,
+    BAD_VERSION,
+    BAD_LENGTH,     // Un TLV se sale del blob
+    BAD_CRC,
+    BAD_FIELD,      // Largo o contenido fuera de rango
+    NO_OWNER,
+    MODEM,          // Sin respuesta AT o sin registro en red
+    TIMEOUT         // El backend no confirmó antes de cerrar la sesión
+};
+
+// Contenido decodificado; has* indica qué campos trajo el blob
+struct ProvisioningRequest {
+    char ownerUid[PROV_OWNER_MAX + 1];
+    char apn[PROV_APN_MAX + 1];
+    char smsGateway[PROV_SMS_GW_MAX + 1];
+    char endpoint[PROV_ENDPOINT_MAX + 1];
+    uint8_t profile;
+    bool hasApn;
+    bool hasProfile;
+    bool hasSmsGateway;
+    bool hasEndpoint;
+};
+
+// ===== PROGRESO (característica NOTIFY) =====
+// 4 bytes: etapa | código (ProvError) | valor (uint16 little-endian). El valor
+// lleva el payload ATT en READY y el status HTTP en BACKEND_*.
+enum class ProvStage : uint8_t {
+    READY = 0,          // MTU negociado: la app puede escribir el blob
+    RECEIVED,           // Blob válido
+    STORED,             // Configuración escrita en NVS
+    MODEM_UP,           // El módem responde AT
+    REGISTERED,         // Registrado en la red
+    LINKED,             // Documento del dispositivo confirmado (señal de la app o checkDeviceStatus)
+    BACKEND_RETRY,      // El heartbeat no recibió 2xx; se reintenta
+    BACKEND_OK,         // Primer heartbeat 2xx: fin de la sesión
+    FAILED = 0xFF       // El código dice por qué; tras un blob inválido la app puede reescribir
+};
+
+#define PROV_STATUS_LEN         4
+
+ProvError parseProvisioningBlob(const uint8_t* buf, size_t len, ProvisioningRequest& out);
+void encodeProvisioningStatus(ProvStage stage, ProvError code, uint16_t value, uint8_t out[PROV_STATUS_LEN]);
+const char* provErrorName(ProvError e);
+const char* provStageName(ProvStage s);
+
+#endif
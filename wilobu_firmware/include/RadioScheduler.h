@@ -0,0 +1,64 @@
+#ifndef RADIO_SCHEDULER_H
+#define RADIO_SCHEDULER_H
+
+#include <Arduino.h>
+
+// ===== PARÁMETROS DE COORDINACIÓN GNSS/LTE =====
+#define RADIO_TTFF_DEFAULT_MS        30000UL  // TTFF supuesto hasta tener una medida real
+#define RADIO_GNSS_LEAD_MARGIN_MS    5000UL   // Margen entre fix listo y heartbeat
+#define RADIO_FIX_FRESH_MS           60000UL  // Un fix más nuevo que esto no requiere ventana previa
+#define RADIO_HEARTBEAT_GRACE_MS     20000UL  // Máximo retraso del heartbeat esperando un fix en curso
+
+// === PLANIFICADOR DE RANURAS DE RADIO (A7670SA / SIM7080G) ===
+// GNSS y LTE comparten front-end RF y UART. Este planificador:
+//  - abre la ventana GNSS justo antes del heartbeat (fix listo al enviar)
+//  - retrasa brevemente el heartbeat si hay una adquisición a punto de terminar
+//  - mide por ciclo de heartbeat cuánto estuvo activa cada radio y cuánto se solaparon
+class RadioScheduler {
+public:
+    void begin(uint32_t nowMs);
+
+    // ===== ACTIVIDAD REAL (la informa main.cpp) =====
+    void cellularBegin(uint32_t nowMs);
+    void cellularEnd(uint32_t nowMs);
+    void gnssPower(bool on, uint32_t nowMs);
+    void onFix(uint32_t nowMs);          // Mide TTFF si venía de un encendido
+
+    bool cellularBusy() const { return cellularActive; }
+    uint32_t ttffEstimateMs() const { return ttffMs; }
+
+    // ===== PLANIFICACIÓN =====
+    // true si conviene abrir ya la ventana GNSS para el próximo heartbeat
+    bool shouldWarmGnssForHeartbeat(uint32_t msToHeartbeat, uint32_t fixAgeMs) const;
+    // Cuánto falta para que shouldWarmGnssForHeartbeat() pase a true (0 = ya)
+    uint32_t msUntilGnssWarm(uint32_t msToHeartbeat, uint32_t fixAgeMs) const;
+    // false mientras convenga esperar a que termine una adquisición en curso
+    bool heartbeatMayStart(uint32_t nowMs, bool gnssAcquiring);
+    bool isDeferring() const { return deferring; }
+
+    // ===== REPORTE =====
+    void printCycle(uint32_t nowMs);     // Estado del ciclo actual sin cerrarlo
+    void closeCycle(uint32_t nowMs);     // Imprime y reinicia (llamar tras cada heartbeat)
+
+private:
+    bool cellularActive = false;
+    bool gnssActive = false;
+    bool awaitingFix = false;
+    uint32_t gnssOnAtMs = 0;
+    uint32_t ttffMs = RADIO_TTFF_DEFAULT_MS;
+
+    bool deferring = false;
+    uint32_t deferStartMs = 0;
+
+    // Acumuladores del ciclo actual
+    uint32_t cycleStartMs = 0;
+    uint32_t lastMarkMs = 0;
+    uint32_t cellularMs = 0;
+    uint32_t gnssMs = 0;
+    uint32_t overlapMs = 0;
+    uint16_t transactions = 0;
+
+    void accumulate(uint32_t nowMs);
+};
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef SOS_FAST_PATH_H
+#define SOS_FAST_PATH_H
+
+#include <Arduino.h>
+
+// ===== PARÁMETROS DE LA RUTA RÁPIDA SOS =====
+#define SOS_SLOT_CHECK_MS        60000UL  // Verificación periódica de la sesión HTTP lista
+#define SOS_SLOT_RETRY_MS        15000UL  // Reintento de preparación si falló
+#define SOS_PREFIX_MAX           192      // Prefijo JSON por tipo (ids de hasta ~64 caracteres)
+
+// === CUERPOS SOS PRE-SERIALIZADOS ===
+// Un prefijo por tipo (general/medica/seguridad) con deviceId, ownerUid, status y
+// lastLocation:null ya escritos; al pulsar solo se agregan época, secuencia y "}".
+// Los prefijos viven en buffers fijos: se reconstruyen en cada preparación del
+// slot sin tocar el heap.
+class SosPayloadTemplates {
+public:
+    void build(const char* deviceId, const char* ownerUid);
+    bool isBuilt() const { return built; }
+    // Escribe el cuerpo en out; devuelve su largo (0 si no entra)
+    size_t body(uint8_t typeCode, uint32_t epoch, uint32_t seq, char* out, size_t outSize) const;
+
+private:
+    char prefix[3][SOS_PREFIX_MAX];
+    uint16_t prefixLen[3];
+    bool built = false;
+};
+
+#endif
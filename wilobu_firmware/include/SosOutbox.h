@@ -0,0 +1,98 @@
+#ifndef SOS_OUTBOX_H
+#define SOS_OUTBOX_H
+
+#include "IModem.h"
+
+// ===== PARÁMETROS DE ENTREGA GARANTIZADA SOS =====
+#define SOS_OUTBOX_MAX          8          // Alertas pendientes retenidas
+#define SOS_RETRY_BASE_MS       2000UL     // Primer reintento
+#define SOS_RETRY_MAX_MS        60000UL    // Techo del backoff exponencial
+#define SOS_OUTBOX_NVS_NS       "wilobu_sos" // Namespace propio: el factory reset NO borra la secuencia
+#define SOS_OUTBOX_MAGIC        0x534F5333UL // "SOS3" (valida la copia en RTC; cambia con el formato)
+#define SOS_DELIVERY_HISTORY    4          // Últimas alertas con tiempos por camino
+
+// Alerta pendiente: compacta para caber en RTC y en un blob NVS
+struct SosPending {
+    uint32_t seq;           // Secuencia monotónica dentro de la época: el backend deduplica por (época, seq)
+    uint8_t type;           // Ver SosOutbox::typeCode()
+    uint8_t attempts;
+    uint8_t hasFix;         // 0 = Disparo 1 (backend usa lastLocation), 1 = con coordenadas
+    uint8_t smsPending;     // 1 = falta el SMS paralelo (se descarta si los datos confirman antes)
+    uint16_t accuracyM;
+    int32_t latE6;
+    int32_t lonE6;
+};
+
+// Tiempo hasta la primera entrega por cada camino (0 = no llegó por ahí)
+struct SosDeliveryRecord {
+    uint32_t seq;
+    uint32_t dataMs;   // Hasta el 2xx
+    uint32_t smsMs;    // Hasta el +CMGS
+};
+
+// Estado persistido (copia idéntica en RTC y NVS). La época es aleatoria y se
+// sortea cada vez que la secuencia vuelve a 1 (primer arranque, NVS borrada o
+// corrupta): sin ella, seq_1 de la secuencia nueva chocaría con la seq_1 ya
+// registrada en el backend y la alerta se descartaría como duplicada
+struct SosOutboxImage {
+    uint32_t magic;
+    uint32_t epoch;
+    uint32_t nextSeq;
+    uint8_t count;
+    SosPending items[SOS_OUTBOX_MAX];
+};
+
+// === BANDEJA DE SALIDA DE ALERTAS SOS ===
+// Cada disparo entra con su número de secuencia y se guarda en RTC (sobrevive
+// deep sleep) y en NVS (sobrevive cortes de energía) ANTES del primer envío.
+// Sale de la bandeja solo con un 2xx; los fallos reintentan con backoff.
+// No toca el módem: main.cpp pide la siguiente alerta vencida y reporta el resultado.
+class SosOutbox {
+public:
+    // persistent=false: solo RAM (pruebas en host)
+    void begin(bool persistent = true);
+    void restore(const SosOutboxImage& img);
+
+    // Encola y persiste; devuelve la secuencia asignada.
+    // withSms: despacho multicamino (SMS al gateway junto con el POST)
+    uint32_t enqueue(const char* sosType, const GPSLocation& loc, uint32_t nowMs, bool withSms = false);
+
+    // Siguiente alerta cuyo reintento venció (nullptr si ninguna)
+    const SosPending* due(uint32_t nowMs) const;
+    // Hasta el reintento más próximo (0 = ya vencido; 0xFFFFFFFF = bandeja vacía)
+    uint32_t msUntilDue(uint32_t nowMs) const;
+    const SosPending* find(uint32_t seq) const;
+    void onResult(uint32_t seq, bool delivered, uint32_t nowMs);
+    // Resultado del SMS paralelo; doneMs = momento del +CMGS
+    void onSmsResult(uint32_t seq, bool sent, uint32_t doneMs);
+
+    // Descarta pendientes (factory reset) pero conserva la secuencia
+    void clear();
+
+    uint32_t epoch() const { return image.epoch; }
+    uint8_t count() const { return image.count; }
+    bool isEmpty() const { return image.count == 0; }
+    const SosOutboxImage& state() const { return image; }
+    void print(uint32_t nowMs) const;
+    void printDeliveries() const;
+
+    static uint32_t backoffMs(uint8_t attempts);
+    static uint8_t typeCode(const char* sosType);
+    static const char* typeName(uint8_t code);
+    static GPSLocation toLocation(const SosPending& p);
+
+private:
+    SosOutboxImage image;
+    uint32_t nextTryMs[SOS_OUTBOX_MAX];   // Solo RAM: tras reiniciar se reintenta ya
+    uint32_t enqueuedMs[SOS_OUTBOX_MAX];  // Solo RAM: base de los tiempos por camino
+    bool persistent = true;
+
+    SosDeliveryRecord history[SOS_DELIVERY_HISTORY];
+    uint8_t historyNext = 0;
+
+    void persist();
+    void recordPath(uint8_t idx, bool sms, uint32_t atMs);
+    void removeAt(uint8_t idx);
+};
+
+#endif
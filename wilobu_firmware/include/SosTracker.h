@@ -0,0 +1,81 @@
+#ifndef SOS_TRACKER_H
+#define SOS_TRACKER_H
+
+#include "IModem.h"
+
+// ===== PARÁMETROS DEL SEGUIMIENTO SOS =====
+#define SOS_TRACK_SAMPLE_MS         30000UL   // Una posición cada 30 s durante la alerta
+#define SOS_TRACK_TIMEOUT_MS        1800000UL // Fin automático si la app no la cierra (30 min)
+#define SOS_TRACK_BUFFER            12        // Puntos retenidos sin enviar (se descartan los más viejos)
+#define SOS_TRACK_BATCH_SLOW        4         // Puntos por POST con enlace lento o tras un fallo
+#define SOS_TRACK_SLOW_LINK_MS      8000UL    // POST más lento que esto -> agrupar
+#define SOS_TRACK_LOW_BATT_MV       3600      // Bajo esto se duplica el intervalo de muestreo
+#define SOS_TRACK_MIN_BATT_MV       3450      // Bajo esto se termina el seguimiento
+#define SOS_TYPE_MAX                12        // "seguridad" + terminador, con margen
+
+// Punto compacto: microgrados + precisión en metros + instante de captura
+struct TrackPoint {
+    int32_t latE6;
+    int32_t lonE6;
+    uint16_t accuracyM;
+    uint32_t capturedMs;
+};
+
+// === SEGUIMIENTO EN VIVO DURANTE UNA ALERTA SOS ===
+// Tras el Disparo 2 sigue enviando la posición cada SOS_TRACK_SAMPLE_MS hasta
+// que la app cierra la alerta o vence el timeout. Con enlace lento agrupa
+// varios puntos por POST. No toca el módem: main.cpp muestrea y envía.
+class SosTracker {
+public:
+    enum class EndReason : uint8_t { NONE, CLEARED, TIMEOUT, LOW_BATTERY };
+
+    void begin(const char* sosType, uint32_t nowMs);
+    void stop(EndReason reason);
+    bool isActive() const { return active; }
+    const FixedString<SOS_TYPE_MAX>& type() const { return sosType; }
+
+    // ===== MUESTREO =====
+    bool sampleDue(uint32_t nowMs) const { return (nowMs - lastSampleMs) >= sampleIntervalMs(); }
+    uint32_t msUntilSample(uint32_t nowMs) const {
+        uint32_t elapsed = nowMs - lastSampleMs;
+        return elapsed >= sampleIntervalMs() ? 0 : sampleIntervalMs() - elapsed;
+    }
+    void addPoint(const GPSLocation& fix, uint32_t nowMs);
+    void onNoFix(uint32_t nowMs) { lastSampleMs = nowMs; }
+
+    // ===== ENVÍO =====
+    bool uploadDue() const { return pending >= batchTarget(); }
+    // Agrega "sosTrack":[[latE6,lngE6,precisión,antigüedad_s],...]; devuelve cuántos puntos
+    uint8_t fillJson(JsonDocument& doc, uint32_t nowMs) const;
+    void onUpload(bool ok, uint8_t sentPoints, uint32_t durationMs);
+
+    // ===== FIN DEL SEGUIMIENTO =====
+    void setBatteryMillivolts(uint16_t mv) { batteryMv = mv; }
+    EndReason checkEnd(uint32_t nowMs) const;
+    EndReason lastEndReason() const { return endReason; }
+    static const char* reasonName(EndReason reason);
+
+    uint8_t pendingCount() const { return pending; }
+    uint32_t sampleIntervalMs() const;
+    void print(uint32_t nowMs) const;
+
+private:
+    bool active = false;
+    FixedString<SOS_TYPE_MAX> sosType;
+    uint32_t startMs = 0;
+    uint32_t lastSampleMs = 0;
+    uint16_t batteryMv = 0;            // 0 = sin medida (no limita)
+    bool slowLink = false;
+    EndReason endReason = EndReason::NONE;
+
+    // Cola circular de puntos sin confirmar
+    TrackPoint points[SOS_TRACK_BUFFER];
+    uint8_t head = 0;                  // Índice del punto más viejo
+    uint8_t pending = 0;
+    uint16_t sentTotal = 0;
+    uint16_t droppedTotal = 0;
+
+    uint8_t batchTarget() const { return slowLink ? SOS_TRACK_BATCH_SLOW : 1; }
+};
+
+#endif
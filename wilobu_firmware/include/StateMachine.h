@@ -0,0 +1,100 @@
+#ifndef STATE_MACHINE_H
+#define STATE_MACHINE_H
+
+#include <Arduino.h>
+#include "IModem.h"
+
+// ===== PARÁMETROS DE LA MÁQUINA DE ESTADOS =====
+#define FSM_STATE_COUNT         8
+#define FSM_TRACE_MAX           16      // Últimas transiciones guardadas para el trazo
+#define FSM_PENDING_MAX         4       // Eventos emitidos desde una acción en curso
+#define FSM_NO_DEADLINE         0xFFFFFFFFUL
+
+// Eventos que mueven la máquina (botón, BLE, pipeline SOS, OTA y timer)
+enum class DeviceEvent : uint8_t {
+    PAIR_REQUEST,       // SOS sostenido 5 s sin aprovisionar
+    BLE_PROVISIONED,    // La app escribió el Owner UID
+    LINK_READY,         // Módem registrado y documento del dispositivo confirmado
+    SOS_GENERAL,        // Botones sostenidos 3 s
+    SOS_MEDICA,
+    SOS_SEGURIDAD,
+    SOS_DONE,           // El pipeline terminó (disparos + LED de alerta)
+    OTA_BEGIN,
+    OTA_END,
+    TIMEOUT             // Venció el tiempo máximo del estado actual
+};
+#define FSM_EVENT_COUNT         10
+
+// Fila de estado, indexada por DeviceState. timeoutMs = 0: sin límite
+struct StateDef {
+    const char* name;
+    void (*onEnter)();
+    void (*onExit)();
+    uint32_t timeoutMs;
+};
+
+// Fila de transición: la primera que coincide (estado, evento) y cuya guarda
+// pasa gana. Orden: onExit del origen, action, onEnter del destino
+struct TransitionDef {
+    DeviceState from;
+    DeviceEvent event;
+    bool (*guard)();        // nullptr = siempre
+    void (*action)();       // nullptr = ninguna
+    DeviceState to;
+};
+
+// === MÁQUINA DE ESTADOS POR TABLA ===
+// Solo la tarea del módem llama a dispatch(); las demás leen state(). Un
+// evento emitido desde una acción se encola y se procesa al terminar la
+// transición en curso. Los timeouts no bloquean: el dueño suma
+// msUntilTimeout() a su espera y llama a checkTimeout() en cada pasada.
+class StateMachine {
+public:
+    void begin(const StateDef* states, const TransitionDef* table, uint8_t tableSize);
+    // Estado inicial (ejecuta su onEnter)
+    void start(DeviceState initial, uint32_t nowMs);
+    // true si el evento produjo al menos una transición
+    bool dispatch(DeviceEvent event, uint32_t nowMs);
+    bool checkTimeout(uint32_t nowMs);
+    uint32_t msUntilTimeout(uint32_t nowMs) const;
+
+    DeviceState state() const { return current; }
+    const char* stateName(DeviceState s) const;
+    static const char* eventName(DeviceEvent e);
+    // Estado actual, permanencia por estado y últimas transiciones
+    void print(uint32_t nowMs) const;
+
+private:
+    struct TraceEntry {
+        uint32_t atMs;
+        uint32_t dwellMs;     // Tiempo que se estuvo en el origen
+        DeviceState from;
+        DeviceState to;
+        DeviceEvent event;
+    };
+    struct Dwell {
+        uint32_t entries;
+        uint32_t totalMs;
+        uint32_t maxMs;
+    };
+
+    const StateDef* states = nullptr;
+    const TransitionDef* table = nullptr;
+    uint8_t tableSize = 0;
+    volatile DeviceState current = DeviceState::IDLE;
+    uint32_t enteredMs = 0;
+    bool started = false;
+    bool busy = false;
+
+    DeviceEvent pending[FSM_PENDING_MAX];
+    uint8_t pendingCount = 0;
+
+    TraceEntry trace[FSM_TRACE_MAX];
+    uint8_t traceHead = 0;
+    uint8_t traceCount = 0;
+    Dwell dwell[FSM_STATE_COUNT] = {};
+
+    bool step(DeviceEvent event, uint32_t nowMs);
+};
+
+#endif
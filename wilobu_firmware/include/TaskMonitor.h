@@ -0,0 +1,37 @@
+#ifndef TASK_MONITOR_H
+#define TASK_MONITOR_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#define TASK_MONITOR_SLOTS      6
+
+// === MONITOR DE TAREAS ===
+// Cada tarea de la aplicación se registra con su handle y suma el tiempo que
+// pasa trabajando (fuera de su espera en cola/evento/delay). print() reporta
+// el mínimo de pila libre (high-water mark) y ese porcentaje activo. Si el
+// framework trae CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS agrega el % de CPU
+// real de todas las tareas del sistema (incluidas NimBLE e IDLE).
+class TaskMonitor {
+public:
+    // Devuelve el slot para addActive(); 0xFF si no hay lugar
+    uint8_t add(TaskHandle_t handle, const char* name, int8_t core, uint32_t stackBytes);
+    void addActive(uint8_t slot, uint32_t us);
+    void print() const;
+
+private:
+    struct Slot {
+        TaskHandle_t handle;
+        const char* name;
+        int8_t core;
+        uint32_t stackBytes;
+        uint64_t activeUs;
+    };
+    Slot slots[TASK_MONITOR_SLOTS];
+    uint8_t count = 0;
+    uint32_t startMs = 0;
+    mutable portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+};
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef TLS_CA_BUNDLE_H
+#define TLS_CA_BUNDLE_H
+
+#include <stddef.h>
+
+// ===== CA FIJADAS PARA HTTPS DESDE EL MÓDEM =====
+// Raíces que firman los endpoints del firmware: Cloud Functions, Firestore y
+// Cloud Storage (Google Trust Services R1/R4) y el Worker de Cloudflare (GTS o
+// Let's Encrypt). Se carga en el sistema de archivos del módem con este
+// nombre: si cambia el contenido hay que cambiar el nombre, así los módems que
+// ya tienen la versión anterior la vuelven a cargar
+#define TLS_CA_FILE     "wilobu_ca1.pem"
+
+extern const char TLS_CA_PEM[];
+extern const size_t TLS_CA_PEM_LEN;     // Sin el '\0' final
+
+#endif
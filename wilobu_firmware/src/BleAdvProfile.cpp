@@ -0,0 +1,79 @@
+#include "BleAdvProfile.h"
+
+void BleAdvProfile::sessionStart(uint32_t nowMs) {
+    sessions++;
+    sessionStartMs = nowMs;
+    advertise(nowMs);
+}
+
+void BleAdvProfile::sessionEnd(uint32_t nowMs) {
+    enter(OFF, nowMs);
+    Serial.printf("[BLE] Sesión de %lu s cerrada\n", (unsigned long)((nowMs - sessionStartMs) / 1000));
+}
+
+void BleAdvProfile::advertise(uint32_t nowMs) {
+    advStartMs = nowMs;
+    enter(ADV_FAST, nowMs);
+}
+
+void BleAdvProfile::enter(Phase p, uint32_t nowMs) {
+    if (current != OFF) totalMs[current] += nowMs - phaseSinceMs;
+    current = p;
+    phaseSinceMs = nowMs;
+}
+
+uint32_t BleAdvProfile::onConnect(uint32_t nowMs) {
+    uint32_t ttc = nowMs - advStartMs;
+    uint8_t i = current == ADV_SLOW ? 1 : 0;
+    connects[i]++;
+    ttcSumMs[i] += ttc;
+    if (ttc < ttcMinMs[i]) ttcMinMs[i] = ttc;
+    if (ttc > ttcMaxMs[i]) ttcMaxMs[i] = ttc;
+    enter(CONN_FAST, nowMs);
+    return ttc;
+}
+
+uint32_t BleAdvProfile::phaseMs(uint8_t p, uint32_t nowMs) const {
+    return totalMs[p] + (current == p ? nowMs - phaseSinceMs : 0);
+}
+
+const char* BleAdvProfile::phaseName(Phase p) {
+    switch (p) {
+        case ADV_FAST: return "adv rápida";
+        case ADV_SLOW: return "adv lenta";
+        case CONN_FAST: return "conexión rápida";
+        case CONN_IDLE: return "conexión en espera";
+        default: return "apagado";
+    }
+}
+
+float BleAdvProfile::phaseMilliamps(Phase p) {
+    switch (p) {
+        case ADV_FAST: return BLE_MA_ADV_FAST;
+        case ADV_SLOW: return BLE_MA_ADV_SLOW;
+        case CONN_FAST: return BLE_MA_CONN_FAST;
+        case CONN_IDLE: return BLE_MA_CONN_IDLE;
+        default: return 0.0f;
+    }
+}
+
+void BleAdvProfile::print(uint32_t nowMs) const {
+    Serial.printf("[BLE] %u sesiones | fase actual: %s\n", sessions, phaseName(current));
+    float totalMah = 0.0f;
+    for (uint8_t p = 0; p < PHASE_COUNT; p++) {
+        uint32_t ms = phaseMs(p, nowMs);
+        float mah = phaseMilliamps((Phase)p) * ms / 3600000.0f;
+        totalMah += mah;
+        Serial.printf("  %-20s %7lu s  %6.3f mAh\n", phaseName((Phase)p), (unsigned long)(ms / 1000), mah);
+    }
+    Serial.printf("  %-20s %7s    %6.3f mAh (radio, estimado)\n", "total", "", totalMah);
+    for (uint8_t i = 0; i < 2; i++) {
+        if (connects[i] == 0) {
+            Serial.printf("  Conexión en %-10s sin datos\n", phaseName((Phase)i));
+            continue;
+        }
+        Serial.printf("  Conexión en %-10s %u veces | hasta conectar: min %lu ms, prom %lu ms, max %lu ms\n",
+            phaseName((Phase)i), connects[i], (unsigned long)ttcMinMs[i],
+            (unsigned long)(ttcSumMs[i] / connects[i]), (unsigned long)ttcMaxMs[i]);
+    }
+}
@@ -0,0 +1,35 @@
+#include "BootProfiler.h"
+
+void BootProfiler::mark(const char* phase) {
+    if (!open || count >= BOOT_PROFILE_MAX_MARKS) return;
+    marks[count].phase = phase;
+    marks[count].atMs = millis();
+    count++;
+}
+
+void BootProfiler::close() {
+    if (!open) return;
+    open = false;
+    print();
+}
+
+uint32_t BootProfiler::at(const char* phase) const {
+    for (uint8_t i = 0; i < count; i++) {
+        if (strcmp(marks[i].phase, phase) == 0) return marks[i].atMs;
+    }
+    return 0;
+}
+
+void BootProfiler::print() const {
+    Serial.printf("[BOOT] Línea de tiempo%s (ms desde el arranque):\n", open ? " (en curso)" : "");
+    uint32_t prev = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        uint32_t dur = marks[i].atMs - prev;
+        char bar[BOOT_PROFILE_BAR_MAX + 1];
+        uint8_t len = dur / BOOT_PROFILE_BAR_MS > BOOT_PROFILE_BAR_MAX ? BOOT_PROFILE_BAR_MAX : dur / BOOT_PROFILE_BAR_MS;
+        memset(bar, '#', len);
+        bar[len] = '\0';
+        Serial.printf("  %-14s %7lu ms  +%6lu ms  %s\n", marks[i].phase, (unsigned long)marks[i].atMs, (unsigned long)dur, bar);
+        prev = marks[i].atMs;
+    }
+}
@@ -0,0 +1,171 @@
+#include "ButtonInput.h"
+#include <driver/gpio.h>
+#include <soc/gpio_struct.h>
+
+void ButtonInput::begin(const uint8_t* pins, uint8_t count) {
+    buttonCount = count > BUTTON_COUNT ? BUTTON_COUNT : count;
+    events = xQueueCreate(BUTTON_EVENT_QUEUE, sizeof(ButtonEvent));
+    // One-shot: tick() lo vuelve a armar solo mientras haya algo que vigilar
+    tickTimer = xTimerCreate("btn", pdMS_TO_TICKS(BUTTON_TICK_MS), pdFALSE, this, onTick);
+
+    uint32_t now = millis();
+    bool heldAtBoot = false;
+    for (uint8_t i = 0; i < buttonCount; i++) {
+        State& b = buttons[i];
+        b.pin = pins[i];
+        b.rawLevel = digitalRead(b.pin);
+        b.stableLevel = HIGH;
+        b.lastEdgeMs = now;
+        b.pressStartMs = now;
+        b.holdsFired = 0;
+        b.settling = false;
+        // Botón ya presionado al arrancar (p.ej. el que despertó al ESP32): no habrá flanco.
+        // El mantenido cuenta desde el arranque, que es cuando se pulsó (millis() = 0)
+        if (b.rawLevel == LOW) {
+            b.pressStartMs = 0;
+            b.settling = true;
+            heldAtBoot = true;
+        }
+        isrArgs[i].self = this;
+        isrArgs[i].button = i;
+        // Armar el nivel contrario al actual; gpio_wakeup_enable() lo deja como fuente de wake
+        attachInterruptArg(b.pin, onEdge, &isrArgs[i], b.rawLevel == LOW ? ONHIGH : ONLOW);
+        gpio_wakeup_enable((gpio_num_t)b.pin, b.rawLevel == LOW ? GPIO_INTR_HIGH_LEVEL : GPIO_INTR_LOW_LEVEL);
+    }
+    if (heldAtBoot) {
+        ticking = true;
+        xTimerStart(tickTimer, 0);
+    }
+    Serial.printf("[BTN] %u botones por interrupción (antirrebote %lu ms)\n", buttonCount, BUTTON_DEBOUNCE_MS);
+}
+
+bool ButtonInput::poll(ButtonEvent& ev, TickType_t wait) {
+    return events && xQueueReceive(events, &ev, wait) == pdTRUE;
+}
+
+bool ButtonInput::isPressed(uint8_t button) const {
+    return button < buttonCount && buttons[button].stableLevel == LOW;
+}
+
+// ===== ISR =====
+void IRAM_ATTR ButtonInput::onEdge(void* arg) {
+    IsrArg* a = static_cast<IsrArg*>(arg);
+    ButtonInput* self = a->self;
+    uint8_t pin = self->buttons[a->button].pin;
+    uint8_t level = digitalRead(pin);
+    // Invertir el nivel armado (registro directo: gpio_set_intr_type() no está en IRAM).
+    // Se conserva el bit de wake, así el mismo pin despierta del light sleep en ambos sentidos.
+    GPIO.pin[pin].int_type = level == LOW ? GPIO_INTR_HIGH_LEVEL : GPIO_INTR_LOW_LEVEL;
+    self->pushEdge(a->button, level, millis());
+}
+
+void IRAM_ATTR ButtonInput::pushEdge(uint8_t button, uint8_t level, uint32_t atMs) {
+    bool start = false;
+    portENTER_CRITICAL_ISR(&edgeMux);
+    uint8_t next = (edgeHead + 1) % BUTTON_EDGE_QUEUE;
+    if (next == edgeTail) {
+        edgesDropped++;   // Rebote extremo: el nivel final igual se relee en tick()
+    } else {
+        edges[edgeHead].button = button;
+        edges[edgeHead].level = level;
+        edges[edgeHead].atMs = atMs;
+        edgeHead = next;
+    }
+    if (!ticking) {
+        ticking = true;
+        start = true;
+    }
+    portEXIT_CRITICAL_ISR(&edgeMux);
+
+    if (start) {
+        BaseType_t woken = pdFALSE;
+        xTimerStartFromISR(tickTimer, &woken);
+        if (woken) portYIELD_FROM_ISR();
+    }
+}
+
+// ===== TIMER DE SOFTWARE =====
+void ButtonInput::onTick(TimerHandle_t timer) {
+    static_cast<ButtonInput*>(pvTimerGetTimerID(timer))->tick();
+}
+
+void ButtonInput::tick() {
+    uint32_t now = millis();
+
+    // 1) Vaciar los flancos crudos
+    for (;;) {
+        Edge e;
+        portENTER_CRITICAL(&edgeMux);
+        bool any = edgeTail != edgeHead;
+        if (any) {
+            e = edges[edgeTail];
+            edgeTail = (edgeTail + 1) % BUTTON_EDGE_QUEUE;
+        }
+        portEXIT_CRITICAL(&edgeMux);
+        if (!any) break;
+
+        State& b = buttons[e.button];
+        // La pulsación empieza en el primer flanco de bajada de la ráfaga
+        if (!b.settling && e.level == LOW && b.stableLevel == HIGH) b.pressStartMs = e.atMs;
+        b.rawLevel = e.level;
+        b.lastEdgeMs = e.atMs;
+        b.settling = true;
+    }
+
+    // 2) Antirrebote y umbrales de mantenido
+    bool active = false;
+    for (uint8_t i = 0; i < buttonCount; i++) {
+        State& b = buttons[i];
+        if (b.settling) {
+            if ((now - b.lastEdgeMs) < BUTTON_DEBOUNCE_MS) {
+                active = true;
+                continue;
+            }
+            b.settling = false;
+            uint8_t level = digitalRead(b.pin);   // Nivel real: cubre flancos perdidos
+            if (level != b.stableLevel) {
+                b.stableLevel = level;
+                if (level == LOW) {
+                    b.holdsFired = 0;
+                    if (b.pressStartMs != 0) {   // 0 = presionado desde el arranque (sin flanco medido)
+                        pressLatencyLastMs = now - b.pressStartMs;
+                        if (pressLatencyLastMs > pressLatencyMaxMs) pressLatencyMaxMs = pressLatencyLastMs;
+                    }
+                    emit(i, ButtonEvent::Type::PRESS, b.pressStartMs, 0);
+                } else {
+                    emit(i, ButtonEvent::Type::RELEASE, b.lastEdgeMs, b.lastEdgeMs - b.pressStartMs);
+                }
+            }
+        }
+
+        if (b.stableLevel == LOW) {
+            uint32_t held = now - b.pressStartMs;
+            if (held >= BUTTON_HOLD_SOS_MS && !(b.holdsFired & 1)) {
+                b.holdsFired |= 1;
+                emit(i, ButtonEvent::Type::HOLD, now, BUTTON_HOLD_SOS_MS);
+            }
+            if (held >= BUTTON_HOLD_PAIR_MS && !(b.holdsFired & 2)) {
+                b.holdsFired |= 2;
+                emit(i, ButtonEvent::Type::HOLD, now, BUTTON_HOLD_PAIR_MS);
+            }
+            // Con ambos umbrales cumplidos ya no hay nada que medir: el flanco de subida re-arma
+            if (b.holdsFired != 3) active = true;
+        }
+    }
+
+    // 3) Re-armar solo con actividad; si no, el timer queda detenido hasta el próximo flanco
+    portENTER_CRITICAL(&edgeMux);
+    bool rearm = active || edgeTail != edgeHead;
+    if (!rearm) ticking = false;
+    portEXIT_CRITICAL(&edgeMux);
+    if (rearm) xTimerStart(tickTimer, 0);
+}
+
+void ButtonInput::emit(uint8_t button, ButtonEvent::Type type, uint32_t atMs, uint32_t heldMs) {
+    ButtonEvent ev;
+    ev.button = button;
+    ev.type = type;
+    ev.atMs = atMs;
+    ev.heldMs = heldMs;
+    xQueueSend(events, &ev, 0);   // Cola llena: el loop lleva mucho bloqueado, se pierde el evento más nuevo
+}
@@ -0,0 +1,85 @@
+#include "DeepSleep.h"
+#include <esp_attr.h>
+#include <esp_sleep.h>
+#include <driver/rtc_io.h>
+#include <sys/time.h>
+
+static RTC_DATA_ATTR RtcRuntime rtcRuntime;
+
+WakeReason DeepSleep::wakeReason() {
+    switch (esp_sleep_get_wakeup_cause()) {
+        case ESP_SLEEP_WAKEUP_TIMER: return WakeReason::TIMER;
+        case ESP_SLEEP_WAKEUP_EXT0:
+        case ESP_SLEEP_WAKEUP_EXT1:  return WakeReason::BUTTON;
+        default:                     return WakeReason::COLD;
+    }
+}
+
+int DeepSleep::wakePin() {
+    esp_sleep_source_t cause = esp_sleep_get_wakeup_cause();
+    if (cause == ESP_SLEEP_WAKEUP_EXT1) {
+        uint64_t mask = esp_sleep_get_ext1_wakeup_status();
+        for (int pin = 0; pin < 40; pin++) {
+            if (mask & (1ULL << pin)) return pin;
+        }
+    }
+    if (cause == ESP_SLEEP_WAKEUP_EXT0 && valid()) return rtcRuntime.ext0Pin;
+    return -1;
+}
+
+bool DeepSleep::valid() {
+    return rtcRuntime.magic == RTC_RUNTIME_MAGIC;
+}
+
+RtcRuntime& DeepSleep::state() {
+    return rtcRuntime;
+}
+
+void DeepSleep::invalidate() {
+    rtcRuntime.magic = 0;
+}
+
+uint64_t DeepSleep::rtcClockMs() {
+    // gettimeofday() se apoya en el timer RTC, que no se detiene en deep sleep
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    return (uint64_t)tv.tv_sec * 1000ULL + tv.tv_usec / 1000;
+}
+
+void DeepSleep::start(uint32_t sleepMs, const uint8_t* wakePins, uint8_t count) {
+    if (sleepMs < SLEEP_MIN_SLEEP_MS) sleepMs = SLEEP_MIN_SLEEP_MS;
+    rtcRuntime.magic = RTC_RUNTIME_MAGIC;
+
+    esp_sleep_enable_timer_wakeup((uint64_t)sleepMs * 1000ULL);
+
+    rtcRuntime.ext0Pin = -1;
+    bool ext0Used = false;
+    bool ext1Used = false;
+    for (uint8_t i = 0; i < count; i++) {
+        gpio_num_t pin = (gpio_num_t)wakePins[i];
+        if (!rtc_gpio_is_valid_gpio(pin)) {
+            Serial.printf("[SLEEP] GPIO%u no es pin RTC: no despierta al ESP32\n", wakePins[i]);
+            continue;
+        }
+        if (!ext0Used) {
+            esp_sleep_enable_ext0_wakeup(pin, 0);
+            rtcRuntime.ext0Pin = (int8_t)wakePins[i];
+            ext0Used = true;
+        } else if (!ext1Used) {
+            // ALL_LOW con un solo pin en la máscara = ese pin en bajo
+            esp_sleep_enable_ext1_wakeup(1ULL << wakePins[i], ESP_EXT1_WAKEUP_ALL_LOW);
+            ext1Used = true;
+        } else {
+            Serial.printf("[SLEEP] GPIO%u sin fuente de wake libre\n", wakePins[i]);
+            continue;
+        }
+        // Pull-up del dominio RTC: el de GPIO se apaga en deep sleep
+        rtc_gpio_pullup_en(pin);
+        rtc_gpio_pulldown_dis(pin);
+    }
+    if (ext0Used) esp_sleep_pd_config(ESP_PD_DOMAIN_RTC_PERIPH, ESP_PD_OPTION_ON);
+
+    Serial.printf("[SLEEP] Deep sleep %lu s (wake #%lu)\n", (unsigned long)(sleepMs / 1000), (unsigned long)rtcRuntime.wakeCount + 1);
+    Serial.flush();
+    esp_deep_sleep_start();
+}
@@ -0,0 +1,214 @@
+#include "DeviceConfig.h"
+#include <Preferences.h>
+#include <esp_attr.h>
+
+// Espejo en memoria RTC: al despertar del deep sleep no se abre NVS
+static RTC_DATA_ATTR ConfigBlob rtcBlob;
+
+// Claves sueltas de versiones anteriores (se migran y se borran)
+static const char* const kLegacyKeys[] = {
+    "provisioned", "ownerUid", "apn", "logLevel", "http_status", "sms_gw", "sos_multi", "psm", "energy_hb"
+};
+#define LEGACY_KEY_COUNT (sizeof(kLegacyKeys) / sizeof(kLegacyKeys[0]))
+
+// ===== INTEGRIDAD =====
+uint32_t DeviceConfig::crc32(const uint8_t* buf, size_t len) {
+    uint32_t crc = 0xFFFFFFFFUL;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= buf[i];
+        for (uint8_t b = 0; b < 8; b++) {
+            crc = (crc >> 1) ^ (0xEDB88320UL & (0 - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+bool DeviceConfig::valid(const ConfigBlob& blob) {
+    return blob.magic == CONFIG_MAGIC && blob.version == CONFIG_VERSION &&
+           blob.size == sizeof(ConfigData) &&
+           blob.crc == crc32((const uint8_t*)&blob.data, sizeof(ConfigData));
+}
+
+void DeviceConfig::seal(ConfigBlob& blob) const {
+    blob.magic = CONFIG_MAGIC;
+    blob.version = CONFIG_VERSION;
+    blob.size = sizeof(ConfigData);
+    blob.data = data;
+    blob.crc = crc32((const uint8_t*)&blob.data, sizeof(ConfigData));
+}
+
+// ===== CARGA =====
+DeviceConfig::Source DeviceConfig::load(const ConfigData& defaults) {
+    dirty = diagDirty = false;
+    if (valid(rtcBlob)) {
+        data = rtcBlob.data;
+        source = Source::RTC;
+        return source;
+    }
+
+    ConfigBlob flash;
+    Preferences prefs;
+    prefs.begin(CONFIG_NVS_NS, true);
+    size_t len = prefs.isKey(CONFIG_NVS_KEY) ? prefs.getBytes(CONFIG_NVS_KEY, &flash, sizeof(flash)) : 0;
+    prefs.end();
+    if (len == sizeof(flash) && valid(flash)) {
+        data = flash.data;
+        source = Source::NVS;
+    } else {
+        if (len > 0) Serial.println("[CONFIG] ⚠️ Blob inválido (versión o CRC) - se reconstruye");
+        source = migrateLegacy(defaults) ? Source::MIGRATED : Source::DEFAULTS;
+        if (source == Source::MIGRATED) commit(true);
+    }
+    seal(rtcBlob);
+    return source;
+}
+
+// Formato anterior: una clave por campo. Se leen, se escribe el blob y se borran
+bool DeviceConfig::migrateLegacy(const ConfigData& defaults) {
+    data = defaults;
+    Preferences prefs;
+    prefs.begin(CONFIG_NVS_NS, true);
+    bool found = false;
+    for (uint8_t i = 0; i < LEGACY_KEY_COUNT; i++) {
+        if (prefs.isKey(kLegacyKeys[i])) found = true;
+    }
+    if (found) {
+        data.provisioned = prefs.getBool("provisioned", false);
+        data.logLevel = prefs.getInt("logLevel", defaults.logLevel);
+        data.sosMultipath = prefs.getBool("sos_multi", defaults.sosMultipath);
+        data.psm = prefs.getBool("psm", defaults.psm);
+        data.energyInHeartbeat = prefs.getBool("energy_hb", defaults.energyInHeartbeat);
+        data.httpStatus = prefs.getString("http_status", String(defaults.httpStatus)).toInt();
+        copyString(data.ownerUid, sizeof(data.ownerUid), prefs.getString("ownerUid", "").c_str());
+        copyString(data.modemApn, sizeof(data.modemApn), prefs.getString("apn", "").c_str());
+        copyString(data.smsGateway, sizeof(data.smsGateway), prefs.getString("sms_gw", "").c_str());
+    }
+    prefs.end();
+    if (!found) return false;
+    legacyKeys = true;
+    Serial.println("[CONFIG] Migrando claves sueltas al blob v" + String(CONFIG_VERSION));
+    return true;
+}
+
+// ===== CAMBIOS =====
+void DeviceConfig::copyString(char* dst, size_t cap, const char* src) {
+    char tmp[sizeof(ConfigData::endpoint)];
+    snprintf(tmp, sizeof(tmp) < cap ? sizeof(tmp) : cap, "%s", src);
+    if (strcmp(dst, tmp) == 0) return;
+    memcpy(dst, tmp, strlen(tmp) + 1);
+    dirty = true;
+}
+
+void DeviceConfig::setOwner(const char* uid) {
+    copyString(data.ownerUid, sizeof(data.ownerUid), uid);
+    if (!data.provisioned) {
+        data.provisioned = 1;
+        dirty = true;
+    }
+}
+
+void DeviceConfig::setApn(const char* apn) {
+    copyString(data.modemApn, sizeof(data.modemApn), apn);
+}
+
+void DeviceConfig::setSmsGateway(const char* gateway) {
+    copyString(data.smsGateway, sizeof(data.smsGateway), gateway);
+}
+
+void DeviceConfig::setEndpoint(const char* base) {
+    copyString(data.endpoint, sizeof(data.endpoint), base);
+}
+
+void DeviceConfig::setSmsKey(const uint8_t* key) {
+    if (memcmp(data.smsKey, key, sizeof(data.smsKey)) == 0) return;
+    memcpy(data.smsKey, key, sizeof(data.smsKey));
+    dirty = true;
+}
+
+void DeviceConfig::setLogLevel(int8_t level) {
+    if (data.logLevel == level) return;
+    data.logLevel = level;
+    dirty = true;
+}
+
+void DeviceConfig::setSosMultipath(bool on) {
+    if (data.sosMultipath == on) return;
+    data.sosMultipath = on;
+    dirty = true;
+}
+
+void DeviceConfig::setPsm(bool on) {
+    if (data.psm == on) return;
+    data.psm = on;
+    dirty = true;
+}
+
+void DeviceConfig::setEnergyInHeartbeat(bool on) {
+    if (data.energyInHeartbeat == on) return;
+    data.energyInHeartbeat = on;
+    dirty = true;
+}
+
+void DeviceConfig::setHttpStatus(int status) {
+    if (data.httpStatus == status) return;
+    data.httpStatus = status;
+    diagDirty = true;
+}
+
+// ===== ESCRITURA =====
+bool DeviceConfig::commit(bool withDiagnostics) {
+    if (!dirty && !(withDiagnostics && diagDirty)) {
+        // Solo diagnóstico pendiente: el espejo RTC sí lo lleva
+        if (diagDirty) seal(rtcBlob);
+        return false;
+    }
+    ConfigBlob blob;
+    seal(blob);
+    Preferences prefs;
+    prefs.begin(CONFIG_NVS_NS, false);
+    bool ok = prefs.putBytes(CONFIG_NVS_KEY, &blob, sizeof(blob)) == sizeof(blob);
+    if (ok && legacyKeys) {
+        for (uint8_t i = 0; i < LEGACY_KEY_COUNT; i++) prefs.remove(kLegacyKeys[i]);
+        legacyKeys = false;
+    }
+    prefs.end();
+    rtcBlob = blob;
+    if (!ok) {
+        Serial.println("[CONFIG] ✗ Error escribiendo el blob en NVS");
+        return false;
+    }
+    dirty = diagDirty = false;
+    writes++;
+    return true;
+}
+
+void DeviceConfig::erase() {
+    Preferences prefs;
+    prefs.begin(CONFIG_NVS_NS, false);
+    prefs.clear();
+    prefs.end();
+    memset(&rtcBlob, 0, sizeof(rtcBlob));
+    dirty = diagDirty = false;
+}
+
+const char* DeviceConfig::sourceName(Source s) {
+    switch (s) {
+        case Source::RTC: return "RTC";
+        case Source::NVS: return "NVS";
+        case Source::MIGRATED: return "migrada";
+        default: return "defaults";
+    }
+}
+
+void DeviceConfig::print() const {
+    Serial.printf("[CONFIG] v%u, %u bytes, origen %s, %lu escrituras%s\n",
+        CONFIG_VERSION, (unsigned)sizeof(ConfigBlob), sourceName(source), (unsigned long)writes,
+        dirty ? " (cambios sin guardar)" : "");
+    Serial.printf("  provisioned=%u ownerUid=%s apn=%s smsGw=%s\n",
+        data.provisioned, data.ownerUid, data.modemApn[0] ? data.modemApn : "(universal)", data.smsGateway);
+    bool hasKey = false;
+    for (uint8_t i = 0; i < sizeof(data.smsKey); i++) hasKey |= data.smsKey[i] != 0;
+    Serial.printf("  endpoint=%s smsKey=%s\n", data.endpoint[0] ? data.endpoint : "(fábrica)", hasKey ? "sí" : "no");
+    Serial.printf("  logLevel=%d sosMulti=%u psm=%u energyHb=%u httpStatus=%ld\n",
+        data.logLevel, data.sosMultipath, data.psm, data.energyInHeartbeat, (long)data.httpStatus);
+}
@@ -0,0 +1,119 @@
+#include "EnergyMeter.h"
+#include <Preferences.h>
+
+namespace {
+
+const uint8_t kLines = 6;
+// Línea del reporte -> nombre (también clave NVS y campo JSON) e índice del modelo
+const char* const kLineNames[kLines] = {"cpu", "sleep", "modem", "tx", "gnss", "ble"};
+const uint8_t kLineModel[kLines] = {
+    EnergyMeter::SUB_COUNT, EnergyMeter::CPU_SLEEP, EnergyMeter::MODEM_REG,
+    EnergyMeter::MODEM_TX, EnergyMeter::GNSS, EnergyMeter::BLE_ADV,
+};
+const float kDefaults[EnergyMeter::SUB_COUNT + 1] = {
+    ENERGY_MA_CPU_SLEEP, ENERGY_MA_MODEM_IDLE, ENERGY_MA_MODEM_TX,
+    ENERGY_MA_GNSS, ENERGY_MA_BLE_ADV, ENERGY_MA_CPU_AWAKE,
+};
+
+} // namespace
+
+void EnergyMeter::begin(uint32_t nowMs) {
+    Preferences prefs;
+    prefs.begin(ENERGY_NVS_NS, true);
+    for (uint8_t i = 0; i < kLines; i++) {
+        model[kLineModel[i]] = prefs.getFloat(kLineNames[i], kDefaults[kLineModel[i]]);
+    }
+    prefs.end();
+    reset(nowMs);
+}
+
+void EnergyMeter::set(Sub sub, bool state, uint32_t nowMs) {
+    if (on[sub] == state) return;
+    if (on[sub]) totalMs[sub] += nowMs - sinceMs[sub];
+    on[sub] = state;
+    sinceMs[sub] = nowMs;
+}
+
+void EnergyMeter::reset(uint32_t nowMs) {
+    windowStartMs = nowMs;
+    for (uint8_t i = 0; i < SUB_COUNT; i++) {
+        totalMs[i] = 0;
+        sinceMs[i] = nowMs;
+    }
+}
+
+uint32_t EnergyMeter::onTime(uint8_t sub, uint32_t nowMs) const {
+    return totalMs[sub] + (on[sub] ? nowMs - sinceMs[sub] : 0);
+}
+
+// ===== MODELO DE CORRIENTE =====
+bool EnergyMeter::setModel(const String& name, float mA) {
+    for (uint8_t i = 0; i < kLines; i++) {
+        if (name != kLineNames[i]) continue;
+        model[kLineModel[i]] = mA;
+        Preferences prefs;
+        prefs.begin(ENERGY_NVS_NS, false);
+        prefs.putFloat(kLineNames[i], mA);
+        prefs.end();
+        return true;
+    }
+    return false;
+}
+
+void EnergyMeter::printModel() const {
+    Serial.print("[ENERGY] Modelo (mA):");
+    for (uint8_t i = 0; i < kLines; i++) {
+        Serial.printf(" %s=%.2f", kLineNames[i], model[kLineModel[i]]);
+    }
+    Serial.println();
+}
+
+// ===== REPORTE =====
+void EnergyMeter::averages(uint32_t nowMs, float* out, uint32_t* windowMs) const {
+    uint32_t window = nowMs - windowStartMs;
+    if (window == 0) window = 1;
+    uint32_t sleep = onTime(CPU_SLEEP, nowMs);
+    uint32_t reg = onTime(MODEM_REG, nowMs);
+    uint32_t tx = onTime(MODEM_TX, nowMs);
+    uint32_t times[kLines] = {
+        window > sleep ? window - sleep : 0,   // CPU despierta
+        sleep,
+        reg > tx ? reg - tx : 0,               // Módem registrado sin transmitir
+        tx,
+        onTime(GNSS, nowMs),
+        onTime(BLE_ADV, nowMs),
+    };
+    for (uint8_t i = 0; i < kLines; i++) {
+        out[i] = model[kLineModel[i]] * (float)times[i] / (float)window;
+    }
+    if (windowMs) *windowMs = window;
+}
+
+void EnergyMeter::print(uint32_t nowMs) const {
+    float avg[kLines];
+    uint32_t window;
+    averages(nowMs, avg, &window);
+    float total = 0;
+    Serial.printf("[ENERGY] Ventana %lu s (estimación por modelo)\n", (unsigned long)(window / 1000));
+    for (uint8_t i = 0; i < kLines; i++) {
+        float share = model[kLineModel[i]] > 0 ? avg[i] / model[kLineModel[i]] * 100.0f : 0;
+        Serial.printf("  %-6s %5.1f%% del tiempo x %6.2f mA = %7.3f mAh/h\n",
+            kLineNames[i], share, model[kLineModel[i]], avg[i]);
+        total += avg[i];
+    }
+    Serial.printf("  TOTAL  %.3f mAh/h\n", total);
+}
+
+void EnergyMeter::fillJson(JsonDocument& doc, uint32_t nowMs) const {
+    float avg[kLines];
+    uint32_t window;
+    averages(nowMs, avg, &window);
+    JsonObject e = doc["energy"].to<JsonObject>();
+    e["win"] = window / 1000;
+    float total = 0;
+    for (uint8_t i = 0; i < kLines; i++) {
+        e[kLineNames[i]] = roundf(avg[i] * 1000.0f) / 1000.0f;
+        total += avg[i];
+    }
+    e["total"] = roundf(total * 1000.0f) / 1000.0f;
+}
@@ -0,0 +1,253 @@
+#include <Arduino.h>
+#include "Geofence.h"
+#include "JsonArena.h"
+#include <ArduinoJson.h>
+#include <Preferences.h>
+
+// Tamaño máximo del blob: cabecera + geocercas completas
+static const size_t kBlobHeader = 4;     // version, count, setVersion(2)
+static const size_t kFenceHeader = 6;    // id(2), type, n, radius(2)
+static const size_t kBlobMax = kBlobHeader + GEOFENCE_MAX * (kFenceHeader + GEOFENCE_MAX_VERTICES * 8);
+
+static void put16(uint8_t* b, size_t& i, uint16_t v) { b[i++] = v & 0xFF; b[i++] = v >> 8; }
+static void put32(uint8_t* b, size_t& i, int32_t v) {
+    uint32_t u = (uint32_t)v;
+    for (int k = 0; k < 4; k++) b[i++] = (u >> (8 * k)) & 0xFF;
+}
+static uint16_t get16(const uint8_t* b, size_t& i) { uint16_t v = b[i] | (b[i + 1] << 8); i += 2; return v; }
+static int32_t get32(const uint8_t* b, size_t& i) {
+    uint32_t u = 0;
+    for (int k = 0; k < 4; k++) u |= (uint32_t)b[i + k] << (8 * k);
+    i += 4;
+    return (int32_t)u;
+}
+
+// ===== PUNTO EN POLÍGONO (ENTERO) =====
+// Ray casting sobre microgrados. Productos en int64: sin pérdida de precisión.
+bool GeofenceSet::pointInPolygon(int32_t latE6, int32_t lonE6,
+                                 const int32_t* latsE6, const int32_t* lonsE6, uint8_t n) {
+    bool inside = false;
+    for (uint8_t i = 0, j = n - 1; i < n; j = i++) {
+        int32_t yi = latsE6[i], yj = latsE6[j];
+        int32_t xi = lonsE6[i], xj = lonsE6[j];
+        if ((yi > latE6) == (yj > latE6)) continue;
+        // ¿El cruce del rayo horizontal con el borde queda a la derecha del punto?
+        int64_t lhs = (int64_t)(lonE6 - xi) * (yj - yi);
+        int64_t rhs = (int64_t)(xj - xi) * (latE6 - yi);
+        if ((yj > yi) ? (lhs < rhs) : (lhs > rhs)) inside = !inside;
+    }
+    return inside;
+}
+
+void GeofenceSet::derive(Geofence& f) {
+    float latDeg = f.latE6[0] / 1000000.0f;
+    f.cosQ15 = (int32_t)(cosf(latDeg * 0.01745329252f) * 32768.0f);
+    // 1 grado de latitud ≈ 111320 m
+    int64_t radiusE6 = (int64_t)f.radiusM * 1000000LL / 111320LL;
+    f.radiusSqE6 = radiusE6 * radiusE6;
+    f.inside = -1;
+    f.pendingCount = 0;
+}
+
+bool GeofenceSet::contains(const Geofence& f, int32_t latE6, int32_t lonE6) const {
+    if (f.type == GeofenceType::CIRCLE) {
+        int64_t dy = (int64_t)latE6 - f.latE6[0];
+        int64_t dx = ((int64_t)lonE6 - f.lonE6[0]) * f.cosQ15 >> 15;
+        return dx * dx + dy * dy <= f.radiusSqE6;
+    }
+    return pointInPolygon(latE6, lonE6, f.latE6, f.lonE6, f.vertexCount);
+}
+
+// ===== PERSISTENCIA (BLOB NVS) =====
+void GeofenceSet::clear() {
+    fenceCount = 0;
+    setVersion = 0;
+}
+
+bool GeofenceSet::save() const {
+    uint8_t buf[kBlobMax];
+    size_t i = 0;
+    buf[i++] = GEOFENCE_BLOB_VERSION;
+    buf[i++] = fenceCount;
+    put16(buf, i, setVersion);
+    for (uint8_t k = 0; k < fenceCount; k++) {
+        const Geofence& f = fences[k];
+        put16(buf, i, f.id);
+        buf[i++] = (uint8_t)f.type;
+        buf[i++] = f.vertexCount;
+        put16(buf, i, f.radiusM);
+        for (uint8_t v = 0; v < f.vertexCount; v++) {
+            put32(buf, i, f.latE6[v]);
+            put32(buf, i, f.lonE6[v]);
+        }
+    }
+
+    Preferences prefs;
+    prefs.begin("wilobu", false);
+    size_t written = prefs.putBytes(GEOFENCE_NVS_KEY, buf, i);
+    prefs.end();
+    Serial.printf("[GEOFENCE] Guardadas %u geocercas (v%u, %u bytes)\n", fenceCount, setVersion, (unsigned)i);
+    return written == i;
+}
+
+bool GeofenceSet::load() {
+    uint8_t buf[kBlobMax];
+    Preferences prefs;
+    prefs.begin("wilobu", true);
+    size_t len = prefs.isKey(GEOFENCE_NVS_KEY) ? prefs.getBytes(GEOFENCE_NVS_KEY, buf, sizeof(buf)) : 0;
+    prefs.end();
+
+    clear();
+    if (len < kBlobHeader || buf[0] != GEOFENCE_BLOB_VERSION || buf[1] > GEOFENCE_MAX) {
+        return false;
+    }
+
+    size_t i = 2;
+    uint16_t ver = get16(buf, i);
+    uint8_t n = buf[1];
+    for (uint8_t k = 0; k < n; k++) {
+        if (i + kFenceHeader > len) { clear(); return false; }
+        Geofence& f = fences[k];
+        f.id = get16(buf, i);
+        f.type = (GeofenceType)buf[i++];
+        f.vertexCount = buf[i++];
+        f.radiusM = get16(buf, i);
+        if (f.vertexCount == 0 || f.vertexCount > GEOFENCE_MAX_VERTICES ||
+            i + (size_t)f.vertexCount * 8 > len) { clear(); return false; }
+        for (uint8_t v = 0; v < f.vertexCount; v++) {
+            f.latE6[v] = get32(buf, i);
+            f.lonE6[v] = get32(buf, i);
+        }
+        derive(f);
+    }
+    fenceCount = n;
+    setVersion = ver;
+    Serial.printf("[GEOFENCE] %u geocercas cargadas (v%u)\n", fenceCount, setVersion);
+    return true;
+}
+
+// ===== ACTUALIZACIÓN DESDE BACKEND =====
+// Formato compacto: {"geofences":{"v":3,"f":[{"i":1,"c":[latE6,lngE6,radioM]},{"i":2,"p":[latE6,lngE6,...]}]}}
+bool GeofenceSet::applyJson(const char* body, JsonArena* arena) {
+    const char* key = strstr(body, "\"geofences\"");
+    if (!key) return false;
+
+    // Solo el objeto de geocercas pasa por el documento; deserializeJson se
+    // detiene al cerrarlo y no lee el resto de la respuesta ni el eco AT
+    const char* start = strchr(key, '{');
+    const char* end = strrchr(body, '}');
+    if (!start || !end || end <= start) return false;
+
+    if (arena) {
+        JsonDocument doc(arena);
+        return applyDoc(doc, start, end - start + 1);
+    }
+    JsonDocument doc;
+    return applyDoc(doc, start, end - start + 1);
+}
+
+bool GeofenceSet::applyDoc(JsonDocument& doc, const char* json, size_t len) {
+    DeserializationError err = deserializeJson(doc, json, len);
+    if (err) {
+        Serial.print("[GEOFENCE] JSON inválido: ");
+        Serial.println(err.c_str());
+        return false;
+    }
+
+    JsonObject set = doc.as<JsonObject>();
+    if (set.isNull()) return false;
+    uint16_t ver = set["v"] | 0;
+    if (ver == setVersion) return false;
+
+    uint8_t n = 0;
+    for (JsonObject item : set["f"].as<JsonArray>()) {
+        if (n >= GEOFENCE_MAX) break;
+        Geofence& f = fences[n];
+        f.id = item["i"] | 0;
+
+        JsonArray circle = item["c"];
+        JsonArray poly = item["p"];
+        if (!circle.isNull() && circle.size() == 3) {
+            f.type = GeofenceType::CIRCLE;
+            f.vertexCount = 1;
+            f.latE6[0] = circle[0];
+            f.lonE6[0] = circle[1];
+            f.radiusM = circle[2];
+        } else if (!poly.isNull() && poly.size() >= 6 && poly.size() % 2 == 0 &&
+                   poly.size() / 2 <= GEOFENCE_MAX_VERTICES) {
+            f.type = GeofenceType::POLYGON;
+            f.vertexCount = poly.size() / 2;
+            f.radiusM = 0;
+            for (uint8_t v = 0; v < f.vertexCount; v++) {
+                f.latE6[v] = poly[v * 2];
+                f.lonE6[v] = poly[v * 2 + 1];
+            }
+        } else {
+            Serial.printf("[GEOFENCE] Geocerca %u ignorada (formato)\n", f.id);
+            continue;
+        }
+        derive(f);
+        n++;
+    }
+
+    fenceCount = n;
+    setVersion = ver;
+    Serial.printf("[GEOFENCE] Recibidas %u geocercas (v%u)\n", fenceCount, setVersion);
+    return true;
+}
+
+// ===== EVALUACIÓN POR FIX =====
+uint8_t GeofenceSet::evaluate(const GPSLocation& fix, GeofenceEvent* events, uint8_t maxEvents) {
+    if (!fix.isValid || fenceCount == 0) return 0;
+    if (fix.accuracy > GEOFENCE_MAX_ACCURACY_M) return 0;
+
+    int32_t lat = (int32_t)lroundf(fix.latitude * 1000000.0f);
+    int32_t lon = (int32_t)lroundf(fix.longitude * 1000000.0f);
+
+    uint8_t count = 0;
+    for (uint8_t k = 0; k < fenceCount; k++) {
+        Geofence& f = fences[k];
+        int8_t in = contains(f, lat, lon) ? 1 : 0;
+
+        // Primer fix: fijar estado sin generar evento
+        if (f.inside < 0) {
+            f.inside = in;
+            continue;
+        }
+        if (in == f.inside) {
+            f.pendingCount = 0;
+            continue;
+        }
+        // Histéresis: el cruce debe repetirse para descartar ruido en el borde
+        if (++f.pendingCount < GEOFENCE_CONFIRM_FIXES) continue;
+
+        f.inside = in;
+        f.pendingCount = 0;
+        if (count < maxEvents) {
+            events[count].id = f.id;
+            events[count].entered = (in == 1);
+            count++;
+        }
+    }
+    return count;
+}
+
+bool GeofenceSet::hasPendingCrossing() const {
+    for (uint8_t k = 0; k < fenceCount; k++) {
+        if (fences[k].pendingCount > 0) return true;
+    }
+    return false;
+}
+
+void GeofenceSet::print() const {
+    Serial.printf("[GEOFENCE] v%u, %u geocercas\n", setVersion, fenceCount);
+    for (uint8_t k = 0; k < fenceCount; k++) {
+        const Geofence& f = fences[k];
+        if (f.type == GeofenceType::CIRCLE) {
+            Serial.printf("  #%u círculo %.6f,%.6f r=%um estado=%d\n", f.id,
+                f.latE6[0] / 1e6, f.lonE6[0] / 1e6, f.radiusM, f.inside);
+        } else {
+            Serial.printf("  #%u polígono %u vértices estado=%d\n", f.id, f.vertexCount, f.inside);
+        }
+    }
+}
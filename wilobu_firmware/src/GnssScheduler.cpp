@@ -0,0 +1,133 @@
+#include <Arduino.h>
+#include "GnssScheduler.h"
+
+static const float kDegToRad = 0.01745329252f;
+static const float kEarthRadiusM = 6371000.0f;
+
+// ===== DISTANCIA ENTRE FIXES =====
+// Aproximación equirectangular: suficiente para distancias de cientos de metros
+float GnssScheduler::distanceMeters(float lat1, float lon1, float lat2, float lon2) {
+    float dLat = (lat2 - lat1) * kDegToRad;
+    float dLon = (lon2 - lon1) * kDegToRad * cosf((lat1 + lat2) * 0.5f * kDegToRad);
+    return kEarthRadiusM * sqrtf(dLat * dLat + dLon * dLon);
+}
+
+uint32_t GnssScheduler::powerRetryDelayMs(uint8_t failCount) {
+    if (failCount <= 1) return GNSS_POWER_RETRY_1_MS;
+    return failCount == 2 ? GNSS_POWER_RETRY_2_MS : GNSS_POWER_RETRY_MAX_MS;
+}
+
+void GnssScheduler::begin(uint32_t nowMs) {
+    state = Motion::UNKNOWN;
+    lastEvalMs = nowMs;
+    waitMs = 0;              // Primera muestra inmediata
+    keepPowered = true;
+    acquiring = false;
+    acqFailures = 0;
+    hasRef = false;
+    lastCourse = -1.0f;
+    stationaryStreak = 0;
+}
+
+void GnssScheduler::schedule(uint32_t nowMs, uint32_t intervalMs) {
+    lastEvalMs = nowMs;
+    waitMs = intervalMs;
+}
+
+void GnssScheduler::setPowered(bool on, uint32_t nowMs) {
+    if (on == powered) return;
+    if (on) {
+        poweredSinceMs = nowMs;
+    } else {
+        onAccumMs += nowMs - poweredSinceMs;
+    }
+    powered = on;
+}
+
+// ===== FIX OBTENIDO =====
+// Clasifica quieto/movimiento y fija el próximo intervalo
+void GnssScheduler::onFix(const GPSLocation& fix, uint32_t nowMs) {
+    fixes++;
+    acquiring = false;
+    acqFailures = 0;
+
+    float displacement = hasRef ? distanceMeters(refLat, refLon, fix.latitude, fix.longitude) : 0.0f;
+    // El umbral crece con la imprecisión del fix para no confundir ruido con movimiento
+    float threshold = GNSS_MOVING_DISPLACEMENT_M;
+    if (fix.accuracy > 0.0f && fix.accuracy < 100.0f && 2.0f * fix.accuracy > threshold) {
+        threshold = 2.0f * fix.accuracy;
+    }
+
+    bool bySpeed = fix.speedKmh >= GNSS_MOVING_SPEED_KMH;
+    bool moving = bySpeed || displacement >= threshold;
+
+    uint32_t interval;
+    if (moving) {
+        state = Motion::MOVING;
+        stationaryStreak = 0;
+
+        if (bySpeed) {
+            // Espaciado constante en metros: más rápido => muestras más seguidas
+            float mps = fix.speedKmh / 3.6f;
+            interval = (uint32_t)(GNSS_TARGET_SPACING_M / mps * 1000.0f);
+            if (interval < GNSS_INTERVAL_MIN_MS) interval = GNSS_INTERVAL_MIN_MS;
+            if (interval > GNSS_INTERVAL_STATIONARY_MS) interval = GNSS_INTERVAL_STATIONARY_MS;
+
+            // Giro brusco: apretar para no cortar la esquina
+            if (lastCourse >= 0.0f) {
+                float turn = fabsf(fmodf(fix.courseDeg - lastCourse + 540.0f, 360.0f) - 180.0f);
+                if (turn >= GNSS_TURN_DEG) interval = GNSS_INTERVAL_MIN_MS;
+            }
+            lastCourse = fix.courseDeg;
+        } else {
+            interval = GNSS_INTERVAL_WALKING_MS;
+            lastCourse = -1.0f;
+        }
+
+        // En movimiento la referencia sigue al último fix
+        refLat = fix.latitude;
+        refLon = fix.longitude;
+        hasRef = true;
+    } else {
+        state = Motion::STATIONARY;
+        lastCourse = -1.0f;
+        if (stationaryStreak < 16) stationaryStreak++;
+
+        // Backoff exponencial: 30s, 60s, 120s ... hasta GNSS_INTERVAL_MAX_MS
+        interval = GNSS_INTERVAL_STATIONARY_MS << (stationaryStreak - 1);
+        if (stationaryStreak > 8 || interval > GNSS_INTERVAL_MAX_MS) interval = GNSS_INTERVAL_MAX_MS;
+
+        // Anclar la referencia al primer fix quieto: el ruido no se acumula
+        if (!hasRef) {
+            refLat = fix.latitude;
+            refLon = fix.longitude;
+            hasRef = true;
+        }
+    }
+
+    keepPowered = interval <= GNSS_KEEP_ON_MAX_MS;
+    schedule(nowMs, interval);
+}
+
+// ===== SIN FIX =====
+// Sigue sondeando mientras dure la ventana de adquisición; luego se rinde y apaga
+void GnssScheduler::onNoFix(uint32_t nowMs) {
+    if (!acquiring) {
+        acquiring = true;
+        acqStartMs = nowMs;
+    }
+
+    if ((nowMs - acqStartMs) < GNSS_ACQ_TIMEOUT_MS) {
+        keepPowered = true;
+        schedule(nowMs, GNSS_ACQ_POLL_MS);
+        return;
+    }
+
+    // Sin cielo (interior): apagar y reintentar con backoff
+    acquiring = false;
+    if (acqFailures < 8) acqFailures++;
+    uint32_t retry = GNSS_INTERVAL_STATIONARY_MS << acqFailures;
+    if (retry > GNSS_INTERVAL_MAX_MS) retry = GNSS_INTERVAL_MAX_MS;
+    keepPowered = false;
+    schedule(nowMs, retry);
+}
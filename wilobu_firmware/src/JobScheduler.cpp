@@ -0,0 +1,121 @@
+#include "JobScheduler.h"
+
+uint8_t JobScheduler::add(const char* name, JobFn fn, uint32_t periodMs,
+                          uint32_t firstDelayMs, uint32_t nowMs) {
+    if (jobCount >= JOB_MAX) return JOB_NONE;
+    uint8_t id = jobCount++;
+    Job& j = jobs[id];
+    j.name = name;
+    j.fn = fn;
+    j.periodMs = periodMs;
+    j.runs = 0;
+    j.maxLateMs = 0;
+    heapPos[id] = JOB_NONE;
+    if (firstDelayMs != JOB_IDLE_FOREVER) in(id, firstDelayMs, nowMs);
+    return id;
+}
+
+void JobScheduler::at(uint8_t id, uint32_t dueMs) {
+    if (id >= jobCount) return;
+    jobs[id].dueMs = dueMs;
+    if (heapPos[id] == JOB_NONE) {
+        heap[heapSize] = id;
+        heapPos[id] = heapSize;
+        siftUp(heapSize++);
+        return;
+    }
+    // Ya armado: el plazo pudo moverse en cualquier sentido
+    siftUp(heapPos[id]);
+    siftDown(heapPos[id]);
+}
+
+void JobScheduler::cancel(uint8_t id) {
+    if (isArmed(id)) removeAt(heapPos[id]);
+}
+
+uint8_t JobScheduler::runDue(uint32_t nowMs) {
+    uint8_t ran = 0;
+    // Tope: un trabajo que se reprograma a "ya" no puede acaparar la pasada
+    while (heapSize > 0 && ran < JOB_MAX) {
+        uint8_t id = heap[0];
+        Job& j = jobs[id];
+        if ((int32_t)(nowMs - j.dueMs) < 0) break;
+        uint32_t late = nowMs - j.dueMs;
+        if (late > j.maxLateMs) j.maxLateMs = late;
+        j.runs++;
+        // Reprogramar antes de correr: la función tiene la última palabra
+        if (j.periodMs > 0) {
+            at(id, nowMs + j.periodMs);
+        } else {
+            removeAt(0);
+        }
+        j.fn();
+        ran++;
+    }
+    return ran;
+}
+
+uint32_t JobScheduler::msUntilNext(uint32_t nowMs) const {
+    if (heapSize == 0) return JOB_IDLE_FOREVER;
+    int32_t wait = (int32_t)(jobs[heap[0]].dueMs - nowMs);
+    return wait > 0 ? (uint32_t)wait : 0;
+}
+
+void JobScheduler::print(uint32_t nowMs) const {
+    Serial.printf("[JOBS] %u trabajos, %u armados\n", jobCount, heapSize);
+    for (uint8_t id = 0; id < jobCount; id++) {
+        const Job& j = jobs[id];
+        if (heapPos[id] == JOB_NONE) {
+            Serial.printf("  %-10s %10s  %6lu corridas  retraso máx %lu ms\n",
+                j.name, "-", (unsigned long)j.runs, (unsigned long)j.maxLateMs);
+        } else {
+            int32_t in = (int32_t)(j.dueMs - nowMs);
+            Serial.printf("  %-10s %8ld ms  %6lu corridas  retraso máx %lu ms\n",
+                j.name, in > 0 ? in : 0L, (unsigned long)j.runs, (unsigned long)j.maxLateMs);
+        }
+    }
+}
+
+// ===== MIN-HEAP =====
+void JobScheduler::swapAt(uint8_t i, uint8_t j) {
+    uint8_t a = heap[i];
+    heap[i] = heap[j];
+    heap[j] = a;
+    heapPos[heap[i]] = i;
+    heapPos[heap[j]] = j;
+}
+
+void JobScheduler::siftUp(uint8_t i) {
+    while (i > 0) {
+        uint8_t parent = (i - 1) / 2;
+        if (!earlier(heap[i], heap[parent])) return;
+        swapAt(i, parent);
+        i = parent;
+    }
+}
+
+void JobScheduler::siftDown(uint8_t i) {
+    for (;;) {
+        uint8_t left = 2 * i + 1;
+        uint8_t right = left + 1;
+        uint8_t best = i;
+        if (left < heapSize && earlier(heap[left], heap[best])) best = left;
+        if (right < heapSize && earlier(heap[right], heap[best])) best = right;
+        if (best == i) return;
+        swapAt(i, best);
+        i = best;
+    }
+}
+
+void JobScheduler::removeAt(uint8_t i) {
+    uint8_t id = heap[i];
+    heapSize--;
+    if (i != heapSize) {
+        uint8_t moved = heap[heapSize];
+        heap[i] = moved;
+        heapPos[moved] = i;
+        siftUp(i);
+        siftDown(heapPos[moved]);
+    }
+    heapPos[id] = JOB_NONE;
+}
@@ -0,0 +1,60 @@
+#include "JsonArena.h"
+
+static size_t alignUp(size_t n) { return (n + 7) & ~(size_t)7; }
+
+void* JsonArena::allocate(size_t size) {
+    size_t body = alignUp(size);
+    if (used + sizeof(Header) + body > cap) {
+        failCount++;
+        return nullptr;
+    }
+    Header* h = (Header*)(buf + used);
+    h->size = body;
+    lastOffset = used;
+    used += sizeof(Header) + body;
+    live++;
+    if (used > peakBytes) peakBytes = used;
+    return h + 1;
+}
+
+void JsonArena::deallocate(void* ptr) {
+    if (!ptr) return;
+    if (isLast(ptr)) {
+        used = lastOffset;
+        lastOffset = SIZE_MAX;
+    }
+    if (live > 0) live--;
+    if (live == 0) {
+        used = 0;
+        lastOffset = SIZE_MAX;
+    }
+}
+
+void* JsonArena::reallocate(void* ptr, size_t newSize) {
+    if (!ptr) return allocate(newSize);
+    Header* h = headerOf(ptr);
+    size_t body = alignUp(newSize);
+    // ArduinoJson encoge el pool al terminar y crece las cadenas: ambos casos
+    // suelen tocar el último bloque, que se ajusta en el lugar
+    if (isLast(ptr)) {
+        if (lastOffset + sizeof(Header) + body > cap) {
+            failCount++;
+            return nullptr;
+        }
+        h->size = body;
+        used = lastOffset + sizeof(Header) + body;
+        if (used > peakBytes) peakBytes = used;
+        return ptr;
+    }
+    if (body <= h->size) return ptr;
+    void* moved = allocate(newSize);
+    if (!moved) return nullptr;
+    memcpy(moved, ptr, h->size);
+    deallocate(ptr);
+    return moved;
+}
+
+void JsonArena::print() const {
+    Serial.printf("  arena %-8s pico %5u / %5u B  fallos %lu\n",
+        name, (unsigned)peakBytes, (unsigned)cap, (unsigned long)failCount);
+}
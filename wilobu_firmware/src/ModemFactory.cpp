@@ -0,0 +1,18 @@
+#include "ModemFactory.h"
+
+// Importar la clase correcta según hardware seleccionado
+#ifdef HARDWARE_A
+  #include "ModemHTTPS.h"
+#else
+  #include "ModemProxy.h"
+#endif
+
+IModem* createModemDriver(HardwareSerial* serial, const char* apn, const char* endpoint) {
+    #ifdef HARDWARE_A
+        (void)apn;
+        (void)endpoint;
+        return new ModemHTTPS(serial);
+    #else
+        return new ModemProxy(serial, apn, endpoint);
+    #endif
+}
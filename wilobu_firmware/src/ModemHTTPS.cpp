@@ -1,31 +1,42 @@
 #include "ModemHTTPS.h"
 #include <ArduinoJson.h>
+#include "OtaUpdate.h"
+#include "TlsCaBundle.h"
 
 ModemHTTPS::ModemHTTPS(HardwareSerial* serial) : modemSerial(serial) {}
 
 // ===== AT COMMAND =====
-String ModemHTTPS::sendATCommand(const String& cmd, unsigned long timeout) {
+String ModemHTTPS::sendATCommand(const String& cmd, uint32_t timeout) {
     while (modemSerial->available()) modemSerial->read();
     modemSerial->println(cmd);
     String r = "";
-    unsigned long start = millis();
+    uint32_t start = millis();
     while (millis() - start < timeout) {
         if (modemSerial->available()) r += (char)modemSerial->read();
+        else idle(5);
     }
     return r;
 }
 
-bool ModemHTTPS::waitForResponse(const String& expected, unsigned long timeout) {
+bool ModemHTTPS::waitForResponse(const String& expected, uint32_t timeout) {
     return sendATCommand("AT", timeout).indexOf(expected) != -1;
 }
 
 // ===== INIT & CONNECT =====
 bool ModemHTTPS::init() {
-    modemSerial->begin(115200);
-    delay(3000);
-    if (sendATCommand("AT", 1000).indexOf("OK") == -1) return false;
+    // NO llamar begin() aquí - main.cpp ya abrió la UART con los pines correctos
+    // Sondeo AT en lugar de una espera fija: sale apenas el módem termina de arrancar
+    bool alive = false;
+    for (int i = 0; i < 5 && !alive; i++) {
+        alive = sendATCommand("AT", 1000).indexOf("OK") != -1;
+        if (!alive) delay(500);
+    }
+    if (!alive) return false;
     sendATCommand("ATE0", 1000);
     sendATCommand("AT+CMGF=1", 1000);
+    // Módem recién arrancado: el contexto SSL volvió a sus valores de fábrica
+    tlsReady = false;
+    configureTls();
     // Chequeo SIM y red
     if (sendATCommand("AT+CPIN?", 1000).indexOf("READY") == -1) return false;
     if (sendATCommand("AT+CSQ", 1000).indexOf("99") != -1) return false; // Sin señal
@@ -52,7 +63,7 @@ bool ModemHTTPS::connect() {
             Serial.println("[MODEM] LTE OK");
             return true;
         }
-        delay(1000);
+        idle(1000);
     }
     return false;
 }
@@ -60,23 +71,86 @@ bool ModemHTTPS::connect() {
 bool ModemHTTPS::disconnect() { sendATCommand("AT+CGACT=0,1", 2000); connected = false; return true; }
 bool ModemHTTPS::isConnected() { return connected; }
 
+// ===== TLS: CA FIJADA =====
+// La CA va al sistema de archivos del módem (directorio 3, customer) y se
+// convierte al formato del contexto SSL 1. El archivo queda entre arranques;
+// sslversion y la conversión se repiten tras cada init()
+bool ModemHTTPS::configureTls() {
+    if (tlsReady) return true;
+    sendATCommand("AT+CFSINIT", 1000);
+    if (sendATCommand("AT+CFSGFIS=3,\"" TLS_CA_FILE "\"", 1000).indexOf("+CFSGFIS:") == -1) {
+        Serial.printf("[TLS] Cargando %s (%u bytes) en el módem\n", TLS_CA_FILE, (unsigned)TLS_CA_PEM_LEN);
+        while (modemSerial->available()) modemSerial->read();
+        modemSerial->printf("AT+CFSWFILE=3,\"%s\",0,%u,10000\r\n", TLS_CA_FILE, (unsigned)TLS_CA_PEM_LEN);
+        String resp;
+        bool ok = readUntil("DOWNLOAD", 5000, resp);
+        if (ok) {
+            modemSerial->write((const uint8_t*)TLS_CA_PEM, TLS_CA_PEM_LEN);
+            resp = "";
+            ok = readUntil("OK\r\n", 10000, resp);
+        }
+        if (!ok) {
+            Serial.println("[TLS] Error: el módem no aceptó la CA");
+            sendATCommand("AT+CFSTERM", 1000);
+            return false;
+        }
+    }
+    sendATCommand("AT+CFSTERM", 1000);
+    tlsReady = sendATCommand("AT+CSSLCFG=\"sslversion\",1,3", 1000).indexOf("OK") != -1 &&
+               sendATCommand("AT+CSSLCFG=\"convert\",2,\"" TLS_CA_FILE "\"", 2000).indexOf("OK") != -1;
+    Serial.println(tlsReady ? "[TLS] ✓ CA fijada en el contexto SSL 1" : "[TLS] ✗ Contexto SSL sin configurar");
+    return tlsReady;
+}
+
+// SHCONF ya tiene la URL: contexto SSL 1 con la CA fijada y SNI del host.
+// Sin CA (o con una URL que no es https) no se conecta
+bool ModemHTTPS::secureConnection(const String& url) {
+    if (!url.startsWith("https://") || !configureTls()) {
+        Serial.println("[TLS] Error: conexión sin CA fijada rechazada");
+        return false;
+    }
+    int hostEnd = url.indexOf('/', 8);
+    String host = hostEnd == -1 ? url.substring(8) : url.substring(8, hostEnd);
+    sendATCommand("AT+CSSLCFG=\"sni\",1,\"" + host + "\"", 1000);
+    return sendATCommand("AT+SHSSL=1,\"" TLS_CA_FILE "\"", 2000).indexOf("OK") != -1;
+}
+
 // ===== HTTPS POST =====
 String ModemHTTPS::httpsPost(const String& url, const String& json) {
+    lastHttpStatus = -1;
     if (!connected) return "";
     sendATCommand("AT+SHDISC", 1000);
     sendATCommand("AT+SHCONF=\"URL\",\"" + url + "\"", 2000);
     sendATCommand("AT+SHCONF=\"BODYLEN\",1024", 1000);
     sendATCommand("AT+SHCONF=\"HEADERLEN\",350", 1000);
-    sendATCommand("AT+SHSSL=1,\"\"", 2000);
+    if (!secureConnection(url)) return "";
     if (sendATCommand("AT+SHCONN", 10000).indexOf("OK") == -1) return "";
     sendATCommand("AT+SHADD=\"Content-Type\",\"application/json\"", 1000);
     sendATCommand("AT+SHADD=\"Content-Length\",\"" + String(json.length()) + "\"", 1000);
     modemSerial->println("AT+SHREQ=\"/\",3," + String(json.length()));
-    delay(1000);
+    idle(1000);
     modemSerial->println(json);
-    delay(2000);
+
+    // Petición en vuelo: sale el SMS armado (multicamino SOS)
+    String reqResp;
+    if (smsState() == SmsState::ARMED) {
+        sendArmedSms();
+        reqResp = smsCapture;
+    }
+
+    // +SHREQ: "POST",<status>,<len> (leer sin vaciar: sendATCommand la descartaría)
+    readUntil("+SHREQ:", 10000, reqResp);
+    idle(50);
+    while (modemSerial->available()) reqResp += (char)modemSerial->read();
+    int idx = reqResp.indexOf("+SHREQ:");
+    if (idx != -1) {
+        int c1 = reqResp.indexOf(',', idx);
+        if (c1 != -1) lastHttpStatus = reqResp.substring(c1 + 1).toInt();
+    }
+
     String response = sendATCommand("AT+SHREAD=0,500", 3000);
     sendATCommand("AT+SHDISC", 1000);
+    lastHttpBody = response.c_str();
     return response;
 }
 
@@ -88,12 +162,44 @@ bool ModemHTTPS::sendToCloudFunction(const String& path, const String& json) {
     return !httpsPost("https://us-central1-wilobu-d21b2.cloudfunctions.net" + path, json).isEmpty();
 }
 
+// ===== SMS =====
+// Lee sin vaciar el buffer (a diferencia de sendATCommand) para no perder la
+// URC de una transacción HTTP en curso; todo queda en 'out'.
+bool ModemHTTPS::readUntil(const char* token, uint32_t timeout, String& out) {
+    uint32_t start = millis();
+    while (millis() - start < timeout) {
+        while (modemSerial->available()) out += (char)modemSerial->read();
+        if (out.indexOf(token) != -1) return true;
+        if (out.indexOf("ERROR") != -1) return false;
+        idle(5);
+    }
+    return false;
+}
+
+bool ModemHTTPS::sendSMS(const char* number, const char* text) {
+    smsCapture = "";
+    Serial.print("[SMS] -> "); Serial.println(number);
+    modemSerial->print(String("AT+CMGS=\"") + number + "\"\r");
+    if (!readUntil(">", 5000, smsCapture)) {
+        Serial.println("[SMS] Error: sin prompt de CMGS");
+        modemSerial->write((uint8_t)0x1B);  // ESC: abortar
+        return false;
+    }
+    modemSerial->print(text);
+    modemSerial->write((uint8_t)0x1A);      // Ctrl+Z: enviar
+    // +CMGS: <mr> = aceptado por el SMSC
+    bool ok = readUntil("+CMGS:", 20000, smsCapture);
+    Serial.println(ok ? "[SMS] ✓ Aceptado por SMSC" : "[SMS] ✗ Sin +CMGS");
+    return ok;
+}
+
 // ===== SOS & HEARTBEAT =====
-bool ModemHTTPS::sendSOSAlert(const String& deviceId, const String& ownerUid, const String& sosType, const GPSLocation& loc) {
+bool ModemHTTPS::sendSOSAlert(const char* deviceId, const char* ownerUid, const char* sosType, const GPSLocation& loc,
+                             const JsonDocument* extra) {
     JsonDocument doc;
     doc["deviceId"] = deviceId;
     doc["ownerUid"] = ownerUid;
-    doc["status"] = "sos_" + sosType;
+    doc["status"] = String("sos_") + sosType;
     if (loc.isValid) {
         doc["lastLocation"]["lat"] = loc.latitude;
         doc["lastLocation"]["lng"] = loc.longitude;
@@ -101,11 +207,16 @@ bool ModemHTTPS::sendSOSAlert(const String& deviceId, const String& ownerUid, co
     } else {
         doc["lastLocation"] = nullptr;
     }
+    if (extra) {
+        for (JsonPairConst kv : extra->as<JsonObjectConst>()) doc[kv.key()] = kv.value();
+    }
     String json; serializeJson(doc, json);
-    return !httpsPost("https://us-central1-wilobu-d21b2.cloudfunctions.net/heartbeat", json).isEmpty();
+    httpsPost("https://us-central1-wilobu-d21b2.cloudfunctions.net/heartbeat", json);
+    return lastHttpStatus >= 200 && lastHttpStatus < 300;
 }
 
-bool ModemHTTPS::sendHeartbeat(const String& ownerUid, const String& deviceId, const GPSLocation& loc) {
+bool ModemHTTPS::sendHeartbeat(const char* ownerUid, const char* deviceId, const GPSLocation& loc,
+                               const JsonDocument* extra) {
     JsonDocument doc;
     doc["deviceId"] = deviceId;
     doc["ownerUid"] = ownerUid;
@@ -116,6 +227,9 @@ bool ModemHTTPS::sendHeartbeat(const String& ownerUid, const String& deviceId, c
         doc["lastLocation"]["lng"] = loc.longitude;
         doc["lastLocation"]["accuracy"] = loc.accuracy;
     }
+    if (extra) {
+        for (JsonPairConst kv : extra->as<JsonObjectConst>()) doc[kv.key()] = kv.value();
+    }
     String json; serializeJson(doc, json);
     String response = httpsPost("https://us-central1-wilobu-d21b2.cloudfunctions.net/heartbeat", json);
     if (response.isEmpty()) return false;
@@ -127,7 +241,7 @@ bool ModemHTTPS::sendHeartbeat(const String& ownerUid, const String& deviceId, c
 }
 
 // ===== AUTO-RECUPERACIÓN DE APROVISIONAMIENTO =====
-String ModemHTTPS::checkProvisioningStatus(const String& deviceId) {
+String ModemHTTPS::checkProvisioningStatus(const char* deviceId) {
     Serial.println("[AUTO-RECOVER] Verificando estado en Firestore...");
     JsonDocument doc;
     doc["deviceId"] = deviceId;
@@ -181,12 +295,16 @@ bool ModemHTTPS::getLocation(GPSLocation& loc) {
     String latStr;
     String lonStr;
     String accStr;
+    String speedStr;
+    String courseStr;
 
     while (token != nullptr) {
         idx++;
         if (idx == 4) latStr = token;
         else if (idx == 5) lonStr = token;
         else if (idx == 6) accStr = token;
+        else if (idx == 7) speedStr = token;   // km/h
+        else if (idx == 8) courseStr = token;
         token = strtok_r(nullptr, ",", &save);
     }
 
@@ -195,6 +313,8 @@ bool ModemHTTPS::getLocation(GPSLocation& loc) {
     loc.latitude = latStr.toFloat();
     loc.longitude = lonStr.toFloat();
     loc.accuracy = accStr.isEmpty() ? 0.0f : accStr.toFloat();
+    loc.speedKmh = speedStr.isEmpty() ? 0.0f : speedStr.toFloat();
+    loc.courseDeg = courseStr.isEmpty() ? 0.0f : courseStr.toFloat();
     loc.timestamp = millis();
     loc.isValid = (loc.latitude != 0.0f || loc.longitude != 0.0f);
     return loc.isValid;
@@ -203,8 +323,189 @@ bool ModemHTTPS::getLocation(GPSLocation& loc) {
 void ModemHTTPS::disableGNSS() { if (gpsEnabled) { sendATCommand("AT+CGNSPWR=0", 2000); gpsEnabled = false; } }
 
 // ===== POWER & OTA STUBS =====
-void ModemHTTPS::enableDeepSleep(unsigned long sec) { if (connected) disconnect(); disableGNSS(); deepSleeping = true; }
+void ModemHTTPS::enableDeepSleep(uint32_t sec) {
+    // El PDP queda activo: al despertar no hay CGDCONT/CGACT ni espera de registro
+    sendATCommand("AT+SHDISC", 1000);
+    disableGNSS();
+    deepSleeping = true;
+}
 bool ModemHTTPS::isDeepSleeping() { return deepSleeping; }
-bool ModemHTTPS::checkForUpdates() { return false; }
-bool ModemHTTPS::downloadFirmwareUpdate(const String& url) { return false; }
-bool ModemHTTPS::applyFirmwareUpdate() { return false; }
+
+bool ModemHTTPS::resume() {
+    bool alive = false;
+    for (int i = 0; i < 3 && !alive; i++) alive = sendATCommand("AT", 300).indexOf("OK") != -1;
+    if (!alive) return false;
+    sendATCommand("ATE0", 300);
+    String r = sendATCommand("AT+CGREG?", 1000);
+    if (r.indexOf("+CGREG: 0,1") == -1 && r.indexOf("+CGREG: 0,5") == -1) return false;
+    connected = true;
+    deepSleeping = false;
+    Serial.println("[MODEM] Reanudado sin reinicializar (registro conservado)");
+    return true;
+}
+
+// SIM7080G: "+CBC: <bcs>,<bcl>,<mV>"
+bool ModemHTTPS::getBatteryMillivolts(uint16_t& mv) {
+    String resp = sendATCommand("AT+CBC", 1000);
+    int idx = resp.indexOf("+CBC:");
+    if (idx == -1) return false;
+    int comma = resp.indexOf(',', resp.indexOf(',', idx) + 1);
+    if (comma == -1) return false;
+    long value = resp.substring(comma + 1).toInt();
+    if (value <= 0) return false;
+    mv = (uint16_t)value;
+    return true;
+}
+
+// ===== OTA =====
+static uint8_t otaChunk[OTA_CHUNK_BYTES];   // Único buffer de la descarga
+
+bool ModemHTTPS::checkForUpdates(const char* deviceId, const char* currentVersion, OtaManifest& manifest) {
+    JsonDocument doc;
+    doc["deviceId"] = deviceId;
+    doc["fw"] = currentVersion;
+    String json; serializeJson(doc, json);
+    String response = httpsPost("https://us-central1-wilobu-d21b2.cloudfunctions.net/firmwareManifest", json);
+    OtaManifest published;
+    if (lastHttpStatus < 200 || lastHttpStatus >= 300 || !parseOtaManifest(response.c_str(), published)) {
+        Serial.println("[OTA] Sin actualización publicada");
+        return false;
+    }
+    if (strcmp(published.version, currentVersion) == 0) return false;
+    manifest = published;
+    Serial.printf("[OTA] Publicada %s (actual %s)\n", published.version, currentVersion);
+    return true;
+}
+
+// AT+SHREAD=<pos>,<n> en binario: "+SHREAD: <n>\r\n" y exactamente n bytes
+int ModemHTTPS::shReadChunk(uint32_t pos, uint8_t* buf, size_t want) {
+    while (modemSerial->available()) modemSerial->read();
+    modemSerial->printf("AT+SHREAD=%lu,%u\r\n", (unsigned long)pos, (unsigned)want);
+
+    String line;
+    long n = -1;
+    uint32_t start = millis();
+    while (n <= 0 && millis() - start < OTA_READ_TIMEOUT_MS) {
+        if (!modemSerial->available()) { idle(5); continue; }
+        char c = (char)modemSerial->read();
+        if (c != '\n') { line += c; continue; }
+        if (line.indexOf("ERROR") != -1) return -1;
+        int idx = line.indexOf("+SHREAD:");
+        if (idx != -1) n = line.substring(idx + 8).toInt();
+        line = "";
+    }
+    if (n <= 0 || (size_t)n > want) return -1;
+
+    size_t got = 0;
+    while (got < (size_t)n && millis() - start < OTA_READ_TIMEOUT_MS) {
+        got += modemSerial->readBytes(buf + got, n - got);
+    }
+    return got == (size_t)n ? (int)n : -1;
+}
+
+bool ModemHTTPS::downloadFirmwareUpdate(const OtaManifest& manifest, OtaUpdater& sink) {
+    if (!connected || !sink.isActive()) return false;
+    uint32_t from = sink.offset();
+    if (from >= manifest.size) return true;
+    uint32_t to = manifest.size - 1;
+    if (to - from >= OTA_RANGE_BYTES) to = from + OTA_RANGE_BYTES - 1;
+
+    // SHCONF lleva esquema y host; la ruta va en SHREQ
+    String url = manifest.url;
+    int hostStart = url.indexOf("://");
+    int pathStart = hostStart == -1 ? -1 : url.indexOf('/', hostStart + 3);
+    if (pathStart == -1) {
+        Serial.println("[OTA] Error: URL de la imagen sin ruta");
+        return false;
+    }
+
+    sendATCommand("AT+SHDISC", 1000);
+    sendATCommand("AT+SHCONF=\"URL\",\"" + url.substring(0, pathStart) + "\"", 2000);
+    sendATCommand("AT+SHCONF=\"HEADERLEN\",350", 1000);
+    if (!secureConnection(url)) return false;
+    if (sendATCommand("AT+SHCONN", 10000).indexOf("OK") == -1) {
+        Serial.println("[OTA] Error: SHCONN fallo");
+        return false;
+    }
+    sendATCommand("AT+SHADD=\"Range\",\"bytes=" + String(from) + "-" + String(to) + "\"", 1000);
+    modemSerial->println("AT+SHREQ=\"" + url.substring(pathStart) + "\",1");
+
+    // +SHREQ: "GET",<status>,<len>
+    String reqResp;
+    readUntil("+SHREQ:", OTA_ACTION_TIMEOUT_MS, reqResp);
+    idle(50);
+    while (modemSerial->available()) reqResp += (char)modemSerial->read();
+    int status = -1;
+    uint32_t bodyLen = 0;
+    int idx = reqResp.indexOf("+SHREQ:");
+    int c1 = idx == -1 ? -1 : reqResp.indexOf(',', idx);
+    int c2 = c1 == -1 ? -1 : reqResp.indexOf(',', c1 + 1);
+    if (c2 != -1) {
+        status = reqResp.substring(c1 + 1).toInt();
+        bodyLen = strtoul(reqResp.c_str() + c2 + 1, nullptr, 10);
+    }
+    lastHttpStatus = status;
+
+    // 200 = el servidor ignoró Range: se lee desde "from" dentro de la imagen entera
+    uint32_t pos;
+    if (status == 206 && bodyLen == to - from + 1) {
+        pos = 0;
+    } else if (status == 200 && bodyLen == manifest.size) {
+        pos = from;
+    } else {
+        Serial.printf("[OTA] Rango %lu-%lu rechazado: status %d, %lu bytes\n",
+            (unsigned long)from, (unsigned long)to, status, (unsigned long)bodyLen);
+        sendATCommand("AT+SHDISC", 1000);
+        return false;
+    }
+
+    uint32_t remaining = to - from + 1;
+    bool ok = true;
+    while (remaining > 0) {
+        size_t want = remaining < OTA_CHUNK_BYTES ? remaining : OTA_CHUNK_BYTES;
+        int n = shReadChunk(pos, otaChunk, want);
+        if (n <= 0 || !sink.write(otaChunk, n)) {
+            Serial.printf("[OTA] Lectura cortada en %lu\n", (unsigned long)sink.offset());
+            ok = false;
+            break;
+        }
+        pos += n;
+        remaining -= n;
+    }
+    sendATCommand("AT+SHDISC", 1000);
+    if (ok) Serial.printf("[OTA] %lu/%lu bytes\n", (unsigned long)sink.offset(), (unsigned long)manifest.size);
+    return ok;
+}
+
+bool ModemHTTPS::applyFirmwareUpdate(OtaUpdater& sink) {
+    sendATCommand("AT+SHDISC", 1000);
+    return sink.finish();
+}
+
+// ===== PSM / eDRX =====
+bool ModemHTTPS::configurePowerSaving(const PowerSavingRequest& req) {
+    uint32_t tau = 0, active = 0;
+    float cycle = 0;
+    String t3412 = PowerSaving::encodeT3412(req.tauSec, &tau);
+    String t3324 = PowerSaving::encodeT3324(req.activeSec, &active);
+    String edrx = PowerSaving::encodeEdrx(req.edrxMaxSec, &cycle);
+
+    bool ok;
+    if (req.psm) {
+        Serial.printf("[PSM] Pidiendo TAU %lu s (%s), active time %lu s (%s)\n",
+            (unsigned long)tau, t3412.c_str(), (unsigned long)active, t3324.c_str());
+        ok = sendATCommand("AT+CPSMS=1,,,\"" + t3412 + "\",\"" + t3324 + "\"", 2000).indexOf("OK") != -1;
+    } else {
+        ok = sendATCommand("AT+CPSMS=0", 2000).indexOf("OK") != -1;
+    }
+    Serial.printf("[EDRX] Pidiendo ciclo %.2f s (%s)\n", cycle, edrx.c_str());
+    ok = sendATCommand("AT+CEDRXS=1," + String(EDRX_ACT_TYPE) + ",\"" + edrx + "\"", 2000).indexOf("OK") != -1 && ok;
+
+    // CEREG=4 agrega los timers PSM a la consulta; se vuelve a 0 para no recibir URCs.
+    // Si la red aún no respondió al pedido, lo otorgado se verá tras el próximo TAU.
+    sendATCommand("AT+CEREG=4", 1000);
+    String cereg = sendATCommand("AT+CEREG?", 1000);
+    sendATCommand("AT+CEREG=0", 1000);
+    PowerSaving::logNegotiated(cereg, sendATCommand("AT+CEDRXRDP", 1000));
+    return ok;
+}
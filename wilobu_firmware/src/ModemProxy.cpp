@@ -1,15 +1,37 @@
 #include <Arduino.h>
 #include "ModemProxy.h"
+#include "JobScheduler.h"
+#include "OtaUpdate.h"
+#include "TlsCaBundle.h"
 #include <ArduinoJson.h>
-#include <Preferences.h>
 
-ModemProxy::ModemProxy(HardwareSerial* serial, const char* apnParam) : modemSerial(serial) {
+ModemProxy::ModemProxy(HardwareSerial* serial, const char* apnParam, const char* endpointBase)
+    : modemSerial(serial), jsonArena("modem", jsonArenaBuf, sizeof(jsonArenaBuf)) {
     if (apnParam && strlen(apnParam) > 0) apn = String(apnParam);
     else apn = String("");
+    setEndpoint(endpointBase);
+}
+
+void ModemProxy::setEndpoint(const char* base) {
+    if (!base || !base[0]) base = CLOUD_FUNCTIONS_BASE;
+    heartbeatUrl.printf("%s/heartbeat", base);
+    statusUrl.printf("%s/checkDeviceStatus", base);
+    otaUrl.printf("%s/firmwareManifest", base);
+    slotUrlCmd.printf("AT+HTTPPARA=\"URL\",\"%s\"", heartbeatUrl.c_str());
+    if (heartbeatUrl.truncated() || statusUrl.truncated() || otaUrl.truncated() || slotUrlCmd.truncated()) {
+        Serial.println("[HTTP] Endpoint demasiado largo - se usa el de fábrica");
+        setEndpoint(CLOUD_FUNCTIONS_BASE);
+        return;
+    }
+    slotReady = false;   // El slot apuntaba a la URL anterior
 }
 
 // ===== AT COMMAND =====
-String ModemProxy::sendATCommand(const String& cmd, unsigned long timeout) {
+static bool isFinalResponse(const char* s) {
+    return strstr(s, "OK\r\n") || strstr(s, "ERROR\r\n") || strstr(s, "DOWNLOAD") || strstr(s, "+HTTPACTION");
+}
+
+const AtResponse& ModemProxy::sendATCommand(const char* cmd, uint32_t timeout) {
     while (modemSerial->available()) modemSerial->read();  // Limpiar buffer
     
     Serial.print("[AT] Enviando: ");
@@ -17,54 +39,53 @@ String ModemProxy::sendATCommand(const String& cmd, unsigned long timeout) {
     
     modemSerial->println(cmd);
     
-    String r = "";
-    unsigned long start = millis();
-    bool hasContent = false;
+    atResp.clear();
+    // Si la respuesta no entra en atResp, el final se sigue mirando aquí
+    char tail[16] = {0};
+    uint32_t start = millis();
+    bool final = false;
     
     while (millis() - start < timeout) {
         while (modemSerial->available()) {
             char c = (char)modemSerial->read();
-            r += c;
-            hasContent = true;
+            if (!atResp.append(c)) {
+                memmove(tail, tail + 1, sizeof(tail) - 2);
+                tail[sizeof(tail) - 2] = c;
+            }
         }
         
         // Terminar early si detectamos OK, ERROR, o DOWNLOAD
-        if (hasContent) {
-            if (r.indexOf("OK\r\n") != -1 || r.indexOf("ERROR\r\n") != -1 || 
-                r.indexOf("DOWNLOAD") != -1 || r.indexOf("+HTTPACTION") != -1) {
-                delay(50); // Pequeño delay para capturar cualquier dato restante
-                while (modemSerial->available()) {
-                    r += (char)modemSerial->read();
-                }
-                break;
-            }
+        if (!atResp.isEmpty() && (isFinalResponse(atResp.c_str()) || (atResp.truncated() && isFinalResponse(tail)))) {
+            delay(50); // Pequeño delay para capturar cualquier dato restante
+            while (modemSerial->available()) atResp.append((char)modemSerial->read());
+            final = true;
+            break;
         }
         
-        delay(10); // Pequeño delay para no saturar el CPU
+        idle(10); // Pequeño delay para no saturar el CPU
     }
+    diagStats.recordAt(millis() - start, !final);
     
-    if (r.length() > 0) {
+    if (!atResp.isEmpty()) {
         Serial.print("[AT] Recibido: ");
-        Serial.println(r);
+        Serial.println(atResp.c_str());
+        if (atResp.truncated()) Serial.printf("[AT] Respuesta recortada a %u bytes\n", (unsigned)AtResponse::capacity());
     }
     
-    return r;
+    return atResp;
 }
 
-bool ModemProxy::waitForResponse(const String& expected, unsigned long timeout) {
-    return sendATCommand("AT", timeout).indexOf(expected) != -1;
+bool ModemProxy::waitForResponse(const String& expected, uint32_t timeout) {
+    return sendATCommand("AT", timeout).contains(expected.c_str());
 }
 
 // ===== INIT & CONNECT =====
 bool ModemProxy::init() {
     // NO llamar begin() aquí - ya se configuró en main.cpp con los pines correctos
-    delay(3000);
-    
-    // Intentar varias veces con AT
+    // Sin espera fija de arranque: el sondeo AT sale apenas el módem responde
     Serial.println("[MODEM] Probando comunicacion AT...");
     for (int i = 0; i < 5; i++) {
-        String r = sendATCommand("AT", 2000);
-        if (r.indexOf("OK") != -1) {
+        if (sendATCommand("AT", 2000).contains("OK")) {
             Serial.println("[MODEM] Comunicacion AT OK");
             break;
         }
@@ -80,12 +101,16 @@ bool ModemProxy::init() {
     
     sendATCommand("ATE0", 1000);
     sendATCommand("AT+CMGF=1", 1000);
+    // Módem recién arrancado: el contexto SSL volvió a sus valores de fábrica
+    tlsReady = false;
+    configureTls();
     
     // Intentar configurar contexto GPRS con el APN proporcionado
-    String setupResponse = sendATCommand("AT+CGDCONT=1,\"IP\",\"" + String(apn) + "\"", 2000);
+    atCmd.printf("AT+CGDCONT=1,\"IP\",\"%s\"", apn.c_str());
+    bool setupFailed = sendATCommand(atCmd.c_str(), 2000).contains("ERROR");
     
     // Si el APN es vacio o falla, intentar APNs universales como fallback
-    if (apn.length() == 0 || setupResponse.indexOf("ERROR") != -1) {
+    if (apn.length() == 0 || setupFailed) {
         Serial.println("[MODEM] APN vacio o fallo. Intentando APNs universales...");
         
         // Array de APNs universales para fallback
@@ -98,8 +123,8 @@ bool ModemProxy::init() {
         
         bool apnConfigured = false;
         for (int i = 0; i < 4; i++) {
-            String apnResponse = sendATCommand("AT+CGDCONT=1,\"IP\",\"" + String(fallbackAPNs[i]) + "\"", 2000);
-            if (apnResponse.indexOf("OK") != -1) {
+            atCmd.printf("AT+CGDCONT=1,\"IP\",\"%s\"", fallbackAPNs[i]);
+            if (sendATCommand(atCmd.c_str(), 2000).contains("OK")) {
                 apn = String(fallbackAPNs[i]);
                 Serial.print("[MODEM] APN fallback OK: ");
                 Serial.println(apn);
@@ -127,15 +152,15 @@ bool ModemProxy::init() {
 bool ModemProxy::connect() {
     Serial.println("[MODEM] Esperando registro en red...");
     for (int i = 0; i < 30; i++) {
-        String r = sendATCommand("AT+CGREG?", 1000);
+        const AtResponse& r = sendATCommand("AT+CGREG?", 1000);
         
-        if (r.indexOf("+CGREG: 0,1") != -1 || r.indexOf("+CGREG: 0,5") != -1) {
+        if (r.contains("+CGREG: 0,1") || r.contains("+CGREG: 0,5")) {
             Serial.println("[MODEM] Registrado en red");
             connected = true;
             return true;
         }
         Serial.print(".");
-        delay(2000);
+        idle(2000);
     }
     Serial.println();
     Serial.println("[MODEM] Timeout registro red");
@@ -145,226 +170,358 @@ bool ModemProxy::connect() {
 bool ModemProxy::disconnect() { sendATCommand("AT+CGACT=0,1", 2000); connected = false; return true; }
 bool ModemProxy::isConnected() { return connected; }
 
-// ===== HTTP POST =====
-String ModemProxy::httpPost(const String& path, const String& json) {
-    if (!connected) {
-        Serial.println("[HTTP] Error: No conectado");
-        lastHttpStatus = -1;
-        return "";
-    }
-    
-    // Intentar cerrar sesión previa (puede fallar si no hay sesión, es normal)
-    sendATCommand("AT+HTTPTERM", 500);
-    
-    // Iniciar nueva sesión
-    if (sendATCommand("AT+HTTPINIT", 2000).indexOf("OK") == -1) {
-        Serial.println("[HTTP] Error: HTTPINIT fallo");
-        lastHttpStatus = -1;
-        return "";
-    }
-    
-    // Detectar si path es una URL completa (https:// o http://)
-    String httpUrl, httpsUrl;
-    if (path.startsWith("http://") || path.startsWith("https://")) {
-        // path ya es URL completa, usarla directamente
-        httpUrl = path.startsWith("https://") ? path : path;
-        httpsUrl = path.startsWith("https://") ? path : "https://" + String(proxyUrl) + path;
-    } else {
-        // path es relativo, agregar proxy
-        httpUrl = "http://" + String(proxyUrl) + path;
-        httpsUrl = "https://" + String(proxyUrl) + path;
-    }
-    
-    Serial.print("[HTTP] POST -> "); Serial.println(httpUrl);
-
-    // Basic HTTP parameters: CID es opcional, solo si el modem lo soporta
-    // CID puede fallar en algunos firmwares; intentar 1 y luego 0
-    String cidResp = sendATCommand("AT+HTTPPARA=\"CID\",1", 1000);
-    if (cidResp.indexOf("ERROR") != -1) {
-        Serial.println("[HTTP] CID=1 fallo, probando CID=0");
-        cidResp = sendATCommand("AT+HTTPPARA=\"CID\",0", 1000);
-        if (cidResp.indexOf("ERROR") != -1) {
-            Serial.println("[HTTP] CID no soportado en este modem, continuando sin CID...");
-            // Continuar sin CID; algunos modems A7670SA lo ignoran
-        }
-    }
-
-    // Parámetros opcionales: si fallan, continuar pero registrar
-    if (sendATCommand("AT+HTTPPARA=\"REDIR\",1", 1000).indexOf("ERROR") != -1) {
-        Serial.println("[HTTP] Aviso: REDIR no soportado");
-    }
-    if (sendATCommand("AT+HTTPPARA=\"UA\",\"Wilobu/1.0\"", 1000).indexOf("ERROR") != -1) {
-        Serial.println("[HTTP] Aviso: UA no soportado");
-    }
-    if (sendATCommand("AT+HTTPPARA=\"CONTENT\",\"application/json\"", 1000).indexOf("ERROR") != -1) {
-        Serial.println("[HTTP] Error: CONTENT no aceptado");
-    }
-
-    String url = httpUrl;
-    String dataCmd = "AT+HTTPDATA=" + String(json.length()) + ",10000";
-    String dataResp;
-    bool triedHttps = false;
-
-retry_http:
-    // set URL for this attempt
-    sendATCommand("AT+HTTPPARA=\"URL\",\"" + url + "\"", 2000);
-
-    dataResp = sendATCommand(dataCmd, 2000);
-    if (dataResp.indexOf("DOWNLOAD") == -1) {
+// ===== HTTPDATA + HTTPACTION SOBRE LA SESIÓN ACTUAL =====
+// Devuelve el status HTTP, -1 si no llegó +HTTPACTION o HTTP_NOT_SENT si el
+// cuerpo no se pudo cargar (la petición no salió)
+int ModemProxy::httpSend(const char* json, size_t len) {
+    atCmd.printf("AT+HTTPDATA=%u,10000", (unsigned)len);
+    const AtResponse& dataResp = sendATCommand(atCmd.c_str(), 2000);
+    if (!dataResp.contains("DOWNLOAD")) {
         Serial.println("[HTTP] Error: HTTPDATA no acepto datos");
-        Serial.print("[HTTP] HTTPDATA response: "); Serial.println(dataResp);
-        sendATCommand("AT+HTTPTERM", 1000);
-        lastHttpStatus = -1;
-        return "";
+        Serial.print("[HTTP] HTTPDATA response: "); Serial.println(dataResp.c_str());
+        diagStats.recordHttp(HTTP_NOT_SENT, 0);
+        return HTTP_NOT_SENT;
     }
 
-    Serial.print("[HTTP] Payload size: "); Serial.println(json.length());
+    Serial.print("[HTTP] Payload size: "); Serial.println((unsigned long)len);
     Serial.print("[HTTP] Sending JSON: "); Serial.println(json);
-    modemSerial->print(json);  // Usar print() sin newline
+    modemSerial->write((const uint8_t*)json, len);  // Sin newline
     
     // Esperar confirmación del módem después de recibir datos
-    String uploadResp = "";
-    unsigned long uploadStart = millis();
+    FixedString<64> uploadResp;
+    uint32_t uploadStart = millis();
     while (millis() - uploadStart < 12000) {  // 12 segundos para upload
         while (modemSerial->available()) {
             char c = (char)modemSerial->read();
-            uploadResp += c;
+            uploadResp.append(c);
             Serial.print(c);  // Echo para debug
         }
-        if (uploadResp.indexOf("OK") != -1) {
+        if (uploadResp.contains("OK")) {
             break;
         }
-        delay(10);
+        idle(10);
     }
     Serial.println();
-    Serial.print("[HTTP] Upload response: "); Serial.println(uploadResp);
+    Serial.print("[HTTP] Upload response: "); Serial.println(uploadResp.c_str());
     
-    if (uploadResp.indexOf("OK") == -1) {
+    if (!uploadResp.contains("OK")) {
         Serial.println("[HTTP] Error: No OK después de enviar payload");
-        sendATCommand("AT+HTTPTERM", 1000);
-        lastHttpStatus = -1;
-        return "";
+        diagStats.recordHttp(HTTP_NOT_SENT, 0);
+        return HTTP_NOT_SENT;
     }
 
     // HTTPACTION devuelve OK inmediatamente, pero +HTTPACTION llega después
-    sendATCommand("AT+HTTPACTION=1", 2000);
+    FixedString<SMS_CAPTURE_MAX + 128> action;
+    uint32_t actionStart = millis();
+    action.append(sendATCommand("AT+HTTPACTION=1", 2000).c_str());
+    
+    // Petición en vuelo: sale el SMS armado (multicamino SOS); lo leído
+    // durante el SMS puede traer ya el +HTTPACTION
+    if (smsState() == SmsState::ARMED) {
+        sendArmedSms();
+        action.append(smsCapture.c_str());
+    }
     
     // Esperar específicamente por +HTTPACTION (puede tardar varios segundos)
     Serial.println("[HTTP] Esperando +HTTPACTION...");
-    String action = "";
-    unsigned long start = millis();
+    uint32_t start = millis();
     while (millis() - start < 20000) {  // 20 segundos max
         while (modemSerial->available()) {
-            char c = (char)modemSerial->read();
-            action += c;
+            action.append((char)modemSerial->read());
         }
         
-        if (action.indexOf("+HTTPACTION:") != -1) {
+        if (action.contains("+HTTPACTION:")) {
             delay(100); // Pequeño delay para capturar el resto
             while (modemSerial->available()) {
-                action += (char)modemSerial->read();
+                action.append((char)modemSerial->read());
             }
             break;
         }
-        delay(50);
+        idle(50);
     }
     
-    Serial.print("[HTTP] Response: "); Serial.println(action);
+    Serial.print("[HTTP] Response: "); Serial.println(action.c_str());
 
     // Parse +HTTPACTION: <method>,<status>,<len>
     int idx = action.indexOf("+HTTPACTION:");
     int httpStatus = -1;
     if (idx != -1) {
-        String tail = action.substring(idx);
-        int c1 = tail.indexOf(',');
-        if (c1 != -1) {
-            int c2 = tail.indexOf(',', c1 + 1);
-            if (c2 != -1) {
-                String statusStr = tail.substring(c1 + 1, c2);
-                statusStr.trim();
-                httpStatus = statusStr.toInt();
-                Serial.printf("[HTTP] Status parsed: %d\n", httpStatus);
-            }
+        const char* c1 = strchr(action.c_str() + idx, ',');
+        if (c1 && strchr(c1 + 1, ',')) {
+            httpStatus = (int)strtol(c1 + 1, nullptr, 10);
+            Serial.printf("[HTTP] Status parsed: %d\n", httpStatus);
         }
     }
 
+    diagStats.recordHttp(httpStatus, millis() - actionStart);
+    return httpStatus;
+}
+
+// ===== TLS: CA FIJADA =====
+// Contexto SSL 0: TLS 1.2, verifica el servidor contra TLS_CA_PEM y manda SNI.
+// El archivo queda en el módem entre arranques (se carga si CCERTLIST no lo
+// lista); el contexto se vuelve a configurar tras cada init() porque el
+// módem lo pierde al reiniciar
+bool ModemProxy::configureTls() {
+    if (tlsReady) return true;
+    if (!sendATCommand("AT+CCERTLIST", 2000).contains(TLS_CA_FILE)) {
+        Serial.printf("[TLS] Cargando %s (%u bytes) en el módem\n", TLS_CA_FILE, (unsigned)TLS_CA_PEM_LEN);
+        while (modemSerial->available()) modemSerial->read();
+        atCmd.printf("AT+CCERTDOWN=\"%s\",%u", TLS_CA_FILE, (unsigned)TLS_CA_PEM_LEN);
+        modemSerial->println(atCmd.c_str());
+        FixedString<SMS_CAPTURE_MAX> resp;
+        if (!readUntil(">", 5000, resp)) {
+            Serial.println("[TLS] Error: sin prompt de CCERTDOWN");
+            return false;
+        }
+        modemSerial->write((const uint8_t*)TLS_CA_PEM, TLS_CA_PEM_LEN);
+        resp.clear();
+        if (!readUntil("OK\r\n", 10000, resp)) {
+            Serial.println("[TLS] Error: el módem no aceptó la CA");
+            return false;
+        }
+    }
+    atCmd.printf("AT+CSSLCFG=\"cacert\",0,\"%s\"", TLS_CA_FILE);
+    tlsReady = sendATCommand("AT+CSSLCFG=\"sslversion\",0,3", 1000).contains("OK") &&
+               sendATCommand(atCmd.c_str(), 1000).contains("OK") &&
+               sendATCommand("AT+CSSLCFG=\"authmode\",0,1", 1000).contains("OK") &&
+               sendATCommand("AT+CSSLCFG=\"enableSNI\",0,1", 1000).contains("OK");
+    Serial.println(tlsReady ? "[TLS] ✓ CA fijada en el contexto SSL 0" : "[TLS] ✗ Contexto SSL sin configurar");
+    return tlsReady;
+}
+
+// Sesión HTTP nueva atada al contexto SSL 0; sin la CA cargada no se abre:
+// ninguna petición sale sin verificar el servidor
+bool ModemProxy::beginHttpsSession() {
+    if (!configureTls()) return false;
+    sendATCommand("AT+HTTPTERM", 500);
+    if (!sendATCommand("AT+HTTPINIT", 2000).contains("OK")) return false;
+    if (sendATCommand("AT+HTTPPARA=\"SSLCFG\",0", 1000).contains("OK")) return true;
+    sendATCommand("AT+HTTPTERM", 1000);
+    return false;
+}
+
+// ===== HTTP POST =====
+// true solo con 2xx; el cuerpo de la respuesta (o el del error) queda en lastHttpBody
+bool ModemProxy::httpPost(const char* path, const char* json, size_t len) {
+    if (!connected) {
+        Serial.println("[HTTP] Error: No conectado");
+        lastHttpStatus = -1;
+        return false;
+    }
+
+    // URL completa (solo https://) o ruta relativa al proxy
+    FixedString<HTTP_URL_MAX> url;
+    if (strncmp(path, "https://", 8) == 0) url.append(path);
+    else if (path[0] == '/') url.printf("https://%s%s", proxyUrl, path);
+    if (url.isEmpty() || url.truncated()) {
+        Serial.printf("[HTTP] Error: URL inválida o sin TLS: %s\n", path);
+        lastHttpStatus = -1;
+        return false;
+    }
+
+    // Cerrar la sesión previa también cierra el slot SOS: se vuelve a
+    // preparar en segundo plano
+    slotReady = false;
+    if (!beginHttpsSession()) {
+        Serial.println("[HTTP] Error: sesión HTTPS no abierta");
+        lastHttpStatus = -1;
+        return false;
+    }
+
+    Serial.print("[HTTP] POST -> "); Serial.println(url.c_str());
+
+    // Basic HTTP parameters: CID es opcional, solo si el modem lo soporta
+    // CID puede fallar en algunos firmwares; intentar 1 y luego 0
+    if (sendATCommand("AT+HTTPPARA=\"CID\",1", 1000).contains("ERROR")) {
+        Serial.println("[HTTP] CID=1 fallo, probando CID=0");
+        if (sendATCommand("AT+HTTPPARA=\"CID\",0", 1000).contains("ERROR")) {
+            Serial.println("[HTTP] CID no soportado en este modem, continuando sin CID...");
+            // Continuar sin CID; algunos modems A7670SA lo ignoran
+        }
+    }
+
+    // Parámetros opcionales: si fallan, continuar pero registrar
+    if (sendATCommand("AT+HTTPPARA=\"REDIR\",1", 1000).contains("ERROR")) {
+        Serial.println("[HTTP] Aviso: REDIR no soportado");
+    }
+    if (sendATCommand("AT+HTTPPARA=\"UA\",\"Wilobu/1.0\"", 1000).contains("ERROR")) {
+        Serial.println("[HTTP] Aviso: UA no soportado");
+    }
+    if (sendATCommand("AT+HTTPPARA=\"CONTENT\",\"application/json\"", 1000).contains("ERROR")) {
+        Serial.println("[HTTP] Error: CONTENT no aceptado");
+    }
+
+    atCmd.printf("AT+HTTPPARA=\"URL\",\"%s\"", url.c_str());
+    sendATCommand(atCmd.c_str(), 2000);
+
+    int httpStatus = httpSend(json, len);
+    if (httpStatus == HTTP_NOT_SENT) {
+        sendATCommand("AT+HTTPTERM", 1000);
+        lastHttpStatus = -1;
+        return false;
+    }
+
     // Registrar status para diagnóstico y resets
     lastHttpStatus = httpStatus;
 
-    // If not 2xx, try HTTPS fallback once
+    // Sin fallback a otro esquema: un status no 2xx (o -1 si el servidor no
+    // pasó la verificación TLS) se reintenta en el próximo ciclo
     if (httpStatus < 200 || httpStatus >= 300) {
         Serial.println("[HTTP] Error: Status not 2xx");
         Serial.print("[HTTP] Numeric status: "); Serial.println(httpStatus);
 
         // Try to read any body for diagnostics
-        String body = sendATCommand("AT+HTTPREAD", 3000);
-        lastHttpBody = body;
-        if (body.length() > 0) {
-            Serial.print("[HTTP] Body on error: "); Serial.println(body);
+        lastHttpBody = sendATCommand("AT+HTTPREAD", 3000).c_str();
+        if (lastHttpBody.length() > 0) {
+            Serial.print("[HTTP] Body on error: "); Serial.println(lastHttpBody.c_str());
         }
 
-        // Persist diagnostics in NVS for later inspection (muy truncado para evitar KEY_TOO_LONG)
-        {
-            Preferences prefs;
-            prefs.begin("wilobu", false);
-            // Limitar a 64 chars por clave
-            String statusStr = String(httpStatus);
-            if (statusStr.length() > 64) statusStr = statusStr.substring(0, 64);
-            prefs.putString("http_status", statusStr);
-            prefs.end();
-        }
-
-        // ⚠️ CRITICAL: Don't retry if this is a deprovision code (404/410/401)
-        // These codes indicate the device was removed from Firestore and should factory reset
+        // 404/410/401: el dispositivo fue quitado de Firestore; lastHttpStatus
+        // lleva el código para que main.cpp haga el reset de fábrica
         if (httpStatus == 404 || httpStatus == 410 || httpStatus == 401) {
-            Serial.println("[HTTP] ⚠️ Código de desaprovisionamiento detectado - NO intentar fallback");
-            sendATCommand("AT+HTTPTERM", 1000);
-            return ""; // Return empty string, but lastHttpStatus is already set to the deprovision code
-        }
-
-        if (!triedHttps) {
-            triedHttps = true;
-            // Try enable SSL mode (may not be supported on all firmwares)
-            Serial.println("[HTTP] Intentando fallback a HTTPS...");
-            sendATCommand("AT+HTTPTERM", 1000);
-            String sslResp = sendATCommand("AT+HTTPSSL=1", 2000);
-            Serial.print("[HTTP] AT+HTTPSSL response: "); Serial.println(sslResp);
-            if (sendATCommand("AT+HTTPINIT", 2000).indexOf("OK") == -1) {
-                Serial.println("[HTTP] Error: HTTPINIT fallo en HTTPS fallback");
-                return "";
-            }
-            url = httpsUrl;
-            goto retry_http;
+            Serial.println("[HTTP] ⚠️ Código de desaprovisionamiento detectado");
         }
 
         sendATCommand("AT+HTTPTERM", 1000);
-        return "";
+        return false;
     }
 
-    String response = sendATCommand("AT+HTTPREAD", 3000);
-    lastHttpBody = response;
-    // Save successful request diagnostics (muy truncado para evitar KEY_TOO_LONG)
-    {
-        Preferences prefs;
-        prefs.begin("wilobu", false);
-        String statusStr = String(httpStatus);
-        if (statusStr.length() > 64) statusStr = statusStr.substring(0, 64);
-        prefs.putString("http_status", statusStr);
-        prefs.end();
-    }
+    lastHttpBody = sendATCommand("AT+HTTPREAD", 3000).c_str();
     sendATCommand("AT+HTTPTERM", 1000);
-    return response;
+    return !lastHttpBody.isEmpty();
+}
+
+// Serializa en jsonBody; 0 si el documento o el cuerpo no entran
+size_t ModemProxy::serializeBody(const JsonDocument& doc) {
+    if (doc.overflowed() || measureJson(doc) >= sizeof(jsonBody)) {
+        Serial.printf("[HTTP] Error: cuerpo JSON excede %u bytes\n", (unsigned)sizeof(jsonBody));
+        return 0;
+    }
+    return serializeJson(doc, jsonBody, sizeof(jsonBody));
+}
+
+bool ModemProxy::sendToFirebase(const String& path, const String& json) { return httpPost("/send", json.c_str(), json.length()); }
+bool ModemProxy::sendToFirebaseFunction(const String& path, const String& json) { return httpPost(path.c_str(), json.c_str(), json.length()); }
+
+// ===== PSM / eDRX =====
+bool ModemProxy::configurePowerSaving(const PowerSavingRequest& req) {
+    uint32_t tau = 0, active = 0;
+    float cycle = 0;
+    String t3412 = PowerSaving::encodeT3412(req.tauSec, &tau);
+    String t3324 = PowerSaving::encodeT3324(req.activeSec, &active);
+    String edrx = PowerSaving::encodeEdrx(req.edrxMaxSec, &cycle);
+
+    bool ok;
+    if (req.psm) {
+        Serial.printf("[PSM] Pidiendo TAU %lu s (%s), active time %lu s (%s)\n",
+            (unsigned long)tau, t3412.c_str(), (unsigned long)active, t3324.c_str());
+        atCmd.printf("AT+CPSMS=1,,,\"%s\",\"%s\"", t3412.c_str(), t3324.c_str());
+        ok = sendATCommand(atCmd.c_str(), 2000).contains("OK");
+    } else {
+        ok = sendATCommand("AT+CPSMS=0", 2000).contains("OK");
+    }
+    Serial.printf("[EDRX] Pidiendo ciclo %.2f s (%s)\n", cycle, edrx.c_str());
+    atCmd.printf("AT+CEDRXS=1,%d,\"%s\"", EDRX_ACT_TYPE, edrx.c_str());
+    ok = sendATCommand(atCmd.c_str(), 2000).contains("OK") && ok;
+
+    // CEREG=4 agrega los timers PSM a la consulta; se vuelve a 0 para no recibir URCs.
+    // Si la red aún no respondió al pedido, lo otorgado se verá tras el próximo TAU.
+    sendATCommand("AT+CEREG=4", 1000);
+    // Se configura rara vez: las copias a String no afectan el heap en régimen
+    String cereg = sendATCommand("AT+CEREG?", 1000).c_str();
+    sendATCommand("AT+CEREG=0", 1000);
+    PowerSaving::logNegotiated(cereg, String(sendATCommand("AT+CEDRXRDP", 1000).c_str()));
+    return ok;
+}
+
+// ===== SLOT SOS (RUTA RÁPIDA) =====
+bool ModemProxy::prepareSosSlot(const char* deviceId, const char* ownerUid) {
+    sosTemplates.build(deviceId, ownerUid);
+    slotReady = false;
+    if (!connected) return false;
+
+    if (!beginHttpsSession()) {
+        Serial.println("[SLOT] Error: sesión HTTPS no abierta");
+        return false;
+    }
+    if (sendATCommand("AT+HTTPPARA=\"CID\",1", 1000).contains("ERROR")) {
+        sendATCommand("AT+HTTPPARA=\"CID\",0", 1000);
+    }
+    sendATCommand("AT+HTTPPARA=\"CONTENT\",\"application/json\"", 1000);
+    slotReady = sendATCommand(slotUrlCmd.c_str(), 2000).contains("OK");
+    Serial.println(slotReady ? "[SLOT] ✓ Slot SOS listo" : "[SLOT] ✗ URL no aceptada");
+    return slotReady;
+}
+
+// Con la sesión viva, volver a fijar la URL responde OK; sin sesión, ERROR
+bool ModemProxy::checkSosSlot() {
+    if (!slotReady || !connected) return false;
+    slotReady = sendATCommand(slotUrlCmd.c_str(), 2000).contains("OK");
+    if (!slotReady) Serial.println("[SLOT] Sesión HTTP perdida");
+    return slotReady;
+}
+
+bool ModemProxy::sendSOSFast(uint8_t typeCode, uint32_t epoch, uint32_t seq) {
+    if (!sosSlotReady() || !sosTemplates.isBuilt()) return false;
+    size_t len = sosTemplates.body(typeCode, epoch, seq, jsonBody, sizeof(jsonBody));
+    if (len == 0) return false;
+    int status = httpSend(jsonBody, len);
+    lastHttpStatus = status;
+    if (status == HTTP_NOT_SENT) {
+        slotReady = false;
+        return false;
+    }
+    if (status < 200 || status >= 300) {
+        // Dejar que la ruta completa se encargue del reintento
+        return false;
+    }
+    // La sesión queda abierta: el slot sigue listo para el siguiente disparo
+    lastHttpBody = sendATCommand("AT+HTTPREAD", 3000).c_str();
+    return true;
 }
 
-bool ModemProxy::sendToFirebase(const String& path, const String& json) { return !httpPost("/send", json).isEmpty(); }
-bool ModemProxy::sendToFirebaseFunction(const String& path, const String& json) { return !httpPost(path, json).isEmpty(); }
+// ===== SMS =====
+// Lee sin vaciar el buffer (a diferencia de sendATCommand) para no perder la
+// URC de una transacción HTTP en curso; todo queda en 'out'.
+bool ModemProxy::readUntil(const char* token, uint32_t timeout, FixedString<SMS_CAPTURE_MAX>& out) {
+    uint32_t start = millis();
+    while (millis() - start < timeout) {
+        while (modemSerial->available()) out.append((char)modemSerial->read());
+        if (out.contains(token)) return true;
+        if (out.contains("ERROR")) return false;
+        idle(5);
+    }
+    return false;
+}
+
+bool ModemProxy::sendSMS(const char* number, const char* text) {
+    smsCapture.clear();
+    Serial.print("[SMS] -> "); Serial.println(number);
+    atCmd.printf("AT+CMGS=\"%s\"\r", number);
+    modemSerial->print(atCmd.c_str());
+    if (!readUntil(">", 5000, smsCapture)) {
+        Serial.println("[SMS] Error: sin prompt de CMGS");
+        modemSerial->write((uint8_t)0x1B);  // ESC: abortar
+        return false;
+    }
+    modemSerial->print(text);
+    modemSerial->write((uint8_t)0x1A);      // Ctrl+Z: enviar
+    // +CMGS: <mr> = aceptado por el SMSC
+    bool ok = readUntil("+CMGS:", 20000, smsCapture);
+    Serial.println(ok ? "[SMS] ✓ Aceptado por SMSC" : "[SMS] ✗ Sin +CMGS");
+    return ok;
+}
 
 // ===== SOS & HEARTBEAT =====
-bool ModemProxy::sendSOSAlert(const String& deviceId, const String& ownerUid, const String& sosType, const GPSLocation& loc) {
-    JsonDocument doc;
+bool ModemProxy::sendSOSAlert(const char* deviceId, const char* ownerUid, const char* sosType, const GPSLocation& loc,
+                             const JsonDocument* extra) {
+    JsonDocument doc(&jsonArena);
+    char status[24];
+    snprintf(status, sizeof(status), "sos_%s", sosType);
     doc["deviceId"] = deviceId;
     doc["ownerUid"] = ownerUid;
-    doc["status"] = "sos_" + sosType;
+    doc["status"] = status;
     if (loc.isValid) {
         doc["lastLocation"]["lat"] = loc.latitude;
         doc["lastLocation"]["lng"] = loc.longitude;
@@ -372,12 +529,16 @@ bool ModemProxy::sendSOSAlert(const String& deviceId, const String& ownerUid, co
     } else {
         doc["lastLocation"] = nullptr;
     }
-    String json; serializeJson(doc, json);
-    return !httpPost("https://us-central1-wilobu-d21b2.cloudfunctions.net/heartbeat", json).isEmpty();
+    if (extra) {
+        for (JsonPairConst kv : extra->as<JsonObjectConst>()) doc[kv.key()] = kv.value();
+    }
+    size_t len = serializeBody(doc);
+    return len > 0 && httpPost(heartbeatUrl.c_str(), jsonBody, len);
 }
 
-bool ModemProxy::sendHeartbeat(const String& ownerUid, const String& deviceId, const GPSLocation& loc) {
-    JsonDocument doc;
+bool ModemProxy::sendHeartbeat(const char* ownerUid, const char* deviceId, const GPSLocation& loc,
+                               const JsonDocument* extra) {
+    JsonDocument doc(&jsonArena);
     doc["deviceId"] = deviceId;
     doc["ownerUid"] = ownerUid;
     doc["status"] = "online";
@@ -387,9 +548,13 @@ bool ModemProxy::sendHeartbeat(const String& ownerUid, const String& deviceId, c
         doc["lastLocation"]["lng"] = loc.longitude;
         doc["lastLocation"]["accuracy"] = loc.accuracy;
     }
-    String json; serializeJson(doc, json);
+    if (extra) {
+        for (JsonPairConst kv : extra->as<JsonObjectConst>()) doc[kv.key()] = kv.value();
+    }
+    size_t len = serializeBody(doc);
+    if (len == 0) return false;
     // Enviar HTTPS directo a Cloud Function, saltando proxy Cloudflare
-    String response = httpPost("https://us-central1-wilobu-d21b2.cloudfunctions.net/heartbeat", json);
+    bool ok = httpPost(heartbeatUrl.c_str(), jsonBody, len);
     
     // Detectar cmd_reset por código HTTP (404=no existe, 410=desprovisionado, 401=owner mismatch)
     // El Cloud Function devuelve estos códigos cuando el dispositivo debe resetearse
@@ -411,13 +576,13 @@ bool ModemProxy::sendHeartbeat(const String& ownerUid, const String& deviceId, c
         return false;
     }
     
-    if (response.isEmpty()) {
+    if (!ok) {
         Serial.println("[HEARTBEAT] Error: respuesta vacía");
         return false;
     }
     
     // Fallback: también verificar cmd_reset en body si se pudo leer
-    if (response.indexOf("\"cmd_reset\":true") != -1) {
+    if (lastHttpBody.indexOf("\"cmd_reset\":true") != -1) {
         Serial.println("[HEARTBEAT] ⚠️ cmd_reset detectado en body - Factory Reset");
         factoryResetPending = true;
     }
@@ -425,19 +590,18 @@ bool ModemProxy::sendHeartbeat(const String& ownerUid, const String& deviceId, c
 }
 
 // ===== AUTO-RECUPERACIÓN DE APROVISIONAMIENTO =====
-String ModemProxy::checkProvisioningStatus(const String& deviceId) {
+String ModemProxy::checkProvisioningStatus(const char* deviceId) {
     Serial.println("[AUTO-RECOVER] Verificando estado en Firestore...");
-    JsonDocument doc;
+    JsonDocument doc(&jsonArena);
     doc["deviceId"] = deviceId;
-    String json; serializeJson(doc, json);
-    String response = httpPost("https://us-central1-wilobu-d21b2.cloudfunctions.net/checkDeviceStatus", json);
-    
-    if (response.isEmpty()) {
+    size_t len = serializeBody(doc);
+    if (len == 0 || !httpPost(statusUrl.c_str(), jsonBody, len)) {
         Serial.println("[AUTO-RECOVER] Sin respuesta del servidor");
         return "";
     }
     
     // Buscar ownerUid en la respuesta JSON
+    const HttpBody& response = lastHttpBody;
     int ownerIdx = response.indexOf("\"ownerUid\":\"");
     if (ownerIdx == -1) {
         Serial.println("[AUTO-RECOVER] Dispositivo no encontrado en Firestore");
@@ -448,7 +612,8 @@ String ModemProxy::checkProvisioningStatus(const String& deviceId) {
     int endIdx = response.indexOf("\"", ownerIdx);
     if (endIdx == -1) return "";
     
-    String ownerUid = response.substring(ownerIdx, endIdx);
+    String ownerUid;
+    ownerUid.concat(response.c_str() + ownerIdx, endIdx - ownerIdx);
     Serial.println("[AUTO-RECOVER] ✓ Dispositivo encontrado - Owner: " + ownerUid);
     return ownerUid;
 }
@@ -457,45 +622,39 @@ String ModemProxy::checkProvisioningStatus(const String& deviceId) {
 bool ModemProxy::initGNSS() {
     if (gpsEnabled) return true;
 
-    // Backoff si ya falló recientemente
-    if (millis() < nextGnssRetryMs) {
+    // Backoff si ya falló recientemente (plazo relativo: no se rompe al desbordar millis())
+    if (gnssFailCount > 0 &&
+        JobScheduler::remaining(millis(), gnssFailMs, GnssScheduler::powerRetryDelayMs(gnssFailCount)) > 0) {
         return false;
     }
 
     Serial.println("[GPS] Activando GNSS en A7670SA...");
     
     // Paso 1: Energizar GNSS
-    String r = sendATCommand("AT+CGNSSPWR=1", 5000);
-    if (r.indexOf("ERROR") != -1) {
+    if (sendATCommand("AT+CGNSSPWR=1", 5000).contains("ERROR")) {
         Serial.println("[GPS] ✗ Error en AT+CGNSSPWR=1");
         gpsEnabled = false;
-        gnssFailCount++;
-        unsigned long delayMs = (gnssFailCount == 1) ? 5000UL : (gnssFailCount == 2 ? 30000UL : 300000UL);
-        nextGnssRetryMs = millis() + delayMs;
+        if (gnssFailCount < 0xFF) gnssFailCount++;
+        gnssFailMs = millis();
         return false;
     }
     
-    // Paso 2: Esperar READY! (hasta 10s)
-    Serial.println("[GPS] Esperando +CGNSSPWR: READY!...");
-    unsigned long start = millis();
-    bool ready = false;
-    while (millis() - start < 10000) {
-        while (modemSerial->available()) {
-            String line = modemSerial->readStringUntil('\n');
-            if (line.indexOf("READY") != -1) {
-                ready = true;
-                Serial.println("[GPS] ✓ GNSS READY");
-                break;
-            }
-        }
-        if (ready) break;
-        delay(100);
-    }
-    
-    if (!ready) {
-        Serial.println("[GPS] ⚠️ Timeout esperando READY, continuando...");
-    }
-    
+    // +CGNSSPWR: READY! llega como URC unos segundos después. No se espera aquí:
+    // la adquisición avanza en el módem mientras LTE registra o envía, y la
+    // salida NMEA se configura en el primer getLocation() posterior.
+    Serial.println("[GPS] ✓ GNSS energizado (configuración diferida hasta READY)");
+    gpsEnabled = true;
+    gnssConfigured = false;
+    gnssPowerOnMs = millis();
+    gnssFailCount = 0;
+    return true;
+}
+
+// Completa la activación una vez que el motor GNSS tuvo tiempo de arrancar
+bool ModemProxy::configureGNSSOutput() {
+    if (gnssConfigured) return true;
+    if (millis() - gnssPowerOnMs < 2000) return false;  // READY típico: 1-2s
+
     // Paso 3: Activar salida de datos
     sendATCommand("AT+CGNSSTST=1", 2000);
     
@@ -503,10 +662,7 @@ bool ModemProxy::initGNSS() {
     sendATCommand("AT+CGNSSPORTSWITCH=0,1", 2000);
     
     Serial.println("[GPS] ✓ GNSS activado");
-    gpsEnabled = true;
-    gnssFailCount = 0;
-    nextGnssRetryMs = millis();
-    delay(2000); // Dar tiempo al GPS para inicializar
+    gnssConfigured = true;
     return true;
 }
 
@@ -515,11 +671,16 @@ bool ModemProxy::getLocation(GPSLocation& loc) {
         loc.isValid = false;
         return false;
     }
+    if (!configureGNSSOutput()) {
+        loc.isValid = false;
+        return false;
+    }
     
     // Para A7670SA usar AT+CGPSINFO
-    String r = sendATCommand("AT+CGPSINFO", 3000);
+    const AtResponse& r = sendATCommand("AT+CGPSINFO", 3000);
     
-    if (r.indexOf("+CGPSINFO") == -1) {
+    int tag = r.indexOf("+CGPSINFO");
+    if (tag == -1) {
         loc.isValid = false;
         return false;
     }
@@ -527,32 +688,36 @@ bool ModemProxy::getLocation(GPSLocation& loc) {
     // Formato: +CGPSINFO: <lat>,<N/S>,<lon>,<E/W>,<date>,<UTC>,<alt>,<speed>,<course>
     // Ejemplo: +CGPSINFO: 4043.000000,N,07400.000000,W,250422,123045.0,0.0,0.0,0.0
     
-    int colon = r.indexOf(":");
-    if (colon == -1) {
+    const char* colon = strchr(r.c_str() + tag, ':');
+    if (!colon) {
         loc.isValid = false;
         return false;
     }
     
-    String data = r.substring(colon + 1);
-    data.trim();
+    // Copia local de la línea: se corta en campos sin tocar el heap
+    char data[112];
+    const char* p = colon + 1;
+    while (*p == ' ') p++;
+    size_t n = strcspn(p, "\r\n");
+    if (n >= sizeof(data)) n = sizeof(data) - 1;
+    memcpy(data, p, n);
+    data[n] = '\0';
     
     // Si retorna vacío o sin fix
-    if (data.length() < 10 || data.startsWith(",,,")) {
+    if (n < 10 || strncmp(data, ",,,", 3) == 0) {
         Serial.println("[GPS] Sin fix GPS");
         loc.isValid = false;
         return false;
     }
     
     // Parsear: lat,dir,lon,dir,...
-    int idx = 0;
-    String parts[9];
+    const char* parts[9] = {0};
     int partIdx = 0;
-    
-    for (int i = 0; i < data.length() && partIdx < 9; i++) {
-        if (data[i] == ',') {
-            partIdx++;
-        } else {
-            parts[partIdx] += data[i];
+    parts[0] = data;
+    for (char* c = data; *c && partIdx < 8; c++) {
+        if (*c == ',') {
+            *c = '\0';
+            parts[++partIdx] = c + 1;
         }
     }
     
@@ -561,32 +726,35 @@ bool ModemProxy::getLocation(GPSLocation& loc) {
         return false;
     }
     
-    String latStr = parts[0];    // "4043.000000"
-    String latDir = parts[1];    // "N" o "S"
-    String lonStr = parts[2];    // "07400.000000"
-    String lonDir = parts[3];    // "E" o "W"
+    const char* latStr = parts[0];    // "4043.000000"
+    const char* latDir = parts[1];    // "N" o "S"
+    const char* lonStr = parts[2];    // "07400.000000"
+    const char* lonDir = parts[3];    // "E" o "W"
     
-    if (latStr.length() == 0 || lonStr.length() == 0) {
+    if (*latStr == '\0' || *lonStr == '\0') {
         loc.isValid = false;
         return false;
     }
     
     // Convertir formato DDMM.MMMMMM a decimal
-    auto toDecimal = [](const String& val, const String& dir) -> float {
-        float raw = val.toFloat();
+    auto toDecimal = [](const char* val, const char* dir) -> float {
+        float raw = atof(val);
         if (raw == 0.0f) return 0.0f;
         
         int deg = (int)(raw / 100);
         float minutes = raw - (deg * 100);
         float decimal = deg + (minutes / 60.0f);
         
-        if (dir == "S" || dir == "W") decimal *= -1.0f;
+        if (*dir == 'S' || *dir == 'W') decimal *= -1.0f;
         return decimal;
     };
     
     loc.latitude = toDecimal(latStr, latDir);
     loc.longitude = toDecimal(lonStr, lonDir);
     loc.accuracy = 10.0;
+    // Velocidad viene en nudos; rumbo en grados (vacíos si no hay movimiento)
+    loc.speedKmh = partIdx >= 7 ? atof(parts[7]) * 1.852f : 0.0f;
+    loc.courseDeg = partIdx >= 8 ? atof(parts[8]) : 0.0f;
     loc.timestamp = millis();
     loc.isValid = (loc.latitude != 0.0f || loc.longitude != 0.0f);
     
@@ -599,14 +767,220 @@ bool ModemProxy::getLocation(GPSLocation& loc) {
 
 void ModemProxy::disableGNSS() { 
     if (gpsEnabled) { 
-        sendATCommand("AT+CGPS=0", 2000); 
+        // Simétrico a initGNSS(): AT+CGPS no corta la alimentación del GNSS en A7670SA
+        sendATCommand("AT+CGNSSPWR=0", 2000); 
         gpsEnabled = false; 
+        gnssConfigured = false; 
     } 
 }
 
 // ===== POWER & OTA STUBS =====
-void ModemProxy::enableDeepSleep(unsigned long sec) { if (connected) disconnect(); disableGNSS(); deepSleeping = true; }
+void ModemProxy::enableDeepSleep(uint32_t sec) {
+    // El PDP queda activo: al despertar no hay CGDCONT/CGACT ni espera de registro
+    sendATCommand("AT+HTTPTERM", 500);
+    slotReady = false;
+    disableGNSS();
+    deepSleeping = true;
+}
 bool ModemProxy::isDeepSleeping() { return deepSleeping; }
-bool ModemProxy::checkForUpdates() { return false; }
-bool ModemProxy::downloadFirmwareUpdate(const String& url) { return false; }
-bool ModemProxy::applyFirmwareUpdate() { return false; }
+
+bool ModemProxy::resume() {
+    bool alive = false;
+    for (int i = 0; i < 3 && !alive; i++) alive = sendATCommand("AT", 300).contains("OK");
+    if (!alive) return false;
+    sendATCommand("ATE0", 300);
+    const AtResponse& r = sendATCommand("AT+CGREG?", 1000);
+    if (!r.contains("+CGREG: 0,1") && !r.contains("+CGREG: 0,5")) return false;
+    connected = true;
+    deepSleeping = false;
+    Serial.println("[MODEM] Reanudado sin reinicializar (registro conservado)");
+    return true;
+}
+
+// A7670SA: "+CBC: 3.912V"
+bool ModemProxy::getBatteryMillivolts(uint16_t& mv) {
+    const AtResponse& resp = sendATCommand("AT+CBC", 1000);
+    int idx = resp.indexOf("+CBC:");
+    if (idx == -1) return false;
+    float volts = atof(resp.c_str() + idx + 5);
+    if (volts <= 0.0f) return false;
+    mv = (uint16_t)(volts * 1000.0f);
+    return true;
+}
+
+// "+CSQ: <rssi>,<ber>"; 99 = el módem aún no midió
+bool ModemProxy::getSignalQuality(uint8_t& csq) {
+    const AtResponse& resp = sendATCommand("AT+CSQ", 1000);
+    int idx = resp.indexOf("+CSQ:");
+    if (idx == -1) return false;
+    long v = strtol(resp.c_str() + idx + 5, nullptr, 10);
+    if (v < 0 || v > 99) return false;
+    csq = (uint8_t)v;
+    return true;
+}
+
+// ===== OTA =====
+// Los trozos de la imagen pasan por jsonBody: no hay petición JSON en curso
+// mientras se descarga y la descarga no suma RAM propia
+static_assert(OTA_CHUNK_BYTES <= HTTP_JSON_MAX, "OTA_CHUNK_BYTES debe caber en jsonBody");
+
+bool ModemProxy::checkForUpdates(const char* deviceId, const char* currentVersion, OtaManifest& manifest) {
+    size_t len;
+    {
+        // La arena sirve un documento a la vez: el de la petición se libera antes de parsear
+        JsonDocument doc(&jsonArena);
+        doc["deviceId"] = deviceId;
+        doc["fw"] = currentVersion;
+        len = serializeBody(doc);
+    }
+    if (len == 0 || !httpPost(otaUrl.c_str(), jsonBody, len)) {
+        Serial.println("[OTA] Sin respuesta del manifiesto");
+        return false;
+    }
+    OtaManifest published;
+    if (!parseOtaManifest(lastHttpBody.c_str(), published, &jsonArena)) {
+        Serial.println("[OTA] Sin actualización publicada");
+        return false;
+    }
+    if (strcmp(published.version, currentVersion) == 0) return false;
+    manifest = published;
+    Serial.printf("[OTA] Publicada %s (actual %s)\n", published.version, currentVersion);
+    return true;
+}
+
+// GET sobre la sesión actual: status HTTP (-1 sin +HTTPACTION) y largo del
+// cuerpo, que queda en el módem para leerlo por partes con HTTPREAD
+int ModemProxy::httpGet(uint32_t& bodyLen) {
+    FixedString<96> action;
+    uint32_t actionStart = millis();
+    action.append(sendATCommand("AT+HTTPACTION=0", 2000).c_str());
+    uint32_t start = millis();
+    while (!action.contains("+HTTPACTION:") && millis() - start < OTA_ACTION_TIMEOUT_MS) {
+        while (modemSerial->available()) action.append((char)modemSerial->read());
+        idle(50);
+    }
+    delay(50);
+    while (modemSerial->available()) action.append((char)modemSerial->read());
+
+    // +HTTPACTION: 0,<status>,<len>
+    int httpStatus = -1;
+    bodyLen = 0;
+    int idx = action.indexOf("+HTTPACTION:");
+    if (idx != -1) {
+        const char* c1 = strchr(action.c_str() + idx, ',');
+        const char* c2 = c1 ? strchr(c1 + 1, ',') : nullptr;
+        if (c2) {
+            httpStatus = (int)strtol(c1 + 1, nullptr, 10);
+            bodyLen = strtoul(c2 + 1, nullptr, 10);
+        }
+    }
+    diagStats.recordHttp(httpStatus, millis() - actionStart);
+    return httpStatus;
+}
+
+// AT+HTTPREAD=<pos>,<n> en binario: "+HTTPREAD: <n>\r\n" y exactamente n
+// bytes (la imagen puede traer "OK\r\n" adentro, no se busca texto en ella).
+// Devuelve los bytes copiados a buf o -1
+int ModemProxy::httpReadChunk(uint32_t pos, uint8_t* buf, size_t want) {
+    while (modemSerial->available()) modemSerial->read();
+    modemSerial->printf("AT+HTTPREAD=%lu,%u\r\n", (unsigned long)pos, (unsigned)want);
+
+    FixedString<64> line;
+    long n = -1;
+    uint32_t start = millis();
+    while (n < 0 && millis() - start < OTA_READ_TIMEOUT_MS) {
+        if (!modemSerial->available()) { idle(5); continue; }
+        char c = (char)modemSerial->read();
+        if (c != '\n') { line.append(c); continue; }
+        if (line.contains("ERROR")) return -1;
+        int idx = line.indexOf("+HTTPREAD:");
+        if (idx != -1) n = strtol(line.c_str() + idx + 10, nullptr, 10);
+        if (n == 0) n = -1;   // Eco de cierre de una lectura anterior
+        line.clear();
+    }
+    if (n <= 0 || (size_t)n > want) return -1;
+
+    size_t got = 0;
+    while (got < (size_t)n && millis() - start < OTA_READ_TIMEOUT_MS) {
+        got += modemSerial->readBytes(buf + got, n - got);
+    }
+    if (got < (size_t)n) return -1;
+
+    // Cola "\r\n+HTTPREAD: 0\r\n": se descarta para que no ensucie el siguiente trozo
+    line.clear();
+    uint32_t tailStart = millis();
+    while (!line.contains("+HTTPREAD: 0") && millis() - tailStart < 500) {
+        if (modemSerial->available()) line.append((char)modemSerial->read());
+        else idle(5);
+        if (line.truncated()) line.clear();
+    }
+    return (int)n;
+}
+
+bool ModemProxy::downloadFirmwareUpdate(const OtaManifest& manifest, OtaUpdater& sink) {
+    if (!connected || !sink.isActive()) return false;
+    uint32_t from = sink.offset();
+    if (from >= manifest.size) return true;
+    uint32_t to = manifest.size - 1;
+    if (to - from >= OTA_RANGE_BYTES) to = from + OTA_RANGE_BYTES - 1;
+
+    slotReady = false;
+    if (!beginHttpsSession()) {
+        Serial.println("[OTA] Error: sesión HTTPS no abierta");
+        return false;
+    }
+    if (sendATCommand("AT+HTTPPARA=\"CID\",1", 1000).contains("ERROR")) {
+        sendATCommand("AT+HTTPPARA=\"CID\",0", 1000);
+    }
+    sendATCommand("AT+HTTPPARA=\"REDIR\",1", 1000);
+    atCmd.printf("AT+HTTPPARA=\"URL\",\"%s\"", manifest.url);
+    if (atCmd.truncated() || !sendATCommand(atCmd.c_str(), 2000).contains("OK")) {
+        Serial.println("[OTA] Error: URL de la imagen no aceptada");
+        sendATCommand("AT+HTTPTERM", 1000);
+        return false;
+    }
+    atCmd.printf("AT+HTTPPARA=\"USERDATA\",\"Range: bytes=%lu-%lu\"", (unsigned long)from, (unsigned long)to);
+    sendATCommand(atCmd.c_str(), 1000);
+
+    uint32_t bodyLen = 0;
+    int status = httpGet(bodyLen);
+    lastHttpStatus = status;
+    // 206: el cuerpo es el rango pedido. 200: el servidor ignoró Range y mandó
+    // la imagen entera; se lee desde "from" dentro de ese cuerpo
+    uint32_t pos;
+    if (status == 206 && bodyLen == to - from + 1) {
+        pos = 0;
+    } else if (status == 200 && bodyLen == manifest.size) {
+        pos = from;
+    } else {
+        Serial.printf("[OTA] Rango %lu-%lu rechazado: status %d, %lu bytes\n",
+            (unsigned long)from, (unsigned long)to, status, (unsigned long)bodyLen);
+        sendATCommand("AT+HTTPTERM", 1000);
+        return false;
+    }
+
+    // Cada trozo se pide recién escrito el anterior: mientras esp_ota_write
+    // borra flash el módem no transmite y el buffer del UART no desborda
+    uint8_t* chunk = (uint8_t*)jsonBody;
+    uint32_t remaining = to - from + 1;
+    bool ok = true;
+    while (remaining > 0) {
+        size_t want = remaining < OTA_CHUNK_BYTES ? remaining : OTA_CHUNK_BYTES;
+        int n = httpReadChunk(pos, chunk, want);
+        if (n <= 0 || !sink.write(chunk, n)) {
+            Serial.printf("[OTA] Lectura cortada en %lu\n", (unsigned long)sink.offset());
+            ok = false;
+            break;
+        }
+        pos += n;
+        remaining -= n;
+    }
+    sendATCommand("AT+HTTPTERM", 1000);
+    if (ok) Serial.printf("[OTA] %lu/%lu bytes\n", (unsigned long)sink.offset(), (unsigned long)manifest.size);
+    return ok;
+}
+
+bool ModemProxy::applyFirmwareUpdate(OtaUpdater& sink) {
+    sendATCommand("AT+HTTPTERM", 500);
+    return sink.finish();
+}
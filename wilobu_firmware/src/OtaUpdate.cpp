@@ -0,0 +1,309 @@
+#include "OtaUpdate.h"
+#include "JsonArena.h"
+#include <ArduinoJson.h>
+#include <Preferences.h>
+#include <esp_system.h>
+#include <mbedtls/ecdsa.h>
+
+// Clave pública de firma del manifiesto: la pone platformio.ini (desde
+// WILOBU_OTA_PUBKEY); la privada no sale de la máquina que publica
+#ifndef OTA_SIGNING_PUBKEY
+  #error "OTA_SIGNING_PUBKEY sin definir: exporta WILOBU_OTA_PUBKEY antes de compilar"
+#endif
+static_assert(sizeof(OTA_SIGNING_PUBKEY) == 2 * OTA_PUBKEY_BYTES + 1,
+    "OTA_SIGNING_PUBKEY debe ser el punto P-256 sin comprimir en hex (130 caracteres)");
+
+bool OtaUpdater::trial = false;
+
+// El core de Arduino marca la imagen como válida al arrancar salvo que esto
+// devuelva true: la confirmación la decide confirm() tras el heartbeat
+extern "C" bool verifyRollbackLater() { return true; }
+
+namespace {
+
+int hexNibble(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Exactamente 2*len dígitos hex
+bool decodeHex(const char* hex, uint8_t* out, size_t len) {
+    if (strlen(hex) != 2 * len) return false;
+    for (size_t i = 0; i < len; i++) {
+        int hi = hexNibble(hex[i * 2]);
+        int lo = hexNibble(hex[i * 2 + 1]);
+        if (hi < 0 || lo < 0) return false;
+        out[i] = (uint8_t)(hi << 4 | lo);
+    }
+    return true;
+}
+
+} // namespace
+
+// ===== MANIFIESTO =====
+namespace {
+
+// ECDSA P-256 de scripts/sign_firmware.js sobre los campos ya decodificados:
+// el texto firmado se rearma aquí, así un campo con otra grafía no verifica
+bool verifyManifestSignature(const OtaManifest& m, const char* sigHex) {
+    uint8_t pub[OTA_PUBKEY_BYTES];
+    uint8_t sig[OTA_SIG_MAX];
+    size_t sigLen = strlen(sigHex) / 2;
+    if (!decodeHex(OTA_SIGNING_PUBKEY, pub, sizeof(pub))) return false;
+    if (sigLen == 0 || sigLen > sizeof(sig) || !decodeHex(sigHex, sig, sigLen)) return false;
+
+    char signedText[OTA_VERSION_MAX + OTA_URL_MAX + 80];
+    int n = snprintf(signedText, sizeof(signedText), "%s|%s|%lu|", m.version, m.url, (unsigned long)m.size);
+    for (uint8_t i = 0; i < sizeof(m.sha256); i++) {
+        n += snprintf(signedText + n, sizeof(signedText) - n, "%02x", m.sha256[i]);
+    }
+    uint8_t digest[32];
+    mbedtls_sha256_context sha;
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_starts_ret(&sha, 0);
+    mbedtls_sha256_update_ret(&sha, (const unsigned char*)signedText, n);
+    mbedtls_sha256_finish_ret(&sha, digest);
+    mbedtls_sha256_free(&sha);
+
+    mbedtls_ecdsa_context ecdsa;
+    mbedtls_ecdsa_init(&ecdsa);
+    bool ok = mbedtls_ecp_group_load(&ecdsa.grp, MBEDTLS_ECP_DP_SECP256R1) == 0 &&
+              mbedtls_ecp_point_read_binary(&ecdsa.grp, &ecdsa.Q, pub, sizeof(pub)) == 0 &&
+              mbedtls_ecdsa_read_signature(&ecdsa, digest, sizeof(digest), sig, sigLen) == 0;
+    mbedtls_ecdsa_free(&ecdsa);
+    return ok;
+}
+
+bool parseManifestDoc(JsonDocument& doc, const char* json, size_t len, OtaManifest& out) {
+    if (deserializeJson(doc, json, len)) return false;
+    const char* version = doc["v"] | "";
+    const char* url = doc["url"] | "";
+    const char* hash = doc["sha256"] | "";
+    const char* sig = doc["sig"] | "";
+    uint32_t size = doc["size"] | 0;
+    OtaManifest m = {};
+    if (!version[0] || strlen(version) >= sizeof(m.version)) return false;
+    if (strlen(url) >= sizeof(m.url) || strncmp(url, "https://", 8) != 0) return false;
+    if (size == 0 || !decodeHex(hash, m.sha256, sizeof(m.sha256))) return false;
+    strcpy(m.version, version);
+    strcpy(m.url, url);
+    m.size = size;
+
+    if (!verifyManifestSignature(m, sig)) {
+        Serial.printf("[OTA] ✗ Manifiesto de %s sin firma válida - descartado\n", version);
+        return false;
+    }
+    out = m;
+    return true;
+}
+
+} // namespace
+
+bool parseOtaManifest(const char* body, OtaManifest& out, JsonArena* arena) {
+    // La respuesta del módem trae cabeceras AT alrededor del JSON
+    const char* start = strchr(body, '{');
+    const char* end = strrchr(body, '}');
+    if (!start || !end || end <= start) return false;
+
+    if (arena) {
+        JsonDocument doc(arena);
+        return parseManifestDoc(doc, start, end - start + 1, out);
+    }
+    JsonDocument doc;
+    return parseManifestDoc(doc, start, end - start + 1, out);
+}
+
+// ===== DESCARGA =====
+bool OtaUpdater::begin(const OtaManifest& m) {
+    abort();
+    partition = esp_ota_get_next_update_partition(nullptr);
+    if (!partition) {
+        Serial.println("[OTA] Sin partición OTA libre");
+        return false;
+    }
+    if (m.size > partition->size) {
+        Serial.printf("[OTA] Imagen de %lu bytes no entra en %s (%lu)\n",
+            (unsigned long)m.size, partition->label, (unsigned long)partition->size);
+        return false;
+    }
+    // Borrado por sector a medida que se escribe: sin una pausa larga antes
+    // del primer rango que bloquee la tarea del módem
+    esp_err_t err = esp_ota_begin(partition, OTA_WITH_SEQUENTIAL_WRITES, &handle);
+    if (err != ESP_OK) {
+        Serial.printf("[OTA] esp_ota_begin: %s\n", esp_err_to_name(err));
+        return false;
+    }
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_starts_ret(&sha, 0);
+    manifest = m;
+    written = 0;
+    active = true;
+    startMs = millis();
+    Serial.printf("[OTA] Descargando %s (%lu bytes) en %s\n", m.version, (unsigned long)m.size, partition->label);
+    return true;
+}
+
+bool OtaUpdater::write(const uint8_t* data, size_t len) {
+    if (!active || written + len > manifest.size) return false;
+    esp_err_t err = esp_ota_write(handle, data, len);
+    if (err != ESP_OK) {
+        // El primer trozo lleva la cabecera: un error aquí es casi siempre una URL que no es la imagen
+        Serial.printf("[OTA] esp_ota_write en %lu: %s\n", (unsigned long)written, esp_err_to_name(err));
+        abort();
+        return false;
+    }
+    mbedtls_sha256_update_ret(&sha, data, len);
+    written += len;
+    return true;
+}
+
+bool OtaUpdater::finish() {
+    if (!isComplete()) return false;
+    uint8_t digest[32];
+    mbedtls_sha256_finish_ret(&sha, digest);
+    mbedtls_sha256_free(&sha);
+    active = false;
+    if (memcmp(digest, manifest.sha256, sizeof(digest)) != 0) {
+        Serial.println("[OTA] ✗ SHA-256 no coincide con el manifiesto - imagen descartada");
+        esp_ota_abort(handle);
+        reject(manifest.version);
+        return false;
+    }
+    esp_err_t err = esp_ota_end(handle);
+    if (err != ESP_OK) {
+        Serial.printf("[OTA] ✗ Imagen inválida: %s\n", esp_err_to_name(err));
+        reject(manifest.version);
+        return false;
+    }
+    err = esp_ota_set_boot_partition(partition);
+    if (err != ESP_OK) {
+        Serial.printf("[OTA] ✗ esp_ota_set_boot_partition: %s\n", esp_err_to_name(err));
+        return false;
+    }
+
+    Preferences prefs;
+    prefs.begin(OTA_NVS_NS, false);
+    prefs.putBool("trial", true);
+    prefs.putUChar("boots", 0);
+    prefs.putString("part", partition->label);
+    prefs.putString("ver", manifest.version);
+    prefs.end();
+    Serial.printf("[OTA] ✓ %s verificada en %lu s - arranca en %s\n",
+        manifest.version, (unsigned long)((millis() - startMs) / 1000), partition->label);
+    return true;
+}
+
+void OtaUpdater::abort() {
+    if (!active) return;
+    esp_ota_abort(handle);
+    mbedtls_sha256_free(&sha);
+    active = false;
+    Serial.printf("[OTA] Descarga descartada en %lu/%lu bytes\n", (unsigned long)written, (unsigned long)manifest.size);
+    written = 0;
+}
+
+bool OtaUpdater::matches(const OtaManifest& m) const {
+    return manifest.size == m.size && strcmp(manifest.version, m.version) == 0 &&
+           memcmp(manifest.sha256, m.sha256, sizeof(m.sha256)) == 0;
+}
+
+void OtaUpdater::print(uint32_t nowMs) const {
+    const esp_partition_t* running = esp_ota_get_running_partition();
+    Serial.printf("[OTA] Corriendo en %s%s\n", running ? running->label : "?", trial ? " (en prueba)" : "");
+    if (!active) {
+        Serial.println("[OTA] Sin descarga en curso");
+        return;
+    }
+    uint32_t secs = (nowMs - startMs) / 1000;
+    Serial.printf("[OTA] %s: %lu/%lu bytes (%lu%%) en %lu s, %lu B/s\n", manifest.version,
+        (unsigned long)written, (unsigned long)manifest.size, (unsigned long)((uint64_t)written * 100 / manifest.size),
+        (unsigned long)secs, secs > 0 ? (unsigned long)(written / secs) : 0UL);
+}
+
+// ===== PERÍODO DE PRUEBA =====
+void OtaUpdater::bootCheck() {
+    Preferences prefs;
+    prefs.begin(OTA_NVS_NS, false);
+    trial = prefs.getBool("trial", false);
+    if (!trial) {
+        prefs.end();
+        return;
+    }
+    // El bootloader (con rollback propio) pudo haber vuelto ya a la anterior
+    const esp_partition_t* running = esp_ota_get_running_partition();
+    String part = prefs.getString("part", "");
+    if (!running || part != running->label) {
+        prefs.end();
+        Serial.println("[OTA] La imagen en prueba ya no es la que corre - prueba cerrada");
+        clearTrial();
+        return;
+    }
+    uint8_t boots = prefs.getUChar("boots", 0);
+    if (esp_reset_reason() != ESP_RST_DEEPSLEEP) boots++;   // Despertar no es reinicio
+    prefs.putUChar("boots", boots);
+    String version = prefs.getString("ver", "?");
+    prefs.end();
+    Serial.printf("[OTA] Imagen %s en prueba: arranque %u de %u\n", version.c_str(), boots, OTA_TRIAL_BOOTS);
+    if (boots > OTA_TRIAL_BOOTS) rollback("reinicios sin confirmar");
+}
+
+void OtaUpdater::clearTrial() {
+    Preferences prefs;
+    prefs.begin(OTA_NVS_NS, false);
+    prefs.remove("trial");
+    prefs.remove("boots");
+    prefs.remove("part");
+    prefs.remove("ver");
+    prefs.end();
+    trial = false;
+}
+
+// Una sola versión rechazada: la siguiente publicación la reemplaza
+void OtaUpdater::reject(const char* version) {
+    Preferences prefs;
+    prefs.begin(OTA_NVS_NS, false);
+    prefs.putString("bad", version);
+    prefs.end();
+}
+
+bool OtaUpdater::isRejected(const char* version) {
+    Preferences prefs;
+    prefs.begin(OTA_NVS_NS, true);
+    String bad = prefs.getString("bad", "");
+    prefs.end();
+    return bad == version;
+}
+
+void OtaUpdater::confirm() {
+    if (!trial) return;
+    clearTrial();
+    esp_ota_mark_app_valid_cancel_rollback();   // Sin rollback en el bootloader no hace nada
+    Serial.println("[OTA] ✓ Imagen nueva confirmada");
+}
+
+void OtaUpdater::rollback(const char* reason, bool rejectVersion) {
+    Serial.printf("[OTA] ⚠️ Rollback: %s\n", reason);
+    Preferences prefs;
+    prefs.begin(OTA_NVS_NS, true);
+    String version = prefs.getString("ver", "");
+    prefs.end();
+    if (rejectVersion && version.length() > 0) reject(version.c_str());
+    clearTrial();
+    const esp_partition_t* running = esp_ota_get_running_partition();
+    esp_ota_img_states_t state;
+    if (running && esp_ota_get_state_partition(running, &state) == ESP_OK && state == ESP_OTA_IMG_PENDING_VERIFY) {
+        esp_ota_mark_app_invalid_rollback_and_reboot();   // Bootloader con rollback: no vuelve
+    }
+    const esp_partition_t* previous = esp_ota_get_next_update_partition(nullptr);
+    esp_app_desc_t desc;
+    if (!previous || esp_ota_get_partition_description(previous, &desc) != ESP_OK ||
+        esp_ota_set_boot_partition(previous) != ESP_OK) {
+        Serial.println("[OTA] Sin imagen anterior válida - se conserva la actual");
+        return;
+    }
+    Serial.printf("[OTA] Volviendo a %s (%s)\n", previous->label, desc.version);
+    delay(500);
+    esp_restart();
+}
@@ -0,0 +1,95 @@
+#include "PowerManager.h"
+#include <esp_sleep.h>
+#include <driver/uart.h>
+
+void PowerManager::begin(int modemUart) {
+    startMs = millis();
+
+    // Fuentes de wake de light sleep: los pines de botón ya quedaron con
+    // gpio_wakeup_enable() en ButtonInput; el RX del módem por UART
+    esp_sleep_enable_gpio_wakeup();
+    uart_set_wakeup_threshold((uart_port_t)modemUart, PM_UART_WAKE_EDGES);
+    esp_sleep_enable_uart_wakeup(modemUart);
+    // Consola (UART0): los comandos seriales despiertan, aunque pierden sus primeros caracteres
+    uart_set_wakeup_threshold((uart_port_t)0, PM_UART_WAKE_EDGES);
+    esp_sleep_enable_uart_wakeup(0);
+
+    esp_pm_config_esp32_t cfg;
+    cfg.max_freq_mhz = PM_MAX_FREQ_MHZ;
+    cfg.min_freq_mhz = PM_MIN_FREQ_MHZ;
+    cfg.light_sleep_enable = true;
+    esp_err_t err = esp_pm_configure(&cfg);
+    if (err == ESP_OK &&
+        esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "loop_cpu", &cpuLock) == ESP_OK &&
+        esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "loop_busy", &sleepLock) == ESP_OK) {
+        esp_pm_lock_acquire(cpuLock);
+        esp_pm_lock_acquire(sleepLock);
+        pmMode = Mode::AUTO;
+        Serial.printf("[PM] DFS %d/%d MHz + light sleep automático\n", PM_MAX_FREQ_MHZ, PM_MIN_FREQ_MHZ);
+    } else {
+        pmMode = Mode::MANUAL;
+        Serial.printf("[PM] esp_pm no disponible (%s) - light sleep manual en la espera del loop\n",
+            esp_err_to_name(err));
+    }
+}
+
+void PowerManager::idle(uint32_t ms, bool allowSleep) {
+    // Trabajo ya pendiente de otra tarea: no esperar
+    if (wakeGroup && (xEventGroupGetBits(wakeGroup) & wakeBits)) return;
+
+    if (pmMode == Mode::AUTO) {
+        esp_pm_lock_release(sleepLock);
+        esp_pm_lock_release(cpuLock);
+        uint32_t t0 = millis();
+        wait(ms);   // Tarea bloqueada: el idle task entra en light sleep si nada más corre
+        esp_pm_lock_acquire(cpuLock);
+        esp_pm_lock_acquire(sleepLock);
+        idleMsTotal += millis() - t0;
+        return;
+    }
+
+    if (pmMode == Mode::MANUAL && allowSleep) {
+        Serial.flush();   // La UART de consola no transmite en light sleep
+        uint32_t t0 = millis();
+        esp_sleep_enable_timer_wakeup((uint64_t)ms * 1000ULL);
+        esp_light_sleep_start();
+        uint32_t slept = millis() - t0;
+        sleptMsTotal += slept;
+        idleMsTotal += slept;
+        wakeups++;
+        if (slept < ms && esp_sleep_get_wakeup_cause() != ESP_SLEEP_WAKEUP_TIMER) return;  // Botón o módem: atender ya
+        if (slept < ms) wait(ms - slept);
+        return;
+    }
+
+    uint32_t t0 = millis();
+    wait(ms);
+    idleMsTotal += millis() - t0;
+}
+
+void PowerManager::wait(uint32_t ms) {
+    if (wakeGroup) {
+        xEventGroupWaitBits(wakeGroup, wakeBits, pdFALSE, pdFALSE, pdMS_TO_TICKS(ms));
+    } else {
+        delay(ms);
+    }
+}
+
+void PowerManager::print(uint32_t pressLastMs, uint32_t pressMaxMs) const {
+    uint32_t total = millis() - startMs;
+    if (total == 0) total = 1;
+    uint32_t busy = total > idleMsTotal ? total - idleMsTotal : 0;
+    // AUTO: el sistema duerme en las ventanas de espera salvo que otra tarea corra
+    uint32_t sleep = pmMode == Mode::AUTO ? idleMsTotal : sleptMsTotal;
+    uint32_t awakeIdle = idleMsTotal > sleep ? idleMsTotal - sleep : 0;
+
+    float avg = (busy * PM_MA_ACTIVE + awakeIdle * PM_MA_IDLE + sleep * PM_MA_LIGHT_SLEEP) / total;
+    const char* modeName = pmMode == Mode::AUTO ? "auto (esp_pm)" : pmMode == Mode::MANUAL ? "manual" : "sin PM";
+
+    Serial.printf("[PM] Modo: %s | %lu s medidos | %lu wakes manuales\n", modeName, (unsigned long)(total / 1000), (unsigned long)wakeups);
+    Serial.printf("  %-22s %7lu s %5.1f%%  ~%.1f mA\n", "Activo (240 MHz)", (unsigned long)(busy / 1000), busy * 100.0f / total, PM_MA_ACTIVE);
+    Serial.printf("  %-22s %7lu s %5.1f%%  ~%.1f mA\n", "Espera (80 MHz)", (unsigned long)(awakeIdle / 1000), awakeIdle * 100.0f / total, PM_MA_IDLE);
+    Serial.printf("  %-22s %7lu s %5.1f%%  ~%.1f mA\n", "Light sleep", (unsigned long)(sleep / 1000), sleep * 100.0f / total, PM_MA_LIGHT_SLEEP);
+    Serial.printf("  Promedio ESP32 estimado: %.1f mA (sin PM: %.1f mA)\n", avg, PM_MA_ACTIVE);
+    Serial.printf("  Botón: flanco -> PRESS última %lu ms, máx %lu ms\n", (unsigned long)pressLastMs, (unsigned long)pressMaxMs);
+}
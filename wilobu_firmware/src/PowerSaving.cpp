@@ -0,0 +1,155 @@
+#include "PowerSaving.h"
+
+namespace {
+
+struct TimerUnit {
+    uint8_t code;             // Bits 8-6
+    uint32_t sec;
+};
+
+// GPRS Timer 3 (T3412 extendido), de la unidad más fina a la más gruesa
+const TimerUnit kT3412Units[] = {
+    {3, 2}, {4, 30}, {5, 60}, {0, 600}, {1, 3600}, {2, 36000}, {6, 1152000},
+};
+// GPRS Timer 2 (T3324)
+const TimerUnit kT3324Units[] = {
+    {0, 2}, {1, 60}, {2, 360},
+};
+
+// Ciclos eDRX para WB-S1: índice = valor de 4 bits
+const float kEdrxCycles[16] = {
+    5.12f, 10.24f, 20.48f, 40.96f, 61.44f, 81.92f, 102.4f, 122.88f,
+    143.36f, 163.84f, 327.68f, 655.36f, 1310.72f, 2621.44f, 5242.88f, 10485.76f,
+};
+
+String toBits(uint8_t value, uint8_t width) {
+    String s;
+    for (int8_t i = width - 1; i >= 0; i--) s += (value >> i) & 1 ? '1' : '0';
+    return s;
+}
+
+long parseBits(const String& bits) {
+    if (bits.length() == 0) return -1;
+    long v = 0;
+    for (size_t i = 0; i < bits.length(); i++) {
+        char c = bits[i];
+        if (c != '0' && c != '1') return -1;
+        v = (v << 1) | (c - '0');
+    }
+    return v;
+}
+
+String encodeTimer(const TimerUnit* units, size_t n, uint32_t sec, uint32_t* actualSec) {
+    for (size_t i = 0; i < n; i++) {
+        uint32_t value = (sec + units[i].sec - 1) / units[i].sec;
+        if (value <= 31) {
+            if (value == 0) value = 1;
+            if (actualSec) *actualSec = value * units[i].sec;
+            return toBits((units[i].code << 5) | value, 8);
+        }
+    }
+    // Fuera de rango: el máximo de la unidad más gruesa
+    if (actualSec) *actualSec = 31 * units[n - 1].sec;
+    return toBits((units[n - 1].code << 5) | 31, 8);
+}
+
+long decodeTimer(const TimerUnit* units, size_t n, const String& bits) {
+    long raw = parseBits(bits);
+    if (raw < 0 || bits.length() != 8) return -1;
+    uint8_t code = (raw >> 5) & 0x07;
+    for (size_t i = 0; i < n; i++) {
+        if (units[i].code == code) return (long)((raw & 0x1F) * units[i].sec);
+    }
+    return -1;  // 111 = desactivado
+}
+
+// Cadenas entre comillas de una respuesta AT, en orden
+uint8_t quotedFields(const String& resp, String* out, uint8_t max) {
+    uint8_t count = 0;
+    int pos = 0;
+    while (count < max) {
+        int open = resp.indexOf('"', pos);
+        if (open == -1) break;
+        int close = resp.indexOf('"', open + 1);
+        if (close == -1) break;
+        out[count++] = resp.substring(open + 1, close);
+        pos = close + 1;
+    }
+    return count;
+}
+
+} // namespace
+
+PowerSavingRequest PowerSaving::forHeartbeat(uint32_t heartbeatMs, bool psm) {
+    PowerSavingRequest req;
+    req.psm = psm;
+    req.tauSec = (heartbeatMs / 1000) * PSM_TAU_FACTOR;
+    req.activeSec = PSM_ACTIVE_TIME_S;
+    req.edrxMaxSec = (heartbeatMs / 1000) / EDRX_CYCLE_DIVISOR;
+    return req;
+}
+
+String PowerSaving::encodeT3412(uint32_t sec, uint32_t* actualSec) {
+    return encodeTimer(kT3412Units, sizeof(kT3412Units) / sizeof(kT3412Units[0]), sec, actualSec);
+}
+
+String PowerSaving::encodeT3324(uint32_t sec, uint32_t* actualSec) {
+    return encodeTimer(kT3324Units, sizeof(kT3324Units) / sizeof(kT3324Units[0]), sec, actualSec);
+}
+
+String PowerSaving::encodeEdrx(uint32_t maxSec, float* actualSec) {
+    uint8_t best = 0;
+    for (uint8_t i = 0; i < 16; i++) {
+        if (kEdrxCycles[i] <= (float)maxSec) best = i;
+    }
+    if (actualSec) *actualSec = kEdrxCycles[best];
+    return toBits(best, 4);
+}
+
+long PowerSaving::decodeT3412(const String& bits) {
+    return decodeTimer(kT3412Units, sizeof(kT3412Units) / sizeof(kT3412Units[0]), bits);
+}
+
+long PowerSaving::decodeT3324(const String& bits) {
+    return decodeTimer(kT3324Units, sizeof(kT3324Units) / sizeof(kT3324Units[0]), bits);
+}
+
+float PowerSaving::decodeEdrx(const String& bits) {
+    long v = parseBits(bits);
+    return (v < 0 || v > 15) ? -1.0f : kEdrxCycles[v];
+}
+
+float PowerSaving::decodePtw(const String& bits) {
+    long v = parseBits(bits);
+    return (v < 0 || v > 15) ? -1.0f : (v + 1) * 1.28f;   // WB-S1
+}
+
+void PowerSaving::logNegotiated(const String& ceregResp, const String& edrxResp) {
+    // +CEREG: 4,<stat>,"<tac>","<ci>",<AcT>,,,"<active-time>","<periodic-tau>"
+    String f[4];
+    if (quotedFields(ceregResp, f, 4) == 4) {
+        long active = decodeT3324(f[2]);
+        long tau = decodeT3412(f[3]);
+        if (active >= 0 && tau >= 0) {
+            Serial.printf("[PSM] Red otorgó: TAU %ld s, active time %ld s\n", tau, active);
+        } else {
+            Serial.println("[PSM] Red no otorgó PSM");
+        }
+    } else {
+        Serial.println("[PSM] Sin timers PSM en +CEREG (red sin PSM)");
+    }
+
+    // +CEDRXRDP: <AcT>,"<pedido>","<otorgado>","<PTW>"
+    String e[3];
+    if (edrxResp.indexOf("+CEDRXRDP") != -1 && quotedFields(edrxResp, e, 3) == 3) {
+        float cycle = decodeEdrx(e[1]);
+        if (cycle > 0) {
+            Serial.printf("[EDRX] Red otorgó: ciclo %.2f s, PTW %.2f s (pedido %.2f s)\n",
+                cycle, decodePtw(e[2]), decodeEdrx(e[0]));
+        } else {
+            Serial.println("[EDRX] Red no otorgó eDRX");
+        }
+    } else {
+        Serial.println("[EDRX] Red no otorgó eDRX");
+    }
+}
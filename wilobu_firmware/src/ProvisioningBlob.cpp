@@ -0,0 +1,112 @@
+#include "ProvisioningBlob.h"
+#include "DeviceConfig.h"
+
+namespace {
+
+// Copia un valor TLV a un buffer C; false si no entra o trae bytes no imprimibles
+bool copyField(char* dst, size_t cap, const uint8_t* value, uint8_t len) {
+    if (len >= cap) return false;
+    for (uint8_t i = 0; i < len; i++) {
+        if (value[i] < 0x20 || value[i] > 0x7E) return false;
+    }
+    memcpy(dst, value, len);
+    dst[len] = '\0';
+    return true;
+}
+
+} // namespace
+
+// ===== DECODIFICACIÓN =====
+ProvError parseProvisioningBlob(const uint8_t* buf, size_t len, ProvisioningRequest& out) {
+    memset(&out, 0, sizeof(out));
+    if (len < PROV_BLOB_MIN) return ProvError::TOO_SHORT;
+    if (len > PROV_BLOB_MAX) return ProvError::TOO_LONG;
+    if (buf[0] != PROV_BLOB_MAGIC_0 || buf[1] != PROV_BLOB_MAGIC_1) return ProvError::BAD_MAGIC;
+    if (buf[2] != PROV_BLOB_VERSION) return ProvError::BAD_VERSION;
+
+    size_t body = len - 4;
+    uint32_t crc = (uint32_t)buf[body] | ((uint32_t)buf[body + 1] << 8) |
+                   ((uint32_t)buf[body + 2] << 16) | ((uint32_t)buf[body + 3] << 24);
+    if (crc != DeviceConfig::crc32(buf, body)) return ProvError::BAD_CRC;
+
+    bool hasOwner = false;
+    size_t pos = PROV_BLOB_HEADER;
+    while (pos < body) {
+        if (pos + 2 > body) return ProvError::BAD_LENGTH;
+        uint8_t tag = buf[pos];
+        uint8_t fieldLen = buf[pos + 1];
+        const uint8_t* value = buf + pos + 2;
+        if (pos + 2 + fieldLen > body) return ProvError::BAD_LENGTH;
+        pos += 2 + fieldLen;
+
+        switch (tag) {
+            case PROV_TAG_OWNER:
+                if (fieldLen < PROV_OWNER_MIN) return ProvError::BAD_FIELD;
+                if (!copyField(out.ownerUid, sizeof(out.ownerUid), value, fieldLen)) return ProvError::BAD_FIELD;
+                hasOwner = true;
+                break;
+            case PROV_TAG_APN:
+                if (!copyField(out.apn, sizeof(out.apn), value, fieldLen)) return ProvError::BAD_FIELD;
+                out.hasApn = true;
+                break;
+            case PROV_TAG_PROFILE:
+                if (fieldLen != 1) return ProvError::BAD_FIELD;
+                out.profile = value[0];
+                out.hasProfile = true;
+                break;
+            case PROV_TAG_SMS_GW:
+                if (!copyField(out.smsGateway, sizeof(out.smsGateway), value, fieldLen)) return ProvError::BAD_FIELD;
+                out.hasSmsGateway = true;
+                break;
+            case PROV_TAG_ENDPOINT:
+                if (!copyField(out.endpoint, sizeof(out.endpoint), value, fieldLen)) return ProvError::BAD_FIELD;
+                // Solo HTTPS y sin barra final: las rutas se agregan con "/"
+                if (strncmp(out.endpoint, "https://", 8) != 0 || fieldLen <= 8) return ProvError::BAD_FIELD;
+                if (out.endpoint[fieldLen - 1] == '/') out.endpoint[fieldLen - 1] = '\0';
+                out.hasEndpoint = true;
+                break;
+            default:
+                break;  // Tipo de una versión más nueva de la app
+        }
+    }
+    return hasOwner ? ProvError::OK : ProvError::NO_OWNER;
+}
+
+void encodeProvisioningStatus(ProvStage stage, ProvError code, uint16_t value, uint8_t out[PROV_STATUS_LEN]) {
+    out[0] = (uint8_t)stage;
+    out[1] = (uint8_t)code;
+    out[2] = value & 0xFF;
+    out[3] = value >> 8;
+}
+
+const char* provErrorName(ProvError e) {
+    switch (e) {
+        case ProvError::OK: return "ok";
+        case ProvError::TOO_SHORT: return "corto";
+        case ProvError::TOO_LONG: return "largo";
+        case ProvError::BAD_MAGIC: return "magic";
+        case ProvError::BAD_VERSION: return "versión";
+        case ProvError::BAD_LENGTH: return "TLV fuera del blob";
+        case ProvError::BAD_CRC: return "CRC";
+        case ProvError::BAD_FIELD: return "campo inválido";
+        case ProvError::NO_OWNER: return "sin owner";
+        case ProvError::MODEM: return "módem";
+        case ProvError::TIMEOUT: return "timeout";
+        default: return "?";
+    }
+}
+
+const char* provStageName(ProvStage s) {
+    switch (s) {
+        case ProvStage::READY: return "READY";
+        case ProvStage::RECEIVED: return "RECEIVED";
+        case ProvStage::STORED: return "STORED";
+        case ProvStage::MODEM_UP: return "MODEM_UP";
+        case ProvStage::REGISTERED: return "REGISTERED";
+        case ProvStage::LINKED: return "LINKED";
+        case ProvStage::BACKEND_RETRY: return "BACKEND_RETRY";
+        case ProvStage::BACKEND_OK: return "BACKEND_OK";
+        case ProvStage::FAILED: return "FAILED";
+        default: return "?";
+    }
+}
@@ -0,0 +1,97 @@
+#include "RadioScheduler.h"
+
+void RadioScheduler::begin(uint32_t nowMs) {
+    cycleStartMs = nowMs;
+    lastMarkMs = nowMs;
+    cellularMs = gnssMs = overlapMs = 0;
+    transactions = 0;
+    deferring = false;
+}
+
+// Suma el tramo desde la última marca al estado vigente
+void RadioScheduler::accumulate(uint32_t nowMs) {
+    uint32_t dt = nowMs - lastMarkMs;
+    if (cellularActive) cellularMs += dt;
+    if (gnssActive) gnssMs += dt;
+    if (cellularActive && gnssActive) overlapMs += dt;
+    lastMarkMs = nowMs;
+}
+
+// ===== ACTIVIDAD REAL =====
+void RadioScheduler::cellularBegin(uint32_t nowMs) {
+    accumulate(nowMs);
+    cellularActive = true;
+    transactions++;
+}
+
+void RadioScheduler::cellularEnd(uint32_t nowMs) {
+    accumulate(nowMs);
+    cellularActive = false;
+}
+
+void RadioScheduler::gnssPower(bool on, uint32_t nowMs) {
+    if (on == gnssActive) return;
+    accumulate(nowMs);
+    gnssActive = on;
+    if (on) {
+        gnssOnAtMs = nowMs;
+        awaitingFix = true;
+    } else {
+        awaitingFix = false;
+    }
+}
+
+void RadioScheduler::onFix(uint32_t nowMs) {
+    if (!awaitingFix) return;
+    awaitingFix = false;
+    // Media móvil 3/4 - 1/4: estable frente a un fix anómalo
+    uint32_t measured = nowMs - gnssOnAtMs;
+    ttffMs = (ttffMs * 3 + measured) / 4;
+}
+
+// ===== PLANIFICACIÓN =====
+bool RadioScheduler::shouldWarmGnssForHeartbeat(uint32_t msToHeartbeat, uint32_t fixAgeMs) const {
+    return msUntilGnssWarm(msToHeartbeat, fixAgeMs) == 0;
+}
+
+uint32_t RadioScheduler::msUntilGnssWarm(uint32_t msToHeartbeat, uint32_t fixAgeMs) const {
+    // Ventana abierta a TTFF + margen del heartbeat, y solo con el fix ya viejo
+    uint32_t lead = ttffMs + RADIO_GNSS_LEAD_MARGIN_MS;
+    uint32_t untilWindow = msToHeartbeat > lead ? msToHeartbeat - lead : 0;
+    uint32_t untilStale = fixAgeMs > RADIO_FIX_FRESH_MS ? 0 : RADIO_FIX_FRESH_MS - fixAgeMs + 1;
+    return untilWindow > untilStale ? untilWindow : untilStale;
+}
+
+bool RadioScheduler::heartbeatMayStart(uint32_t nowMs, bool gnssAcquiring) {
+    if (!gnssAcquiring) {
+        deferring = false;
+        return true;
+    }
+    if (!deferring) {
+        deferring = true;
+        deferStartMs = nowMs;
+        Serial.println("[RADIO] Heartbeat en espera: adquisición GNSS en curso");
+    }
+    if ((nowMs - deferStartMs) >= RADIO_HEARTBEAT_GRACE_MS) {
+        Serial.println("[RADIO] Gracia agotada - Heartbeat sin esperar fix");
+        deferring = false;
+        return true;
+    }
+    return false;
+}
+
+// ===== REPORTE =====
+void RadioScheduler::printCycle(uint32_t nowMs) {
+    accumulate(nowMs);
+    uint32_t cycle = nowMs - cycleStartMs;
+    Serial.printf("[RADIO] Ciclo %lus: LTE %lu ms (%u tx) | GNSS %lu ms | solape %lu ms | TTFF est %lu ms\n",
+        (unsigned long)(cycle / 1000), (unsigned long)cellularMs, transactions, (unsigned long)gnssMs,
+        (unsigned long)overlapMs, (unsigned long)ttffMs);
+}
+
+void RadioScheduler::closeCycle(uint32_t nowMs) {
+    printCycle(nowMs);
+    cycleStartMs = nowMs;
+    cellularMs = gnssMs = overlapMs = 0;
+    transactions = 0;
+}
@@ -0,0 +1,42 @@
+#include "SosFastPath.h"
+#include "JsonArena.h"
+#include <ArduinoJson.h>
+
+static const char* const kSosStatus[] = {"sos_general", "sos_medica", "sos_seguridad"};
+static const char kSeqKey[] = ",\"sosEpoch\":";
+
+static uint8_t templateArenaBuf[512];
+static JsonArena templateArena("sos", templateArenaBuf, sizeof(templateArenaBuf));
+
+// ===== PLANTILLAS =====
+void SosPayloadTemplates::build(const char* deviceId, const char* ownerUid) {
+    built = false;
+    for (uint8_t i = 0; i < 3; i++) {
+        // Mismo JSON que sendSOSAlert() sin ubicación; ArduinoJson se encarga del escapado
+        JsonDocument doc(&templateArena);
+        doc["deviceId"] = deviceId;
+        doc["ownerUid"] = ownerUid;
+        doc["status"] = kSosStatus[i];
+        doc["lastLocation"] = nullptr;
+        // Sin la "}" final y con lugar para la clave de época
+        size_t len = measureJson(doc);
+        if (doc.overflowed() || len - 1 + sizeof(kSeqKey) > SOS_PREFIX_MAX) {
+            Serial.println("[SLOT] Error: plantilla SOS no entra en el buffer");
+            return;
+        }
+        serializeJson(doc, prefix[i], SOS_PREFIX_MAX);
+        memcpy(prefix[i] + len - 1, kSeqKey, sizeof(kSeqKey));
+        prefixLen[i] = len - 1 + sizeof(kSeqKey) - 1;
+    }
+    built = true;
+}
+
+size_t SosPayloadTemplates::body(uint8_t typeCode, uint32_t epoch, uint32_t seq, char* out, size_t outSize) const {
+    uint8_t t = typeCode < 3 ? typeCode : 0;
+    if (prefixLen[t] >= outSize) return 0;
+    memcpy(out, prefix[t], prefixLen[t]);
+    int n = snprintf(out + prefixLen[t], outSize - prefixLen[t], "%lu,\"sosSeq\":%lu}",
+        (unsigned long)epoch, (unsigned long)seq);
+    if (n < 0 || (size_t)n >= outSize - prefixLen[t]) return 0;
+    return prefixLen[t] + n;
+}
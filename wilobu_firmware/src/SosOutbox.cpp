@@ -0,0 +1,240 @@
+#include "SosOutbox.h"
+#include <Preferences.h>
+#include <esp_attr.h>
+#include <esp_system.h>
+
+// Copia en memoria RTC: sobrevive al deep sleep y a reinicios por software
+static RTC_DATA_ATTR SosOutboxImage rtcImage;
+
+static const char* const kTypeNames[] = {"general", "medica", "seguridad"};
+
+// ===== PERSISTENCIA =====
+static bool validImage(const SosOutboxImage& img) {
+    return img.magic == SOS_OUTBOX_MAGIC && img.epoch != 0 && img.count <= SOS_OUTBOX_MAX;
+}
+
+static uint32_t newEpoch() {
+    uint32_t e;
+    do { e = esp_random(); } while (e == 0);
+    return e;
+}
+
+void SosOutbox::begin(bool persistentParam) {
+    persistent = persistentParam;
+    memset(&image, 0, sizeof(image));
+    image.magic = SOS_OUTBOX_MAGIC;
+    image.epoch = newEpoch();
+    image.nextSeq = 1;
+
+    if (persistent) {
+        SosOutboxImage flash;
+        Preferences prefs;
+        prefs.begin(SOS_OUTBOX_NVS_NS, true);
+        size_t len = prefs.isKey("outbox") ? prefs.getBytes("outbox", &flash, sizeof(flash)) : 0;
+        prefs.end();
+        bool flashOk = (len == sizeof(flash)) && validImage(flash);
+
+        // RTC es la copia más reciente salvo tras un corte de energía
+        // (o si NVS se borró y la época cambió: manda la de NVS)
+        if (validImage(rtcImage) && (!flashOk || (rtcImage.epoch == flash.epoch && rtcImage.nextSeq >= flash.nextSeq))) {
+            image = rtcImage;
+            Serial.printf("[OUTBOX] Restaurada desde RTC: %u pendientes (época %08lx, seq %lu)\n",
+                image.count, (unsigned long)image.epoch, (unsigned long)image.nextSeq);
+        } else if (flashOk) {
+            image = flash;
+            Serial.printf("[OUTBOX] Restaurada desde NVS: %u pendientes (época %08lx, seq %lu)\n",
+                image.count, (unsigned long)image.epoch, (unsigned long)image.nextSeq);
+        } else {
+            Serial.printf("[OUTBOX] Secuencia nueva: época %08lx\n", (unsigned long)image.epoch);
+        }
+    }
+    for (uint8_t i = 0; i < SOS_OUTBOX_MAX; i++) nextTryMs[i] = enqueuedMs[i] = 0;
+    memset(history, 0, sizeof(history));
+    historyNext = 0;
+    if (persistent) rtcImage = image;
+}
+
+void SosOutbox::restore(const SosOutboxImage& img) {
+    if (!validImage(img)) return;
+    image = img;
+    for (uint8_t i = 0; i < SOS_OUTBOX_MAX; i++) nextTryMs[i] = enqueuedMs[i] = 0;
+}
+
+void SosOutbox::persist() {
+    if (!persistent) return;
+    rtcImage = image;
+    Preferences prefs;
+    prefs.begin(SOS_OUTBOX_NVS_NS, false);
+    prefs.putBytes("outbox", &image, sizeof(image));
+    prefs.end();
+}
+
+// ===== COLA =====
+uint32_t SosOutbox::enqueue(const char* sosType, const GPSLocation& loc, uint32_t nowMs, bool withSms) {
+    if (image.count == SOS_OUTBOX_MAX) {
+        Serial.printf("[OUTBOX] ⚠️ Bandeja llena - se descarta seq %lu\n", (unsigned long)image.items[0].seq);
+        removeAt(0);
+    }
+    SosPending& p = image.items[image.count];
+    p.seq = image.nextSeq++;
+    p.type = typeCode(sosType);
+    p.attempts = 0;
+    p.hasFix = loc.isValid ? 1 : 0;
+    p.smsPending = withSms ? 1 : 0;
+    p.accuracyM = loc.isValid ? (uint16_t)min(loc.accuracy, 65535.0f) : 0;
+    p.latE6 = loc.isValid ? (int32_t)lroundf(loc.latitude * 1000000.0f) : 0;
+    p.lonE6 = loc.isValid ? (int32_t)lroundf(loc.longitude * 1000000.0f) : 0;
+    nextTryMs[image.count] = nowMs;
+    enqueuedMs[image.count] = nowMs;
+    image.count++;
+
+    // Persistir antes de intentar: un reinicio durante el POST no pierde la alerta
+    persist();
+    return p.seq;
+}
+
+const SosPending* SosOutbox::due(uint32_t nowMs) const {
+    for (uint8_t i = 0; i < image.count; i++) {
+        if ((int32_t)(nowMs - nextTryMs[i]) >= 0) return &image.items[i];
+    }
+    return nullptr;
+}
+
+uint32_t SosOutbox::msUntilDue(uint32_t nowMs) const {
+    uint32_t best = 0xFFFFFFFFUL;
+    for (uint8_t i = 0; i < image.count; i++) {
+        int32_t wait = (int32_t)(nextTryMs[i] - nowMs);
+        if (wait <= 0) return 0;
+        if ((uint32_t)wait < best) best = wait;
+    }
+    return best;
+}
+
+const SosPending* SosOutbox::find(uint32_t seq) const {
+    for (uint8_t i = 0; i < image.count; i++) {
+        if (image.items[i].seq == seq) return &image.items[i];
+    }
+    return nullptr;
+}
+
+void SosOutbox::onResult(uint32_t seq, bool delivered, uint32_t nowMs) {
+    for (uint8_t i = 0; i < image.count; i++) {
+        SosPending& p = image.items[i];
+        if (p.seq != seq) continue;
+        // Sin logs en pruebas (persistent=false)
+        if (delivered) {
+            if (persistent) Serial.printf("[OUTBOX] ✓ seq %lu entregada (%u intentos)\n", (unsigned long)seq, p.attempts + 1);
+            if (p.smsPending && persistent) Serial.printf("[OUTBOX] seq %lu: datos confirmó primero - SMS descartado\n", (unsigned long)seq);
+            recordPath(i, false, nowMs);
+            removeAt(i);
+        } else {
+            if (p.attempts < 255) p.attempts++;
+            nextTryMs[i] = nowMs + backoffMs(p.attempts);
+            if (persistent) Serial.printf("[OUTBOX] ✗ seq %lu falló (intento %u) - reintento en %lus\n",
+                (unsigned long)seq, p.attempts, (unsigned long)(backoffMs(p.attempts) / 1000));
+        }
+        persist();
+        return;
+    }
+}
+
+void SosOutbox::onSmsResult(uint32_t seq, bool sent, uint32_t doneMs) {
+    for (uint8_t i = 0; i < image.count; i++) {
+        SosPending& p = image.items[i];
+        if (p.seq != seq || !p.smsPending) continue;
+        if (sent) {
+            // SMS aceptado: sale del conjunto de reintentos; los datos siguen hasta su 2xx
+            p.smsPending = 0;
+            recordPath(i, true, doneMs);
+            persist();
+        }
+        return;
+    }
+}
+
+// Registra la primera entrega por camino y anuncia cuál ganó
+void SosOutbox::recordPath(uint8_t idx, bool sms, uint32_t atMs) {
+    uint32_t seq = image.items[idx].seq;
+    uint32_t elapsed = max(atMs - enqueuedMs[idx], (uint32_t)1);
+    SosDeliveryRecord* rec = nullptr;
+    for (uint8_t k = 0; k < SOS_DELIVERY_HISTORY; k++) {
+        if (history[k].seq == seq) rec = &history[k];
+    }
+    if (!rec) {
+        rec = &history[historyNext];
+        historyNext = (historyNext + 1) % SOS_DELIVERY_HISTORY;
+        rec->seq = seq;
+        rec->dataMs = rec->smsMs = 0;
+        if (persistent) Serial.printf("[OUTBOX] seq %lu: primera entrega por %s en %lu ms\n",
+            (unsigned long)seq, sms ? "SMS" : "datos", (unsigned long)elapsed);
+    }
+    if (sms) rec->smsMs = elapsed;
+    else rec->dataMs = elapsed;
+}
+
+void SosOutbox::removeAt(uint8_t idx) {
+    for (uint8_t i = idx; i + 1 < image.count; i++) {
+        image.items[i] = image.items[i + 1];
+        nextTryMs[i] = nextTryMs[i + 1];
+        enqueuedMs[i] = enqueuedMs[i + 1];
+    }
+    image.count--;
+}
+
+void SosOutbox::clear() {
+    image.count = 0;
+    persist();
+}
+
+// ===== AUXILIARES =====
+uint32_t SosOutbox::backoffMs(uint8_t attempts) {
+    if (attempts == 0) return 0;
+    uint32_t ms = SOS_RETRY_BASE_MS;
+    for (uint8_t i = 1; i < attempts && ms < SOS_RETRY_MAX_MS; i++) ms *= 2;
+    return min(ms, (uint32_t)SOS_RETRY_MAX_MS);
+}
+
+uint8_t SosOutbox::typeCode(const char* sosType) {
+    for (uint8_t i = 0; i < 3; i++) {
+        if (strcmp(sosType, kTypeNames[i]) == 0) return i;
+    }
+    return 0;
+}
+
+const char* SosOutbox::typeName(uint8_t code) {
+    return code < 3 ? kTypeNames[code] : kTypeNames[0];
+}
+
+GPSLocation SosOutbox::toLocation(const SosPending& p) {
+    GPSLocation loc = {0.0, 0.0, 999.0, 0, false};
+    if (p.hasFix) {
+        loc.latitude = p.latE6 / 1000000.0f;
+        loc.longitude = p.lonE6 / 1000000.0f;
+        loc.accuracy = p.accuracyM;
+        loc.isValid = true;
+    }
+    return loc;
+}
+
+void SosOutbox::print(uint32_t nowMs) const {
+    Serial.printf("[OUTBOX] %u pendientes, época %08lx, próxima seq %lu\n", image.count,
+        (unsigned long)image.epoch, (unsigned long)image.nextSeq);
+    for (uint8_t i = 0; i < image.count; i++) {
+        const SosPending& p = image.items[i];
+        int32_t wait = (int32_t)(nextTryMs[i] - nowMs);
+        Serial.printf("  seq %lu %s %s intentos=%u reintento en %lds%s\n", (unsigned long)p.seq,
+            typeName(p.type), p.hasFix ? "con fix" : "sin fix", p.attempts, wait > 0 ? (long)(wait / 1000) : 0L,
+            p.smsPending ? " (+SMS)" : "");
+    }
+}
+
+void SosOutbox::printDeliveries() const {
+    Serial.println("[OUTBOX] Tiempo hasta primera entrega por camino:");
+    for (uint8_t k = 0; k < SOS_DELIVERY_HISTORY; k++) {
+        const SosDeliveryRecord& r = history[(historyNext + k) % SOS_DELIVERY_HISTORY];
+        if (r.seq == 0) continue;
+        const char* winner = (r.smsMs && (!r.dataMs || r.smsMs < r.dataMs)) ? "SMS" : "datos";
+        Serial.printf("  seq %lu: datos %s%lu ms | SMS %s%lu ms -> gana %s\n", (unsigned long)r.seq,
+            r.dataMs ? "" : "(pendiente) ", (unsigned long)r.dataMs, r.smsMs ? "" : "(no) ", (unsigned long)r.smsMs, winner);
+    }
+}
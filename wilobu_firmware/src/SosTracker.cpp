@@ -0,0 +1,109 @@
+#include "SosTracker.h"
+
+void SosTracker::begin(const char* type, uint32_t nowMs) {
+    active = true;
+    sosType = type;
+    startMs = nowMs;
+    lastSampleMs = nowMs;      // El Disparo 2 ya llevó la primera posición
+    slowLink = false;
+    endReason = EndReason::NONE;
+    head = 0;
+    pending = 0;
+    sentTotal = 0;
+    droppedTotal = 0;
+    Serial.printf("[TRACK] Seguimiento SOS '%s' iniciado (cada %lus, máx %lu min)\n",
+        type, (unsigned long)(sampleIntervalMs() / 1000), (unsigned long)(SOS_TRACK_TIMEOUT_MS / 60000));
+}
+
+void SosTracker::stop(EndReason reason) {
+    if (!active) return;
+    active = false;
+    endReason = reason;
+    Serial.printf("[TRACK] Seguimiento terminado (%s): %u puntos enviados, %u descartados, %u sin enviar\n",
+        reasonName(reason), sentTotal, droppedTotal, pending);
+    pending = 0;
+}
+
+// ===== MUESTREO =====
+uint32_t SosTracker::sampleIntervalMs() const {
+    if (batteryMv != 0 && batteryMv < SOS_TRACK_LOW_BATT_MV) return SOS_TRACK_SAMPLE_MS * 2;
+    return SOS_TRACK_SAMPLE_MS;
+}
+
+void SosTracker::addPoint(const GPSLocation& fix, uint32_t nowMs) {
+    lastSampleMs = nowMs;
+    if (!fix.isValid) return;
+
+    // Cola llena: se pierde el punto más viejo, el más reciente es el que importa
+    if (pending == SOS_TRACK_BUFFER) {
+        head = (head + 1) % SOS_TRACK_BUFFER;
+        pending--;
+        droppedTotal++;
+    }
+    TrackPoint& p = points[(head + pending) % SOS_TRACK_BUFFER];
+    p.latE6 = (int32_t)lroundf(fix.latitude * 1000000.0f);
+    p.lonE6 = (int32_t)lroundf(fix.longitude * 1000000.0f);
+    p.accuracyM = fix.accuracy > 65535.0f ? 65535 : (uint16_t)fix.accuracy;
+    p.capturedMs = nowMs;
+    pending++;
+}
+
+// ===== ENVÍO =====
+uint8_t SosTracker::fillJson(JsonDocument& doc, uint32_t nowMs) const {
+    JsonArray arr = doc["sosTrack"].to<JsonArray>();
+    for (uint8_t i = 0; i < pending; i++) {
+        const TrackPoint& p = points[(head + i) % SOS_TRACK_BUFFER];
+        JsonArray pt = arr.add<JsonArray>();
+        pt.add(p.latE6);
+        pt.add(p.lonE6);
+        pt.add(p.accuracyM);
+        pt.add((nowMs - p.capturedMs) / 1000);
+    }
+    return pending;
+}
+
+void SosTracker::onUpload(bool ok, uint8_t sentPoints, uint32_t durationMs) {
+    if (!ok) {
+        // Fallo: conservar los puntos y esperar a juntar un lote antes de reintentar
+        slowLink = true;
+        return;
+    }
+    if (sentPoints > pending) sentPoints = pending;
+    head = (head + sentPoints) % SOS_TRACK_BUFFER;
+    pending -= sentPoints;
+    sentTotal += sentPoints;
+
+    bool wasSlow = slowLink;
+    slowLink = durationMs > SOS_TRACK_SLOW_LINK_MS;
+    if (slowLink != wasSlow) {
+        Serial.printf("[TRACK] Enlace %s (%lu ms) -> %u punto(s) por envío\n",
+            slowLink ? "lento" : "normal", (unsigned long)durationMs, batchTarget());
+    }
+}
+
+// ===== FIN DEL SEGUIMIENTO =====
+SosTracker::EndReason SosTracker::checkEnd(uint32_t nowMs) const {
+    if (!active) return EndReason::NONE;
+    if ((nowMs - startMs) >= SOS_TRACK_TIMEOUT_MS) return EndReason::TIMEOUT;
+    if (batteryMv != 0 && batteryMv < SOS_TRACK_MIN_BATT_MV) return EndReason::LOW_BATTERY;
+    return EndReason::NONE;
+}
+
+const char* SosTracker::reasonName(EndReason reason) {
+    switch (reason) {
+        case EndReason::CLEARED:     return "cerrada desde la app";
+        case EndReason::TIMEOUT:     return "timeout";
+        case EndReason::LOW_BATTERY: return "batería baja";
+        default:                     return "-";
+    }
+}
+
+void SosTracker::print(uint32_t nowMs) const {
+    if (!active) {
+        Serial.printf("[TRACK] Inactivo (último fin: %s)\n", reasonName(endReason));
+        return;
+    }
+    Serial.printf("[TRACK] '%s' activo %lus | cada %lus | pendientes %u | enviados %u | descartados %u | enlace %s | batería %u mV\n",
+        sosType.c_str(), (unsigned long)((nowMs - startMs) / 1000), (unsigned long)(sampleIntervalMs() / 1000),
+        pending, sentTotal, droppedTotal, slowLink ? "lento" : "normal", batteryMv);
+}
@@ -0,0 +1,124 @@
+#include "StateMachine.h"
+
+static const char* const EVENT_NAMES[FSM_EVENT_COUNT] = {
+    "PAIR", "BLE_UID", "LINK_READY", "SOS_GEN", "SOS_MED", "SOS_SEG", "SOS_DONE", "OTA_BEGIN", "OTA_END", "TIMEOUT"
+};
+
+void StateMachine::begin(const StateDef* stateTable, const TransitionDef* transitions, uint8_t count) {
+    states = stateTable;
+    table = transitions;
+    tableSize = count;
+}
+
+void StateMachine::start(DeviceState initial, uint32_t nowMs) {
+    current = initial;
+    enteredMs = nowMs;
+    started = true;
+    dwell[(int)initial].entries++;
+    Serial.printf("[STATE] Inicial: %s\n", stateName(initial));
+    if (states[(int)initial].onEnter) states[(int)initial].onEnter();
+}
+
+bool StateMachine::dispatch(DeviceEvent event, uint32_t nowMs) {
+    if (!started) return false;
+    // Emitido desde una acción: se procesa al cerrar la transición en curso
+    if (busy) {
+        if (pendingCount < FSM_PENDING_MAX) pending[pendingCount++] = event;
+        return false;
+    }
+    bool moved = step(event, nowMs);
+    for (uint8_t i = 0; i < pendingCount; i++) {
+        if (step(pending[i], millis())) moved = true;
+    }
+    pendingCount = 0;
+    return moved;
+}
+
+bool StateMachine::step(DeviceEvent event, uint32_t nowMs) {
+    DeviceState from = current;
+    const TransitionDef* t = nullptr;
+    for (uint8_t i = 0; i < tableSize; i++) {
+        if (table[i].from == from && table[i].event == event && (!table[i].guard || table[i].guard())) {
+            t = &table[i];
+            break;
+        }
+    }
+    if (!t) return false;
+
+    busy = true;
+    uint32_t stayed = nowMs - enteredMs;
+    Dwell& d = dwell[(int)from];
+    d.totalMs += stayed;
+    if (stayed > d.maxMs) d.maxMs = stayed;
+
+    TraceEntry& e = trace[traceHead];
+    e.atMs = nowMs;
+    e.dwellMs = stayed;
+    e.from = from;
+    e.to = t->to;
+    e.event = event;
+    traceHead = (traceHead + 1) % FSM_TRACE_MAX;
+    if (traceCount < FSM_TRACE_MAX) traceCount++;
+
+    Serial.printf("[STATE] %s -> %s (%s, %lu ms)\n", stateName(from), stateName(t->to), eventName(event), (unsigned long)stayed);
+    if (states[(int)from].onExit) states[(int)from].onExit();
+    if (t->action) t->action();
+    current = t->to;
+    // Las acciones pueden bloquear (p.ej. setupModem): la permanencia cuenta desde aquí
+    enteredMs = millis();
+    dwell[(int)t->to].entries++;
+    if (states[(int)t->to].onEnter) states[(int)t->to].onEnter();
+    busy = false;
+    return true;
+}
+
+bool StateMachine::checkTimeout(uint32_t nowMs) {
+    if (!started || msUntilTimeout(nowMs) != 0) return false;
+    return dispatch(DeviceEvent::TIMEOUT, nowMs);
+}
+
+uint32_t StateMachine::msUntilTimeout(uint32_t nowMs) const {
+    if (!started) return FSM_NO_DEADLINE;
+    uint32_t limit = states[(int)current].timeoutMs;
+    if (limit == 0) return FSM_NO_DEADLINE;
+    uint32_t stayed = nowMs - enteredMs;
+    return stayed >= limit ? 0 : limit - stayed;
+}
+
+const char* StateMachine::stateName(DeviceState s) const {
+    int i = (int)s;
+    return (states && i >= 0 && i < FSM_STATE_COUNT) ? states[i].name : "?";
+}
+
+const char* StateMachine::eventName(DeviceEvent e) {
+    int i = (int)e;
+    return (i >= 0 && i < FSM_EVENT_COUNT) ? EVENT_NAMES[i] : "?";
+}
+
+void StateMachine::print(uint32_t nowMs) const {
+    DeviceState s = current;
+    uint32_t limit = msUntilTimeout(nowMs);
+    Serial.printf("[STATE] Actual: %s hace %lu ms", stateName(s), (unsigned long)(nowMs - enteredMs));
+    if (limit != FSM_NO_DEADLINE) Serial.printf(" (timeout en %lu ms)", (unsigned long)limit);
+    Serial.println();
+
+    Serial.println("  estado         entradas   total ms     máx ms");
+    for (uint8_t i = 0; i < FSM_STATE_COUNT; i++) {
+        const Dwell& d = dwell[i];
+        if (d.entries == 0) continue;
+        // El estado actual suma su permanencia en curso
+        uint32_t open = (uint8_t)s == i ? nowMs - enteredMs : 0;
+        uint32_t maxMs = open > d.maxMs ? open : d.maxMs;
+        Serial.printf("  %-14s %8lu %10lu %10lu\n", states[i].name, (unsigned long)d.entries,
+            (unsigned long)(d.totalMs + open), (unsigned long)maxMs);
+    }
+
+    if (traceCount == 0) return;
+    Serial.printf("  Últimas %u transiciones:\n", traceCount);
+    uint8_t first = (traceHead + FSM_TRACE_MAX - traceCount) % FSM_TRACE_MAX;
+    for (uint8_t n = 0; n < traceCount; n++) {
+        const TraceEntry& e = trace[(first + n) % FSM_TRACE_MAX];
+        Serial.printf("  %9lu ms  %-12s -> %-12s %-9s (%lu ms)\n",
+            (unsigned long)e.atMs, stateName(e.from), stateName(e.to), eventName(e.event), (unsigned long)e.dwellMs);
+    }
+}
@@ -0,0 +1,56 @@
+#include "TaskMonitor.h"
+
+uint8_t TaskMonitor::add(TaskHandle_t handle, const char* name, int8_t core, uint32_t stackBytes) {
+    if (count >= TASK_MONITOR_SLOTS) return 0xFF;
+    if (count == 0) startMs = millis();
+    Slot& s = slots[count];
+    s.handle = handle;
+    s.name = name;
+    s.core = core;
+    s.stackBytes = stackBytes;
+    s.activeUs = 0;
+    return count++;
+}
+
+void TaskMonitor::addActive(uint8_t slot, uint32_t us) {
+    if (slot >= count) return;
+    portENTER_CRITICAL(&mux);
+    slots[slot].activeUs += us;
+    portEXIT_CRITICAL(&mux);
+}
+
+void TaskMonitor::print() const {
+    uint32_t windowMs = millis() - startMs;
+    if (windowMs == 0) windowMs = 1;
+    Serial.printf("[TASKS] Ventana %lu s | núcleo 0: host NimBLE y controlador BT\n", (unsigned long)(windowMs / 1000));
+    Serial.println("  tarea    núcleo prio  pila libre / total   activo");
+    for (uint8_t i = 0; i < count; i++) {
+        const Slot& s = slots[i];
+        portENTER_CRITICAL(&mux);
+        uint64_t activeUs = s.activeUs;
+        portEXIT_CRITICAL(&mux);
+        // En ESP-IDF la marca de agua se expresa en bytes
+        Serial.printf("  %-8s %6d %4u  %6u / %-6lu B  %5.1f%%\n",
+            s.name, s.core, (unsigned)uxTaskPriorityGet(s.handle),
+            (unsigned)uxTaskGetStackHighWaterMark(s.handle), (unsigned long)s.stackBytes,
+            activeUs / 10.0f / windowMs);
+    }
+    Serial.println("  (activo = fuera de su espera; el módem incluye las esperas de respuestas AT)");
+
+#if configGENERATE_RUN_TIME_STATS
+    UBaseType_t n = uxTaskGetNumberOfTasks();
+    TaskStatus_t* all = (TaskStatus_t*)malloc(n * sizeof(TaskStatus_t));
+    if (!all) return;
+    uint32_t totalRun = 0;
+    n = uxTaskGetSystemState(all, n, &totalRun);
+    // Contador de run time por núcleo: la capacidad total es la de ambos
+    float capacity = totalRun * (float)portNUM_PROCESSORS / 100.0f;
+    if (capacity > 0) {
+        Serial.println("  CPU real desde el arranque (% de ambos núcleos):");
+        for (UBaseType_t i = 0; i < n; i++) {
+            Serial.printf("    %-14s %5.1f%%\n", all[i].pcTaskName, all[i].ulRunTimeCounter / capacity);
+        }
+    }
+    free(all);
+#endif
+}
@@ -7,25 +7,34 @@ int logLevel = 1; // 0=ERROR, 1=INFO, 2=DEBUG (configurable)
 #define LOG_DEBUG(x) do { if (logLevel >= 2) { Serial.print("[DEBUG] "); Serial.println(x); } } while(0)
 #include <NimBLEDevice.h>
 #include <ArduinoJson.h>
-#include <Preferences.h>
 #include <esp_mac.h>
 #include <esp_sleep.h>
 
-// ===== SELECCIÓN DE HARDWARE =====
-// Selecciona la variante de hardware y módem a usar
-// Descomentar SOLO UNA de las siguientes líneas:
-// #define HARDWARE_A  // SIM7080G con HTTPS directo
-// #define HARDWARE_B  // A7670SA con batería (Prototipo)
-#define HARDWARE_C  // A7670SA sin batería (Laboratorio)
-
-// Importar la clase correcta según hardware seleccionado
-#ifdef HARDWARE_A
-  #include "ModemHTTPS.h"
-  #define MODEM_TYPE "SIM7080G (HTTPS)"
-#else
-  #include "ModemProxy.h"
-  #define MODEM_TYPE "A7670SA (Proxy)"
-#endif
+// Variante de hardware y driver del módem: ModemFactory.h
+#include "ModemFactory.h"
+#include "GnssScheduler.h"
+#include "RadioScheduler.h"
+#include "Geofence.h"
+#include "SosTracker.h"
+#include "SosOutbox.h"
+#include "SosFastPath.h"
+#include "ButtonInput.h"
+#include "DeepSleep.h"
+#include "PowerManager.h"
+#include "EnergyMeter.h"
+#include "BootProfiler.h"
+#include "TaskMonitor.h"
+#include "JobScheduler.h"
+#include "StateMachine.h"
+#include "DeviceConfig.h"
+#include "JsonArena.h"
+#include "ProvisioningBlob.h"
+#include "BleAdvProfile.h"
+#include "DiagFrame.h"
+#include "OtaUpdate.h"
+#include <freertos/semphr.h>
+#include <freertos/event_groups.h>
+#include <mbedtls/md.h>
 
 // ===== PINES (NO CAMBIAR - CRÍTICO) =====
 // Definición de pines para UART, botones y LEDs
@@ -44,17 +53,79 @@ int logLevel = 1; // 0=ERROR, 1=INFO, 2=DEBUG (configurable)
 #define SERVICE_UUID           "0000ffaa-0000-1000-8000-00805f9b34fb"
 #define CHAR_OWNER_UUID        "0000ffab-0000-1000-8000-00805f9b34fb"
 #define CHAR_DEVICE_ID_UUID    "0000ffae-0000-1000-8000-00805f9b34fb"
-#define CHAR_WIFI_SSID_UUID    "0000ffac-0000-1000-8000-00805f9b34fb"
-#define CHAR_WIFI_PASS_UUID    "0000ffad-0000-1000-8000-00805f9b34fb"
+#define CHAR_PROV_BLOB_UUID    "0000ffaf-0000-1000-8000-00805f9b34fb"  // Blob completo (ProvisioningBlob.h)
+#define CHAR_PROV_STATUS_UUID  "0000ffb0-0000-1000-8000-00805f9b34fb"  // Progreso (READ | NOTIFY)
+#define CHAR_LINK_READY_UUID   "0000ffb1-0000-1000-8000-00805f9b34fb"  // 0x01 = documento creado
+// Servicio de diagnóstico (opcional, con PIN): tramas de DiagFrame.h por notificación
+#define DIAG_SERVICE_UUID      "0000ffc0-0000-1000-8000-00805f9b34fb"
+#define DIAG_CHAR_FRAMES_UUID  "0000ffc1-0000-1000-8000-00805f9b34fb"
+#define DIAG_PERIOD_MS         1000UL    // Una ronda de tramas (módem, GNSS, sistema) por segundo
+#define DIAG_CSQ_EVERY         5         // AT+CSQ cada 5 rondas: no ocupar el módem cada segundo
+#define DIAG_SESSION_MIN       15        // Duración por defecto de la sesión (minutos)
+#define DIAG_SESSION_MAX_MIN   60
 #define DEVICE_NAME_PREFIX     "Wilobu-"
+#define BLE_MTU_PREFERRED      247       // El blob entra en una sola escritura
+#define BLE_POWER_DEFAULT      ESP_PWR_LVL_P3  // Conexión y fase rápida: la app está a centímetros
+#define BLE_POWER_ADV_SLOW     ESP_PWR_LVL_N3  // Fase lenta (intervalos en BleAdvProfile.h)
+#define PROV_SESSION_MS        180000UL  // Tras el blob: plazo para que el backend confirme
+#define PROV_CLOSE_GRACE_MS    1500UL    // Deja salir la última notificación antes de apagar BLE
 
 // ===== CONSTANTES =====
 // Tiempos y parámetros globales del sistema
-#define DEEP_SLEEP_ENABLED     false // Cambiar a true en producción
+#ifndef DEEP_SLEEP_ENABLED
+  #define DEEP_SLEEP_ENABLED   false // Producción: -D DEEP_SLEEP_ENABLED=true
+#endif
 #define DEEP_SLEEP_TIME        3600  // 1 hora en modo idle
 #define GPS_COLD_START_TIME    45000 // 45 segundos para GPS "cold start"
-#define LOCATION_UPDATE_INTERVAL 30000 // Actualizar ubicación cada 30s
-#define BUTTON_DEBOUNCE_TIME   100   // 100ms debounce
+#ifndef BOOT_CONSOLE_WAIT_MS
+  #define BOOT_CONSOLE_WAIT_MS 0     // Espera para abrir el monitor serie (dev: -D BOOT_CONSOLE_WAIT_MS=2000)
+#endif
+#define BOOT_LED_BLINK_MS      720   // Parpadeo de arranque de LED_LINK (no bloquea)
+#define JSON_EXTRA_ARENA       4096  // Pools del JsonDocument 'extra' (12 puntos SOS + energía + heap)
+#ifndef FIRMWARE_VERSION
+  #define FIRMWARE_VERSION     "2.0.0" // Se compara con el manifiesto OTA (CI: -D FIRMWARE_VERSION=\"x.y.z\")
+#endif
+// Raíz de las claves SMS por dispositivo: llega al compilar (platformio.ini la
+// toma de WILOBU_SMS_PSK) y es la misma SMS_SOS_PSK de las Cloud Functions.
+// No se versiona: sin ella no hay build
+#ifndef SMS_SOS_PSK
+  #error "SMS_SOS_PSK sin definir: exporta WILOBU_SMS_PSK antes de compilar"
+#endif
+static_assert(sizeof(SMS_SOS_PSK) > 16, "SMS_SOS_PSK vacía o demasiado corta");
+#define SMS_SOS_TAG_BYTES      8     // Tag del SMS SOS: HMAC-SHA256 truncado (16 hex)
+
+// ===== TAREAS =====
+// Núcleo 0 queda para el host NimBLE y el controlador BT; las tareas propias van
+// al 1 junto al loop de Arduino, que hace de tarea del módem (única que usa ModemSerial
+// salvo la tarea GNSS, que pide prestado el bus para cada muestra)
+#define TASK_APP_CORE          1
+#define TASK_LOOP_STACK        8192  // CONFIG_ARDUINO_LOOP_STACK_SIZE (tarea del módem)
+#define TASK_GNSS_STACK        4096
+#define TASK_INPUT_STACK       3072
+#define TASK_UI_STACK          2048
+#define TASK_INPUT_PRIO        3     // Sobre el loop (prioridad 1): una pulsación nunca espera al módem
+#define TASK_GNSS_PRIO         2
+#define TASK_UI_PRIO           1
+#define TASK_UI_STATIC_MS      5000  // Red de seguridad con LEDs fijos (los cambios de estado notifican)
+#define TASK_GNSS_IDLE_MS      30000 // Tope de espera de la tarea GNSS (la tarea del módem la despierta)
+#define INPUT_ACTION_QUEUE     4
+
+// ===== TRABAJOS DE LA TAREA DEL MÓDEM =====
+// La tarea duerme hasta el plazo más próximo (JobScheduler) o hasta un evento
+#define LOOP_MAX_IDLE_MS       10000UL // Tope de espera entre pasadas
+#define HEARTBEAT_RETRY_MS     5000UL  // Heartbeat vencido que no salió (sin red o esperando fix)
+#define JOB_RETRY_MS           1000UL  // Trabajo vencido pero bloqueado (p.ej. disparos SOS en curso)
+#define SOS_STEP_MS            100UL   // Cadencia del pipeline SOS mientras está activo
+#define SLEEP_CHECK_MS         1000UL  // Evaluación de deep sleep
+
+// Bits del grupo de eventos de la aplicación
+#define APP_EVT_READY          (1 << 0)  // setup() terminó: la tarea GNSS puede empezar
+#define APP_EVT_INPUT          (1 << 1)  // Acción de botón en cola para la tarea del módem
+#define APP_EVT_FIX            (1 << 2)  // La tarea GNSS publicó un fix nuevo
+#define APP_EVT_CONSOLE        (1 << 3)  // Llegó un comando por la consola serie
+#define APP_EVT_BLE            (1 << 4)  // La app escribió el blob o el Owner UID por BLE
+#define APP_EVT_LINK           (1 << 5)  // La app avisó por BLE que el documento ya existe
+#define APP_EVT_WAKE_MODEM     (APP_EVT_INPUT | APP_EVT_FIX | APP_EVT_CONSOLE | APP_EVT_BLE | APP_EVT_LINK)
 #define SOS_ALERT_TIMEOUT      5000  // Timeout para envío de alerta SOS
 #ifdef HARDWARE_A
   #define HEARTBEAT_INTERVAL     900000UL // 15 minutos (Tier A)
@@ -62,81 +133,287 @@ int logLevel = 1; // 0=ERROR, 1=INFO, 2=DEBUG (configurable)
   #define HEARTBEAT_INTERVAL     300000UL // 5 minutos (Tier B/C)
 #endif
 
+// Reporte de ubicación por evento: el heartbeat solo adjunta lastLocation si cambió
+#define LOCATION_REPORT_MIN_MOVE_M 50.0f     // Desplazamiento mínimo para volver a subirla
+#define LOCATION_REPORT_MAX_AGE_MS 3600000UL // Refresco forzado aunque no se mueva (1 h)
+
 // Ventana inicial para detectar desprovisionamiento rapido tras un unlink
 #define HEARTBEAT_EARLY_WINDOW_MS 300000UL // 5 minutos
 #define HEARTBEAT_FAST_INTERVAL   30000UL  // 30s en ventana inicial o cuando provisioned=false
 
 // ===== MÁQUINA DE ESTADOS =====
-// Controla el modo global del dispositivo
-DeviceState deviceState = DeviceState::PROVISIONING;
-DeviceState previousState = DeviceState::PROVISIONING;
+// Controla el modo global del dispositivo (tabla en "MÁQUINA DE ESTADOS PRINCIPAL")
+#define FSM_PROVISIONING_MS    300000UL // Espera máxima de la app por BLE (5 min)
+#define FSM_LINKING_MS         120000UL // Red de seguridad: sin señal de la app ni confirmación del backend
+#define LINK_POLL_FIRST_MS     2000UL   // checkDeviceStatus: 2 s, 4 s, 8 s... hasta LINK_POLL_MAX_MS
+#define LINK_POLL_MAX_MS       15000UL
+#define FSM_SOS_MAX_MS         300000UL // Red de seguridad: el pipeline SOS termina mucho antes
+#define FSM_OTA_MAX_MS         1800000UL // Descarga colgada: se descarta y vuelve a ONLINE (30 min)
+#define OTA_RETRY_FIRST_MS     5000UL   // Rango cortado: 5 s, 10 s, 20 s... hasta OTA_RETRY_MAX_MS
+#define OTA_RETRY_MAX_MS       60000UL
+#define OTA_MAX_FAILURES       8        // Rangos fallidos seguidos antes de abandonar la descarga
+#define OTA_HEALTH_MS          900000UL // Imagen nueva: 15 min para registrarse y, desde ahí, para un heartbeat 2xx
+StateMachine fsm;
 
 // ===== VARIABLES GLOBALES =====
 // Estado global, buffers y configuración persistente
-HardwareSerial ModemSerial(2);  // UART2 para módem
+#define MODEM_UART_NUM 1        // UART1: en el ESP32 solo UART0/1 despiertan del light sleep
+HardwareSerial ModemSerial(MODEM_UART_NUM);  // Pines remapeados a 16/17 en begin()
 IModem* modem = nullptr;
-Preferences preferences;
-
-// Identificación del dispositivo
-String deviceId = "";
-String ownerUid = "";
-String modemApn = "";
-String wifiSSID = "";
-String wifiPassword = "";
+DeviceConfig config;          // Copia en RAM de la configuración persistente (blob en NVS)
+
+// Identificación del dispositivo: capacidad fija, sin heap en la ruta SOS
+FixedString<16> deviceId;     // 12 hex de la MAC
+FixedString<sizeof(ConfigData::ownerUid)> ownerUid;
+FixedString<sizeof(ConfigData::modemApn)> modemApn;
+FixedString<SMS_NUMBER_MAX> smsGateway;  // Gateway SMS (lo entrega el backend o el comando sms_gw)
+bool sosMultipath = true;     // Despacho SOS: datos + SMS en paralelo (false = solo datos)
+bool modemPsm = DEEP_SLEEP_ENABLED; // PSM solo tiene sentido si el ESP32 duerme entre heartbeats
 bool isProvisioned = false;
 bool lastHeartbeatOk = false; // true solo cuando el heartbeat recibe 2xx
-unsigned long bootTimestamp = 0;
+uint32_t bootTimestamp = 0;
 
 // Localización
 GPSLocation lastLocation = {0.0, 0.0, 999.0, 0, false};
-unsigned long lastLocationUpdate = 0;
-unsigned long lastHeartbeat = 0;
+GnssScheduler gnssScheduler;  // Intervalo adaptativo según movimiento (ver GnssScheduler.h)
+RadioScheduler radio;         // Coordina ventanas GNSS con transacciones LTE
+uint32_t heartbeatIntervalMs = HEARTBEAT_INTERVAL;  // Intervalo vigente (normal o rápido)
+GeofenceSet geofences;        // Geocercas evaluadas en el dispositivo
+SosTracker sosTracker;        // Seguimiento en vivo tras una alerta SOS
+SosOutbox sosOutbox;          // Alertas SOS pendientes de 2xx (RTC + NVS)
+ButtonInput buttons;          // Botones por interrupción con antirrebote en timer
+PowerManager power;           // DFS + light sleep en la espera del loop
+EnergyMeter energy;           // Tiempo por estado de energía -> mAh/h estimados
+bool energyInHeartbeat = false; // Adjuntar el reporte de energía al heartbeat (configuración persistente)
+BootProfiler bootProfile;     // Línea de tiempo del arranque en frío hasta el primer heartbeat
+uint8_t extraArenaBuf[JSON_EXTRA_ARENA];
+JsonArena extraArena("extra", extraArenaBuf, sizeof(extraArenaBuf)); // 'extra' de heartbeat/SOS sin heap
+uint32_t heapAfterSetup = 0;  // Bloque mayor al terminar setup(): referencia de fragmentación
+
+// Acción decidida por la tarea de entrada; la ejecuta la tarea del módem
+struct InputAction {
+    enum class Type : uint8_t { SOS, PAIR };
+    Type type;
+    uint8_t button;
+    uint32_t atMs;      // Instante en que se cumplió el umbral de mantenido
+};
+SemaphoreHandle_t modemBus = nullptr;     // Recursivo: dueño de ModemSerial y del estado compartido
+EventGroupHandle_t appEvents = nullptr;
+QueueHandle_t inputActions = nullptr;
+TaskHandle_t uiTaskHandle = nullptr;
+TaskHandle_t gnssTaskHandle = nullptr;
+JobScheduler jobs;                        // Plazos de la tarea del módem
+uint8_t jobHeartbeat = JOB_NONE;
+uint8_t jobSos = JOB_NONE;
+uint8_t jobOutbox = JOB_NONE;
+uint8_t jobSlot = JOB_NONE;
+uint8_t jobTrack = JOB_NONE;
+uint8_t jobBleSession = JOB_NONE;
+uint8_t jobLink = JOB_NONE;
+uint8_t jobDiag = JOB_NONE;
+uint8_t jobOta = JOB_NONE;
+uint8_t jobOtaHealth = JOB_NONE;
+TaskMonitor taskMonitor;
+uint8_t modemTaskSlot = 0xFF;             // Slots del monitor (0xFF = aún sin registrar)
+uint8_t gnssTaskSlot = 0xFF;
+uint8_t inputTaskSlot = 0xFF;
+uint8_t uiTaskSlot = 0xFF;
+volatile bool uiAnimating = false;        // Hay un LED parpadeando (no congelarlo con light sleep manual)
+bool bootFixPending = false;  // El heartbeat inicial salió sin fix: la ubicación sale apenas llegue
+const uint8_t BUTTON_PINS[BUTTON_COUNT] = {PIN_BTN_SOS, PIN_BTN_MEDICA, PIN_BTN_SEGURIDAD};
+const char* const BUTTON_SOS_TYPES[BUTTON_COUNT] = {"general", "medica", "seguridad"};
+const DeviceEvent BUTTON_SOS_EVENTS[BUTTON_COUNT] = {
+    DeviceEvent::SOS_GENERAL, DeviceEvent::SOS_MEDICA, DeviceEvent::SOS_SEGURIDAD
+};
+enum { BTN_SOS = 0, BTN_MEDICA = 1, BTN_SEGURIDAD = 2 };
+GPSLocation lastUploadedLocation = {0.0, 0.0, 999.0, 0, false};
+uint32_t lastLocationUploadMs = 0;
+uint32_t lastHeartbeat = 0;
 bool firstHeartbeatSent = false;
-bool isOTAInProgress = false;
+uint32_t modemBaud = 0;       // Baudrate que respondió (se conserva en RTC)
+WakeReason wakeReason = WakeReason::COLD;
 
 // BLE
 NimBLEServer* pServer = nullptr;
 NimBLEAdvertising* pAdvertising = nullptr;
+NimBLECharacteristic* pCharProvStatus = nullptr;
 bool bleConnected = false;
+volatile bool bleAdvWanted = false;   // PROVISIONING: se anuncia (y se reanuda tras desconectar)
+uint16_t bleConnHandle = 0;
+BleAdvProfile bleProfile;         // Fase de radio vigente, tiempo hasta conectar y energía por fase
+bool bleSessionOpen = false;      // BLE vivo desde PROVISIONING hasta el primer heartbeat 2xx
+bool bleSessionClosing = false;   // Última notificación enviada: se apaga en PROV_CLOSE_GRACE_MS
+// Buzón de 1 elemento: el host NimBLE deja el último pedido válido y la tarea del módem lo aplica.
+// ownerUid e isProvisioned solo se escriben en la tarea del módem, después del commit.
+QueueHandle_t provMailbox = nullptr;
+volatile bool linkBackendReady = false;   // Señal de la app: el documento en Firestore ya existe
+bool linkModemStale = false;      // El blob cambió APN o endpoint: recrear el driver del módem
+uint8_t linkPolls = 0;            // Consultas a checkDeviceStatus en esta vinculación
+NimBLECharacteristic* pCharDiag = nullptr;
+bool diagActive = false;          // La sesión BLE abierta es la de diagnóstico
+volatile bool diagAuthenticated = false;  // Enlace cifrado con MITM (PIN correcto)
+uint32_t diagStartMs = 0;
+uint32_t diagDurationMs = 0;
+uint8_t diagSeq = 0;
+uint8_t diagRounds = 0;
+uint8_t diagCsq = DIAG_CSQ_UNKNOWN;
+
+// OTA
+OtaUpdater ota;                   // Imagen a medio escribir: sobrevive a una alerta SOS
+OtaManifest otaManifest = {};
+bool otaCheckPending = false;     // El heartbeat avisó que hay versión publicada
+uint8_t otaFailures = 0;          // Rangos fallidos seguidos
+bool otaTrialRegistered = false;  // La imagen en prueba llegó a registrarse en la red
+uint32_t otaRetryMs = OTA_RETRY_FIRST_MS;
+
+// ===== DECLARACIONES FORWARD =====
+void attemptAutoRecovery();
+bool gnssPowerOn();
+void uiRefresh();
+void gnssRefresh();
+void onHeartbeatSent(bool carriedBootFix);
+uint32_t msUntilHeartbeat();
+bool deviceEvent(DeviceEvent event);
+bool diagOpen(uint32_t passkey, uint16_t minutes);
 
 // ===== CALLBACKS BLE =====
-// Manejan eventos BLE: escritura de Owner UID y conexión/desconexión
+// Manejan eventos BLE: blob de aprovisionamiento, Owner UID suelto (apps
+// anteriores), MTU y conexión/desconexión
+
+// Publica una etapa en la característica de progreso (lectura + notificación)
+void provNotify(ProvStage stage, ProvError code = ProvError::OK, uint16_t value = 0) {
+    if (!pCharProvStatus) return;
+    uint8_t payload[PROV_STATUS_LEN];
+    encodeProvisioningStatus(stage, code, value, payload);
+    pCharProvStatus->setValue(payload, sizeof(payload));
+    pCharProvStatus->notify();
+    Serial.printf("[BLE] Progreso: %s (%s, %u)\n", provStageName(stage), provErrorName(code), value);
+}
+
+// Blob completo en una escritura: se valida aquí, se aplica en la tarea del módem
+class ProvBlobCallbacks : public NimBLECharacteristicCallbacks {
+    void onWrite(NimBLECharacteristic* pCharacteristic) override {
+        std::string value = pCharacteristic->getValue();
+        ProvisioningRequest req;
+        ProvError err = parseProvisioningBlob((const uint8_t*)value.data(), value.length(), req);
+        if (err != ProvError::OK) {
+            // La sesión sigue abierta: la app puede corregir y reescribir
+            Serial.printf("[BLE] Blob inválido (%u bytes): %s\n", (unsigned)value.length(), provErrorName(err));
+            provNotify(ProvStage::FAILED, err, value.length());
+            return;
+        }
+        xQueueOverwrite(provMailbox, &req);
+        Serial.printf("[BLE] Blob v%u recibido (%u bytes): UID %s%s%s%s%s\n", PROV_BLOB_VERSION,
+            (unsigned)value.length(), req.ownerUid, req.hasApn ? " +apn" : "", req.hasProfile ? " +perfil" : "",
+            req.hasSmsGateway ? " +sms_gw" : "", req.hasEndpoint ? " +endpoint" : "");
+        provNotify(ProvStage::RECEIVED);
+        xEventGroupSetBits(appEvents, APP_EVT_BLE);
+    }
+};
 
 // Callback para recibir Owner UID desde la app móvil
 class OwnerUIDCallbacks : public NimBLECharacteristicCallbacks {
     void onWrite(NimBLECharacteristic* pCharacteristic) override {
         std::string value = pCharacteristic->getValue();
         // Validación mínima: longitud razonable
-        if (value.length() >= 6 && value.length() <= 64) {
-            ownerUid = String(value.c_str());
-            Serial.println("[BLE] UID recibido: " + ownerUid);
-
-            // Guardar en memoria no volátil (NVS)
-            preferences.begin("wilobu", false);
-            preferences.putString("ownerUid", ownerUid);
-            preferences.putBool("provisioned", true);
-            preferences.end();
-
-            isProvisioned = true;
-            Serial.println("[BLE] Dispositivo aprovisionado en NVS");
+        if (value.length() >= 6 && value.length() <= PROV_OWNER_MAX) {
+            // Pedido sin campos opcionales: solo el UID, copiado a un arreglo fijo
+            ProvisioningRequest req = {};
+            memcpy(req.ownerUid, value.data(), value.length());
+            req.ownerUid[value.length()] = '\0';
+            Serial.printf("[BLE] UID recibido: %s\n", req.ownerUid);
+            // Callback del host NimBLE: NVS y la transición quedan para la tarea del módem
+            xQueueOverwrite(provMailbox, &req);
+            xEventGroupSetBits(appEvents, APP_EVT_BLE);
         } else {
             Serial.println("[BLE] UID recibido inválido (longitud)");
         }
     }
 };
 
+// La app terminó de crear el documento: reemplaza la espera fija de LINKING
+class LinkReadyCallbacks : public NimBLECharacteristicCallbacks {
+    void onWrite(NimBLECharacteristic* pCharacteristic) override {
+        std::string value = pCharacteristic->getValue();
+        if (value.length() != 1 || value[0] != 0x01) {
+            Serial.println("[BLE] Señal de vinculación inválida");
+            return;
+        }
+        Serial.println("[BLE] La app confirmó el documento del dispositivo");
+        linkBackendReady = true;
+        xEventGroupSetBits(appEvents, APP_EVT_LINK);
+    }
+};
+
 // Callback para eventos de conexión y desconexión BLE
+void bleAdvertiseFast();
+
+// Fin de la fase rápida (o conexión): si nadie se conectó, publicidad lenta sin plazo
+void onFastAdvComplete(NimBLEAdvertising* adv) {
+    if (!bleAdvWanted || bleConnected || (pServer && pServer->getConnectedCount() > 0)) return;
+    adv->stop();
+    adv->setMinInterval(BLE_ADV_SLOW_MIN_ITVL);
+    adv->setMaxInterval(BLE_ADV_SLOW_MAX_ITVL);
+    NimBLEDevice::setPower(BLE_POWER_ADV_SLOW, ESP_BLE_PWR_TYPE_ADV);
+    adv->start();
+    bleProfile.enter(BleAdvProfile::ADV_SLOW, millis());
+    Serial.printf("[BLE] Sin conexión en %lus - publicidad lenta\n", BLE_ADV_FAST_MS / 1000);
+}
+
+// Publicidad rápida por BLE_ADV_FAST_MS; al vencer, onFastAdvComplete() pasa a la lenta
+void bleAdvertiseFast() {
+    if (!pAdvertising) return;
+    pAdvertising->setMinInterval(BLE_ADV_FAST_MIN_ITVL);
+    pAdvertising->setMaxInterval(BLE_ADV_FAST_MAX_ITVL);
+    NimBLEDevice::setPower(BLE_POWER_DEFAULT, ESP_BLE_PWR_TYPE_ADV);
+    pAdvertising->start(BLE_ADV_FAST_MS / 1000, onFastAdvComplete);
+    bleProfile.advertise(millis());
+}
+
+// Tras el blob solo quedan notificaciones: intervalo largo con latencia de esclavo
+void bleConnRelax() {
+    if (!bleConnected || !pServer) return;
+    pServer->updateConnParams(bleConnHandle, BLE_CONN_IDLE_MIN_ITVL, BLE_CONN_IDLE_MAX_ITVL,
+                              BLE_CONN_IDLE_LATENCY, BLE_CONN_TIMEOUT);
+    bleProfile.enter(BleAdvProfile::CONN_IDLE, millis());
+}
+
 class ServerCallbacks : public NimBLEServerCallbacks {
-    void onConnect(NimBLEServer* pServer) override {
+    // Intervalo corto mientras la app descubre servicios y escribe el blob
+    void onConnect(NimBLEServer* pServer, ble_gap_conn_desc* desc) override {
         bleConnected = true;
-        Serial.println("[BLE] ✓ Cliente conectado - LED parpadeando");
-        // LED parpadea durante handshake (se maneja en el loop de provisioning)
+        bleConnHandle = desc->conn_handle;
+        BleAdvProfile::Phase advPhase = bleProfile.phase();
+        uint32_t ttc = bleProfile.onConnect(millis());
+        pServer->updateConnParams(desc->conn_handle, BLE_CONN_FAST_MIN_ITVL, BLE_CONN_FAST_MAX_ITVL,
+                                  BLE_CONN_FAST_LATENCY, BLE_CONN_TIMEOUT);
+        uiRefresh();
+        Serial.printf("[BLE] ✓ Cliente conectado en %lu ms (%s) - LED parpadeando\n",
+            (unsigned long)ttc, BleAdvProfile::phaseName(advPhase));
     }
 
     void onDisconnect(NimBLEServer* pServer) override {
         bleConnected = false;
+        diagAuthenticated = false;
+        bleProfile.onDisconnect(millis());
+        uiRefresh();
         Serial.println("[BLE] ✗ Cliente desconectado");
         // Si se aprovisionó, mantener LED encendido; si no, volver a parpadear
+        if (bleAdvWanted) bleAdvertiseFast();
+    }
+
+    // La app pide el MTU al conectar; READY le dice cuánto entra en una escritura
+    void onMTUChange(uint16_t MTU, ble_gap_conn_desc* desc) override {
+        Serial.printf("[BLE] MTU negociado: %u\n", MTU);
+        provNotify(ProvStage::READY, ProvError::OK, MTU - 3);
+    }
+
+    // Diagnóstico: sin cifrado con MITM (PIN equivocado o "Just Works") no hay tramas
+    void onAuthenticationComplete(ble_gap_conn_desc* desc) override {
+        if (!diagActive) return;
+        diagAuthenticated = desc->sec_state.encrypted && desc->sec_state.authenticated;
+        Serial.printf("[DIAG] Emparejamiento %s\n", diagAuthenticated ? "autenticado" : "rechazado");
+        if (!diagAuthenticated && pServer) pServer->disconnect(desc->conn_handle);
     }
 };
 
@@ -146,15 +423,16 @@ void setupBLE() {
     Serial.println("[SETUP] Inicializando BLE para aprovisionamiento...");
     
     // Usar deviceId que ya se generó en setup()
-    String shortId = deviceId.substring(6);
-    String deviceName = String(DEVICE_NAME_PREFIX) + shortId;
+    String deviceName = String(DEVICE_NAME_PREFIX) + (deviceId.c_str() + 6);
     
     NimBLEDevice::init(deviceName.c_str());
-    NimBLEDevice::setPower(ESP_PWR_LVL_P9);
+    NimBLEDevice::setPower(BLE_POWER_DEFAULT);
+    NimBLEDevice::setMTU(BLE_MTU_PREFERRED);
     
     // Crear servidor BLE
     pServer = NimBLEDevice::createServer();
     pServer->setCallbacks(new ServerCallbacks());
+    pServer->advertiseOnDisconnect(false);   // La reanuda onDisconnect() con el perfil
     
     // Crear servicio
     NimBLEService* pService = pServer->createService(SERVICE_UUID);
@@ -165,6 +443,29 @@ void setupBLE() {
         NIMBLE_PROPERTY::WRITE
     );
     pCharOwner->setCallbacks(new OwnerUIDCallbacks());
+
+    // Blob versionado: owner, APN, perfil de heartbeat y endpoints en una escritura
+    NimBLECharacteristic* pCharProvBlob = pService->createCharacteristic(
+        CHAR_PROV_BLOB_UUID,
+        NIMBLE_PROPERTY::WRITE,
+        PROV_BLOB_MAX
+    );
+    pCharProvBlob->setCallbacks(new ProvBlobCallbacks());
+
+    // Progreso del aprovisionamiento; la lectura devuelve la última etapa
+    pCharProvStatus = pService->createCharacteristic(
+        CHAR_PROV_STATUS_UUID,
+        NIMBLE_PROPERTY::READ | NIMBLE_PROPERTY::NOTIFY
+    );
+    NimBLECharacteristic* pCharLinkReady = pService->createCharacteristic(
+        CHAR_LINK_READY_UUID,
+        NIMBLE_PROPERTY::WRITE
+    );
+    pCharLinkReady->setCallbacks(new LinkReadyCallbacks());
+
+    uint8_t ready[PROV_STATUS_LEN];
+    encodeProvisioningStatus(ProvStage::READY, ProvError::OK, 20, ready);   // MTU por defecto (23)
+    pCharProvStatus->setValue(ready, sizeof(ready));
     
     // Característica de solo lectura para exponer el DeviceID real al móvil
     NimBLECharacteristic* pCharDeviceId = pService->createCharacteristic(
@@ -175,7 +476,7 @@ void setupBLE() {
     std::string deviceIdStr = deviceId.c_str();
     pCharDeviceId->setValue(deviceIdStr);
     Serial.print("[BLE] DeviceID characteristic set to: ");
-    Serial.println(deviceId);
+    Serial.println(deviceId.c_str());
     
     // Iniciar servicio
     pService->start();
@@ -184,7 +485,12 @@ void setupBLE() {
     pAdvertising = NimBLEDevice::getAdvertising();
     pAdvertising->addServiceUUID(SERVICE_UUID);
     pAdvertising->setScanResponse(true);
-    pAdvertising->start();
+    bleAdvWanted = true;
+    bleProfile.sessionStart(millis());
+    bleAdvertiseFast();
+    energy.set(EnergyMeter::BLE_ADV, true, millis());
+    bleSessionOpen = true;
+    bleSessionClosing = false;
     
     Serial.println("═════════════════════════════════════");
     Serial.println("  WILOBU EN MODO APROVISIONAMIENTO");
@@ -192,12 +498,19 @@ void setupBLE() {
     Serial.print("  Nombre BLE: ");
     Serial.println(deviceName);
     Serial.print("  Device ID:  ");
-    Serial.println(deviceId);
+    Serial.println(deviceId.c_str());
     Serial.println("═════════════════════════════════════");
 }
 
-// ===== DECLARACIONES FORWARD =====
-void attemptAutoRecovery();
+// Pide PSM/eDRX con timers derivados del intervalo de heartbeat del tier
+void applyPowerSaving() {
+    if (!modem || !modem->isConnected()) return;
+    modem->configurePowerSaving(PowerSaving::forHeartbeat(HEARTBEAT_INTERVAL, modemPsm));
+}
+
+void createModem() {
+    modem = createModemDriver(&ModemSerial, modemApn.c_str(), config.get().endpoint);
+}
 
 // ===== INICIALIZACIÓN DEL MÓDEM =====
 // Inicializa el módem y prueba varios baudrates
@@ -213,24 +526,45 @@ void setupModem() {
             LOG_INFO(String("Probando baudrate: ") + baudrates[b]);
         
         ModemSerial.begin(baudrates[b], SERIAL_8N1, PIN_MODEM_RX, PIN_MODEM_TX);
-        delay(2000);
+        delay(50);   // init() sondea AT hasta que el módem termina de arrancar
         
-        #ifdef HARDWARE_A
-            modem = new ModemHTTPS(&ModemSerial);
-        #else
-            modem = new ModemProxy(&ModemSerial, modemApn.c_str());
-        #endif
+        createModem();
         
-        if (modem->init() && modem->connect()) {
-            LOG_INFO(String("Conectado a ") + baudrates[b]);
+        if (modem->init()) {
+            bootProfile.mark("modem_at");
+            provNotify(ProvStage::MODEM_UP);
+            // Calentar GNSS mientras el registro en red está pendiente:
+            // la adquisición corre en el módem durante el sondeo de CGREG
+            if (isProvisioned) {
+                gnssPowerOn();
+                bootProfile.mark("gnss_on");
+            }
+            
+            radio.cellularBegin(millis());
+            
+            energy.set(EnergyMeter::MODEM_TX, true, millis());
+            bool registered = modem->connect();
+            radio.cellularEnd(millis());
+            energy.set(EnergyMeter::MODEM_TX, false, millis());
             
-            // Intentar auto-recuperación si no está aprovisionado
-            if (!isProvisioned) {
-                attemptAutoRecovery();
+            if (registered) {
+                LOG_INFO(String("Conectado a ") + baudrates[b]);
+                bootProfile.mark("registro");
+                provNotify(ProvStage::REGISTERED);
+                modemBaud = baudrates[b];
+                applyPowerSaving();
+                
+                // Intentar auto-recuperación si no está aprovisionado
+                if (!isProvisioned) {
+                    attemptAutoRecovery();
+                }
+                return;
             }
-            return;
         }
         
+        gnssScheduler.setPowered(false, millis());
+        radio.gnssPower(false, millis());
+        energy.set(EnergyMeter::GNSS, false, millis());
         delete modem;
         modem = nullptr;
         ModemSerial.end();
@@ -241,6 +575,21 @@ void setupModem() {
         LOG_ERROR("  - Verifica cables TX/RX");
         LOG_ERROR("  - Verifica que el módem esté encendido");
     modem = nullptr;
+    provNotify(ProvStage::FAILED, ProvError::MODEM);
+}
+
+// Tras deep sleep: el módem siguió encendido y registrado, sin barrido de
+// baudrates ni esperas de arranque. Si no responde, el llamador usa setupModem().
+bool setupModemWarm() {
+    if (modemBaud == 0 || !DeepSleep::state().modemRegistered) return false;
+    ModemSerial.begin(modemBaud, SERIAL_8N1, PIN_MODEM_RX, PIN_MODEM_TX);
+    createModem();
+    if (modem->resume()) return true;
+    Serial.println("[WAKE] Módem no reanudó - arranque completo");
+    delete modem;
+    modem = nullptr;
+    ModemSerial.end();
+    return false;
 }
 
 // ===== INICIALIZACIÓN DE PINES =====
@@ -253,6 +602,9 @@ void setupPins() {
     pinMode(PIN_BTN_MEDICA, INPUT_PULLUP);
     pinMode(PIN_BTN_SEGURIDAD, INPUT_PULLUP);
     pinMode(PIN_SWITCH_PWR, INPUT_PULLUP);
+    buttons.begin(BUTTON_PINS, BUTTON_COUNT);
+    power.begin(MODEM_UART_NUM);
+    energy.begin(millis());
     
     // Salida (LEDs)
     pinMode(PIN_LED_LINK, OUTPUT);
@@ -266,211 +618,687 @@ void setupPins() {
     Serial.println("[SETUP] ✓ Pines configurados");
 }
 
-// ===== ENVÍO DE ALERTA SOS (2 DISPAROS) =====
+// ===== ENERGÍA GNSS =====
+// Único punto de encendido/apagado para que la contabilidad del planificador cuadre
+bool gnssPowerOn() {
+    if (!modem) return false;
+    bool ok = modem->initGNSS();
+    gnssScheduler.setPowered(ok, millis());
+    radio.gnssPower(ok, millis());
+    energy.set(EnergyMeter::GNSS, ok, millis());
+    return ok;
+}
+
+void gnssPowerOff() {
+    if (!modem) return;
+    modem->disableGNSS();
+    gnssScheduler.setPowered(false, millis());
+    radio.gnssPower(false, millis());
+    energy.set(EnergyMeter::GNSS, false, millis());
+}
+
+// ===== PIPELINE SOS NO BLOQUEANTE (2 DISPAROS) =====
 // Disparo 1: Inmediato con ubicación NULL (Backend busca lastLocation)
 // Disparo 2: Preciso con coordenadas reales si GPS está disponible
-void sendSOSAlert(const String& sosType) {
-    Serial.println("[SOS] Iniciando alerta: " + sosType);
+// sosStep() avanza una etapa corta por corrida del trabajo 'sos' (cada
+// SOS_STEP_MS mientras dure): botones, LEDs y heartbeats siguen corriendo
+// entre etapas, y botones y LEDs también dentro de los POST (tareas propias).
+enum class SosStage : uint8_t { IDLE, TRIGGER, SHOT1, FIX, SHOT2, DONE };
+const char* const SOS_STAGE_NAMES[] = {"IDLE", "TRIGGER", "SHOT1", "FIX", "SHOT2", "DONE"};
+#define SOS_STAGE_COUNT   6
+#define SOS_FIX_POLL_MS   1000UL  // Sondeo de GNSS durante la etapa FIX
+#define SOS_LED_HOLD_MS   5000UL  // LED de alerta visible tras terminar
 
-    if (!modem || !modem->isConnected()) {
-        Serial.println("[SOS] ✗ Modem no disponible");
-        return;
+struct SosRun {
+    SosStage stage;
+    FixedString<SOS_TYPE_MAX> type;
+    uint32_t triggerMs;                    // Momento de la pulsación confirmada
+    uint32_t stageStartMs;
+    uint32_t stageMs[SOS_STAGE_COUNT];     // Duración medida de cada etapa
+    uint32_t lastPollMs;
+    GPSLocation fix;
+    uint32_t shot1Seq;                          // Secuencias en la bandeja de salida
+    uint32_t shot2Seq;
+    bool shot1Ok;
+    bool shot2Ok;
+};
+SosRun sos = {SosStage::IDLE};
+
+bool sosActive() {
+    return sos.stage != SosStage::IDLE;
+}
+
+void sosEnterStage(SosStage next) {
+    uint32_t now = millis();
+    sos.stageMs[(int)sos.stage] = now - sos.stageStartMs;
+    sos.stage = next;
+    sos.stageStartMs = now;
+    LOG_DEBUG(String("[SOS] Etapa -> ") + SOS_STAGE_NAMES[(int)next]);
+}
+
+void printSosTimings() {
+    Serial.printf("[SOS] Tiempos '%s': trigger %lu ms | disparo1 %lu ms | fix %lu ms | disparo2 %lu ms | total %lu ms\n",
+        sos.type.c_str(),
+        (unsigned long)sos.stageMs[(int)SosStage::TRIGGER], (unsigned long)sos.stageMs[(int)SosStage::SHOT1],
+        (unsigned long)sos.stageMs[(int)SosStage::FIX], (unsigned long)sos.stageMs[(int)SosStage::SHOT2],
+        (unsigned long)(sos.stageStartMs - sos.triggerMs));
+    Serial.printf("[SOS] Resultado: disparo1=%s disparo2=%s\n",
+        sos.shot1Ok ? "OK" : "FALLO", sos.shot2Ok ? "OK" : "NO");
+}
+
+// SMS compacto para el gateway:
+// "WLB1 <deviceId> <época hex>-<seq> <g|m|s> <lat>,<lng>,<precisión> <tag>" ("-" sin fix)
+void sosSmsText(const SosPending& p, FixedString<SMS_TEXT_MAX>& text) {
+    text.printf("WLB1 %s %08lx-%lu %c ", deviceId.c_str(), (unsigned long)sosOutbox.epoch(), (unsigned long)p.seq,
+                SosOutbox::typeName(p.type)[0]);
+    if (p.hasFix) {
+        text.appendf("%.5f,%.5f,%u", p.latE6 / 1000000.0, p.lonE6 / 1000000.0, (unsigned)p.accuracyM);
+    } else {
+        text.append('-');
     }
 
-    // LED parpadea RÁPIDO durante el proceso SOS
-    unsigned long sosStart = millis();
-    
-    // ===== DISPARO 1: INMEDIATO (ubicación NULL) =====
-    Serial.println("[SOS] DISPARO 1: Enviando alerta vacía (Backend consulta lastLocation)...");
-    GPSLocation emptyLocation = {0.0, 0.0, 999.0, 0, false}; // GPS inválido
-    bool sent1 = modem->sendSOSAlert(deviceId, ownerUid, sosType, emptyLocation);
-    
-    if (!sent1) {
-        Serial.println("[SOS] ✗ DISPARO 1 falló");
-        return;
+    // Tag con la clave de este dispositivo: el webhook lo verifica con la del
+    // documento en Firestore y descarta los SMS que no salieron de este Wilobu
+    uint8_t mac[32];
+    mbedtls_md_hmac(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256),
+                    config.get().smsKey, sizeof(config.get().smsKey),
+                    (const uint8_t*)text.c_str(), text.length(), mac);
+    text.append(' ');
+    for (uint8_t i = 0; i < SMS_SOS_TAG_BYTES; i++) text.appendf("%02x", mac[i]);
+}
+
+// Clave SMS del dispositivo: HMAC-SHA256(SMS_SOS_PSK, deviceId) truncado. Se
+// deriva al aprovisionar y queda en el blob de configuración; el backend guarda
+// la misma en el documento del dispositivo al vincularlo (onDeviceLinked)
+void deriveSmsKey() {
+    uint8_t mac[32];
+    mbedtls_md_hmac(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256),
+                    (const uint8_t*)SMS_SOS_PSK, strlen(SMS_SOS_PSK),
+                    (const uint8_t*)deviceId.c_str(), deviceId.length(), mac);
+    config.setSmsKey(mac);
+}
+
+// Intenta entregar una alerta de la bandeja; solo un 2xx la retira.
+// Multicamino: el SMS se arma y el driver lo envía en cuanto el POST queda en vuelo.
+bool deliverSos(const SosPending& p) {
+    JsonDocument extra(&extraArena);
+    extra["sosEpoch"] = sosOutbox.epoch();  // El backend deduplica reintentos (y SMS/datos)
+    extra["sosSeq"] = p.seq;                // por (época, secuencia)
+    uint32_t seq = p.seq;     // p apunta a la bandeja: copiar antes de onResult()
+    bool withSms = p.smsPending && smsGateway.length() > 0;
+    if (withSms) {
+        FixedString<SMS_TEXT_MAX> smsText;
+        sosSmsText(p, smsText);
+        modem->armSms(smsGateway.c_str(), smsText.c_str());
     }
-    Serial.println("[SOS] ✓ DISPARO 1 exitoso");
-    
-    // ===== ESPERA ACTIVA PARA GPS =====
-    Serial.println("[SOS] Iniciando búsqueda GPS (cold start)...");
-    modem->initGNSS();
-    
-    GPSLocation preciseLocation = {0.0, 0.0, 999.0, 0, false};
-    unsigned long gpsStart = millis();
-    bool gpsFound = false;
-    
-    while ((millis() - gpsStart) < GPS_COLD_START_TIME) {
-        if (modem->getLocation(preciseLocation)) {
-            if (preciseLocation.isValid) {
-                gpsFound = true;
+
+    radio.cellularBegin(millis());
+
+    energy.set(EnergyMeter::MODEM_TX, true, millis());
+    bool ok = false;
+    if (!p.hasFix && modem->sosSlotReady()) {
+        // Ruta rápida: cuerpo pre-serializado sobre la sesión HTTP ya abierta
+        ok = modem->sendSOSFast(p.type, sosOutbox.epoch(), seq);
+        if (!ok) Serial.println("[SOS] Slot rápido falló - usando ruta completa");
+    }
+    if (!ok) {
+        // Si el intento rápido llegó al servidor, el backend lo deduplica por (sosEpoch, sosSeq)
+        ok = modem->sendSOSAlert(deviceId.c_str(), ownerUid.c_str(), SosOutbox::typeName(p.type), SosOutbox::toLocation(p), &extra);
+    }
+    radio.cellularEnd(millis());
+    energy.set(EnergyMeter::MODEM_TX, false, millis());
+
+    if (withSms) {
+        // El POST falló antes de quedar en vuelo: el SMS sale ahora.
+        // Si los datos confirmaron sin que saliera, se descarta.
+        if (modem->smsState() == IModem::SmsState::ARMED && !ok) {
+            modem->sendArmedSms();
+        }
+        if (modem->smsState() == IModem::SmsState::SENT || modem->smsState() == IModem::SmsState::FAILED) {
+            sosOutbox.onSmsResult(seq, modem->smsState() == IModem::SmsState::SENT, modem->smsDoneMs());
+        }
+        modem->disarmSms();
+    }
+    sosOutbox.onResult(seq, ok, millis());
+    jobs.at(jobSlot, millis());  // Cualquier POST cierra el slot pre-armado
+    return ok;
+}
+
+// Entrada a un estado SOS: solo registra la alerta, no bloquea
+void sosBegin(const char* sosType) {
+    Serial.printf("[SOS] Iniciando alerta: %s\n", sosType);
+    memset(sos.stageMs, 0, sizeof(sos.stageMs));
+    sos.type = sosType;
+    sos.triggerMs = millis();
+    sos.stageStartMs = sos.triggerMs;
+    sos.shot1Ok = false;
+    sos.shot2Ok = false;
+    sos.stage = SosStage::TRIGGER;
+    jobs.at(jobSos, millis());
+}
+
+void sosEnterGeneral() { sosBegin("general"); }
+void sosEnterMedica() { sosBegin("medica"); }
+void sosEnterSeguridad() { sosBegin("seguridad"); }
+
+// Salida de un estado SOS: con el pipeline aún activo es el timeout de la máquina
+void sosExit() {
+    if (!sosActive()) return;
+    Serial.printf("[SOS] ⚠️ Pipeline abortado en etapa %s\n", SOS_STAGE_NAMES[(int)sos.stage]);
+    sosEnterStage(SosStage::DONE);
+    printSosTimings();
+    sos.stage = SosStage::IDLE;
+}
+
+void sosStep() {
+    switch (sos.stage) {
+        case SosStage::IDLE:
+            return;
+
+        case SosStage::TRIGGER: {
+            // Persistir el Disparo 1 antes de tocar el módem: si no sale ahora, se reintenta
+            GPSLocation emptyLocation = {0.0, 0.0, 999.0, 0, false}; // GPS inválido
+            sos.shot1Seq = sosOutbox.enqueue(sos.type.c_str(), emptyLocation, millis(), sosMultipath && smsGateway.length() > 0);
+            sos.shot2Seq = 0;
+            if (!modem || !modem->isConnected()) {
+                Serial.println("[SOS] ✗ Modem no disponible - alerta en bandeja de salida");
+                sosEnterStage(SosStage::DONE);
+                return;
+            }
+            // Energizar GNSS antes del Disparo 1: el motor adquiere mientras sale el POST
+            // (solo es un AT+CGNSSPWR; no se sondea el GNSS durante la transacción)
+            gnssPowerOn();
+            sosEnterStage(SosStage::SHOT1);
+            // Sin return: el Disparo 1 sale en esta misma pasada del loop
+        }
+        // fall through
+
+        case SosStage::SHOT1: {
+            Serial.printf("[SOS] DISPARO 1 (seq %lu): Enviando alerta vacía (Backend consulta lastLocation)...\n",
+                (unsigned long)sos.shot1Seq);
+            const SosPending* pending = sosOutbox.find(sos.shot1Seq);
+            sos.shot1Ok = pending && deliverSos(*pending);
+            if (sos.shot1Ok) {
+                Serial.println("[SOS] ✓ DISPARO 1 exitoso");
+                lastHeartbeat = millis();  // El backend acaba de ver al dispositivo
+            } else {
+                // Queda en la bandeja con backoff; seguir buscando fix para el Disparo 2
+                Serial.println("[SOS] ✗ DISPARO 1 falló - se reintentará");
+            }
+            Serial.println("[SOS] Esperando fix GPS (GNSS ya en adquisición)...");
+            sos.fix = GPSLocation{0.0, 0.0, 999.0, 0, false};
+            sos.lastPollMs = 0;
+            sosEnterStage(SosStage::FIX);
+            return;
+        }
+
+        case SosStage::FIX: {
+            uint32_t now = millis();
+            if ((now - sos.stageStartMs) >= GPS_COLD_START_TIME) {
+                Serial.println("[SOS] ⚠️ GPS no disponible - sin Disparo 2");
+                sosEnterStage(SosStage::DONE);
+                return;
+            }
+            if (sos.lastPollMs != 0 && (now - sos.lastPollMs) < SOS_FIX_POLL_MS) return;
+            sos.lastPollMs = now;
+
+            // Un solo sondeo por pasada
+            if (gnssPowerOn() && modem->getLocation(sos.fix) && sos.fix.isValid) {
+                radio.onFix(millis());
                 Serial.printf("[SOS] ✓ GPS válido: %.6f, %.6f (accuracy: %.1fm)\n", 
-                    preciseLocation.latitude, preciseLocation.longitude, preciseLocation.accuracy);
-                break;
+                    sos.fix.latitude, sos.fix.longitude, sos.fix.accuracy);
+                sosEnterStage(SosStage::SHOT2);
             }
+            return;
         }
-        delay(100);
-    }
-    
-    // ===== DISPARO 2: PRECISO (si GPS disponible) =====
-    if (gpsFound) {
-        Serial.println("[SOS] DISPARO 2: Enviando ubicación precisa...");
-        bool sent2 = modem->sendSOSAlert(deviceId, ownerUid, sosType, preciseLocation);
-        if (sent2) {
-            Serial.println("[SOS] ✓ DISPARO 2 exitoso");
-            lastLocation = preciseLocation; // Actualizar últimas coordenadas
-        } else {
-            Serial.println("[SOS] ⚠️ DISPARO 2 falló (pero alerta ya enviada)");
+
+        case SosStage::SHOT2: {
+            sos.shot2Seq = sosOutbox.enqueue(sos.type.c_str(), sos.fix, millis(), sosMultipath && smsGateway.length() > 0);
+            lastLocation = sos.fix; // Actualizar últimas coordenadas
+            gnssScheduler.onFix(sos.fix, millis());
+            Serial.printf("[SOS] DISPARO 2 (seq %lu): Enviando ubicación precisa...\n", (unsigned long)sos.shot2Seq);
+            const SosPending* pending = sosOutbox.find(sos.shot2Seq);
+            sos.shot2Ok = pending && deliverSos(*pending);
+            if (sos.shot2Ok) {
+                Serial.println("[SOS] ✓ DISPARO 2 exitoso");
+            } else {
+                Serial.println("[SOS] ⚠️ DISPARO 2 falló - se reintentará");
+            }
+            sosEnterStage(SosStage::DONE);
+            return;
         }
+
+        case SosStage::DONE:
+            // Primera pasada en DONE: reportar tiempos y pasar a seguimiento en vivo
+            if (sos.stageMs[(int)SosStage::DONE] == 0) {
+                sos.stageMs[(int)SosStage::DONE] = 1;
+                printSosTimings();
+                // Con el Disparo 1 entregado o en bandeja, la alerta sigue viva
+                if (modem && modem->isConnected()) {
+                    sosTracker.begin(sos.type.c_str(), millis());
+                    uint16_t mv;
+                    if (modem->getBatteryMillivolts(mv)) sosTracker.setBatteryMillivolts(mv);
+                }
+            }
+            // Mantener el LED de alerta un momento y volver a ONLINE para permitir nuevos disparos
+            if ((millis() - sos.stageStartMs) >= SOS_LED_HOLD_MS) {
+                sos.stage = SosStage::IDLE;
+                deviceEvent(DeviceEvent::SOS_DONE);
+            }
+            return;
+    }
+}
+
+// ===== MODO APROVISIONAMIENTO BLE =====
+// PROVISIONING anuncia por BLE hasta que la app escribe el blob o el UID (o
+// vence FSM_PROVISIONING_MS). En LINKING el módem se levanta en paralelo con
+// la app creando el documento en Firestore; se pasa a ONLINE apenas ambos
+// están listos (ver linkJob). La conexión sigue abierta sin anunciar hasta el primer heartbeat 2xx
+// (o PROV_SESSION_MS) para que la app vea el progreso por notificaciones.
+void bleSessionClose() {
+    if (!bleSessionOpen) return;
+    bleAdvWanted = false;
+    NimBLEDevice::deinit(true);
+    bleProfile.sessionEnd(millis());
+    pServer = nullptr;
+    pAdvertising = nullptr;
+    pCharProvStatus = nullptr;
+    pCharDiag = nullptr;
+    energy.set(EnergyMeter::BLE_ADV, false, millis());
+    bleConnected = false;
+    bleSessionOpen = false;
+    bleSessionClosing = false;
+    jobs.cancel(jobBleSession);
+    jobs.cancel(jobDiag);
+    Serial.printf("[BLE] Sesión de %s cerrada\n", diagActive ? "diagnóstico" : "aprovisionamiento");
+    diagActive = false;
+    diagAuthenticated = false;
+}
+
+// Tras la última notificación: margen para que salga y luego apagar
+void bleSessionFinish(ProvStage stage, ProvError code, uint16_t value) {
+    provNotify(stage, code, value);
+    bleSessionClosing = true;
+    jobs.in(jobBleSession, PROV_CLOSE_GRACE_MS, millis());
+}
+
+void bleSessionJob() {
+    if (!bleSessionOpen) return;
+    if (bleSessionClosing) {
+        bleSessionClose();
+        return;
+    }
+    Serial.println("[BLE] El backend no confirmó a tiempo - cerrando sesión");
+    bleSessionFinish(ProvStage::FAILED, ProvError::TIMEOUT, 0);
+}
+
+// Heartbeat con la sesión abierta: el primer 2xx confirma el alta en el backend
+void provisioningReport(int status) {
+    if (!bleSessionOpen || bleSessionClosing || diagActive || fsm.state() == DeviceState::PROVISIONING) return;
+    if (status >= 200 && status < 300) {
+        bleSessionFinish(ProvStage::BACKEND_OK, ProvError::OK, status);
     } else {
-        Serial.println("[SOS] ⚠️ GPS no disponible - Solo Disparo 1 enviado");
+        provNotify(ProvStage::BACKEND_RETRY, ProvError::OK, status > 0 ? status : 0);
     }
-    
-    // Actualizar estado (updateLEDs() manejará el LED)
-    deviceState = (sosType == "general") ? DeviceState::SOS_GENERAL :
-                  (sosType == "medica") ? DeviceState::SOS_MEDICA : DeviceState::SOS_SEGURIDAD;
+}
 
-    // Volver a ONLINE tras completar la alerta para permitir nuevos disparos
-    deviceState = DeviceState::ONLINE;
+// Campos opcionales del blob: misma copia de trabajo + config que los comandos seriales
+void applyProvisioning(const ProvisioningRequest& req) {
+    // APN o endpoint nuevos: el módem que levantó setup() no sirve para vincular
+    if (req.hasApn && strcmp(config.get().modemApn, req.apn) != 0) linkModemStale = true;
+    if (req.hasEndpoint && strcmp(config.get().endpoint, req.endpoint) != 0) linkModemStale = true;
+    if (req.hasApn) {
+        config.setApn(req.apn);
+        modemApn = req.apn[0] ? req.apn : "web.gprsuniversal";
+    }
+    if (req.hasProfile) {
+        modemPsm = req.profile & PROV_PROFILE_PSM;
+        energyInHeartbeat = req.profile & PROV_PROFILE_ENERGY_HB;
+        config.setPsm(modemPsm);
+        config.setEnergyInHeartbeat(energyInHeartbeat);
+    }
+    if (req.hasSmsGateway) {
+        smsGateway = req.smsGateway;
+        config.setSmsGateway(smsGateway.c_str());
+    }
+    if (req.hasEndpoint) config.setEndpoint(req.endpoint);
 }
 
-// ===== ACTIVAR MODO APROVISIONAMIENTO BLE =====
-// Inicia el flujo de vinculación BLE con la app
-void enterProvisioningMode() {
+void provisioningEnter() {
     Serial.println("\n[BLE] Activando modo aprovisionamiento...");
-    deviceState = DeviceState::PROVISIONING;
-    
+    linkBackendReady = false;
+    if (diagActive) bleSessionClose();   // El aprovisionamiento manda sobre el diagnóstico
     setupBLE();
-    
     Serial.println("[LED] FIJO = Esperando App | PARPADEO = Conectando");
-    
-    unsigned long startTime = millis();
-    while (!isProvisioned && (millis() - startTime) < 300000) {  // Timeout 5 min
-        delay(50);
-        
-        if (bleConnected) {
-            Serial.println("[PROVISIONING] Cliente conectado...");
+}
+
+// Deja de anunciar; la conexión con la app sigue para las notificaciones
+void provisioningExit() {
+    bleAdvWanted = false;
+    if (pAdvertising) pAdvertising->stop();
+    if (!bleConnected) bleProfile.enter(BleAdvProfile::OFF, millis());
+    energy.set(EnergyMeter::BLE_ADV, false, millis());
+}
+
+void provisioningTimeout() {
+    Serial.println("[BLE] Timeout - Volviendo a IDLE");
+    bleSessionClose();
+}
+
+void linkingEnter() {
+    Serial.println("[BLE] Vinculacion exitosa - levantando módem mientras la app crea el documento");
+    linkPolls = 0;
+    jobs.at(jobLink, millis());
+}
+
+// Vinculación en dos frentes: módem registrado (aquí) y documento creado (la
+// app lo avisa por BLE o se consulta checkDeviceStatus con backoff). Si nada
+// confirma en FSM_LINKING_MS, el timer de LINKING pasa a ONLINE igual
+void linkJob() {
+    if (fsm.state() != DeviceState::LINKING) return;
+
+    if (linkModemStale || !modem || !modem->isConnected()) {
+        linkModemStale = false;
+        delete modem;
+        modem = nullptr;
+        setupModem();
+        if (!modem) {
+            jobs.in(jobLink, LINK_POLL_MAX_MS, millis());
+            return;
         }
     }
-    
-    if (!isProvisioned) {
-        Serial.println("[BLE] Timeout - Volviendo a IDLE");
-        NimBLEDevice::deinit(true);
-        deviceState = DeviceState::IDLE;
+
+    if (linkBackendReady) {
+        deviceEvent(DeviceEvent::LINK_READY);
         return;
     }
-    
-    // Vinculación exitosa
-    Serial.println("[BLE] Vinculacion exitosa");
-    
-    // Apagar BLE
-    NimBLEDevice::deinit(true);
-    bleConnected = false;
-    
-    // Dar tiempo a la app para crear el documento en Firestore (20s para evitar race condition)
-    Serial.println("[BLE] Esperando 20s para que la app complete la vinculación en Firestore...");
-    delay(20000);
-    
-    // Inicializar módem y pasar a ONLINE SIN REINICIAR
-    setupModem();
-    deviceState = DeviceState::ONLINE;
-    Serial.println("[BLE] Modo ONLINE activado");
+    // El documento pudo quedar de un dueño anterior: solo cuenta el nuestro
+    String owner = modem->checkProvisioningStatus(deviceId.c_str());
+    if (owner.length() > 0 && ownerUid.equals(owner.c_str())) {
+        deviceEvent(DeviceEvent::LINK_READY);
+        return;
+    }
+    uint32_t wait = LINK_POLL_FIRST_MS << (linkPolls < 3 ? linkPolls : 3);
+    if (wait > LINK_POLL_MAX_MS) wait = LINK_POLL_MAX_MS;
+    if (linkPolls < 0xFF) linkPolls++;
+    Serial.printf("[LINK] Documento aún no visible - nueva consulta en %lus\n", (unsigned long)(wait / 1000));
+    jobs.in(jobLink, wait, millis());
+}
+
+// ONLINE SIN REINICIAR: el primer heartbeat sale ya, no al cumplirse el intervalo
+void linkingDone() {
+    provNotify(ProvStage::LINKED);
+    lastHeartbeat = millis() - heartbeatIntervalMs;
+    jobs.at(jobHeartbeat, millis());
+    Serial.printf("[BLE] Modo ONLINE activado (%u consultas al backend)\n", linkPolls);
+}
+
+// Sin confirmación: mismo comportamiento que la espera fija anterior
+void linkingTimeout() {
+    jobs.cancel(jobLink);
+    if (!modem || !modem->isConnected()) {
+        delete modem;
+        modem = nullptr;
+        setupModem();
+    }
+    lastHeartbeat = millis() - heartbeatIntervalMs;
+    jobs.at(jobHeartbeat, millis());
+    Serial.println("[BLE] Vinculación sin confirmar - Modo ONLINE activado");
 }
 
 // ===== LECTURA DE BOTONES =====
-// Detecta pulsaciones largas para SOS o vinculación
+// Ejecuta las acciones que decidió la tarea de entrada (inputTask). La medición
+// de los 3 s / 5 s y la decisión no dependen del loop; aquí solo se actúa.
 void checkButtons() {
-    static unsigned long btnHoldStart = 0;
-    static bool btnWasPressed = false;
-    static bool actionTriggered = false;
-    static unsigned long lastLogTime = 0;
-    
-    // Botón SOS principal - detectar hold
-    if (digitalRead(PIN_BTN_SOS) == LOW) {
-        if (!btnWasPressed) {
-            btnWasPressed = true;
-            btnHoldStart = millis();
-            actionTriggered = false;
-            Serial.println("[BTN] Botón SOS presionado - Iniciando contador...");
+    InputAction action;
+    while (xQueueReceive(inputActions, &action, 0) == pdTRUE) {
+        uint32_t lagMs = millis() - action.atMs;  // > 0 si el módem estaba ocupado
+        const char* name = BUTTON_SOS_TYPES[action.button];
+
+        // Las guardas de la tabla revalidan: el estado pudo cambiar mientras la acción esperaba
+        if (action.type == InputAction::Type::PAIR) {
+            Serial.printf("[BTN] ✓ 5s detectados (atendido +%lu ms) - Activando vinculación\n", (unsigned long)lagMs);
+            if (!deviceEvent(DeviceEvent::PAIR_REQUEST)) {
+                Serial.printf("[BTN] Vinculación ignorada en %s\n", fsm.stateName(fsm.state()));
+            }
+            continue;
         }
-        
-        unsigned long holdTime = millis() - btnHoldStart;
-        
-        // Log cada segundo mientras se mantiene presionado
-        if ((millis() - lastLogTime) >= 1000) {
-            lastLogTime = millis();
-            Serial.printf("[BTN] Manteniendo... %lu segundos\n", holdTime / 1000);
+
+        if (isProvisioned) {
+            Serial.printf("[BTN] ✓ 3s detectados en %s (atendido +%lu ms) - Enviando SOS\n", name, (unsigned long)lagMs);
+            if (!deviceEvent(BUTTON_SOS_EVENTS[action.button])) {
+                Serial.printf("[SOS] Pulsación ignorada en %s\n", fsm.stateName(fsm.state()));
+            }
         }
-        
-        // 5 segundos = Activar vinculación (solo si no aprovisionado y en IDLE)
-        if (holdTime >= 5000 && !actionTriggered && !isProvisioned && deviceState == DeviceState::IDLE) {
-            actionTriggered = true;
-            Serial.println("[BTN] ✓ 5s detectados - Activando vinculación");
-            enterProvisioningMode();
-            return;
+    }
+}
+
+// ===== ACTUALIZACIÓN OTA =====
+// El heartbeat avisa ("ota":true) y otaJob consulta el manifiesto cuando el
+// dispositivo está ONLINE sin nada pendiente. En OTA_UPDATE baja un rango por
+// pasada (OTA_RANGE_BYTES): entre rangos el loop atiende botones, heartbeat y
+// una alerta, que interrumpe la descarga sin perder lo escrito.
+void otaEnter() {
+    otaRetryMs = OTA_RETRY_FIRST_MS;
+    Serial.printf("[OTA] Descarga de %s desde %lu/%lu bytes\n", otaManifest.version,
+        (unsigned long)ota.offset(), (unsigned long)otaManifest.size);
+    jobs.at(jobOta, millis());
+}
+
+void otaExit() {
+    jobs.cancel(jobOta);
+}
+
+void otaTimeout() {
+    Serial.println("[OTA] ✗ Descarga colgada - se descarta");
+    ota.abort();
+}
+
+// Antes de reanudar (tras una alerta o un rango fallido) el backend pudo
+// publicar otra imagen: si cambió, lo escrito no sirve y se vuelve al byte 0.
+// false: no se puede seguir ahora (sin respuesta, retirada o rechazada)
+bool otaRefreshManifest() {
+    OtaManifest fresh;
+    uint32_t now = millis();
+    radio.cellularBegin(now);
+    energy.set(EnergyMeter::MODEM_TX, true, now);
+    bool published = modem->checkForUpdates(deviceId.c_str(), FIRMWARE_VERSION, fresh);
+    radio.cellularEnd(millis());
+    energy.set(EnergyMeter::MODEM_TX, false, millis());
+    jobs.at(jobSlot, millis());
+    otaCheckPending = false;
+
+    if (published && ota.matches(fresh)) return true;
+    int st = modem->getLastHttpStatus();
+    if (!published && (st < 200 || st >= 300)) return false;   // Sin respuesta: la sesión sigue
+    if (!published) {
+        Serial.println("[OTA] La imagen ya no está publicada - se descarta lo descargado");
+        ota.abort();
+        return false;
+    }
+    if (OtaUpdater::isRejected(fresh.version)) {
+        Serial.printf("[OTA] Ahora se publica %s, ya rechazada - se descarta lo descargado\n", fresh.version);
+        ota.abort();
+        return false;
+    }
+    Serial.printf("[OTA] El manifiesto cambió (%s -> %s) - descarga desde el byte 0\n",
+        otaManifest.version, fresh.version);
+    otaManifest = fresh;
+    otaFailures = 0;
+    return ota.begin(otaManifest);   // begin() descarta la sesión anterior
+}
+
+// Un rango por llamada; reinicia en la imagen nueva cuando está completa y verificada
+void otaStep() {
+    uint32_t now = millis();
+    if (ota.isComplete()) {
+        if (modem->applyFirmwareUpdate(ota)) {
+            Serial.println("[OTA] Reiniciando en la imagen nueva...");
+            config.commit(true);
+            delay(500);
+            ESP.restart();
         }
-        
-        // 3 segundos = Enviar SOS (solo si aprovisionado)
-            if (holdTime >= 3000 && !actionTriggered && isProvisioned) {
-            actionTriggered = true;
-            Serial.println("[BTN] ✓ 3s detectados - Enviando SOS");
-            sendSOSAlert("general");
+        deviceEvent(DeviceEvent::OTA_END);
+        return;
+    }
+    if (!ota.isActive()) {       // Error de flash: la sesión ya se descartó
+        deviceEvent(DeviceEvent::OTA_END);
+        return;
+    }
+
+    bool ok = false;
+    // Un reintento confirma antes que la imagen publicada sigue siendo la misma
+    if (modem && modem->isConnected() && (otaFailures == 0 || otaRefreshManifest())) {
+        radio.cellularBegin(now);
+        energy.set(EnergyMeter::MODEM_TX, true, now);
+        ok = modem->downloadFirmwareUpdate(otaManifest, ota);
+        radio.cellularEnd(millis());
+        energy.set(EnergyMeter::MODEM_TX, false, millis());
+        jobs.at(jobSlot, millis());  // La descarga cerró la sesión HTTP del slot
+    }
+    if (ok) {
+        otaFailures = 0;
+        otaRetryMs = OTA_RETRY_FIRST_MS;
+        jobs.at(jobOta, millis());
+        return;
+    }
+    if (!ota.isActive() || ++otaFailures >= OTA_MAX_FAILURES) {
+        Serial.println("[OTA] ✗ Descarga abandonada");
+        ota.abort();
+        otaFailures = 0;
+        deviceEvent(DeviceEvent::OTA_END);
+        return;
+    }
+    Serial.printf("[OTA] Reintento %u/%u en %lu s desde el byte %lu\n", otaFailures, OTA_MAX_FAILURES,
+        (unsigned long)(otaRetryMs / 1000), (unsigned long)ota.offset());
+    jobs.in(jobOta, otaRetryMs, millis());
+    otaRetryMs = otaRetryMs * 2 > OTA_RETRY_MAX_MS ? OTA_RETRY_MAX_MS : otaRetryMs * 2;
+}
+
+void otaJob() {
+    uint32_t now = millis();
+    DeviceState state = fsm.state();
+    if (state == DeviceState::OTA_UPDATE) {
+        otaStep();
+        return;
+    }
+    if (state != DeviceState::ONLINE) return;   // Tras una alerta la rearma sosJob
+    if (!ota.isActive() && !otaCheckPending) return;
+
+    // Primero lo que no puede esperar: alertas, bandeja, imagen en prueba, vinculación
+    if (!modem || !modem->isConnected() || sosTracker.isActive() || !sosOutbox.isEmpty() ||
+        OtaUpdater::trialPending() || bleSessionOpen) {
+        jobs.in(jobOta, OTA_RETRY_MAX_MS, now);
+        return;
+    }
+    if (ota.isActive()) {
+        // Descarga interrumpida por una alerta: sigue solo si la imagen no cambió
+        if (!otaRefreshManifest()) {
+            if (ota.isActive()) jobs.in(jobOta, OTA_RETRY_MAX_MS, millis());
             return;
         }
     } else {
-        if (btnWasPressed && !actionTriggered) {
-            unsigned long holdTime = millis() - btnHoldStart;
-            Serial.printf("[BTN] Soltado después de %lu ms (sin acción)\n", holdTime);
+        otaCheckPending = false;
+        radio.cellularBegin(now);
+        energy.set(EnergyMeter::MODEM_TX, true, now);
+        bool published = modem->checkForUpdates(deviceId.c_str(), FIRMWARE_VERSION, otaManifest);
+        radio.cellularEnd(millis());
+        energy.set(EnergyMeter::MODEM_TX, false, millis());
+        jobs.at(jobSlot, millis());
+        if (!published) return;
+        if (OtaUpdater::isRejected(otaManifest.version)) {
+            Serial.printf("[OTA] %s ya fue rechazada - se ignora\n", otaManifest.version);
+            return;
         }
-        btnWasPressed = false;
-        actionTriggered = false;
+        if (!ota.begin(otaManifest)) return;
+        otaFailures = 0;
     }
-    
-    // Solo verificar otros botones si está aprovisionado
-    if (!isProvisioned) return;
-    
-    // Botón Médica
-    if (digitalRead(PIN_BTN_MEDICA) == LOW) {
-        delay(BUTTON_DEBOUNCE_TIME);
-        if (digitalRead(PIN_BTN_MEDICA) == LOW) {
-            unsigned long start = millis();
-            while (digitalRead(PIN_BTN_MEDICA) == LOW && (millis() - start) < 3000) delay(50);
-            if ((millis() - start) >= 3000) {
-                sendSOSAlert("medica");
-            }
-        }
+    deviceEvent(DeviceEvent::OTA_BEGIN);
+}
+
+// Período de prueba: el veredicto solo cuenta desde que el módem se registró
+// (otaTrialNoteRegistered reprograma el plazo). Registrada y sin heartbeat 2xx
+// en OTA_HEALTH_MS, la imagen no sirve y queda rechazada. Sin registro no se
+// puede juzgar: vuelve a la anterior sin rechazarla y la descarga se repite
+// con cobertura. Nunca con una alerta en curso: el reinicio espera a que termine
+void otaHealthJob() {
+    if (!OtaUpdater::trialPending()) return;
+    if (sosActive() || sosTracker.isActive() || !sosOutbox.isEmpty()) {
+        jobs.in(jobOtaHealth, OTA_RETRY_MAX_MS, millis());
+        return;
     }
-    
-    // Botón Seguridad
-    if (digitalRead(PIN_BTN_SEGURIDAD) == LOW) {
-        delay(BUTTON_DEBOUNCE_TIME);
-        if (digitalRead(PIN_BTN_SEGURIDAD) == LOW) {
-            unsigned long start = millis();
-            while (digitalRead(PIN_BTN_SEGURIDAD) == LOW && (millis() - start) < 3000) delay(50);
-            if ((millis() - start) >= 3000) {
-                sendSOSAlert("seguridad");
-            }
-        }
+    if (!otaTrialRegistered) {
+        OtaUpdater::rollback("sin registro en la red durante la prueba", false);
+        return;
     }
+    OtaUpdater::rollback("sin heartbeat 2xx tras registrarse en la red");
+}
+
+// Primer registro de la imagen en prueba: desde aquí corre el plazo del heartbeat
+void otaTrialNoteRegistered() {
+    if (otaTrialRegistered || !OtaUpdater::trialPending() || !modem || !modem->isConnected()) return;
+    otaTrialRegistered = true;
+    jobs.in(jobOtaHealth, OTA_HEALTH_MS, millis());
+    Serial.println("[OTA] Imagen en prueba registrada en la red - esperando heartbeat 2xx");
 }
 
 // ===== MÁQUINA DE ESTADOS PRINCIPAL =====
-// Cambia el comportamiento según el estado global
-void updateStateMachine() {
-    if (deviceState == previousState) return;
-    
-    // Log compacto de transición (protección de rango)
-    const char* stateNames[] = {"IDLE","PROVISIONING","ONLINE","SOS_GEN","SOS_MED","SOS_SEG","OTA"};
-    int prevIdx = (int)previousState;
-    int curIdx = (int)deviceState;
-    const int STATE_COUNT = sizeof(stateNames) / sizeof(stateNames[0]);
-    if (prevIdx >= 0 && prevIdx < STATE_COUNT && curIdx >= 0 && curIdx < STATE_COUNT) {
-        Serial.printf("[STATE] %s -> %s\n", stateNames[prevIdx], stateNames[curIdx]);
-    } else {
-        Serial.printf("[STATE] %d -> %d\n", prevIdx, curIdx);
-    }
-    
-    // Los LEDs se actualizan en updateLEDs(), no aquí
-    previousState = deviceState;
+// Entradas/salidas y transiciones por tabla. Los eventos llegan de los botones
+// (checkButtons), BLE (APP_EVT_BLE), el pipeline SOS y el timer de cada estado
+bool guardProvisioned() { return isProvisioned; }
+bool guardUnprovisioned() { return !isProvisioned; }
+
+// Indexada por DeviceState
+const StateDef DEVICE_STATES[FSM_STATE_COUNT] = {
+    {"IDLE",         nullptr,           nullptr,           0},
+    {"PROVISIONING", provisioningEnter, provisioningExit,  FSM_PROVISIONING_MS},
+    {"ONLINE",       nullptr,           nullptr,           0},
+    {"SOS_GEN",      sosEnterGeneral,   sosExit,           FSM_SOS_MAX_MS},
+    {"SOS_MED",      sosEnterMedica,    sosExit,           FSM_SOS_MAX_MS},
+    {"SOS_SEG",      sosEnterSeguridad, sosExit,           FSM_SOS_MAX_MS},
+    {"OTA",          otaEnter,          otaExit,           FSM_OTA_MAX_MS},
+    {"LINKING",      linkingEnter,      nullptr,           FSM_LINKING_MS},
+};
+
+const TransitionDef DEVICE_TRANSITIONS[] = {
+    {DeviceState::IDLE,          DeviceEvent::PAIR_REQUEST,    guardUnprovisioned, nullptr,             DeviceState::PROVISIONING},
+    {DeviceState::PROVISIONING,  DeviceEvent::BLE_PROVISIONED, guardProvisioned,   nullptr,             DeviceState::LINKING},
+    {DeviceState::PROVISIONING,  DeviceEvent::TIMEOUT,         nullptr,            provisioningTimeout, DeviceState::IDLE},
+    {DeviceState::LINKING,       DeviceEvent::LINK_READY,      nullptr,            linkingDone,         DeviceState::ONLINE},
+    {DeviceState::LINKING,       DeviceEvent::TIMEOUT,         nullptr,            linkingTimeout,      DeviceState::ONLINE},
+    {DeviceState::ONLINE,        DeviceEvent::SOS_GENERAL,     guardProvisioned,   nullptr,             DeviceState::SOS_GENERAL},
+    {DeviceState::ONLINE,        DeviceEvent::SOS_MEDICA,      guardProvisioned,   nullptr,             DeviceState::SOS_MEDICA},
+    {DeviceState::ONLINE,        DeviceEvent::SOS_SEGURIDAD,   guardProvisioned,   nullptr,             DeviceState::SOS_SEGURIDAD},
+    {DeviceState::SOS_GENERAL,   DeviceEvent::SOS_DONE,        nullptr,            nullptr,             DeviceState::ONLINE},
+    {DeviceState::SOS_MEDICA,    DeviceEvent::SOS_DONE,        nullptr,            nullptr,             DeviceState::ONLINE},
+    {DeviceState::SOS_SEGURIDAD, DeviceEvent::SOS_DONE,        nullptr,            nullptr,             DeviceState::ONLINE},
+    {DeviceState::SOS_GENERAL,   DeviceEvent::TIMEOUT,         nullptr,            nullptr,             DeviceState::ONLINE},
+    {DeviceState::SOS_MEDICA,    DeviceEvent::TIMEOUT,         nullptr,            nullptr,             DeviceState::ONLINE},
+    {DeviceState::SOS_SEGURIDAD, DeviceEvent::TIMEOUT,         nullptr,            nullptr,             DeviceState::ONLINE},
+    {DeviceState::ONLINE,        DeviceEvent::OTA_BEGIN,       nullptr,            nullptr,             DeviceState::OTA_UPDATE},
+    {DeviceState::OTA_UPDATE,    DeviceEvent::OTA_END,         nullptr,            nullptr,             DeviceState::ONLINE},
+    {DeviceState::OTA_UPDATE,    DeviceEvent::TIMEOUT,         nullptr,            otaTimeout,          DeviceState::ONLINE},
+    // Una alerta interrumpe la descarga entre rangos; lo escrito se conserva
+    {DeviceState::OTA_UPDATE,    DeviceEvent::SOS_GENERAL,     guardProvisioned,   nullptr,             DeviceState::SOS_GENERAL},
+    {DeviceState::OTA_UPDATE,    DeviceEvent::SOS_MEDICA,      guardProvisioned,   nullptr,             DeviceState::SOS_MEDICA},
+    {DeviceState::OTA_UPDATE,    DeviceEvent::SOS_SEGURIDAD,   guardProvisioned,   nullptr,             DeviceState::SOS_SEGURIDAD},
+};
+
+void startStateMachine(DeviceState initial) {
+    fsm.begin(DEVICE_STATES, DEVICE_TRANSITIONS, sizeof(DEVICE_TRANSITIONS) / sizeof(DEVICE_TRANSITIONS[0]));
+    fsm.start(initial, millis());
+    uiRefresh();
+}
+
+// Solo desde la tarea del módem. Los LEDs los maneja la tarea UI: solo se le avisa
+bool deviceEvent(DeviceEvent event) {
+    bool moved = fsm.dispatch(event, millis());
+    if (moved) uiRefresh();
+    return moved;
+}
+
+bool isSosState(DeviceState s) {
+    return s >= DeviceState::SOS_GENERAL && s <= DeviceState::SOS_SEGURIDAD;
 }
 
 // ===== ACTUALIZACIÓN DE LEDS =====
@@ -480,32 +1308,53 @@ void updateStateMachine() {
 // - Vinculación: LED_LINK FIJO (Esperando) -> PARPADEA (Conectando)
 // - Alerta SOS: LED_ALERT parpadea RÁPIDO
 // - OTA: Ambos parpadean
-void updateLEDs() {
+// Corre en la tarea UI; devuelve los ms hasta el próximo cambio (LED_STATIC = fijo)
+#define LED_STATIC 0xFFFFFFFFUL
+
+// Parpadeo de semiperiodo halfMs: nivel actual y ms hasta el próximo cambio
+bool blinkLevel(uint32_t halfMs, uint32_t* nextChangeMs) {
+    uint32_t now = millis();
+    *nextChangeMs = halfMs - now % halfMs;
+    return (now / halfMs) % 2;
+}
+
+uint32_t updateLEDs() {
+    uint32_t next = LED_STATIC;
+    DeviceState state = fsm.state();
+    
     // OTA: Ambos LEDs parpadean
-    if (isOTAInProgress) {
-        bool blink = (millis() / 300) % 2;
+    if (state == DeviceState::OTA_UPDATE) {
+        bool blink = blinkLevel(300, &next);
         digitalWrite(PIN_LED_LINK, blink);
         #if defined(HARDWARE_B) || defined(HARDWARE_C)
             digitalWrite(PIN_LED_ALERT, blink);
         #endif
-        return;
+        return next;
+    }
+    
+    // Arranque en frío: LED_LINK parpadea los primeros BOOT_LED_BLINK_MS
+    uint32_t sinceBoot = millis() - bootTimestamp;
+    if (wakeReason == WakeReason::COLD && sinceBoot < BOOT_LED_BLINK_MS) {
+        digitalWrite(PIN_LED_LINK, (sinceBoot / 120) % 2 == 0);
+        next = 120 - sinceBoot % 120;
+        return next < BOOT_LED_BLINK_MS - sinceBoot ? next : BOOT_LED_BLINK_MS - sinceBoot;
     }
     
     // SOS: LED_ALERT parpadea RÁPIDO
-    if (deviceState >= DeviceState::SOS_GENERAL && deviceState <= DeviceState::SOS_SEGURIDAD) {
-        bool blinkFast = (millis() / 150) % 2;
+    if (isSosState(state)) {
+        bool blinkFast = blinkLevel(150, &next);
         digitalWrite(PIN_LED_LINK, LOW);
         #if defined(HARDWARE_B) || defined(HARDWARE_C)
             digitalWrite(PIN_LED_ALERT, blinkFast);
         #endif
-        return;
+        return next;
     }
     
-    // Vinculación: LED_LINK FIJO (esperando) -> PARPADEA (conectando)
-    if (deviceState == DeviceState::PROVISIONING) {
-        if (bleConnected) {
+    // Vinculación: LED_LINK FIJO (esperando) -> PARPADEA (conectando y hasta ONLINE)
+    if (state == DeviceState::PROVISIONING || state == DeviceState::LINKING) {
+        if (bleConnected || state == DeviceState::LINKING) {
             // Conectando: PARPADEA
-            bool blink = (millis() / 200) % 2;
+            bool blink = blinkLevel(200, &next);
             digitalWrite(PIN_LED_LINK, blink);
         } else {
             // Esperando: FIJO
@@ -514,7 +1363,7 @@ void updateLEDs() {
         #if defined(HARDWARE_B) || defined(HARDWARE_C)
             digitalWrite(PIN_LED_ALERT, LOW);
         #endif
-        return;
+        return next;
     }
 
     // Modo ONLINE/IDLE: LED_LINK apagado (Idle)
@@ -522,31 +1371,248 @@ void updateLEDs() {
     #if defined(HARDWARE_B) || defined(HARDWARE_C)
         digitalWrite(PIN_LED_ALERT, LOW);
     #endif
+    return next;
+}
+
+// ===== ENVÍO DE HEARTBEAT AL BACKEND =====
+// Único punto de envío: adjunta la versión de geocercas, sube lastLocation solo
+// si cambió y aplica las geocercas que devuelva el backend
+bool postHeartbeat(const GeofenceEvent* event) {
+    JsonDocument extra(&extraArena);
+    extra["geofenceVer"] = geofences.version();
+    extra["fw"] = FIRMWARE_VERSION;
+    if (smsGateway.length() > 0) extra["smsGw"] = smsGateway.c_str();
+    if (energyInHeartbeat) energy.fillJson(extra, millis());
+    // Fragmentación: el bloque mayor debe mantenerse plano en uptimes largos
+    extra["heap"]["free"] = ESP.getFreeHeap();
+    extra["heap"]["maxBlock"] = ESP.getMaxAllocHeap();
+    extra["heap"]["minFree"] = ESP.getMinFreeHeap();
+    // Seguimiento SOS: el backend mantiene el estado de alerta y guarda los puntos
+    uint8_t trackPoints = 0;
+    if (sosTracker.isActive()) {
+        char status[24];
+        snprintf(status, sizeof(status), "sos_%s", sosTracker.type().c_str());
+        extra["status"] = status;
+        trackPoints = sosTracker.fillJson(extra, millis());
+        SosTracker::EndReason end = sosTracker.checkEnd(millis());
+        if (end != SosTracker::EndReason::NONE) {
+            extra["sosTrackEnd"] = end == SosTracker::EndReason::TIMEOUT ? "timeout" : "low_battery";
+        }
+    }
+    if (event) {
+        extra["geofenceEvent"]["id"] = event->id;
+        extra["geofenceEvent"]["type"] = event->entered ? "enter" : "exit";
+    }
+
+    // Ubicación solo si se movió o si la última subida es vieja (o hay evento)
+    GPSLocation loc = lastLocation;
+    if (loc.isValid && !event && lastUploadedLocation.isValid &&
+        (millis() - lastLocationUploadMs) < LOCATION_REPORT_MAX_AGE_MS &&
+        GnssScheduler::distanceMeters(lastUploadedLocation.latitude, lastUploadedLocation.longitude,
+                                      loc.latitude, loc.longitude) < LOCATION_REPORT_MIN_MOVE_M) {
+        loc.isValid = false;
+        LOG_DEBUG("[HEARTBEAT] Sin cambio de ubicación - no se adjunta lastLocation");
+    }
+
+    uint32_t startMs = millis();
+    radio.cellularBegin(startMs);
+    energy.set(EnergyMeter::MODEM_TX, true, startMs);
+    bool sent = modem->sendHeartbeat(ownerUid.c_str(), deviceId.c_str(), loc, &extra);
+    radio.cellularEnd(millis());
+    energy.set(EnergyMeter::MODEM_TX, false, millis());
+    jobs.at(jobSlot, millis());  // Cualquier POST cierra el slot pre-armado
+
+    if (sosTracker.isActive()) {
+        sosTracker.onUpload(sent, trackPoints, millis() - startMs);
+        if (sent && modem->getLastHttpBody().indexOf("\"sos_clear\":true") != -1) {
+            sosTracker.stop(SosTracker::EndReason::CLEARED);
+        }
+    }
+
+    if (sent) {
+        if (loc.isValid) {
+            lastUploadedLocation = loc;
+            lastLocationUploadMs = millis();
+        }
+        // La arena del driver queda libre al volver del POST
+        if (geofences.applyJson(modem->getLastHttpBody().c_str(), modem->getJsonArena())) {
+            geofences.save();
+        }
+        // Gateway SMS para el despacho multicamino (solo llega si cambió)
+        const HttpBody& body = modem->getLastHttpBody();
+        int gw = body.indexOf("\"sms_gw\":\"");
+        if (gw != -1) {
+            int start = gw + 10;
+            int end = body.indexOf('"', start);
+            if (end > start) {
+                smsGateway.assign(body.c_str() + start, end - start);
+                config.setSmsGateway(smsGateway.c_str());
+                config.commit();
+                Serial.printf("[SMS] Gateway actualizado: %s\n", smsGateway.c_str());
+            }
+        }
+        // Pedido de diagnóstico BLE desde la app: "diag":{"pin":123456,"min":15}
+        int dg = body.indexOf("\"diag\":{");
+        if (dg != -1) {
+            int pinIdx = body.indexOf("\"pin\":", dg);
+            int minIdx = body.indexOf("\"min\":", dg);
+            if (pinIdx != -1) {
+                diagOpen((uint32_t)strtoul(body.c_str() + pinIdx + 6, nullptr, 10),
+                         minIdx != -1 ? (uint16_t)strtoul(body.c_str() + minIdx + 6, nullptr, 10) : 0);
+            }
+        }
+        // Hay otra versión publicada: otaJob consulta el manifiesto cuando pueda
+        if (body.indexOf("\"ota\":true") != -1 && !ota.isActive() && !otaCheckPending) {
+            otaCheckPending = true;
+            jobs.at(jobOta, millis());
+        }
+    }
+    return sent;
+}
+
+// ===== GEOCERCAS =====
+// Evalúa el fix y reporta de inmediato cada cruce confirmado
+void checkGeofences(const GPSLocation& fix) {
+    GeofenceEvent events[GEOFENCE_MAX];
+    uint8_t n = geofences.evaluate(fix, events, GEOFENCE_MAX);
+    for (uint8_t i = 0; i < n; i++) {
+        Serial.printf("[GEOFENCE] %s geocerca #%u -> reportando\n",
+            events[i].entered ? "Entrada a" : "Salida de", events[i].id);
+        if (postHeartbeat(&events[i])) {
+            lastHeartbeat = millis();  // El evento también cuenta como heartbeat
+        }
+    }
+    // Cruce sin confirmar: no esperar al intervalo estacionario para verificarlo
+    if (geofences.hasPendingCrossing()) {
+        gnssScheduler.requestSample(millis(), GNSS_INTERVAL_MIN_MS);
+    }
+}
+
+// ===== REINTENTOS DE ALERTAS SOS =====
+// Una alerta vencida por pasada. Mientras el pipeline envía sus disparos no se
+// interfiere; durante la espera de fix sí (un Disparo 1 fallido no espera 45 s).
+void sosOutboxStep() {
+    if (sosOutbox.isEmpty() || !modem || !modem->isConnected()) return;
+    if (sos.stage == SosStage::TRIGGER || sos.stage == SosStage::SHOT1 || sos.stage == SosStage::SHOT2) return;
+    const SosPending* p = sosOutbox.due(millis());
+    if (!p) return;
+    Serial.printf("[OUTBOX] Reintentando seq %lu (%s)\n", (unsigned long)p->seq, SosOutbox::typeName(p->type));
+    if (deliverSos(*p)) lastHeartbeat = millis();
+}
+
+// ===== SLOT SOS PRE-ARMADO =====
+// Mientras está online y sin alerta en curso, mantiene lista la sesión HTTP del
+// Disparo 1. Cualquier otro POST (heartbeat, reintentos) la cierra y vuelve a
+// armar este trabajo para ya. Tras un fallo espera SOS_SLOT_RETRY_MS.
+void sosSlotJob() {
+    uint32_t next = SOS_SLOT_CHECK_MS;
+    if (!modem || !modem->isConnected() || sosActive() || sosTracker.isActive()) {
+        // El fin del SOS lo vuelve a armar; esto cubre la espera de red
+        next = SOS_SLOT_RETRY_MS;
+    } else if (!modem->sosSlotReady()) {
+        if (!modem->prepareSosSlot(deviceId.c_str(), ownerUid.c_str())) next = SOS_SLOT_RETRY_MS;
+    } else {
+        modem->checkSosSlot();
+    }
+    jobs.in(jobSlot, next, millis());
+}
+
+// ===== SEGUIMIENTO SOS EN VIVO =====
+// Muestrea cada SOS_TRACK_SAMPLE_MS y envía en cuanto hay un lote listo.
+// Termina cuando la app cierra la alerta, por timeout o con batería baja.
+void sosTrackStep() {
+    if (!sosTracker.isActive() || sosActive()) return;
+
+    uint32_t now = millis();
+    SosTracker::EndReason end = sosTracker.checkEnd(now);
+    if (end != SosTracker::EndReason::NONE) {
+        // Último envío con lo pendiente y sosTrackEnd: el backend vuelve a "online"
+        Serial.printf("[TRACK] Fin por %s - enviando %u puntos finales\n",
+            SosTracker::reasonName(end), sosTracker.pendingCount());
+        if (postHeartbeat(nullptr)) lastHeartbeat = millis();
+        sosTracker.stop(end);
+        return;
+    }
+
+    if (!sosTracker.sampleDue(now)) return;
+
+    // El intervalo (30 s) es menor que GNSS_KEEP_ON_MAX_MS: GNSS encendido todo el seguimiento
+    GPSLocation fix = lastLocation;
+    if (gnssPowerOn() && modem->getLocation(fix) && fix.isValid) {
+        lastLocation = fix;
+        radio.onFix(millis());
+        gnssScheduler.onFix(fix, millis());
+        sosTracker.addPoint(fix, millis());
+        LOG_DEBUG(String("[TRACK] Punto ") + String(fix.latitude, 6) + "," + String(fix.longitude, 6));
+    } else {
+        sosTracker.onNoFix(millis());
+    }
+
+    if (sosTracker.uploadDue()) {
+        uint16_t mv;
+        if (modem->getBatteryMillivolts(mv)) sosTracker.setBatteryMillivolts(mv);
+        if (postHeartbeat(nullptr)) lastHeartbeat = millis();
+    }
 }
 
 // ===== ACTUALIZACIÓN PERIÓDICA DE UBICACIÓN =====
-// Actualiza la ubicación GPS periódicamente
-void updateLocation() {
+// Muestrea según el planificador adaptativo: intervalos cortos en movimiento,
+// backoff y GNSS apagado estando quieto. Corre en la tarea GNSS con el bus del
+// módem tomado; devuelve true con un fix nuevo (las geocercas las evalúa el loop)
+bool updateLocation() {
     if (!modem || !modem->isConnected()) {
-        return;
+        return false;
     }
     
-    if ((millis() - lastLocationUpdate) < LOCATION_UPDATE_INTERVAL) {
-        return;
+    // Durante un SOS y su seguimiento el GNSS es del pipeline (no apagarlo ni sondearlo dos veces)
+    if (sosActive() || sosTracker.isActive()) {
+        return false;
     }
     
-    // Inicializar GPS si no está activo
-    modem->initGNSS();
+    // Ventana previa al heartbeat: abrir GNSS con antelación = TTFF estimado,
+    // así el fix está listo justo cuando sale el heartbeat
+    uint32_t now = millis();
+    if (!gnssScheduler.isPowered()) {
+        uint32_t msToHeartbeat = msUntilHeartbeat();
+        uint32_t fixAge = lastLocation.isValid ? now - lastLocation.timestamp : 0xFFFFFFFFUL;
+        if (firstHeartbeatSent && radio.shouldWarmGnssForHeartbeat(msToHeartbeat, fixAge)) {
+            LOG_DEBUG(String("[RADIO] Ventana GNSS pre-heartbeat (faltan ") + (unsigned long)(msToHeartbeat / 1000) + "s)");
+            gnssScheduler.requestSample(now);
+        }
+    }
     
-    // Obtener última ubicación
-    if (modem->getLocation(lastLocation)) {
-        Serial.print("[GPS] Ubicación actualizada: ");
-        Serial.print(lastLocation.latitude, 6);
-        Serial.print(", ");
-        Serial.println(lastLocation.longitude, 6);
+    if (!gnssScheduler.isDue(now)) {
+        return false;
     }
     
-    lastLocationUpdate = millis();
+    // Copia: getLocation() invalida el destino si no hay fix
+    GPSLocation fix = lastLocation;
+    bool fixed = gnssPowerOn() && modem->getLocation(fix);
+    if (fixed) {
+        lastLocation = fix;
+        radio.onFix(millis());
+        gnssScheduler.onFix(fix, millis());
+        if (bootFixPending) bootProfile.mark("gnss_fix");
+        Serial.printf("[GPS] Ubicación actualizada: %.6f, %.6f (%.1f km/h, %s, próxima en %lus)\n",
+            fix.latitude, fix.longitude, fix.speedKmh,
+            gnssScheduler.motion() == GnssScheduler::Motion::MOVING ? "mov" : "quieto",
+            (unsigned long)(gnssScheduler.intervalMs() / 1000));
+    } else {
+        gnssScheduler.onNoFix(millis());
+        if (bootFixPending && !gnssScheduler.isAcquiring()) {
+            // Sin cielo: la ubicación queda para el heartbeat periódico
+            bootFixPending = false;
+            bootProfile.mark("gnss_timeout");
+            if (firstHeartbeatSent) bootProfile.close();
+        }
+    }
+    
+    // Apagar entre muestras si el próximo intervalo es largo
+    if (!gnssScheduler.wantsPower() && gnssScheduler.isPowered()) {
+        LOG_DEBUG(String("[GPS] GNSS OFF hasta próxima muestra (") + (unsigned long)(gnssScheduler.intervalMs() / 1000) + "s)");
+        gnssPowerOff();
+    }
+    return fixed;
 }
 
 // ===== AUTO-RECUPERACIÓN DE APROVISIONAMIENTO =====
@@ -557,78 +1623,109 @@ void attemptAutoRecovery() {
     }
     
     Serial.println("[AUTO-RECOVER] Dispositivo no aprovisionado localmente - Intentando recuperación...");
-    String recoveredOwnerUid = modem->checkProvisioningStatus(deviceId);
+    String recoveredOwnerUid = modem->checkProvisioningStatus(deviceId.c_str());
     
     if (recoveredOwnerUid.length() > 0) {
         // ¡Encontrado! Aprovisionar automáticamente
-        ownerUid = recoveredOwnerUid;
-        preferences.begin("wilobu", false);
-        preferences.putString("ownerUid", ownerUid);
-        preferences.putBool("provisioned", true);
-        preferences.end();
+        ownerUid = recoveredOwnerUid.c_str();
+        config.setOwner(ownerUid.c_str());
+        deriveSmsKey();
+        config.commit();
         
         isProvisioned = true;
         Serial.println("[AUTO-RECOVER] ✓✓✓ Dispositivo auto-aprovisionado exitosamente");
-        Serial.println("[AUTO-RECOVER] Owner UID: " + ownerUid);
-        
-        // Cambiar a estado ONLINE
-        deviceState = DeviceState::ONLINE;
+        Serial.printf("[AUTO-RECOVER] Owner UID: %s\n", ownerUid.c_str());
+        // setup() arranca la máquina en ONLINE
     } else {
         Serial.println("[AUTO-RECOVER] Dispositivo no encontrado en Firestore - Requiere vinculación manual");
     }
 }
 
 // ===== ENVÍO PERIÓDICO DE HEARTBEAT =====
+uint32_t msUntilHeartbeat() {
+    return JobScheduler::remaining(millis(), lastHeartbeat, heartbeatIntervalMs);
+}
+
 // Envía estado y ubicación periódicamente al backend
 void sendHeartbeat() {
-    if (!modem || !modem->isConnected() || !isProvisioned) {
+    // En LINKING la app todavía está creando el documento del dispositivo
+    if (!modem || !modem->isConnected() || !isProvisioned || fsm.state() == DeviceState::LINKING) {
         return;
     }
 
-    // Verificar si está en proceso de desprovisión (provisioned=false en NVS)
-    preferences.begin("wilobu", true);
-    bool nvs_provisioned = preferences.getBool("provisioned", true);
-    preferences.end();
+    // Verificar si está en proceso de desprovisión (provisioned=false en la configuración)
+    bool nvs_provisioned = config.get().provisioned;
     
     // Intervalo adaptativo para detección rápida de unlink
-    unsigned long heartbeat_check_interval = HEARTBEAT_INTERVAL;
+    uint32_t heartbeat_check_interval = HEARTBEAT_INTERVAL;
     
     // Si está desprovisionado, usar intervalo rápido
     if (!nvs_provisioned) {
         heartbeat_check_interval = HEARTBEAT_FAST_INTERVAL;
     }
     
-    if ((millis() - lastHeartbeat) < heartbeat_check_interval) {
+    heartbeatIntervalMs = heartbeat_check_interval;
+    
+    // El heartbeat inicial salió sin ubicación: el primer fix viaja sin esperar el intervalo
+    bool carriesBootFix = bootFixPending && firstHeartbeatSent && lastLocation.isValid;
+    if (!carriesBootFix && (millis() - lastHeartbeat) < heartbeat_check_interval) {
+        return;
+    }
+    
+    // No competir por RF/UART con una adquisición GNSS a punto de terminar
+    if (!radio.heartbeatMayStart(millis(), gnssScheduler.isAcquiring())) {
         return;
     }
 
-    bool sent = modem->sendHeartbeat(ownerUid, deviceId, lastLocation);
+    bool sent = postHeartbeat(nullptr);
+    radio.closeCycle(millis());
 
-    // Para ModemProxy (A7670SA) con HTTPS directo
-    ModemProxy* m = (ModemProxy*)modem;
-    if (m) {
-        int st = m->getLastHttpStatus();
+    if (modem) {
+        int st = modem->getLastHttpStatus();
         lastHeartbeatOk = (st >= 200 && st < 300);
+        config.setHttpStatus(st);
         Serial.printf("[HEARTBEAT] lastHeartbeatOk=%d (status=%d)\n", lastHeartbeatOk, st);
+        provisioningReport(st);
     }
 
     if (sent) {
         lastHeartbeat = millis();
-        firstHeartbeatSent = true;
+        onHeartbeatSent(carriesBootFix);
         Serial.println("[HEARTBEAT] ✓ Enviado");
     } else {
         Serial.println("[HEARTBEAT] ✗ Error");
     }
 }
+
+// Cierra el perfil de arranque con el primer heartbeat aceptado, o con el que
+// lleva el primer fix si el inicial salió sin ubicación
+void onHeartbeatSent(bool carriedBootFix) {
+    firstHeartbeatSent = true;
+    if (OtaUpdater::trialPending()) {
+        OtaUpdater::confirm();
+        jobs.cancel(jobOtaHealth);
+    }
+    if (!bootProfile.isOpen()) return;
+    if (bootProfile.at("heartbeat") == 0) {
+        bootProfile.mark("heartbeat");
+        Serial.printf("[BOOT] ✓ Primer heartbeat a %lu ms del arranque\n", (unsigned long)millis());
+    }
+    if (carriedBootFix) {
+        bootFixPending = false;
+        bootProfile.mark("heartbeat_gps");
+    }
+    if (!bootFixPending) bootProfile.close();
+}
+
 // ===== FACTORY RESET =====
 // Borra configuración y reinicia el dispositivo
 void performFactoryReset() {
     Serial.println("[RESET] ⚠️ Ejecutando Factory Reset...");
     
     // Borrar NVS
-    preferences.begin("wilobu", false);
-    preferences.clear();
-    preferences.end();
+    config.erase();
+    sosOutbox.clear();  // Alertas del dueño anterior; la secuencia se conserva
+    DeepSleep::invalidate();
     
     Serial.println("[RESET] ✓ NVS borrada");
     Serial.println("[RESET] Reiniciando...");
@@ -639,126 +1736,577 @@ void performFactoryReset() {
 // ===== VERIFICAR CMD_RESET =====
 // Ejecuta reset si el backend lo solicita
 void checkFactoryReset() {
-    #ifdef HARDWARE_A
-        ModemHTTPS* m = (ModemHTTPS*)modem;
-        if (m && m->factoryResetPending) performFactoryReset();
-    #else
-        ModemProxy* m = (ModemProxy*)modem;
-        if (m && m->factoryResetPending) performFactoryReset();
+    if (modem && modem->factoryResetPending) performFactoryReset();
+}
+
+// ===== CONFIGURACIÓN PERSISTENTE =====
+// Una sola lectura al arrancar o despertar; los globales son la copia de trabajo
+// y cada cambio pasa por config.setX() + config.commit()
+DeviceConfig::Source loadConfig() {
+    ConfigData defaults = {};
+    defaults.logLevel = 1;
+    defaults.sosMultipath = true;
+    defaults.psm = DEEP_SLEEP_ENABLED;
+    defaults.httpStatus = -1;
+    DeviceConfig::Source source = config.load(defaults);
+
+    const ConfigData& c = config.get();
+    isProvisioned = c.provisioned;
+    logLevel = c.logLevel;
+    ownerUid = c.provisioned ? c.ownerUid : "";
+    // Sin APN: web.gprsuniversal es estándar Vodafone internacional y soportado por muchos operadores
+    modemApn = c.modemApn[0] ? c.modemApn : "web.gprsuniversal";
+    smsGateway = c.smsGateway;
+    sosMultipath = c.sosMultipath;
+    modemPsm = c.psm;
+    energyInHeartbeat = c.energyInHeartbeat;
+    return source;
+}
+
+// ===== ESTADO EN RTC =====
+// millis() se reinicia al despertar: las marcas de tiempo viajan en reloj RTC
+uint64_t toRtcMs(uint32_t t) {
+    return DeepSleep::rtcClockMs() - (millis() - t);
+}
+
+uint32_t fromRtcMs(uint64_t rtcMs) {
+    // Aritmética sin signo: (millis() - t) vuelve a dar la edad real
+    return millis() - (uint32_t)(DeepSleep::rtcClockMs() - rtcMs);
+}
+
+void saveRuntimeState() {
+    RtcRuntime& rt = DeepSleep::state();
+    config.commit();   // La configuración viaja en su propio espejo RTC
+    snprintf(rt.deviceId, sizeof(rt.deviceId), "%s", deviceId.c_str());
+    rt.lastHeartbeatOk = lastHeartbeatOk;
+    rt.modemBaud = modemBaud;
+    rt.modemRegistered = modem && modem->isConnected();
+    rt.lastLocation = lastLocation;
+    rt.lastUploadedLocation = lastUploadedLocation;
+    rt.lastFixRtcMs = toRtcMs(lastLocation.timestamp);
+    rt.lastLocationUploadRtcMs = toRtcMs(lastLocationUploadMs);
+    rt.lastHeartbeatRtcMs = toRtcMs(lastHeartbeat);
+}
+
+void restoreRuntimeState() {
+    RtcRuntime& rt = DeepSleep::state();
+    rt.wakeCount++;
+    loadConfig();           // Desde el espejo RTC: sin abrir NVS
+    isProvisioned = true;   // Solo se duerme aprovisionado
+    deviceId = rt.deviceId;
+    lastHeartbeatOk = rt.lastHeartbeatOk;
+    modemBaud = rt.modemBaud;
+    lastLocation = rt.lastLocation;
+    lastLocation.timestamp = fromRtcMs(rt.lastFixRtcMs);
+    lastUploadedLocation = rt.lastUploadedLocation;
+    lastLocationUploadMs = fromRtcMs(rt.lastLocationUploadRtcMs);
+    lastHeartbeat = fromRtcMs(rt.lastHeartbeatRtcMs);
+    firstHeartbeatSent = true;
+}
+
+// Camino corto tras deep sleep: sin banner, NVS, barrido de baudrates ni
+// espera de GNSS. Por timer el heartbeat ya venció y lo envía el loop; por
+// botón el loop atiende primero la pulsación (ButtonInput ya la está midiendo).
+void resumeAfterSleep() {
+    restoreRuntimeState();
+    Serial.printf("[WAKE] Owner UID: %s | Device ID: %s\n", ownerUid.c_str(), deviceId.c_str());
+    geofences.load();
+    sosOutbox.begin();
+    gnssScheduler.begin(millis());
+    radio.begin(millis());
+    startStateMachine(DeviceState::ONLINE);
+
+    if (wakeReason == WakeReason::BUTTON) {
+        Serial.printf("[WAKE] Botón en GPIO%d - mantener 3s para SOS\n", DeepSleep::wakePin());
+    }
+    if (!setupModemWarm()) setupModem();
+    bootProfile.mark("modem");
+    Serial.printf("[WAKE] Listo en %lu ms\n", (unsigned long)millis());
+}
+
+// ===== DEEP SLEEP =====
+// Duerme hasta el próximo heartbeat cuando no queda nada pendiente. Bloquean
+// siempre: alerta o seguimiento SOS, botón presionado, OTA (descarga o imagen
+// en prueba). Bloquean hasta
+// SLEEP_MAX_AWAKE_MS: bandeja SOS, adquisición GNSS y heartbeat pendiente.
+bool readyToSleep(uint32_t now) {
+    if (!isProvisioned || fsm.state() != DeviceState::ONLINE) return false;
+    if (sosActive() || sosTracker.isActive() || bleSessionOpen) return false;
+    // Descarga interrumpida por una alerta o imagen nueva sin confirmar
+    if (ota.isActive() || OtaUpdater::trialPending()) return false;
+    for (uint8_t i = 0; i < BUTTON_COUNT; i++) {
+        if (buttons.isPressed(i)) return false;
+    }
+    uint32_t awakeMs = now - bootTimestamp;
+    if (awakeMs < SLEEP_MIN_AWAKE_MS) return false;
+    if (awakeMs >= SLEEP_MAX_AWAKE_MS) return true;
+
+    bool heartbeatDone = firstHeartbeatSent && (now - lastHeartbeat) < heartbeatIntervalMs;
+    return heartbeatDone && sosOutbox.isEmpty() && !gnssScheduler.isAcquiring();
+}
+
+void enterDeepSleep() {
+    uint32_t now = millis();
+    uint32_t elapsed = now - lastHeartbeat;
+    // Heartbeat vencido (no salió en este ciclo): se reintenta tras un intervalo completo
+    uint32_t sleepMs = elapsed >= heartbeatIntervalMs ? heartbeatIntervalMs : heartbeatIntervalMs - elapsed;
+    if (!sosOutbox.isEmpty() && sleepMs > SOS_RETRY_MAX_MS) sleepMs = SOS_RETRY_MAX_MS;
+
+    Serial.println("[POWER] Ciclo completado -> Deep Sleep");
+    gnssPowerOff();
+    if (modem) modem->enableDeepSleep(sleepMs / 1000);
+    saveRuntimeState();
+    DeepSleep::start(sleepMs, BUTTON_PINS, BUTTON_COUNT);
+}
+
+// Espera del loop con contabilidad: la ventana cuenta como CPU dormida si se permitió el sleep.
+// El light sleep manual congela todas las tareas: no con un antirrebote, un LED
+// parpadeando o la sesión BLE de vinculación abierta
+void idleLowPower(uint32_t ms) {
+    bool allowSleep = !buttons.isBusy() && !uiAnimating && !bleSessionOpen;
+    energy.set(EnergyMeter::CPU_SLEEP, allowSleep && power.mode() != PowerManager::Mode::NONE, millis());
+    power.idle(ms, allowSleep);
+    energy.set(EnergyMeter::CPU_SLEEP, false, millis());
+}
+
+void sleepStep() {
+    #if DEEP_SLEEP_ENABLED
+    if (readyToSleep(millis())) enterDeepSleep();
+    #endif
+}
+
+// ===== TRABAJOS DE LA TAREA DEL MÓDEM =====
+// Cada trabajo fija su próximo plazo y loop() duerme hasta el más cercano.
+// Los eventos (botón, fix, consola, fin de un POST) adelantan el plazo con jobs.at()
+void heartbeatJob() {
+    sendHeartbeat();
+    uint32_t wait = msUntilHeartbeat();
+    // Vencido y sin salir (sin red o cediendo a una adquisición GNSS): reintento corto
+    jobs.in(jobHeartbeat, wait > 0 ? wait : HEARTBEAT_RETRY_MS, millis());
+}
+
+void sosJob() {
+    sosStep();
+    uint32_t now = millis();
+    // Un disparo que no salió quedó en la bandeja: se reintenta durante la espera de fix
+    if (!sosOutbox.isEmpty() && !jobs.isArmed(jobOutbox)) jobs.at(jobOutbox, now);
+    if (sosActive()) {
+        jobs.in(jobSos, SOS_STEP_MS, now);
+        return;
+    }
+    // Fin del pipeline: seguimiento y slot retoman ya; una descarga OTA interrumpida, cuando se pueda
+    jobs.at(jobTrack, now);
+    jobs.at(jobSlot, now);
+    if (ota.isActive()) jobs.in(jobOta, OTA_RETRY_FIRST_MS, now);
+}
+
+void outboxJob() {
+    sosOutboxStep();
+    uint32_t wait = sosOutbox.msUntilDue(millis());
+    if (wait == JOB_IDLE_FOREVER) return;   // Bandeja vacía: la rearma el próximo SOS
+    jobs.in(jobOutbox, wait > 0 ? wait : JOB_RETRY_MS, millis());
+}
+
+void trackJob() {
+    sosTrackStep();
+    if (!sosTracker.isActive()) return;
+    uint32_t wait = sosTracker.msUntilSample(millis());
+    jobs.in(jobTrack, wait > 0 ? wait : JOB_RETRY_MS, millis());
+}
+
+// ===== DIAGNÓSTICO POR BLE =====
+// Sesión opcional y temporal: solo con el dispositivo ONLINE, un PIN de 6
+// dígitos (emparejamiento con MITM; el dispositivo "muestra" el PIN que el
+// dueño recibe por el backend o la consola) y la radio apagada al vencer.
+// Cada segundo publica tres tramas de 20 bytes (DiagFrame.h) mientras haya un
+// cliente autenticado suscrito; tools/diag_decoder.cpp las graba en CSV.
+static uint16_t diagSat16(uint32_t v) { return v > 0xFFFF ? 0xFFFF : (uint16_t)v; }
+
+bool diagOpen(uint32_t passkey, uint16_t minutes) {
+    if (!isProvisioned || fsm.state() != DeviceState::ONLINE) {
+        Serial.println("[DIAG] Solo disponible con el dispositivo ONLINE");
+        return false;
+    }
+    if (bleSessionOpen) {
+        Serial.println("[DIAG] Ya hay una sesión BLE abierta");
+        return false;
+    }
+    if (passkey > 999999) {
+        Serial.println("[DIAG] El PIN debe tener 6 dígitos");
+        return false;
+    }
+    if (minutes == 0) minutes = DIAG_SESSION_MIN;
+    if (minutes > DIAG_SESSION_MAX_MIN) minutes = DIAG_SESSION_MAX_MIN;
+
+    String deviceName = String(DEVICE_NAME_PREFIX) + (deviceId.c_str() + 6);
+    NimBLEDevice::init(deviceName.c_str());
+    NimBLEDevice::setPower(BLE_POWER_DEFAULT);
+    // Sin bonding: la sesión es de un solo uso y no deja claves en NVS
+    NimBLEDevice::setSecurityAuth(false, true, true);
+    NimBLEDevice::setSecurityIOCap(BLE_HS_IO_DISPLAY_ONLY);
+    NimBLEDevice::setSecurityPasskey(passkey);
+
+    pServer = NimBLEDevice::createServer();
+    pServer->setCallbacks(new ServerCallbacks());
+    pServer->advertiseOnDisconnect(false);
+    NimBLEService* pService = pServer->createService(DIAG_SERVICE_UUID);
+    pCharDiag = pService->createCharacteristic(
+        DIAG_CHAR_FRAMES_UUID,
+        NIMBLE_PROPERTY::READ | NIMBLE_PROPERTY::NOTIFY | NIMBLE_PROPERTY::READ_ENC | NIMBLE_PROPERTY::READ_AUTHEN,
+        DIAG_FRAME_LEN
+    );
+    pService->start();
+
+    pAdvertising = NimBLEDevice::getAdvertising();
+    pAdvertising->addServiceUUID(DIAG_SERVICE_UUID);
+    pAdvertising->setScanResponse(true);
+    bleAdvWanted = true;
+    bleProfile.sessionStart(millis());
+    bleAdvertiseFast();
+    energy.set(EnergyMeter::BLE_ADV, true, millis());
+    bleSessionOpen = true;
+    bleSessionClosing = false;
+
+    diagActive = true;
+    diagAuthenticated = false;
+    diagSeq = 0;
+    diagRounds = 0;
+    diagCsq = DIAG_CSQ_UNKNOWN;
+    diagStartMs = millis();
+    diagDurationMs = minutes * 60000UL;
+    jobs.at(jobDiag, diagStartMs);
+    Serial.printf("[DIAG] Servicio BLE abierto por %u min como %s\n", minutes, deviceName.c_str());
+    return true;
+}
+
+void diagNotify(const uint8_t* frame) {
+    pCharDiag->setValue(frame, DIAG_FRAME_LEN);
+    pCharDiag->notify();
+}
+
+// Una ronda: módem, GNSS y sistema con la misma vista del instante actual
+void diagPublish(uint32_t now) {
+    uint8_t frame[DIAG_FRAME_LEN];
+    DiagHeader h = {0, 0, (uint16_t)(now / 1000)};
+
+    if (modem && modem->isConnected() && diagRounds % DIAG_CSQ_EVERY == 0) {
+        if (!modem->getSignalQuality(diagCsq)) diagCsq = DIAG_CSQ_UNKNOWN;
+    }
+    diagRounds++;
+
+    DiagModem m = {};
+    m.csq = diagCsq;
+    const ModemDiagStats* st = modem ? modem->getDiagStats() : nullptr;
+    if (st) {
+        for (uint8_t i = 0; i < DIAG_AT_RECENT; i++) m.atRecentMs[i] = st->atRecentMs[i];
+        m.atMaxMs = st->atMaxMs;
+        m.atTimeouts = st->atTimeouts;
+        for (uint8_t i = 0; i < DIAG_HTTP_RECENT; i++) m.httpRecent[i] = st->httpRecent[i];
+        m.httpLastMs = st->httpLastMs;
+    }
+    h.type = DIAG_TYPE_MODEM;
+    h.seq = diagSeq++;
+    diagEncodeModem(h, m, frame);
+    diagNotify(frame);
+
+    DiagGnss g;
+    g.state = !gnssScheduler.isPowered() ? 0 : gnssScheduler.isAcquiring() ? 1 : 2;
+    g.motion = (uint8_t)gnssScheduler.motion();
+    g.fixes = diagSat16(gnssScheduler.fixCount());
+    g.ttffS = diagSat16(radio.ttffEstimateMs() / 1000);
+    g.fixAgeS = lastLocation.isValid ? diagSat16((now - lastLocation.timestamp) / 1000) : 0xFFFF;
+    if (lastLocation.isValid && g.fixAgeS == 0xFFFF) g.fixAgeS = 0xFFFE;
+    g.intervalS = diagSat16(gnssScheduler.intervalMs() / 1000);
+    g.accuracyDm = lastLocation.isValid ? diagSat16((unsigned long)(lastLocation.accuracy * 10.0f)) : 0xFFFF;
+    g.onTotalS = gnssScheduler.gnssOnMs(now) / 1000;
+    h.type = DIAG_TYPE_GNSS;
+    h.seq = diagSeq++;
+    diagEncodeGnss(h, g, frame);
+    diagNotify(frame);
+
+    DiagSystem s;
+    s.heapFree = ESP.getFreeHeap();
+    s.heapMaxBlock = ESP.getMaxAllocHeap();
+    s.heapMinFree = ESP.getMinFreeHeap();
+    s.inputQueue = inputActions ? (uint8_t)uxQueueMessagesWaiting(inputActions) : 0;
+    s.outbox = sosOutbox.count();
+    s.jobsArmed = jobs.armedCount();
+    s.fsmState = (uint8_t)fsm.state();
+    h.type = DIAG_TYPE_SYSTEM;
+    h.seq = diagSeq++;
+    diagEncodeSystem(h, s, frame);
+    diagNotify(frame);
+}
+
+void diagJob() {
+    if (!diagActive) return;
+    uint32_t now = millis();
+    if (JobScheduler::remaining(now, diagStartMs, diagDurationMs) == 0) {
+        Serial.println("[DIAG] Sesión vencida");
+        bleSessionClose();
+        return;
+    }
+    if (bleConnected && diagAuthenticated && pCharDiag && pCharDiag->getSubscribedCount() > 0) diagPublish(now);
+    jobs.in(jobDiag, DIAG_PERIOD_MS, now);
+}
+
+// Se llama al final de setup() (arranque en frío o despertar)
+void startJobs() {
+    uint32_t now = millis();
+    jobHeartbeat = jobs.add("heartbeat", heartbeatJob, 0, msUntilHeartbeat(), now);
+    jobSos = jobs.add("sos", sosJob, 0, JOB_IDLE_FOREVER, now);
+    jobOutbox = jobs.add("outbox", outboxJob, 0, 0, now);
+    jobSlot = jobs.add("sos_slot", sosSlotJob, 0, 0, now);
+    jobTrack = jobs.add("track", trackJob, 0, JOB_IDLE_FOREVER, now);
+    jobBleSession = jobs.add("ble", bleSessionJob, 0, JOB_IDLE_FOREVER, now);
+    jobLink = jobs.add("link", linkJob, 0, JOB_IDLE_FOREVER, now);
+    jobDiag = jobs.add("diag", diagJob, 0, JOB_IDLE_FOREVER, now);
+    jobOta = jobs.add("ota", otaJob, 0, otaCheckPending ? 0 : JOB_IDLE_FOREVER, now);
+    jobOtaHealth = jobs.add("ota_health", otaHealthJob, 0,
+                            OtaUpdater::trialPending() ? OTA_HEALTH_MS : JOB_IDLE_FOREVER, now);
+    #if DEEP_SLEEP_ENABLED
+    jobs.add("sleep", sleepStep, SLEEP_CHECK_MS, SLEEP_CHECK_MS, now);
     #endif
 }
 
+// ===== TAREAS =====
+void uiRefresh() {
+    if (uiTaskHandle) xTaskNotifyGive(uiTaskHandle);
+}
+
+// LEDs: duerme justo hasta el próximo cambio de fase del parpadeo; con un patrón
+// fijo, hasta un aviso (uiRefresh) o TASK_UI_STATIC_MS
+void uiTask(void*) {
+    for (;;) {
+        uint32_t t0 = micros();
+        uint32_t next = updateLEDs();
+        uiAnimating = next != LED_STATIC;
+        taskMonitor.addActive(uiTaskSlot, micros() - t0);
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(uiAnimating ? next : TASK_UI_STATIC_MS));
+    }
+}
+
+// Botones: interpreta los eventos de ButtonInput y encola la acción para la
+// tarea del módem, que la toma apenas termina la transacción en curso
+void inputTask(void*) {
+    bool actionTriggered[BUTTON_COUNT] = {false, false, false};
+    ButtonEvent ev;
+    for (;;) {
+        if (!buttons.poll(ev, portMAX_DELAY)) continue;
+        uint32_t t0 = micros();
+        const char* name = BUTTON_SOS_TYPES[ev.button];
+        switch (ev.type) {
+            case ButtonEvent::Type::PRESS:
+                actionTriggered[ev.button] = false;
+                Serial.printf("[BTN] Botón %s presionado\n", name);
+                break;
+
+            case ButtonEvent::Type::HOLD: {
+                if (actionTriggered[ev.button]) break;
+                InputAction action = {InputAction::Type::SOS, ev.button, ev.atMs};
+                if (ev.button == BTN_SOS && ev.heldMs == BUTTON_HOLD_PAIR_MS &&
+                    !isProvisioned && fsm.state() == DeviceState::IDLE) {
+                    // 5 segundos en SOS = Activar vinculación (solo si no aprovisionado y en IDLE)
+                    action.type = InputAction::Type::PAIR;
+                } else if (ev.heldMs != BUTTON_HOLD_SOS_MS || !isProvisioned) {
+                    // 3 segundos = SOS del tipo del botón (solo si aprovisionado)
+                    break;
+                }
+                actionTriggered[ev.button] = true;
+                if (xQueueSend(inputActions, &action, 0) != pdTRUE) {
+                    Serial.println("[BTN] ⚠️ Cola de acciones llena - acción descartada");
+                    break;
+                }
+                xEventGroupSetBits(appEvents, APP_EVT_INPUT);
+                break;
+            }
+
+            case ButtonEvent::Type::RELEASE:
+                if (!actionTriggered[ev.button]) {
+                    Serial.printf("[BTN] %s soltado después de %lu ms (sin acción)\n", name, (unsigned long)ev.heldMs);
+                }
+                actionTriggered[ev.button] = false;
+                break;
+        }
+        taskMonitor.addActive(inputTaskSlot, micros() - t0);
+    }
+}
+
+void gnssRefresh() {
+    if (gnssTaskHandle) xTaskNotifyGive(gnssTaskHandle);
+}
+
+// Plazo exacto de la próxima muestra: la del planificador adaptativo o la
+// apertura de la ventana pre-heartbeat, lo que llegue antes
+uint32_t gnssWaitMs() {
+    if (!isProvisioned || !modem || !modem->isConnected() || sosActive() || sosTracker.isActive()) {
+        return TASK_GNSS_IDLE_MS;   // No muestrea: el fin del SOS o la red lo despiertan
+    }
+    uint32_t now = millis();
+    uint32_t waitMs = gnssScheduler.msUntilDue(now);
+    if (!gnssScheduler.isPowered() && firstHeartbeatSent) {
+        uint32_t fixAge = lastLocation.isValid ? now - lastLocation.timestamp : 0xFFFFFFFFUL;
+        uint32_t warmMs = radio.msUntilGnssWarm(msUntilHeartbeat(), fixAge);
+        if (warmMs < waitMs) waitMs = warmMs;
+    }
+    // Vencido pero sin muestra (p.ej. motor adquiriendo): sondeo de adquisición
+    if (waitMs == 0) waitMs = GNSS_ACQ_POLL_MS;
+    return waitMs > TASK_GNSS_IDLE_MS ? TASK_GNSS_IDLE_MS : waitMs;
+}
+
+// GNSS: mantiene el fix vigente. Toma el bus del módem solo para cada muestra
+// (la tarea del módem lo suelta en su espera), avisa los fixes nuevos por evento
+// y duerme hasta su próximo plazo o hasta un gnssRefresh()
+void gnssTask(void*) {
+    xEventGroupWaitBits(appEvents, APP_EVT_READY, pdFALSE, pdTRUE, portMAX_DELAY);
+    for (;;) {
+        xSemaphoreTakeRecursive(modemBus, portMAX_DELAY);
+        uint32_t t0 = micros();
+        bool fixed = isProvisioned && updateLocation();
+        uint32_t waitMs = gnssWaitMs();
+        taskMonitor.addActive(gnssTaskSlot, micros() - t0);
+        xSemaphoreGiveRecursive(modemBus);
+
+        if (fixed) xEventGroupSetBits(appEvents, APP_EVT_FIX);
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(waitMs));
+    }
+}
+
+TaskHandle_t spawnTask(TaskFunction_t fn, const char* name, uint32_t stack, UBaseType_t prio, uint8_t* slot) {
+    TaskHandle_t handle = nullptr;
+    if (xTaskCreatePinnedToCore(fn, name, stack, nullptr, prio, &handle, TASK_APP_CORE) != pdPASS) {
+        LOG_ERROR(String("No se pudo crear la tarea ") + name);
+        return nullptr;
+    }
+    *slot = taskMonitor.add(handle, name, TASK_APP_CORE, stack);
+    return handle;
+}
+
+// Se llama con los botones ya configurados (setupPins); la tarea GNSS espera APP_EVT_READY
+void startTasks() {
+    modemBus = xSemaphoreCreateRecursiveMutex();
+    appEvents = xEventGroupCreate();
+    inputActions = xQueueCreate(INPUT_ACTION_QUEUE, sizeof(InputAction));
+    provMailbox = xQueueCreate(1, sizeof(ProvisioningRequest));
+    power.setWakeEvents(appEvents, APP_EVT_WAKE_MODEM);
+
+    modemTaskSlot = taskMonitor.add(xTaskGetCurrentTaskHandle(), "modem", xPortGetCoreID(), TASK_LOOP_STACK);
+    uiTaskHandle = spawnTask(uiTask, "ui", TASK_UI_STACK, TASK_UI_PRIO, &uiTaskSlot);
+    spawnTask(inputTask, "input", TASK_INPUT_STACK, TASK_INPUT_PRIO, &inputTaskSlot);
+    gnssTaskHandle = spawnTask(gnssTask, "gnss", TASK_GNSS_STACK, TASK_GNSS_PRIO, &gnssTaskSlot);
+    // Un comando por consola despierta a la tarea del módem en vez de esperar su plazo
+    Serial.onReceive([]() { xEventGroupSetBits(appEvents, APP_EVT_CONSOLE); });
+    Serial.printf("[TASKS] ✓ modem (loop), gnss, input y ui en el núcleo %d\n", TASK_APP_CORE);
+}
+
 // ===== SETUP =====
 // Inicialización global: pines, BLE, módem, configuración
 void setup() {
     Serial.begin(115200);
-    delay(2000);
+    wakeReason = DeepSleep::wakeReason();
+    if (wakeReason != WakeReason::COLD && DeepSleep::valid()) {
+        bootTimestamp = millis();
+        Serial.printf("\n[WAKE] Despertar por %s (#%lu)\n",
+            wakeReason == WakeReason::TIMER ? "timer" : "botón", (unsigned long)DeepSleep::state().wakeCount + 1);
+        setupPins();   // ButtonInput toma el botón que sigue presionado
+        startTasks();
+        OtaUpdater::bootCheck();
+        resumeAfterSleep();
+        startJobs();
+        heapAfterSetup = ESP.getMaxAllocHeap();
+        xEventGroupSetBits(appEvents, APP_EVT_READY);
+        return;
+    }
+    wakeReason = WakeReason::COLD;
+    delay(BOOT_CONSOLE_WAIT_MS);
     bootTimestamp = millis();
+    bootProfile.mark("consola");
     
     Serial.println("\n╔═════════════════════════════════════════════╗");
     Serial.println("║       WILOBU FIRMWARE v2.0 (IoT)           ║");
     Serial.println("║  Sistema de Seguridad Personal con LTE+GPS  ║");
     Serial.println("╚═════════════════════════════════════════════╝\n");
+    Serial.printf("[FW] Versión %s\n", FIRMWARE_VERSION);
+    OtaUpdater::bootCheck();
     
-    // Inicializar componentes
+    // Inicializar componentes (el parpadeo de arranque lo lleva la tarea UI)
     setupPins();
+    startTasks();
+    bootProfile.mark("pines");
     
-    // Boot: LED_LINK parpadea durante inicialización
-    for (int i = 0; i < 6; i++) {
-        digitalWrite(PIN_LED_LINK, i % 2);
-        delay(120);
-    }
-    digitalWrite(PIN_LED_LINK, LOW); // Apagar tras boot
-    
-    // Cargar configuración desde NVS
-    preferences.begin("wilobu", true);  // read-only
-    isProvisioned = preferences.getBool("provisioned", false);
-    logLevel = preferences.getInt("logLevel", 1); // Leer nivel de log desde NVS
-    // Leer APN opcional para módem A7670SA
-    modemApn = preferences.getString("apn", "");
-    if (modemApn.length() > 0) {
-        Serial.print("[NVS] APN: "); Serial.println(modemApn);
-    }
-    // Si no hay APN en NVS, usar APNs universales que funcionan con la mayoría de operadores
-    // web.gprsuniversal es estándar Vodafone internacional y soportado por muchos operadores
-    if (modemApn.length() == 0) {
-        modemApn = String("web.gprsuniversal");
+    // Cargar configuración desde NVS (un solo blob; migra las claves sueltas)
+    DeviceConfig::Source configSource = loadConfig();
+    Serial.printf("[NVS] Configuración: %s\n", DeviceConfig::sourceName(configSource));
+    if (config.get().modemApn[0]) {
+        Serial.print("[NVS] APN: "); Serial.println(modemApn.c_str());
+    } else {
         Serial.println("[NVS] APN no configurado. Usando 'web.gprsuniversal' (universal compatible).");
     }
     if (isProvisioned) {
-        ownerUid = preferences.getString("ownerUid", "");
         Serial.println("[NVS] Dispositivo aprovisionado previamente");
         Serial.print("[NVS]   Owner UID: ");
-        Serial.println(ownerUid);
+        Serial.println(ownerUid.c_str());
     } else {
         Serial.println("[NVS] Dispositivo no aprovisionado");
         Serial.println("[INFO] Mantén Botón SOS 5 segundos para vincular");
     }
     Serial.print("[NVS] logLevel: ");
     Serial.println(logLevel);
-    preferences.end();
-        // (Serial handler moved to loop)
+    geofences.load();
+    sosOutbox.begin();
+    bootProfile.mark("nvs");
     
     // Generar Device ID basado en MAC WiFi (siempre disponible)
     uint8_t mac[6];
     esp_read_mac(mac, ESP_MAC_WIFI_STA);
     char macStr[13];
     snprintf(macStr, sizeof(macStr), "%02X%02X%02X%02X%02X%02X", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
-    deviceId = String(macStr);
+    deviceId = macStr;
     
     Serial.print("[DEVICE] ID: ");
-    Serial.println(deviceId);
+    Serial.println(deviceId.c_str());
+    // Aprovisionado por un firmware sin clave SMS: se deriva una vez
+    if (isProvisioned) {
+        deriveSmsKey();
+        config.commit();
+    }
     
     // Intentar inicializar módem siempre (para auto-recovery)
     setupModem();
     
-    // Si ya está aprovisionado: GNSS + Heartbeat inicial + Deep Sleep
-    if (isProvisioned && modem && modem->isConnected()) {
-        deviceState = DeviceState::ONLINE;
-        Serial.println("\n[BOOT] Dispositivo provisionado -> Obteniendo ubicación inicial...");
-        
-        // Iniciar GNSS
-        modem->initGNSS();
-        unsigned long gpsStart = millis();
-        bool fixObtained = false;
-        
-        // Esperar hasta 45s para obtener Fix
-        while ((millis() - gpsStart) < GPS_COLD_START_TIME) {
-            if (modem->getLocation(lastLocation) && lastLocation.isValid) {
-                fixObtained = true;
-                Serial.printf("[BOOT] ✓ GPS Fix: %.6f, %.6f\n", lastLocation.latitude, lastLocation.longitude);
-                break;
-            }
-            delay(100);
-        }
+    // Si ya está aprovisionado: heartbeat inicial sin esperar el fix. El GNSS
+    // adquiere desde antes del registro (setupModem) y sigue en updateLocation();
+    // la ubicación sale en un heartbeat extra apenas llega el primer fix
+    bool online = isProvisioned && modem && modem->isConnected();
+    if (online) {
+        gnssScheduler.begin(millis());
+        radio.begin(millis());
         
-        if (!fixObtained) {
-            Serial.println("[BOOT] ⚠️ GPS timeout - Enviando heartbeat sin ubicación");
-            lastLocation.isValid = false;
+        if (gnssPowerOn() && modem->getLocation(lastLocation) && lastLocation.isValid) {
+            radio.onFix(millis());
+            gnssScheduler.onFix(lastLocation, millis());
+            bootProfile.mark("gnss_fix");
+            Serial.printf("[BOOT] ✓ GPS Fix: %.6f, %.6f\n", lastLocation.latitude, lastLocation.longitude);
+        } else {
+            bootFixPending = true;
+            Serial.println("[BOOT] GPS sin fix aún - heartbeat inicial sin ubicación");
         }
         
-        // Enviar heartbeat inicial (con o sin GPS)
         Serial.println("[BOOT] Enviando heartbeat inicial...");
-        bool sent = modem->sendHeartbeat(ownerUid, deviceId, lastLocation);
+        bool sent = postHeartbeat(nullptr);
+        radio.closeCycle(millis());
 
         // Actualizar flag de éxito para la lógica de LED (online visible)
-        ModemProxy* m = (ModemProxy*)modem;
-        if (m) {
-            int st = m->getLastHttpStatus();
+        if (modem) {
+            int st = modem->getLastHttpStatus();
             lastHeartbeatOk = (st >= 200 && st < 300);
+            config.setHttpStatus(st);
         }
         
         if (sent) {
-            Serial.println("[BOOT] ✓ Heartbeat enviado");
             lastHeartbeat = millis();
-            firstHeartbeatSent = true;
-            #if DEEP_SLEEP_ENABLED
-            // Deep Sleep según tier
-            unsigned long sleepTime = HEARTBEAT_INTERVAL / 1000; // Convertir a segundos
-            Serial.printf("[BOOT] Deep Sleep %lu segundos\n", sleepTime);
-            esp_sleep_enable_timer_wakeup(sleepTime * 1000000ULL);
-            esp_deep_sleep_start();
-            #else
+            onHeartbeatSent(false);
+            #if !DEEP_SLEEP_ENABLED
             Serial.println("[BOOT] Deep Sleep DESACTIVADO (dev mode)");
             #endif
         } else {
@@ -766,7 +2314,6 @@ void setup() {
         }
     } else if (!isProvisioned) {
         // Dispositivo virgen: IDLE con radio apagada
-        deviceState = DeviceState::IDLE;
         Serial.println("\n[BOOT] Dispositivo NO provisionado -> IDLE (Radio OFF)");
         
         // Apagar módem para ahorrar energía
@@ -774,11 +2321,36 @@ void setup() {
             Serial.println("[BOOT] Apagando radio LTE...");
         }
     }
+    
+    bootProfile.mark("setup");
+    // Sin heartbeat en curso (no aprovisionado o sin red): el perfil termina aquí
+    if (!online) bootProfile.close();
+    // Aprovisionado sin red también es ONLINE: heartbeat y bandeja reintentan solos
+    startStateMachine(isProvisioned ? DeviceState::ONLINE : DeviceState::IDLE);
+    startJobs();
+    heapAfterSetup = ESP.getMaxAllocHeap();
+    xEventGroupSetBits(appEvents, APP_EVT_READY);
 }
 
-// ===== LOOP PRINCIPAL =====
-// Bucle principal: gestiona estado, botones, heartbeat y LEDs
-void loop() {
+// ===== DIAGNÓSTICO DE HEAP =====
+// Tras setup() las rutas calientes no asignan: el bloque mayor debería seguir
+// donde quedó al terminar el arranque
+void printHeap() {
+    uint32_t maxBlock = ESP.getMaxAllocHeap();
+    uint32_t freeHeap = ESP.getFreeHeap();
+    Serial.printf("[HEAP] Libre %lu B | bloque mayor %lu B | mínimo histórico %lu B\n",
+        (unsigned long)freeHeap, (unsigned long)maxBlock, (unsigned long)ESP.getMinFreeHeap());
+    Serial.printf("  fragmentación %lu%% | bloque mayor tras setup %lu B (%+ld B)\n",
+        freeHeap ? 100UL - (unsigned long)((uint64_t)maxBlock * 100 / freeHeap) : 0UL,
+        (unsigned long)heapAfterSetup, (long)maxBlock - (long)heapAfterSetup);
+    extraArena.print();
+    if (modem && modem->getJsonArena()) modem->getJsonArena()->print();
+}
+
+// ===== PASADA DE LA TAREA DEL MÓDEM =====
+// Comandos seriales, estado, acciones de botón, SOS, heartbeat. Corre con el
+// bus del módem tomado; LEDs, botones y GNSS siguen en sus propias tareas
+void modemStep(EventBits_t events) {
     // Handler serial en runtime: comandos simples (ej. "log <0|1|2>")
     if (Serial.available()) {
         String cmd = Serial.readStringUntil('\n');
@@ -787,9 +2359,8 @@ void loop() {
             int lvl = cmd.substring(4).toInt();
             if (lvl >= 0 && lvl <= 2) {
                 logLevel = lvl;
-                preferences.begin("wilobu", false);
-                preferences.putInt("logLevel", logLevel);
-                preferences.end();
+                config.setLogLevel(logLevel);
+                config.commit();
                 Serial.print("[LOG] Nivel cambiado a: ");
                 Serial.println(logLevel);
             } else {
@@ -798,26 +2369,21 @@ void loop() {
         }
         else if (cmd.startsWith("apn ")) {
             String newApn = cmd.substring(4);
-            modemApn = newApn;
-            preferences.begin("wilobu", false);
-            preferences.putString("apn", modemApn);
-            preferences.end();
-            Serial.print("[APN] Cambiado a: "); Serial.println(modemApn);
+            modemApn = newApn.c_str();
+            config.setApn(modemApn.c_str());
+            config.commit();
+            Serial.print("[APN] Cambiado a: "); Serial.println(modemApn.c_str());
             Serial.println("[APN] Requiere reinicio para aplicar cambios. Usa 'restart'");
         }
         else if (cmd == "restart") {
             Serial.println("[RESTART] Reiniciando en 2s...");
+            config.commit(true);
             delay(2000);
             ESP.restart();
         }
         else if (cmd == "factory_reset") {
-            Serial.println("[FACTORY_RESET] Limpiando NVS y reiniciando...");
-            preferences.begin("wilobu", false);
-            preferences.clear();  // Borrar todo
-            preferences.end();
-            Serial.println("[FACTORY_RESET] NVS limpiada. Reiniciando en 2s...");
-            delay(2000);
-            ESP.restart();
+            // Mismo camino que cmd_reset: configuración, bandeja SOS y estado RTC
+            performFactoryReset();
         }
         else if (cmd.startsWith("at ")) {
             String atcmd = cmd.substring(3);
@@ -825,7 +2391,7 @@ void loop() {
             if (modem) {
                 // send directly to modem UART and capture response
                 ModemSerial.println(atcmd);
-                unsigned long start = millis();
+                uint32_t start = millis();
                 String resp = "";
                 while (millis() - start < 3000) {
                     while (ModemSerial.available()) {
@@ -883,7 +2449,7 @@ void loop() {
                 
                 // Test 5: Esperar READY
                 Serial.println("\n[6] Esperando +CGNSSPWR: READY! (10s)...");
-                unsigned long start = millis();
+                uint32_t start = millis();
                 while (millis() - start < 10000) {
                     if (ModemSerial.available()) {
                         Serial.write(ModemSerial.read());
@@ -930,37 +2496,198 @@ void loop() {
                 Serial.println("[GPS_TEST] Modem no inicializado");
             }
         }
+        else if (cmd == "sos") {
+            Serial.printf("[SOS] Etapa actual: %s\n", SOS_STAGE_NAMES[(int)sos.stage]);
+            if (sos.triggerMs != 0) printSosTimings();
+        }
+        else if (cmd == "outbox") {
+            sosOutbox.print(millis());
+            sosOutbox.printDeliveries();
+        }
+        else if (cmd.startsWith("sms_gw ")) {
+            String gateway = cmd.substring(7);
+            gateway.trim();
+            smsGateway = gateway.c_str();
+            config.setSmsGateway(smsGateway.c_str());
+            config.commit();
+            Serial.printf("[SMS] Gateway: %s\n", smsGateway.c_str());
+        }
+        else if (cmd.startsWith("sos_mode ")) {
+            String mode = cmd.substring(9);
+            if (mode == "multi" || mode == "data") {
+                sosMultipath = (mode == "multi");
+                config.setSosMultipath(sosMultipath);
+                config.commit();
+            }
+            Serial.printf("[SOS] Despacho: %s (gateway SMS: %s)\n", sosMultipath ? "datos + SMS" : "solo datos",
+                smsGateway.length() > 0 ? smsGateway.c_str() : "sin configurar");
+        }
+        else if (cmd == "psm" || cmd.startsWith("psm ")) {
+            String mode = cmd.substring(3);
+            mode.trim();
+            if (mode == "on" || mode == "off") {
+                modemPsm = (mode == "on");
+                config.setPsm(modemPsm);
+                config.commit();
+            }
+            Serial.printf("[PSM] PSM %s, eDRX activo\n", modemPsm ? "activo" : "desactivado");
+            applyPowerSaving();   // Vuelve a pedir y registra lo negociado
+        }
+        else if (cmd == "energy") {
+            energy.print(millis());
+            energy.printModel();
+        }
+        else if (cmd == "energy_reset") {
+            energy.reset(millis());
+            Serial.println("[ENERGY] Ventana reiniciada");
+        }
+        else if (cmd.startsWith("energy_hb ")) {
+            energyInHeartbeat = cmd.substring(10) == "on";
+            config.setEnergyInHeartbeat(energyInHeartbeat);
+            config.commit();
+            Serial.printf("[ENERGY] Reporte en heartbeat: %s\n", energyInHeartbeat ? "sí" : "no");
+        }
+        else if (cmd.startsWith("energy_model ")) {
+            // energy_model <cpu|sleep|modem|tx|gnss|ble> <mA>
+            String args = cmd.substring(13);
+            int sp = args.indexOf(' ');
+            if (sp == -1 || !energy.setModel(args.substring(0, sp), args.substring(sp + 1).toFloat())) {
+                Serial.println("[ENERGY] Uso: energy_model <cpu|sleep|modem|tx|gnss|ble> <mA>");
+            }
+            energy.printModel();
+        }
+        else if (cmd == "tasks") {
+            taskMonitor.print();
+        }
+        else if (cmd == "boot") {
+            bootProfile.print();
+        }
+        else if (cmd == "power") {
+            power.print(buttons.lastPressLatencyMs(), buttons.maxPressLatencyMs());
+        }
+        else if (cmd == "sleep") {
+            // Ciclo de deep sleep inmediato (prueba de wake por timer/botón)
+            if (isProvisioned) enterDeepSleep();
+            else Serial.println("[SLEEP] Solo disponible con el dispositivo aprovisionado");
+        }
+        else if (cmd == "sos_slot") {
+            Serial.printf("[SLOT] %s\n", modem && modem->sosSlotReady() ? "listo" : "no disponible");
+        }
+        else if (cmd == "track") {
+            sosTracker.print(millis());
+        }
+        else if (cmd == "track_stop") {
+            sosTracker.stop(SosTracker::EndReason::CLEARED);
+        }
+        else if (cmd == "geofences") {
+            geofences.print();
+        }
+        else if (cmd == "radio") {
+            radio.printCycle(millis());
+        }
+        else if (cmd == "jobs") {
+            jobs.print(millis());
+        }
+        else if (cmd == "heap") {
+            printHeap();
+        }
+        else if (cmd == "ble") {
+            bleProfile.print(millis());
+        }
+        else if (cmd.startsWith("diag_ble ")) {
+            // diag_ble <PIN de 6 dígitos> [minutos] | diag_ble off
+            String args = cmd.substring(9);
+            args.trim();
+            if (args == "off") {
+                if (diagActive) bleSessionClose();
+            } else {
+                int sp = args.indexOf(' ');
+                String pin = sp == -1 ? args : args.substring(0, sp);
+                uint16_t minutes = sp == -1 ? 0 : (uint16_t)args.substring(sp + 1).toInt();
+                if (pin.length() != 6) Serial.println("[DIAG] Uso: diag_ble <PIN de 6 dígitos> [minutos] | diag_ble off");
+                else diagOpen((uint32_t)pin.toInt(), minutes);
+            }
+        }
+        else if (cmd == "ota") {
+            ota.print(millis());
+        }
+        else if (cmd == "ota_check") {
+            otaCheckPending = true;
+            jobs.at(jobOta, millis());
+        }
+        else if (cmd == "ota_abort") {
+            ota.abort();
+            deviceEvent(DeviceEvent::OTA_END);
+        }
+        else if (cmd == "ota_rollback") {
+            OtaUpdater::rollback("pedido por consola");
+        }
+        else if (cmd == "config") {
+            config.print();
+        }
+        else if (cmd == "fsm") {
+            fsm.print(millis());
+        }
+        else if (cmd == "gnss") {
+            uint32_t now = millis();
+            Serial.printf("[GNSS] %s | ON=%d | fixes=%lu | ON total=%lus | intervalo=%lus\n",
+                gnssScheduler.motion() == GnssScheduler::Motion::MOVING ? "MOVIMIENTO" :
+                gnssScheduler.motion() == GnssScheduler::Motion::STATIONARY ? "QUIETO" : "?",
+                gnssScheduler.isPowered(), (unsigned long)gnssScheduler.fixCount(),
+                (unsigned long)(gnssScheduler.gnssOnMs(now) / 1000), (unsigned long)(gnssScheduler.intervalMs() / 1000));
+        }
+    }
+    // Eventos de la máquina: blob o UID por BLE, botones y el timer del estado actual
+    ProvisioningRequest provReq;
+    if ((events & APP_EVT_BLE) && xQueueReceive(provMailbox, &provReq, 0) == pdTRUE) {
+        applyProvisioning(provReq);
+        config.setOwner(provReq.ownerUid);
+        deriveSmsKey();
+        if (config.commit()) Serial.println("[BLE] Dispositivo aprovisionado en NVS");
+        // Recién ahora lo ven los guards de la FSM, el heartbeat y el SOS
+        ownerUid = provReq.ownerUid;
+        isProvisioned = true;
+        provNotify(ProvStage::STORED);
+        bleConnRelax();
+        if (deviceEvent(DeviceEvent::BLE_PROVISIONED)) jobs.in(jobBleSession, PROV_SESSION_MS, millis());
     }
-    updateStateMachine();
+    // Señal de la app durante LINKING: linkJob la atiende apenas el módem lo permite
+    if ((events & APP_EVT_LINK) && fsm.state() == DeviceState::LINKING) jobs.at(jobLink, millis());
     checkButtons();
+    if (fsm.msUntilTimeout(millis()) == 0) deviceEvent(DeviceEvent::TIMEOUT);
+    energy.set(EnergyMeter::MODEM_REG, modem && modem->isConnected(), millis());
+    otaTrialNoteRegistered();
     
     // Si no está aprovisionado, solo verificar botones
     if (!isProvisioned) {
-        updateLEDs();
-        delay(100);
         return;
     }
     
-    // Modo ONLINE - funcionalidad completa
-    updateLocation();
-    sendHeartbeat();
-    checkFactoryReset();
-    updateLEDs();
-    
-    // Deep sleep si no está en SOS y pasó el intervalo
-    bool inSOS = (deviceState == DeviceState::SOS_GENERAL || 
-                  deviceState == DeviceState::SOS_MEDICA || 
-                  deviceState == DeviceState::SOS_SEGURIDAD);
-    
-    #if DEEP_SLEEP_ENABLED
-    if (!inSOS && firstHeartbeatSent && (millis() - lastHeartbeat) >= HEARTBEAT_INTERVAL) {
-        Serial.println("[POWER] Ciclo completado -> Deep Sleep");
-        unsigned long sleepTime = HEARTBEAT_INTERVAL / 1000;
-        Serial.printf("[POWER] Deep Sleep %lu segundos\n", sleepTime);
-        esp_sleep_enable_timer_wakeup(sleepTime * 1000000ULL);
-        esp_deep_sleep_start();
+    // Modo ONLINE - funcionalidad completa (la ubicación la mantiene la tarea GNSS)
+    if (events & APP_EVT_FIX) {
+        checkGeofences(lastLocation);
+        // Fix que esperaba un heartbeat (el de arranque o uno diferido): sale ya
+        if (bootFixPending || radio.isDeferring()) jobs.at(jobHeartbeat, millis());
     }
-    #endif
+    jobs.runDue(millis());
+    checkFactoryReset();
+    gnssRefresh();          // El plazo de la ventana pre-heartbeat pudo moverse
+}
+
+// ===== LOOP PRINCIPAL = TAREA DEL MÓDEM =====
+void loop() {
+    EventBits_t events = xEventGroupClearBits(appEvents, APP_EVT_WAKE_MODEM);
+    xSemaphoreTakeRecursive(modemBus, portMAX_DELAY);
+    uint32_t t0 = micros();
+    modemStep(events);
+    taskMonitor.addActive(modemTaskSlot, micros() - t0);
+    xSemaphoreGiveRecursive(modemBus);
     
-    delay(100);
+    // Light sleep hasta el próximo plazo; despierta antes con un botón, datos del módem,
+    // la consola o un evento de otra tarea. Sin aprovisionar solo se atienden botones
+    uint32_t waitMs = isProvisioned ? jobs.msUntilNext(millis()) : LOOP_MAX_IDLE_MS;
+    uint32_t stateMs = fsm.msUntilTimeout(millis());
+    if (stateMs < waitMs) waitMs = stateMs;
+    if (waitMs > LOOP_MAX_IDLE_MS) waitMs = LOOP_MAX_IDLE_MS;
+    idleLowPower(waitMs);
 }
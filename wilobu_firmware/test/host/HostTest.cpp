@@ -0,0 +1,5 @@
+#include "HostTest.h"
+
+namespace hosttest {
+int failures = 0;
+}
@@ -0,0 +1,27 @@
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+
+#include <stdio.h>
+
+// ===== ASERCIONES DE LAS PRUEBAS EN HOST =====
+// Cada prueba es un ejecutable: imprime su reporte, cuenta los CHECK
+// fallidos y termina con código != 0 si hubo alguno (ctest lo marca)
+namespace hosttest {
+extern int failures;
+}
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { \
+        hosttest::failures++; \
+        fprintf(stderr, "%s:%d: CHECK(%s) falló: ", __FILE__, __LINE__, #cond); \
+        fprintf(stderr, __VA_ARGS__); \
+        fputc('\n', stderr); \
+    } \
+} while (0)
+
+#define TEST_MAIN_END() do { \
+    if (hosttest::failures) fprintf(stderr, "%d verificaciones fallidas\n", hosttest::failures); \
+    return hosttest::failures ? 1 : 0; \
+} while (0)
+
+#endif
@@ -0,0 +1,101 @@
+#include "ScriptedModem.h"
+#include "Host.h"
+
+#define SCRIPTED_TTFF_MS        28000UL  // Desde AT+CGNSSPWR=1
+#define SCRIPTED_HTTP_BODY      "{\"ok\":true}"
+
+void ScriptedModem::attach(HardwareSerial& serial) {
+    uart = &serial;
+    uart->onTransmit(onTx, this);
+}
+
+void ScriptedModem::onTx(const uint8_t* buf, size_t n, void* arg) {
+    ScriptedModem* self = static_cast<ScriptedModem*>(arg);
+    for (size_t i = 0; i < n; i++) self->rx((char)buf[i]);
+}
+
+void ScriptedModem::rx(char c) {
+    // Cuerpo de HTTPDATA o CCERTDOWN: bytes crudos, el OK llega cuando la UART terminó de pasarlos
+    if (dataLeft > 0) {
+        if (--dataLeft == 0) {
+            reply((uint32_t)(dataLen * 10UL * 1000UL / SCRIPTED_BAUD) + SCRIPTED_AT_RTT_MS, "\r\nOK\r\n");
+        }
+        return;
+    }
+    if (lineLen == 0) {
+        if (c == '\r' || c == '\n') return;
+        lineStartUs = host::elapsedUs();
+    }
+    if (c == '\n' || c == '\r') {
+        line[lineLen] = '\0';
+        lineLen = 0;
+        command(line);
+        return;
+    }
+    if (lineLen < sizeof(line) - 1) line[lineLen++] = c;
+}
+
+void ScriptedModem::command(const char* cmd) {
+    Command entry;
+    entry.atUs = lineStartUs;
+    snprintf(entry.text, sizeof(entry.text), "%s", cmd);
+    commands.push_back(entry);
+
+    if (strncmp(cmd, "AT+CCERTDOWN=", 13) == 0) {
+        // AT+CCERTDOWN="<archivo>",<largo>: prompt y el archivo queda cargado
+        const char* comma = strrchr(cmd, ',');
+        dataLen = dataLeft = comma ? strtoul(comma + 1, nullptr, 10) : 0;
+        snprintf(certFile, sizeof(certFile), "%.*s", (int)(comma ? comma - cmd - 13 : 0), cmd + 13);
+        reply(SCRIPTED_AT_RTT_MS, "\r\n>");
+    } else if (strcmp(cmd, "AT+CCERTLIST") == 0) {
+        char resp[80];
+        snprintf(resp, sizeof(resp), "\r\n+CCERTLIST: %s\r\n\r\nOK\r\n", certFile);
+        reply(SCRIPTED_AT_RTT_MS, certFile[0] ? resp : "\r\nOK\r\n");
+    } else if (strncmp(cmd, "AT+HTTPDATA=", 12) == 0) {
+        dataLen = dataLeft = strtoul(cmd + 12, nullptr, 10);
+        reply(SCRIPTED_AT_RTT_MS, "\r\nDOWNLOAD\r\n");
+    } else if (strncmp(cmd, "AT+HTTPACTION=", 14) == 0) {
+        char urc[48];
+        snprintf(urc, sizeof(urc), "\r\n+HTTPACTION: %c,200,%u\r\n", cmd[14], (unsigned)strlen(SCRIPTED_HTTP_BODY));
+        reply(SCRIPTED_AT_RTT_MS, "\r\nOK\r\n");
+        reply(SCRIPTED_AT_RTT_MS + SCRIPTED_NET_MS, urc);
+    } else if (strncmp(cmd, "AT+HTTPREAD", 11) == 0) {
+        char resp[96];
+        snprintf(resp, sizeof(resp), "\r\n+HTTPREAD: %u\r\n%s\r\n+HTTPREAD: 0\r\n\r\nOK\r\n",
+            (unsigned)strlen(SCRIPTED_HTTP_BODY), SCRIPTED_HTTP_BODY);
+        reply(SCRIPTED_AT_RTT_MS, resp);
+    } else if (strncmp(cmd, "AT+HTTPPARA=\"URL\"", 17) == 0) {
+        reply(SCRIPTED_AT_RTT_MS, urlAccepted ? "\r\nOK\r\n" : "\r\nERROR\r\n");
+    } else if (strcmp(cmd, "AT+CGREG?") == 0) {
+        reply(SCRIPTED_AT_RTT_MS, "\r\n+CGREG: 0,1\r\n\r\nOK\r\n");
+    } else if (strcmp(cmd, "AT+CGNSSPWR=1") == 0) {
+        gnssOnUs = host::elapsedUs();
+        reply(SCRIPTED_AT_RTT_MS, "\r\nOK\r\n");
+    } else if (strcmp(cmd, "AT+CGPSINFO") == 0) {
+        bool fix = host::elapsedUs() - gnssOnUs >= SCRIPTED_TTFF_MS * 1000ULL;
+        reply(SCRIPTED_AT_RTT_MS, fix
+            ? "\r\n+CGPSINFO: 1202.784000,S,07702.568000,W,180626,120000.0,150.0,0.0,0.0\r\n\r\nOK\r\n"
+            : "\r\n+CGPSINFO: ,,,,,,,,\r\n\r\nOK\r\n");
+    } else if (strcmp(cmd, "AT+CBC") == 0) {
+        reply(SCRIPTED_AT_RTT_MS, "\r\n+CBC: 3.950V\r\n\r\nOK\r\n");
+    } else if (strcmp(cmd, "AT+CSQ") == 0) {
+        reply(SCRIPTED_AT_RTT_MS, "\r\n+CSQ: 20,99\r\n\r\nOK\r\n");
+    } else {
+        reply(SCRIPTED_AT_RTT_MS, "\r\nOK\r\n");
+    }
+}
+
+const ScriptedModem::Command* ScriptedModem::first(const char* prefix, uint64_t sinceUs) const {
+    for (size_t i = 0; i < commands.size(); i++) {
+        if (commands[i].atUs >= sinceUs && strncmp(commands[i].text, prefix, strlen(prefix)) == 0) return &commands[i];
+    }
+    return nullptr;
+}
+
+uint32_t ScriptedModem::countBetween(uint64_t fromUs, uint64_t toUs) const {
+    uint32_t n = 0;
+    for (size_t i = 0; i < commands.size(); i++) {
+        if (commands[i].atUs >= fromUs && commands[i].atUs < toUs) n++;
+    }
+    return n;
+}
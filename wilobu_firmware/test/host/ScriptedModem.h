@@ -0,0 +1,54 @@
+#ifndef SCRIPTED_MODEM_H
+#define SCRIPTED_MODEM_H
+
+#include <Arduino.h>
+#include <vector>
+
+// ===== A7670SA EN GUION SOBRE LA UART SIMULADA =====
+// Contesta lo que el driver real (ModemProxy) escribe en su HardwareSerial:
+// cada comando recibe su respuesta SCRIPTED_AT_RTT_MS después, HTTPDATA
+// acepta el cuerpo al ritmo de la UART y +HTTPACTION llega SCRIPTED_NET_MS
+// después de HTTPACTION. Registra cada comando con su instante virtual para
+// medir latencias y contar idas y vueltas AT.
+#define SCRIPTED_AT_RTT_MS      40UL     // Respuesta típica a un AT de configuración
+#define SCRIPTED_NET_MS         1800UL   // HTTPACTION hasta la respuesta del servidor (LTE-M)
+#define SCRIPTED_BAUD           115200UL
+#define SCRIPTED_CMD_MAX        48       // Lo que se guarda de cada comando
+
+class ScriptedModem {
+public:
+    struct Command {
+        uint64_t atUs;              // host::elapsedUs() del primer byte
+        char text[SCRIPTED_CMD_MAX];
+    };
+
+    void attach(HardwareSerial& uart);
+    // false: AT+HTTPPARA="URL" responde ERROR, como un firmware que no deja
+    // reutilizar la sesión HTTP (el slot SOS nunca queda listo)
+    void setUrlAccepted(bool ok) { urlAccepted = ok; }
+
+    const std::vector<Command>& log() const { return commands; }
+    // Primer comando que empieza con prefix desde sinceUs; nullptr si no hubo
+    const Command* first(const char* prefix, uint64_t sinceUs) const;
+    // Comandos en [fromUs, toUs)
+    uint32_t countBetween(uint64_t fromUs, uint64_t toUs) const;
+
+private:
+    HardwareSerial* uart = nullptr;
+    bool urlAccepted = true;
+    std::vector<Command> commands;
+    char line[256];
+    size_t lineLen = 0;
+    uint64_t lineStartUs = 0;
+    size_t dataLeft = 0;            // Bytes de HTTPDATA/CCERTDOWN por recibir
+    char certFile[40] = "";         // CA cargada con CCERTDOWN (con comillas)
+    size_t dataLen = 0;
+    uint64_t gnssOnUs = 0;          // AT+CGNSSPWR=1: el fix llega tras un TTFF
+
+    static void onTx(const uint8_t* buf, size_t n, void* arg);
+    void rx(char c);
+    void command(const char* cmd);
+    void reply(uint32_t delayMs, const char* text) { uart->feedAfter(delayMs, text); }
+};
+
+#endif
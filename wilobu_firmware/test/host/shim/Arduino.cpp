@@ -0,0 +1,274 @@
+#include <Arduino.h>
+#include <sys/time.h>
+#include "Host.h"
+
+HardwareSerial Serial(0);
+EspClass ESP;
+
+namespace {
+
+uint64_t clockUs = 0;           // Transcurrido desde host::reset()
+uint32_t millisBase = 0;        // millis() en el instante del reset
+uint32_t microsBase = 0;
+uint32_t randState = 1;
+bool echoOn = false;
+int pinLevel[NUM_DIGITAL_PINS];
+void (*pinIsr[NUM_DIGITAL_PINS])(void*);   // attachInterruptArg(): ISR por pin
+void* pinIsrArg[NUM_DIGITAL_PINS];
+uint32_t cpuMhz = 240;
+
+void defaultDelay(unsigned long ms) { host::advanceMs(ms); }
+void defaultYield() {}
+
+bool envEcho() {
+    const char* v = getenv("WILOBU_HOST_ECHO");
+    return v && v[0] == '1';
+}
+
+} // namespace
+
+// ===== CONTROL DEL ENTORNO =====
+namespace host {
+
+void (*delayHook)(unsigned long ms) = defaultDelay;
+void (*yieldHook)() = defaultYield;
+
+void reset(unsigned long preRollMs) {
+    clockUs = 0;
+    millisBase = (uint32_t)0 - (uint32_t)preRollMs;
+    microsBase = (uint32_t)0 - (uint32_t)(preRollMs * 1000UL);
+    randState = 1;
+    echoOn = envEcho();
+    for (int i = 0; i < NUM_DIGITAL_PINS; i++) {
+        pinLevel[i] = HIGH;   // Botones con pull-up, sueltos
+        pinIsr[i] = nullptr;
+    }
+    Serial.clearOutput();
+    while (Serial.available()) Serial.read();
+}
+
+uint64_t elapsedUs() { return clockUs; }
+void advanceUs(uint64_t us) { clockUs += us; }
+
+// Un cambio de nivel dispara la ISR del pin en el contexto de quien llama,
+// como una interrupción que corta a la tarea en curso
+void setPin(uint8_t pin, int level) {
+    if (pin >= NUM_DIGITAL_PINS || pinLevel[pin] == level) return;
+    pinLevel[pin] = level;
+    if (pinIsr[pin]) pinIsr[pin](pinIsrArg[pin]);
+}
+
+void setEcho(bool on) { echoOn = on || envEcho(); }
+bool echo() { return echoOn; }
+
+} // namespace host
+
+// ===== TIEMPO =====
+// Aritmética de 32 bits como en el ESP32: micros() desborda cada ~71,6 min y
+// millis() cada ~49,7 días, aunque el host sea de 64 bits
+uint32_t millis() { return millisBase + (uint32_t)(clockUs / 1000); }
+uint32_t micros() { return microsBase + (uint32_t)clockUs; }
+void delay(unsigned long ms) { host::delayHook(ms); }
+void delayMicroseconds(unsigned int us) { host::advanceUs(us); }
+void yield() { host::yieldHook(); }
+
+// gettimeofday() (reloj RTC de DeepSleep) también sigue el reloj virtual: el
+// enlazador la desvía aquí con --wrap=gettimeofday
+extern "C" int __wrap_gettimeofday(struct timeval* tv, void* tz) {
+    (void)tz;
+    if (tv) {
+        tv->tv_sec = (time_t)(clockUs / 1000000ULL);
+        tv->tv_usec = (suseconds_t)(clockUs % 1000000ULL);
+    }
+    return 0;
+}
+
+// ===== PINES =====
+void pinMode(uint8_t pin, uint8_t mode) { (void)pin; (void)mode; }
+void digitalWrite(uint8_t pin, uint8_t val) { host::setPin(pin, val); }
+int digitalRead(uint8_t pin) { return pin < NUM_DIGITAL_PINS ? pinLevel[pin] : LOW; }
+int analogRead(uint8_t pin) { (void)pin; return 0; }
+void attachInterrupt(uint8_t pin, void (*fn)(void), int mode) { (void)pin; (void)fn; (void)mode; }
+void attachInterruptArg(uint8_t pin, void (*fn)(void*), void* arg, int mode) {
+    (void)mode;   // Nivel o flanco: la ISR se llama en cada cambio de setPin()
+    if (pin >= NUM_DIGITAL_PINS) return;
+    pinIsr[pin] = fn;
+    pinIsrArg[pin] = arg;
+}
+void detachInterrupt(uint8_t pin) {
+    if (pin < NUM_DIGITAL_PINS) pinIsr[pin] = nullptr;
+}
+
+// ===== ALEATORIOS =====
+uint32_t esp_random(void) {
+    randState = randState * 1664525UL + 1013904223UL;
+    return randState;
+}
+
+long random(long howbig) { return howbig <= 0 ? 0 : (long)(esp_random() % (uint32_t)howbig); }
+long random(long howsmall, long howbig) { return howsmall >= howbig ? howsmall : howsmall + random(howbig - howsmall); }
+void randomSeed(unsigned long seed) { if (seed) randState = (uint32_t)seed; }
+
+bool setCpuFrequencyMhz(uint32_t mhz) { cpuMhz = mhz; return true; }
+uint32_t getCpuFrequencyMhz() { return cpuMhz; }
+
+// ===== STRING =====
+bool String::equalsIgnoreCase(const String& o) const {
+    if (s.size() != o.s.size()) return false;
+    for (size_t i = 0; i < s.size(); i++) {
+        if (tolower((unsigned char)s[i]) != tolower((unsigned char)o.s[i])) return false;
+    }
+    return true;
+}
+
+void String::trim() {
+    size_t b = 0, e = s.size();
+    while (b < e && isspace((unsigned char)s[b])) b++;
+    while (e > b && isspace((unsigned char)s[e - 1])) e--;
+    s = s.substr(b, e - b);
+}
+
+void String::toUpperCase() { for (char& c : s) c = (char)toupper((unsigned char)c); }
+void String::toLowerCase() { for (char& c : s) c = (char)tolower((unsigned char)c); }
+void String::replace(char find, char with) { for (char& c : s) if (c == find) c = with; }
+
+void String::replace(const String& find, const String& with) {
+    if (find.s.empty()) return;
+    for (size_t pos = s.find(find.s); pos != std::string::npos; pos = s.find(find.s, pos + with.s.size())) {
+        s.replace(pos, find.s.size(), with.s);
+    }
+}
+
+void String::getBytes(unsigned char* buf, unsigned int size, unsigned int index) const {
+    if (!buf || size == 0) return;
+    size_t n = index < s.size() ? std::min<size_t>(size - 1, s.size() - index) : 0;
+    if (n) memcpy(buf, s.data() + index, n);
+    buf[n] = 0;
+}
+
+void String::fromLong(long long v, unsigned char base) {
+    if (v < 0 && base == DEC) {
+        fromULong((unsigned long long)(-(v + 1)) + 1, base);
+        s.insert(0, 1, '-');
+    } else {
+        fromULong((unsigned long long)v, base);
+    }
+}
+
+void String::fromULong(unsigned long long v, unsigned char base) {
+    char buf[66];
+    char* p = buf + sizeof(buf) - 1;
+    *p = 0;
+    if (base < 2) base = DEC;
+    do {
+        unsigned d = (unsigned)(v % base);
+        *--p = (char)(d < 10 ? '0' + d : 'A' + d - 10);
+        v /= base;
+    } while (v);
+    s = p;
+}
+
+void String::fromDouble(double v, unsigned int decimals) {
+    char buf[48];
+    snprintf(buf, sizeof(buf), "%.*f", (int)decimals, v);
+    s = buf;
+}
+
+// ===== PRINT / STREAM =====
+size_t Print::printf(const char* fmt, ...) {
+    char small[256];
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(small, sizeof(small), fmt, args);
+    va_end(args);
+    if (n < 0) return 0;
+    if ((size_t)n < sizeof(small)) return write((const uint8_t*)small, n);
+    std::string big(n + 1, '\0');
+    va_start(args, fmt);
+    vsnprintf(&big[0], big.size(), fmt, args);
+    va_end(args);
+    return write((const uint8_t*)big.data(), n);
+}
+
+// Sin datos el reloj avanza como lo haría la espera real
+int Stream::timedRead() {
+    unsigned long start = millis();
+    do {
+        int c = read();
+        if (c >= 0) return c;
+        delay(1);
+    } while (millis() - start < timeoutMs);
+    return -1;
+}
+
+size_t Stream::readBytes(char* buf, size_t len) {
+    size_t n = 0;
+    while (n < len) {
+        int c = timedRead();
+        if (c < 0) break;
+        buf[n++] = (char)c;
+    }
+    return n;
+}
+
+String Stream::readString() {
+    String r;
+    for (int c = timedRead(); c >= 0; c = timedRead()) r += (char)c;
+    return r;
+}
+
+String Stream::readStringUntil(char terminator) {
+    String r;
+    for (int c = timedRead(); c >= 0 && c != terminator; c = timedRead()) r += (char)c;
+    return r;
+}
+
+// ===== HARDWARESERIAL =====
+int HardwareSerial::read() {
+    releaseDue();
+    if (rx.empty()) return -1;
+    uint8_t c = (uint8_t)rx.front();
+    rx.pop_front();
+    return c;
+}
+
+size_t HardwareSerial::write(uint8_t c) { return write(&c, 1); }
+
+size_t HardwareSerial::write(const uint8_t* buf, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        tx[txHead] = (char)buf[i];
+        txHead = (txHead + 1) % HOST_SERIAL_TX_BYTES;
+    }
+    txLen = std::min<size_t>(txLen + n, HOST_SERIAL_TX_BYTES);
+    if (uart == 0 && host::echo()) fwrite(buf, 1, n, stdout);
+    if (txTap) txTap(buf, n, txTapArg);
+    return n;
+}
+
+std::string HardwareSerial::output() const {
+    std::string out;
+    out.reserve(txLen);
+    size_t start = (txHead + HOST_SERIAL_TX_BYTES - txLen) % HOST_SERIAL_TX_BYTES;
+    for (size_t i = 0; i < txLen; i++) out += tx[(start + i) % HOST_SERIAL_TX_BYTES];
+    return out;
+}
+
+void HardwareSerial::feed(const char* text) {
+    while (*text) rx.push_back(*text++);
+    if (rxCallback) rxCallback();
+}
+
+void HardwareSerial::feedAfter(uint32_t delayMs, const char* text) {
+    Pending p = {host::elapsedUs() + (uint64_t)delayMs * 1000, text};
+    std::deque<Pending>::iterator it = pending.end();
+    while (it != pending.begin() && (it - 1)->atUs > p.atUs) --it;
+    pending.insert(it, p);
+}
+
+void HardwareSerial::releaseDue() {
+    while (!pending.empty() && pending.front().atUs <= host::elapsedUs()) {
+        std::string text = pending.front().text;
+        pending.pop_front();
+        feed(text.c_str());
+    }
+}
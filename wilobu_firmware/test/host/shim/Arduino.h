@@ -0,0 +1,237 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+// ===== CORE ARDUINO PARA PRUEBAS EN HOST =====
+// Lo mínimo del core ESP32 que usa el firmware, sobre un reloj virtual:
+// millis()/micros() solo avanzan con delay() o desde la prueba (HostClock).
+// Ambos devuelven uint32_t como en el ESP32 y el reloj arranca cerca de 2^32,
+// así que cualquier resta mal hecha falla en el host igual que en el equipo.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string>
+#include <algorithm>
+#include "esp_attr.h"
+#include "esp_system.h"
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH            1
+#define LOW             0
+#define INPUT           0x01
+#define OUTPUT          0x03
+#define INPUT_PULLUP    0x05
+#define RISING          0x01
+#define FALLING         0x02
+#define CHANGE          0x03
+#define ONLOW           0x04
+#define ONHIGH          0x05
+#define SERIAL_8N1      0x800001c
+#define DEC             10
+#define HEX             16
+#define NUM_DIGITAL_PINS 40
+
+// === Tiempo ===
+uint32_t millis();
+uint32_t micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+// === Pines ===
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+inline int digitalPinToInterrupt(uint8_t pin) { return pin; }
+void attachInterrupt(uint8_t pin, void (*fn)(void), int mode);
+void attachInterruptArg(uint8_t pin, void (*fn)(void*), void* arg, int mode);
+void detachInterrupt(uint8_t pin);
+
+// === Aleatorios (deterministas: semilla fija por prueba) ===
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(unsigned long seed);
+
+template<class T, class L, class H>
+inline T constrain(T x, L lo, H hi) { return x < lo ? lo : (x > hi ? hi : x); }
+using std::min;
+using std::max;
+
+bool setCpuFrequencyMhz(uint32_t mhz);
+uint32_t getCpuFrequencyMhz();
+
+// ===== STRING =====
+class String {
+public:
+    String() {}
+    String(const char* c) : s(c ? c : "") {}
+    String(const String& o) : s(o.s) {}
+    String(char c) : s(1, c) {}
+    explicit String(int v, unsigned char base = DEC) { fromLong(v, base); }
+    explicit String(unsigned int v, unsigned char base = DEC) { fromULong(v, base); }
+    explicit String(long v, unsigned char base = DEC) { fromLong(v, base); }
+    explicit String(unsigned long v, unsigned char base = DEC) { fromULong(v, base); }
+    explicit String(long long v, unsigned char base = DEC) { fromLong(v, base); }
+    explicit String(unsigned long long v, unsigned char base = DEC) { fromULong(v, base); }
+    explicit String(float v, unsigned int decimals = 2) { fromDouble(v, decimals); }
+    explicit String(double v, unsigned int decimals = 2) { fromDouble(v, decimals); }
+
+    String& operator=(const String& o) { s = o.s; return *this; }
+    String& operator=(const char* c) { s = c ? c : ""; return *this; }
+
+    unsigned int length() const { return (unsigned int)s.size(); }
+    bool isEmpty() const { return s.empty(); }
+    const char* c_str() const { return s.c_str(); }
+    bool reserve(unsigned int size) { s.reserve(size); return true; }
+
+    char charAt(unsigned int i) const { return i < s.size() ? s[i] : 0; }
+    void setCharAt(unsigned int i, char c) { if (i < s.size()) s[i] = c; }
+    char operator[](unsigned int i) const { return charAt(i); }
+    char& operator[](unsigned int i) { return s[i]; }
+
+    int indexOf(char c, unsigned int from = 0) const { return found(s.find(c, from)); }
+    int indexOf(const String& x, unsigned int from = 0) const { return found(s.find(x.s, from)); }
+    int indexOf(const char* x, unsigned int from = 0) const { return found(s.find(x, from)); }
+    int lastIndexOf(char c) const { return found(s.rfind(c)); }
+    int lastIndexOf(const String& x) const { return found(s.rfind(x.s)); }
+
+    String substring(unsigned int from) const { return from >= s.size() ? String() : String(s.substr(from)); }
+    String substring(unsigned int from, unsigned int to) const {
+        if (from > to) std::swap(from, to);
+        if (from >= s.size()) return String();
+        return String(s.substr(from, std::min<size_t>(to, s.size()) - from));
+    }
+
+    bool startsWith(const String& p) const { return s.compare(0, p.s.size(), p.s) == 0; }
+    bool endsWith(const String& p) const {
+        return s.size() >= p.s.size() && s.compare(s.size() - p.s.size(), p.s.size(), p.s) == 0;
+    }
+    bool equals(const String& o) const { return s == o.s; }
+    bool equalsIgnoreCase(const String& o) const;
+    int compareTo(const String& o) const { return s.compare(o.s); }
+
+    void trim();
+    void toUpperCase();
+    void toLowerCase();
+    void replace(char find, char with);
+    void replace(const String& find, const String& with);
+    void remove(unsigned int index) { if (index < s.size()) s.erase(index); }
+    void remove(unsigned int index, unsigned int count) { if (index < s.size()) s.erase(index, count); }
+
+    long toInt() const { return atol(s.c_str()); }
+    float toFloat() const { return (float)atof(s.c_str()); }
+    double toDouble() const { return atof(s.c_str()); }
+    void toCharArray(char* buf, unsigned int size, unsigned int index = 0) const { getBytes((unsigned char*)buf, size, index); }
+    void getBytes(unsigned char* buf, unsigned int size, unsigned int index = 0) const;
+
+    bool concat(const String& o) { s += o.s; return true; }
+    bool concat(const char* c) { if (c) s += c; return c != nullptr; }
+    bool concat(const char* c, unsigned int n) { if (c) s.append(c, n); return c != nullptr; }
+    bool concat(char c) { s += c; return true; }
+    bool concat(int v) { return concat(String(v)); }
+    bool concat(unsigned int v) { return concat(String(v)); }
+    bool concat(long v) { return concat(String(v)); }
+    bool concat(unsigned long v) { return concat(String(v)); }
+    bool concat(float v) { return concat(String(v)); }
+    bool concat(double v) { return concat(String(v)); }
+
+    template<class T> String& operator+=(const T& v) { concat(v); return *this; }
+
+    bool operator==(const String& o) const { return s == o.s; }
+    bool operator==(const char* c) const { return s == (c ? c : ""); }
+    bool operator!=(const String& o) const { return s != o.s; }
+    bool operator!=(const char* c) const { return !(*this == c); }
+    bool operator<(const String& o) const { return s < o.s; }
+
+private:
+    std::string s;
+
+    explicit String(const std::string& x) : s(x) {}
+    static int found(size_t pos) { return pos == std::string::npos ? -1 : (int)pos; }
+    void fromLong(long long v, unsigned char base);
+    void fromULong(unsigned long long v, unsigned char base);
+    void fromDouble(double v, unsigned int decimals);
+};
+
+inline String operator+(const String& a, const String& b) { String r(a); r.concat(b); return r; }
+inline String operator+(const String& a, const char* b) { String r(a); r.concat(b); return r; }
+inline String operator+(const char* a, const String& b) { String r(a); r.concat(b); return r; }
+inline String operator+(const String& a, char b) { String r(a); r.concat(b); return r; }
+inline String operator+(const String& a, int b) { String r(a); r.concat(b); return r; }
+inline String operator+(const String& a, unsigned int b) { String r(a); r.concat(b); return r; }
+inline String operator+(const String& a, long b) { String r(a); r.concat(b); return r; }
+inline String operator+(const String& a, unsigned long b) { String r(a); r.concat(b); return r; }
+inline String operator+(const String& a, float b) { String r(a); r.concat(b); return r; }
+inline String operator+(const String& a, double b) { String r(a); r.concat(b); return r; }
+inline bool operator==(const char* a, const String& b) { return b == a; }
+
+// ===== PRINT / STREAM =====
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buf, size_t n) {
+        size_t w = 0;
+        while (n--) w += write(*buf++);
+        return w;
+    }
+    size_t write(const char* str) { return str ? write((const uint8_t*)str, strlen(str)) : 0; }
+    size_t write(const char* buf, size_t n) { return write((const uint8_t*)buf, n); }
+
+    size_t print(const String& v) { return write(v.c_str()); }
+    size_t print(const char* v) { return write(v); }
+    size_t print(char v) { return write((uint8_t)v); }
+    size_t print(int v, int base = DEC) { return print(String(v, (unsigned char)base)); }
+    size_t print(unsigned int v, int base = DEC) { return print(String(v, (unsigned char)base)); }
+    size_t print(long v, int base = DEC) { return print(String(v, (unsigned char)base)); }
+    size_t print(unsigned long v, int base = DEC) { return print(String(v, (unsigned char)base)); }
+    size_t print(double v, int decimals = 2) { return print(String(v, (unsigned int)decimals)); }
+
+    template<class T> size_t println(const T& v) { size_t n = print(v); return n + println(); }
+    template<class T> size_t println(const T& v, int fmt) { size_t n = print(v, fmt); return n + println(); }
+    size_t println() { return write("\r\n"); }
+
+    size_t printf(const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+    virtual void flush() {}
+};
+
+class Stream : public Print {
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+
+    void setTimeout(unsigned long ms) { timeoutMs = ms; }
+    size_t readBytes(char* buf, size_t len);
+    size_t readBytes(uint8_t* buf, size_t len) { return readBytes((char*)buf, len); }
+    String readString();
+    String readStringUntil(char terminator);
+
+protected:
+    unsigned long timeoutMs = 1000;
+    int timedRead();
+};
+
+#include "HardwareSerial.h"
+
+// ===== ESP =====
+class EspClass {
+public:
+    void restart();
+    uint32_t getHeapSize();
+    uint32_t getFreeHeap();
+    uint32_t getMinFreeHeap();
+    uint32_t getMaxAllocHeap();
+    uint32_t getCpuFreqMHz() { return getCpuFrequencyMhz(); }
+    uint64_t getEfuseMac();
+};
+extern EspClass ESP;
+
+#endif
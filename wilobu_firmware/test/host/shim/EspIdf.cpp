@@ -0,0 +1,209 @@
+#include <Arduino.h>
+#include <esp_err.h>
+#include <esp_mac.h>
+#include <esp_ota_ops.h>
+#include <esp_pm.h>
+#include <esp_sleep.h>
+#include <driver/gpio.h>
+#include <driver/rtc_io.h>
+#include <driver/uart.h>
+#include <soc/gpio_struct.h>
+#include "Host.h"
+
+gpio_dev_t GPIO;
+
+// ===== ERRORES =====
+const char* esp_err_to_name(esp_err_t code) {
+    switch (code) {
+        case ESP_OK: return "ESP_OK";
+        case ESP_FAIL: return "ESP_FAIL";
+        case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_INVALID_SIZE: return "ESP_ERR_INVALID_SIZE";
+        case ESP_ERR_NOT_FOUND: return "ESP_ERR_NOT_FOUND";
+        case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+        default: return "UNKNOWN ERROR";
+    }
+}
+
+// ===== MAC =====
+esp_err_t esp_read_mac(uint8_t* mac, esp_mac_type_t type) {
+    uint64_t efuse = ESP.getEfuseMac();
+    for (int i = 0; i < 6; i++) mac[i] = (uint8_t)(efuse >> (8 * i));
+    mac[5] += (uint8_t)type;   // Como el IDF: STA, AP, BT y ETH consecutivas
+    return ESP_OK;
+}
+
+// ===== GESTIÓN DE ENERGÍA =====
+struct HostPmLock {
+    esp_pm_lock_type_t type;
+    int count;
+};
+
+namespace {
+HostPmLock pmLocks[4];
+int pmLockCount = 0;
+}
+
+esp_err_t esp_pm_configure(const void* config) { return config ? ESP_OK : ESP_ERR_INVALID_ARG; }
+
+esp_err_t esp_pm_lock_create(esp_pm_lock_type_t type, int arg, const char* name, esp_pm_lock_handle_t* handle) {
+    (void)arg; (void)name;
+    if (pmLockCount >= (int)(sizeof(pmLocks) / sizeof(pmLocks[0]))) return ESP_ERR_NO_MEM;
+    HostPmLock* lock = &pmLocks[pmLockCount++];
+    lock->type = type;
+    lock->count = 0;
+    *handle = lock;
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_acquire(esp_pm_lock_handle_t handle) {
+    if (!handle) return ESP_ERR_INVALID_ARG;
+    handle->count++;
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_release(esp_pm_lock_handle_t handle) {
+    if (!handle || handle->count == 0) return ESP_ERR_INVALID_STATE;
+    handle->count--;
+    return ESP_OK;
+}
+
+// ===== SLEEP =====
+namespace {
+uint64_t sleepTimerUs = 0;
+esp_sleep_source_t wakeCause = ESP_SLEEP_WAKEUP_UNDEFINED;
+}
+
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t us) { sleepTimerUs = us; return ESP_OK; }
+esp_err_t esp_sleep_enable_gpio_wakeup(void) { return ESP_OK; }
+esp_err_t esp_sleep_enable_uart_wakeup(int uart) { (void)uart; return ESP_OK; }
+esp_err_t esp_sleep_enable_ext0_wakeup(gpio_num_t pin, int level) { (void)pin; (void)level; return ESP_OK; }
+esp_err_t esp_sleep_enable_ext1_wakeup(uint64_t mask, esp_sleep_ext1_wakeup_mode_t mode) { (void)mask; (void)mode; return ESP_OK; }
+esp_err_t esp_sleep_pd_config(esp_sleep_pd_domain_t domain, esp_sleep_pd_option_t option) { (void)domain; (void)option; return ESP_OK; }
+esp_sleep_source_t esp_sleep_get_wakeup_cause(void) { return wakeCause; }
+uint64_t esp_sleep_get_ext1_wakeup_status(void) { return 0; }
+
+// Duerme hasta el timer: el resto de las tareas también quedan detenidas
+esp_err_t esp_light_sleep_start(void) {
+    host::advanceUs(sleepTimerUs);
+    wakeCause = ESP_SLEEP_WAKEUP_TIMER;
+    return ESP_OK;
+}
+
+void esp_deep_sleep_start(void) {
+    wakeCause = ESP_SLEEP_WAKEUP_TIMER;
+    host::setResetReason(ESP_RST_DEEPSLEEP);
+    throw host::Restart();
+}
+
+// ===== PINES =====
+esp_err_t gpio_wakeup_enable(gpio_num_t pin, gpio_int_type_t type) {
+    if (pin < 0 || pin >= 40) return ESP_ERR_INVALID_ARG;
+    GPIO.pin[pin].int_type = type;
+    GPIO.pin[pin].wakeup_enable = 1;
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_intr_type(gpio_num_t pin, gpio_int_type_t type) {
+    if (pin < 0 || pin >= 40) return ESP_ERR_INVALID_ARG;
+    GPIO.pin[pin].int_type = type;
+    return ESP_OK;
+}
+
+bool rtc_gpio_is_valid_gpio(gpio_num_t pin) {
+    switch (pin) {
+        case 0: case 2: case 4: case 12: case 13: case 14: case 15:
+        case 25: case 26: case 27: case 32: case 33: case 34: case 35:
+        case 36: case 37: case 38: case 39:
+            return true;
+        default:
+            return false;
+    }
+}
+
+esp_err_t rtc_gpio_pullup_en(gpio_num_t pin) { return rtc_gpio_is_valid_gpio(pin) ? ESP_OK : ESP_ERR_INVALID_ARG; }
+esp_err_t rtc_gpio_pulldown_dis(gpio_num_t pin) { return rtc_gpio_is_valid_gpio(pin) ? ESP_OK : ESP_ERR_INVALID_ARG; }
+esp_err_t uart_set_wakeup_threshold(uart_port_t uart, int edges) { (void)uart; return edges > 2 ? ESP_OK : ESP_ERR_INVALID_ARG; }
+
+// ===== OTA =====
+namespace {
+const esp_partition_t otaPartitions[2] = {
+    {0x00, 0x10, 0x010000, 0x1E0000, "ota_0", false},
+    {0x00, 0x11, 0x1F0000, 0x1E0000, "ota_1", false},
+};
+int runningSlot = 0;
+int bootSlot = 0;
+bool otaOpen = false;
+size_t otaWritten = 0;
+
+int slotOf(const esp_partition_t* p) {
+    if (p == &otaPartitions[0]) return 0;
+    if (p == &otaPartitions[1]) return 1;
+    return -1;
+}
+}
+
+const esp_partition_t* esp_ota_get_running_partition(void) { return &otaPartitions[runningSlot]; }
+
+const esp_partition_t* esp_ota_get_next_update_partition(const esp_partition_t* start) {
+    int slot = start ? slotOf(start) : runningSlot;
+    return slot < 0 ? nullptr : &otaPartitions[1 - slot];
+}
+
+esp_err_t esp_ota_begin(const esp_partition_t* partition, size_t imageSize, esp_ota_handle_t* handle) {
+    (void)imageSize;
+    int slot = slotOf(partition);
+    if (slot < 0) return ESP_ERR_INVALID_ARG;
+    if (slot == runningSlot || otaOpen) return ESP_ERR_INVALID_STATE;
+    otaOpen = true;
+    otaWritten = 0;
+    *handle = 1;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_write(esp_ota_handle_t handle, const void* data, size_t size) {
+    if (handle != 1 || !otaOpen || !data) return ESP_ERR_INVALID_ARG;
+    if (otaWritten + size > otaPartitions[0].size) return ESP_ERR_INVALID_SIZE;
+    otaWritten += size;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_end(esp_ota_handle_t handle) {
+    if (handle != 1 || !otaOpen) return ESP_ERR_NOT_FOUND;
+    otaOpen = false;
+    return otaWritten ? ESP_OK : ESP_ERR_INVALID_SIZE;
+}
+
+esp_err_t esp_ota_abort(esp_ota_handle_t handle) {
+    if (handle != 1 || !otaOpen) return ESP_ERR_NOT_FOUND;
+    otaOpen = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t* partition) {
+    int slot = slotOf(partition);
+    if (slot < 0) return ESP_ERR_INVALID_ARG;
+    bootSlot = slot;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_get_state_partition(const esp_partition_t* partition, esp_ota_img_states_t* state) {
+    if (slotOf(partition) < 0) return ESP_ERR_INVALID_ARG;
+    *state = ESP_OTA_IMG_VALID;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_mark_app_valid_cancel_rollback(void) { return ESP_OK; }
+esp_err_t esp_ota_mark_app_invalid_rollback_and_reboot(void) { return ESP_FAIL; }
+
+// Solo la partición corriendo tiene una app válida
+esp_err_t esp_ota_get_partition_description(const esp_partition_t* partition, esp_app_desc_t* desc) {
+    if (slotOf(partition) != runningSlot) return ESP_ERR_NOT_FOUND;
+    memset(desc, 0, sizeof(*desc));
+    desc->magic_word = 0xABCD5432;
+    strncpy(desc->version, "host", sizeof(desc->version) - 1);
+    strncpy(desc->project_name, "wilobu_firmware", sizeof(desc->project_name) - 1);
+    return ESP_OK;
+}
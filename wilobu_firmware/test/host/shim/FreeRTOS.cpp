@@ -0,0 +1,497 @@
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/event_groups.h>
+#include <freertos/timers.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <unistd.h>
+#include "Host.h"
+
+// ===== PLANIFICADOR COOPERATIVO =====
+// Cada tarea es un hilo, pero solo corre la que tiene el turno (current): las
+// demás esperan en su variable de condición. Una tarea entrega el turno al
+// bloquearse (delay, cola, evento, notificación, mutex) o al despertar a una
+// de mayor prioridad. Las condiciones de espera se evalúan al planificar, así
+// que dar un recurso no necesita avisar a nadie. Sin tareas listas, el reloj
+// virtual salta al plazo más próximo (tarea o timer): días simulados en segundos.
+// El hilo que hace la primera llamada (el de la prueba) es la tarea del loop.
+
+#define HOST_MAX_TASKS      8
+#define HOST_MAX_TIMERS     8
+#define HOST_LOOP_PRIO      1        // loopTask del core Arduino
+#define HOST_LOOP_STACK     8192
+#define HOST_NO_DEADLINE    UINT64_MAX
+
+struct HostTask;
+typedef bool (*WaitCond)(HostTask* task);
+
+struct HostTask {
+    char name[16];
+    UBaseType_t prio;
+    uint32_t stackBytes;
+    TaskFunction_t fn;
+    void* arg;
+    std::condition_variable cv;
+    bool blocked;
+    WaitCond cond;              // nullptr: solo plazo
+    void* waitObj;
+    uint64_t wakeUs;            // Plazo en host::elapsedUs() (no desborda)
+    uint64_t lastRunSeq;        // Desempate por antigüedad entre iguales
+    uint32_t notify;
+    EventBits_t waitBits;
+    bool waitAll;
+};
+
+struct HostQueue {
+    uint8_t* buf;
+    UBaseType_t length;
+    UBaseType_t itemSize;
+    UBaseType_t head;
+    UBaseType_t count;
+};
+
+struct HostSemaphore {
+    HostTask* owner;
+    UBaseType_t depth;
+};
+
+struct HostEventGroup {
+    EventBits_t bits;
+};
+
+struct HostTimer {
+    const char* name;
+    TickType_t period;
+    bool autoReload;
+    void* id;
+    TimerCallbackFunction_t callback;
+    bool active;
+    uint64_t expiryUs;
+};
+
+namespace {
+
+std::mutex baton;
+HostTask* tasks[HOST_MAX_TASKS];
+uint8_t taskCount = 0;
+HostTask* current = nullptr;
+HostTimer* timers[HOST_MAX_TIMERS];
+uint8_t timerCount = 0;
+bool inTimers = false;
+uint64_t runSeq = 0;
+uint64_t idleUs = 0;
+uint64_t switches = 0;
+
+uint64_t ticksToUs(TickType_t ticks) { return (uint64_t)ticks * 1000000ULL / configTICK_RATE_HZ; }
+
+uint64_t deadline(TickType_t wait) {
+    if (wait == portMAX_DELAY) return HOST_NO_DEADLINE;
+    return host::elapsedUs() + ticksToUs(wait);
+}
+
+bool isReady(HostTask* t) {
+    if (!t->blocked) return true;
+    if (t->cond && t->cond(t)) return true;
+    return host::elapsedUs() >= t->wakeUs;
+}
+
+// Vence los timers en orden; sus callbacks no cambian de tarea
+void runDueTimers() {
+    inTimers = true;
+    for (;;) {
+        HostTimer* due = nullptr;
+        for (uint8_t i = 0; i < timerCount; i++) {
+            HostTimer* t = timers[i];
+            if (t->active && t->expiryUs <= host::elapsedUs() && (!due || t->expiryUs < due->expiryUs)) due = t;
+        }
+        if (!due) break;
+        if (due->autoReload) due->expiryUs += ticksToUs(due->period);
+        else due->active = false;
+        due->callback(due);
+    }
+    inTimers = false;
+}
+
+HostTask* pickReady() {
+    HostTask* best = nullptr;
+    for (uint8_t i = 0; i < taskCount; i++) {
+        HostTask* t = tasks[i];
+        if (!isReady(t)) continue;
+        if (!best || t->prio > best->prio || (t->prio == best->prio && t->lastRunSeq < best->lastRunSeq)) best = t;
+    }
+    return best;
+}
+
+uint64_t nextDeadline() {
+    uint64_t next = HOST_NO_DEADLINE;
+    for (uint8_t i = 0; i < taskCount; i++) {
+        if (tasks[i]->blocked && tasks[i]->wakeUs < next) next = tasks[i]->wakeUs;
+    }
+    for (uint8_t i = 0; i < timerCount; i++) {
+        if (timers[i]->active && timers[i]->expiryUs < next) next = timers[i]->expiryUs;
+    }
+    return next;
+}
+
+// Entrega el turno a la tarea lista de mayor prioridad (puede ser la misma)
+void reschedule() {
+    HostTask* self = current;
+    HostTask* next;
+    for (;;) {
+        runDueTimers();
+        next = pickReady();
+        if (next) break;
+        uint64_t at = nextDeadline();
+        if (at == HOST_NO_DEADLINE) {
+            fprintf(stderr, "[HOST] Todas las tareas bloqueadas sin plazo (última: %s)\n", self->name);
+            fflush(stdout);
+            _exit(2);
+        }
+        idleUs += at - host::elapsedUs();
+        host::advanceUs(at - host::elapsedUs());
+    }
+    next->lastRunSeq = ++runSeq;
+    if (next == self) return;
+    switches++;
+    std::unique_lock<std::mutex> lk(baton);
+    current = next;
+    next->cv.notify_one();
+    self->cv.wait(lk, [self] { return current == self; });
+}
+
+// Bloquea a la tarea actual hasta que cond se cumpla o venza el plazo
+bool block(WaitCond cond, void* obj, TickType_t wait) {
+    HostTask* self = current;
+    if (cond && cond(self)) return true;
+    if (wait == 0 || inTimers) return false;
+    self->blocked = true;
+    self->cond = cond;
+    self->waitObj = obj;
+    self->wakeUs = deadline(wait);
+    reschedule();
+    self->blocked = false;
+    self->cond = nullptr;
+    return cond && cond(self);
+}
+
+// Algo que se acaba de dar pudo despertar a una tarea de mayor prioridad
+void preempt() {
+    if (inTimers || !current) return;
+    HostTask* self = current;
+    for (uint8_t i = 0; i < taskCount; i++) {
+        if (tasks[i]->prio > self->prio && isReady(tasks[i])) {
+            reschedule();
+            return;
+        }
+    }
+}
+
+void schedDelay(unsigned long ms) {
+    if (ms == 0) {
+        vPortYield();
+        return;
+    }
+    block(nullptr, nullptr, (TickType_t)ms);
+}
+
+HostTask* newTask(const char* name, UBaseType_t prio, uint32_t stackBytes) {
+    if (taskCount >= HOST_MAX_TASKS) return nullptr;
+    HostTask* t = new HostTask();
+    snprintf(t->name, sizeof(t->name), "%s", name);
+    t->prio = prio;
+    t->stackBytes = stackBytes;
+    t->blocked = false;
+    t->cond = nullptr;
+    t->waitObj = nullptr;
+    t->wakeUs = HOST_NO_DEADLINE;
+    t->lastRunSeq = 0;
+    t->notify = 0;
+    tasks[taskCount++] = t;
+    return t;
+}
+
+// El hilo de la prueba pasa a ser la tarea del loop; delay()/yield() ceden el turno
+void ensureStarted() {
+    if (current) return;
+    current = newTask("loopTask", HOST_LOOP_PRIO, HOST_LOOP_STACK);
+    host::delayHook = schedDelay;
+    host::yieldHook = vPortYield;
+}
+
+void taskMain(HostTask* self) {
+    {
+        std::unique_lock<std::mutex> lk(baton);
+        self->cv.wait(lk, [self] { return current == self; });
+    }
+    try {
+        self->fn(self->arg);
+    } catch (const host::Restart&) {
+        fprintf(stderr, "[HOST] Reinicio pedido desde la tarea %s\n", self->name);
+    }
+    // Una tarea de FreeRTOS no debe retornar
+    fprintf(stderr, "[HOST] La tarea %s terminó\n", self->name);
+    fflush(stdout);
+    _exit(3);
+}
+
+bool queueHasItem(HostTask* t) { return static_cast<HostQueue*>(t->waitObj)->count > 0; }
+bool queueHasSpace(HostTask* t) {
+    HostQueue* q = static_cast<HostQueue*>(t->waitObj);
+    return q->count < q->length;
+}
+bool semaphoreFree(HostTask* t) {
+    HostSemaphore* s = static_cast<HostSemaphore*>(t->waitObj);
+    return s->owner == nullptr || s->owner == t;
+}
+bool notified(HostTask* t) { return t->notify > 0; }
+bool bitsSet(HostTask* t) {
+    EventBits_t bits = static_cast<HostEventGroup*>(t->waitObj)->bits & t->waitBits;
+    return t->waitAll ? bits == t->waitBits : bits != 0;
+}
+
+} // namespace
+
+// ===== CONTROL DEL ENTORNO =====
+namespace host {
+
+uint64_t schedulerIdleUs() { return idleUs; }
+uint64_t contextSwitches() { return switches; }
+
+} // namespace host
+
+// ===== PUERTO =====
+BaseType_t xPortGetCoreID() { return 1; }
+
+void vPortYield() {
+    ensureStarted();
+    if (inTimers) return;
+    reschedule();
+}
+
+// ===== TAREAS =====
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char* name, uint32_t stackBytes, void* arg,
+                                   UBaseType_t prio, TaskHandle_t* handle, BaseType_t core) {
+    (void)core;
+    ensureStarted();
+    HostTask* t = newTask(name, prio, stackBytes);
+    if (!t) return pdFAIL;
+    t->fn = fn;
+    t->arg = arg;
+    std::thread(taskMain, t).detach();
+    if (handle) *handle = t;
+    preempt();
+    return pdPASS;
+}
+
+void vTaskDelay(TickType_t ticks) { schedDelay(ticks); }
+TickType_t xTaskGetTickCount() { return (TickType_t)(host::elapsedUs() * configTICK_RATE_HZ / 1000000ULL); }
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+    ensureStarted();
+    return current;
+}
+
+const char* pcTaskGetName(TaskHandle_t task) { return (task ? task : current)->name; }
+UBaseType_t uxTaskPriorityGet(TaskHandle_t task) { return (task ? task : current)->prio; }
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) { return (task ? task : current)->stackBytes; }
+UBaseType_t uxTaskGetNumberOfTasks() { return taskCount; }
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    task->notify++;
+    preempt();
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* woken) {
+    task->notify++;
+    if (woken && current && task->prio > current->prio) *woken = pdTRUE;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t wait) {
+    ensureStarted();
+    HostTask* self = current;
+    block(notified, nullptr, wait);
+    uint32_t value = self->notify;
+    if (value) self->notify = clearOnExit ? 0 : value - 1;
+    return value;
+}
+
+// ===== COLAS =====
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+    HostQueue* q = new HostQueue();
+    q->buf = new uint8_t[length * itemSize];
+    q->length = length;
+    q->itemSize = itemSize;
+    q->head = 0;
+    q->count = 0;
+    return q;
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void* item, TickType_t wait) {
+    ensureStarted();
+    if (q->count >= q->length) {
+        current->waitObj = q;
+        if (!block(queueHasSpace, q, wait)) return pdFALSE;
+    }
+    memcpy(q->buf + ((q->head + q->count) % q->length) * q->itemSize, item, q->itemSize);
+    q->count++;
+    preempt();
+    return pdTRUE;
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t q, const void* item, BaseType_t* woken) {
+    if (q->count >= q->length) return pdFALSE;
+    memcpy(q->buf + ((q->head + q->count) % q->length) * q->itemSize, item, q->itemSize);
+    q->count++;
+    if (woken) *woken = pdTRUE;
+    return pdTRUE;
+}
+
+// Solo para colas de 1 elemento, como en FreeRTOS: reemplaza lo que hubiera
+BaseType_t xQueueOverwrite(QueueHandle_t q, const void* item) {
+    ensureStarted();
+    memcpy(q->buf + q->head * q->itemSize, item, q->itemSize);
+    q->count = 1;
+    preempt();
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void* item, TickType_t wait) {
+    ensureStarted();
+    if (q->count == 0) {
+        current->waitObj = q;
+        if (!block(queueHasItem, q, wait)) return pdFALSE;
+    }
+    memcpy(item, q->buf + q->head * q->itemSize, q->itemSize);
+    q->head = (q->head + 1) % q->length;
+    q->count--;
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q) { return q->count; }
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t q) { return q->length - q->count; }
+
+// ===== SEMÁFOROS (MUTEX) =====
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+    HostSemaphore* s = new HostSemaphore();
+    s->owner = nullptr;
+    s->depth = 0;
+    return s;
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex() { return xSemaphoreCreateMutex(); }
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t s, TickType_t wait) {
+    ensureStarted();
+    current->waitObj = s;
+    if (!semaphoreFree(current) && !block(semaphoreFree, s, wait)) return pdFALSE;
+    s->owner = current;
+    s->depth++;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t s) {
+    if (s->owner != current || s->depth == 0) return pdFALSE;
+    if (--s->depth == 0) {
+        s->owner = nullptr;
+        preempt();
+    }
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t s, TickType_t wait) {
+    ensureStarted();
+    if (s->owner == current) return pdFALSE;   // No recursivo
+    return xSemaphoreTakeRecursive(s, wait);
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t s) { return xSemaphoreGiveRecursive(s); }
+
+// ===== GRUPOS DE EVENTOS =====
+EventGroupHandle_t xEventGroupCreate() {
+    HostEventGroup* g = new HostEventGroup();
+    g->bits = 0;
+    return g;
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t g, EventBits_t bits) {
+    g->bits |= bits;
+    EventBits_t value = g->bits;
+    preempt();
+    return value;
+}
+
+BaseType_t xEventGroupSetBitsFromISR(EventGroupHandle_t g, EventBits_t bits, BaseType_t* woken) {
+    g->bits |= bits;
+    if (woken) *woken = pdTRUE;
+    return pdPASS;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t g, EventBits_t bits) {
+    EventBits_t before = g->bits;
+    g->bits &= ~bits;
+    return before;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t g) { return g->bits; }
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t g, EventBits_t bits, BaseType_t clearOnExit,
+                                BaseType_t waitForAll, TickType_t wait) {
+    ensureStarted();
+    HostTask* self = current;
+    self->waitObj = g;
+    self->waitBits = bits;
+    self->waitAll = waitForAll;
+    bool met = block(bitsSet, g, wait);
+    EventBits_t value = g->bits;
+    if (met && clearOnExit) g->bits &= ~bits;
+    return value;
+}
+
+// ===== TIMERS =====
+TimerHandle_t xTimerCreate(const char* name, TickType_t period, UBaseType_t autoReload, void* id,
+                           TimerCallbackFunction_t callback) {
+    if (timerCount >= HOST_MAX_TIMERS) return nullptr;
+    HostTimer* t = new HostTimer();
+    t->name = name;
+    t->period = period;
+    t->autoReload = autoReload;
+    t->id = id;
+    t->callback = callback;
+    t->active = false;
+    t->expiryUs = 0;
+    timers[timerCount++] = t;
+    return t;
+}
+
+BaseType_t xTimerStart(TimerHandle_t t, TickType_t wait) {
+    (void)wait;
+    t->active = true;
+    t->expiryUs = host::elapsedUs() + ticksToUs(t->period);
+    return pdPASS;
+}
+
+BaseType_t xTimerStartFromISR(TimerHandle_t t, BaseType_t* woken) {
+    if (woken) *woken = pdFALSE;
+    return xTimerStart(t, 0);
+}
+
+// Como en FreeRTOS: cambia el período y arranca el timer aunque estuviera parado
+BaseType_t xTimerChangePeriod(TimerHandle_t t, TickType_t period, TickType_t wait) {
+    t->period = period;
+    return xTimerStart(t, wait);
+}
+
+BaseType_t xTimerStop(TimerHandle_t t, TickType_t wait) {
+    (void)wait;
+    t->active = false;
+    return pdPASS;
+}
+
+BaseType_t xTimerReset(TimerHandle_t t, TickType_t wait) { return xTimerStart(t, wait); }
+BaseType_t xTimerIsTimerActive(TimerHandle_t t) { return t->active ? pdTRUE : pdFALSE; }
+void* pvTimerGetTimerID(TimerHandle_t t) { return t->id; }
@@ -0,0 +1,65 @@
+#ifndef HOST_HARDWARE_SERIAL_H
+#define HOST_HARDWARE_SERIAL_H
+
+#include <string>
+#include <deque>
+
+#define HOST_SERIAL_TX_BYTES 16384
+
+// UART en memoria: lo último que el firmware escribe queda en tx (y todo se
+// copia a stdout con WILOBU_HOST_ECHO=1); lo que la prueba inyecta con feed()
+// se lee como si hubiera llegado por el cable, y con feedAfter() recién cuando
+// el reloj virtual llega al plazo. tx es un anillo fijo para que las pruebas
+// largas no crezcan ni cuenten bloques del heap por la consola
+class HardwareSerial : public Stream {
+public:
+    explicit HardwareSerial(int uartNum) : uart(uartNum) {}
+
+    void begin(unsigned long baud, uint32_t config = SERIAL_8N1, int8_t rxPin = -1, int8_t txPin = -1) {
+        (void)config; (void)rxPin; (void)txPin;
+        baudRate = baud;
+        open = true;
+    }
+    void end() { open = false; }
+    void setRxBufferSize(size_t size) { (void)size; }
+    void onReceive(void (*fn)(void)) { rxCallback = fn; }
+    unsigned long baud() const { return baudRate; }
+    operator bool() const { return open; }
+
+    int available() override { releaseDue(); return (int)rx.size(); }
+    int read() override;
+    int peek() override { releaseDue(); return rx.empty() ? -1 : (uint8_t)rx.front(); }
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* buf, size_t n) override;
+    using Print::write;
+
+    // === Lado de la prueba ===
+    void feed(const char* text);
+    void feedAfter(uint32_t delayMs, const char* text);
+    // Cada escritura del firmware pasa también por fn (módem simulado)
+    void onTransmit(void (*fn)(const uint8_t* buf, size_t n, void* arg), void* arg) { txTap = fn; txTapArg = arg; }
+    std::string output() const;     // Los últimos HOST_SERIAL_TX_BYTES escritos
+    void clearOutput() { txHead = 0; txLen = 0; }
+
+private:
+    int uart;
+    unsigned long baudRate = 0;
+    bool open = false;
+    std::deque<char> rx;
+    struct Pending {
+        uint64_t atUs;      // host::elapsedUs() en que se vuelve legible
+        std::string text;
+    };
+    std::deque<Pending> pending;    // Ordenado por atUs
+    void releaseDue();
+    char tx[HOST_SERIAL_TX_BYTES];
+    size_t txHead = 0;
+    size_t txLen = 0;
+    void (*rxCallback)(void) = nullptr;
+    void (*txTap)(const uint8_t* buf, size_t n, void* arg) = nullptr;
+    void* txTapArg = nullptr;
+};
+
+extern HardwareSerial Serial;
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef HOST_H
+#define HOST_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_system.h"
+
+// ===== CONTROL DEL ENTORNO SIMULADO =====
+// Lo usan solo las pruebas: el firmware ve millis(), Serial, pines, etc.
+namespace host {
+
+// Reinicia reloj, pines, consola y semilla de random(). preRollMs: cuánto
+// antes del desborde de 32 bits arrancan millis() y micros() (este último
+// vuelve a desbordar cada ~71,6 min, como en el ESP32)
+void reset(unsigned long preRollMs = 0);
+
+// Tiempo virtual transcurrido desde reset() (no desborda)
+uint64_t elapsedUs();
+inline uint64_t elapsedMs() { return elapsedUs() / 1000; }
+void advanceUs(uint64_t us);
+inline void advanceMs(uint64_t ms) { advanceUs(ms * 1000); }
+
+// delay()/yield() del firmware: por defecto solo avanzan el reloj; el
+// planificador de tareas las reemplaza para ceder la CPU a las demás
+extern void (*delayHook)(unsigned long ms);
+extern void (*yieldHook)();
+
+// Planificador de FreeRTOS (FreeRTOS.cpp): tiempo sin tareas listas (el reloj
+// saltó al próximo vencimiento) y cambios de tarea desde el arranque
+uint64_t schedulerIdleUs();
+uint64_t contextSwitches();
+
+// Nivel de un pin; si cambia y tiene ISR (attachInterruptArg), la dispara
+void setPin(uint8_t pin, int level);
+
+// === Reinicios y persistencia ===
+// esp_restart()/ESP.restart() lanzan Restart: la prueba lo atrapa y vuelve a
+// correr setup(). Las variables RTC_DATA_ATTR y la NVS simulada sobreviven
+struct Restart {};
+// Corte de energía: borra las variables RTC_DATA_ATTR (la NVS se conserva)
+void powerLoss();
+// NVS en blanco, como tras borrar la flash
+void nvsErase();
+void setResetReason(esp_reset_reason_t reason);
+
+// Montículo: new/delete y malloc/free del código enlazado pasan por un
+// contador. ESP.getFreeHeap() y compañía se calculan sobre HOST_HEAP_BYTES
+#define HOST_HEAP_BYTES 300000UL
+struct HeapStats {
+    uint64_t allocs;
+    uint64_t frees;
+    size_t liveBytes;
+    size_t peakBytes;
+};
+HeapStats heapStats();
+void resetHeapPeak();   // El pico vuelve a lo vivo ahora
+
+// Salida de consola a stdout (también con la variable WILOBU_HOST_ECHO=1)
+void setEcho(bool on);
+bool echo();
+
+} // namespace host
+
+#endif
@@ -0,0 +1,96 @@
+#include <Arduino.h>
+#include <new>
+#include "Host.h"
+
+// ===== MONTÍCULO CONTADO =====
+// Cada bloque lleva delante su tamaño para descontarlo al liberarlo. El
+// enlazador redirige malloc/realloc/calloc/free de los objetos del firmware
+// (-Wl,--wrap); new/delete se reemplazan directamente
+extern "C" {
+void* __real_malloc(size_t size);
+void* __real_realloc(void* ptr, size_t size);
+void __real_free(void* ptr);
+}
+
+namespace {
+
+const size_t kHeader = 16;   // Mantiene la alineación de malloc
+host::HeapStats stats = {0, 0, 0, 0};
+
+void* countedAlloc(size_t size) {
+    unsigned char* raw = (unsigned char*)__real_malloc(size + kHeader);
+    if (!raw) return nullptr;
+    *(size_t*)raw = size;
+    stats.allocs++;
+    stats.liveBytes += size;
+    if (stats.liveBytes > stats.peakBytes) stats.peakBytes = stats.liveBytes;
+    return raw + kHeader;
+}
+
+void countedFree(void* ptr) {
+    if (!ptr) return;
+    unsigned char* raw = (unsigned char*)ptr - kHeader;
+    stats.frees++;
+    stats.liveBytes -= *(size_t*)raw;
+    __real_free(raw);
+}
+
+} // namespace
+
+extern "C" {
+
+void* __wrap_malloc(size_t size) { return countedAlloc(size); }
+void __wrap_free(void* ptr) { countedFree(ptr); }
+
+void* __wrap_calloc(size_t n, size_t size) {
+    void* p = countedAlloc(n * size);
+    if (p) memset(p, 0, n * size);
+    return p;
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+    if (!ptr) return countedAlloc(size);
+    if (size == 0) {
+        countedFree(ptr);
+        return nullptr;
+    }
+    size_t old = *(size_t*)((unsigned char*)ptr - kHeader);
+    void* p = countedAlloc(size);
+    if (!p) return nullptr;
+    memcpy(p, ptr, old < size ? old : size);
+    countedFree(ptr);
+    return p;
+}
+
+} // extern "C"
+
+void* operator new(size_t size) {
+    void* p = countedAlloc(size ? size : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+void* operator new[](size_t size) { return operator new(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return countedAlloc(size ? size : 1); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return countedAlloc(size ? size : 1); }
+void operator delete(void* ptr) noexcept { countedFree(ptr); }
+void operator delete[](void* ptr) noexcept { countedFree(ptr); }
+void operator delete(void* ptr, size_t) noexcept { countedFree(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { countedFree(ptr); }
+
+namespace host {
+
+HeapStats heapStats() { return stats; }
+void resetHeapPeak() { stats.peakBytes = stats.liveBytes; }
+
+} // namespace host
+
+// ===== ESP =====
+uint32_t EspClass::getHeapSize() { return HOST_HEAP_BYTES; }
+uint32_t EspClass::getFreeHeap() {
+    return stats.liveBytes < HOST_HEAP_BYTES ? (uint32_t)(HOST_HEAP_BYTES - stats.liveBytes) : 0;
+}
+uint32_t EspClass::getMinFreeHeap() {
+    return stats.peakBytes < HOST_HEAP_BYTES ? (uint32_t)(HOST_HEAP_BYTES - stats.peakBytes) : 0;
+}
+uint32_t EspClass::getMaxAllocHeap() { return getFreeHeap(); }
+uint64_t EspClass::getEfuseMac() { return 0x0000A1B2C3D4E5F6ULL; }
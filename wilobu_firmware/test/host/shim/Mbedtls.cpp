@@ -0,0 +1,182 @@
+#include <string.h>
+#include <mbedtls/ecdsa.h>
+#include <mbedtls/md.h>
+#include <mbedtls/sha256.h>
+#include <openssl/core_names.h>
+#include <openssl/evp.h>
+#include <openssl/params.h>
+
+// ===== SHA-256 (FIPS 180-4) =====
+namespace {
+
+const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+inline uint32_t rotr(uint32_t x, int n) { return (x >> n) | (x << (32 - n)); }
+
+void compress(uint32_t state[8], const unsigned char block[64]) {
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++) {
+        w[i] = ((uint32_t)block[4 * i] << 24) | ((uint32_t)block[4 * i + 1] << 16) |
+               ((uint32_t)block[4 * i + 2] << 8) | block[4 * i + 3];
+    }
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int i = 0; i < 64; i++) {
+        uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + K[i] + w[i];
+        uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+    state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+    state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+} // namespace
+
+void mbedtls_sha256_init(mbedtls_sha256_context* ctx) { memset(ctx, 0, sizeof(*ctx)); }
+void mbedtls_sha256_free(mbedtls_sha256_context* ctx) { if (ctx) memset(ctx, 0, sizeof(*ctx)); }
+
+int mbedtls_sha256_starts_ret(mbedtls_sha256_context* ctx, int is224) {
+    static const uint32_t init[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+    };
+    if (is224) return -1;   // El firmware solo usa SHA-256
+    memcpy(ctx->state, init, sizeof(init));
+    ctx->total = 0;
+    return 0;
+}
+
+int mbedtls_sha256_update_ret(mbedtls_sha256_context* ctx, const unsigned char* input, size_t len) {
+    size_t fill = (size_t)(ctx->total % 64);
+    ctx->total += len;
+    while (len > 0) {
+        size_t n = 64 - fill < len ? 64 - fill : len;
+        memcpy(ctx->buffer + fill, input, n);
+        fill += n;
+        input += n;
+        len -= n;
+        if (fill == 64) {
+            compress(ctx->state, ctx->buffer);
+            fill = 0;
+        }
+    }
+    return 0;
+}
+
+int mbedtls_sha256_finish_ret(mbedtls_sha256_context* ctx, unsigned char output[32]) {
+    uint64_t bits = ctx->total * 8;
+    unsigned char pad[72] = {0x80};
+    size_t fill = (size_t)(ctx->total % 64);
+    size_t padLen = fill < 56 ? 56 - fill : 120 - fill;
+    for (int i = 0; i < 8; i++) pad[padLen + i] = (unsigned char)(bits >> (56 - 8 * i));
+    mbedtls_sha256_update_ret(ctx, pad, padLen + 8);
+    for (int i = 0; i < 8; i++) {
+        output[4 * i] = (unsigned char)(ctx->state[i] >> 24);
+        output[4 * i + 1] = (unsigned char)(ctx->state[i] >> 16);
+        output[4 * i + 2] = (unsigned char)(ctx->state[i] >> 8);
+        output[4 * i + 3] = (unsigned char)ctx->state[i];
+    }
+    return 0;
+}
+
+// ===== HMAC-SHA256 (RFC 2104) =====
+struct mbedtls_md_info_t {
+    mbedtls_md_type_t type;
+};
+
+namespace {
+const mbedtls_md_info_t sha256Info = {MBEDTLS_MD_SHA256};
+}
+
+const mbedtls_md_info_t* mbedtls_md_info_from_type(mbedtls_md_type_t type) {
+    return type == MBEDTLS_MD_SHA256 ? &sha256Info : nullptr;
+}
+
+int mbedtls_md_hmac(const mbedtls_md_info_t* info, const unsigned char* key, size_t keylen,
+                    const unsigned char* input, size_t ilen, unsigned char* output) {
+    if (info != &sha256Info) return -1;
+    unsigned char k[64] = {0};
+    mbedtls_sha256_context ctx;
+    if (keylen > sizeof(k)) {
+        mbedtls_sha256_starts_ret(&ctx, 0);
+        mbedtls_sha256_update_ret(&ctx, key, keylen);
+        mbedtls_sha256_finish_ret(&ctx, k);
+    } else {
+        memcpy(k, key, keylen);
+    }
+    unsigned char pad[64];
+    unsigned char inner[32];
+    for (int i = 0; i < 64; i++) pad[i] = k[i] ^ 0x36;
+    mbedtls_sha256_starts_ret(&ctx, 0);
+    mbedtls_sha256_update_ret(&ctx, pad, sizeof(pad));
+    mbedtls_sha256_update_ret(&ctx, input, ilen);
+    mbedtls_sha256_finish_ret(&ctx, inner);
+    for (int i = 0; i < 64; i++) pad[i] = k[i] ^ 0x5c;
+    mbedtls_sha256_starts_ret(&ctx, 0);
+    mbedtls_sha256_update_ret(&ctx, pad, sizeof(pad));
+    mbedtls_sha256_update_ret(&ctx, inner, sizeof(inner));
+    mbedtls_sha256_finish_ret(&ctx, output);
+    return 0;
+}
+
+// ===== ECDSA P-256 (libcrypto del host) =====
+void mbedtls_ecdsa_init(mbedtls_ecdsa_context* ctx) { memset(ctx, 0, sizeof(*ctx)); }
+void mbedtls_ecdsa_free(mbedtls_ecdsa_context* ctx) { if (ctx) memset(ctx, 0, sizeof(*ctx)); }
+
+int mbedtls_ecp_group_load(mbedtls_ecp_group* grp, mbedtls_ecp_group_id id) {
+    if (id != MBEDTLS_ECP_DP_SECP256R1) return MBEDTLS_ERR_ECP_BAD_INPUT_DATA;
+    grp->id = id;
+    return 0;
+}
+
+int mbedtls_ecp_point_read_binary(const mbedtls_ecp_group* grp, mbedtls_ecp_point* pt,
+                                  const unsigned char* buf, size_t ilen) {
+    // Como mbedtls: solo el formato sin comprimir; que esté en la curva se ve al verificar
+    if (grp->id != MBEDTLS_ECP_DP_SECP256R1 || ilen != sizeof(pt->raw) || buf[0] != 0x04) {
+        return MBEDTLS_ERR_ECP_BAD_INPUT_DATA;
+    }
+    memcpy(pt->raw, buf, ilen);
+    pt->len = ilen;
+    return 0;
+}
+
+int mbedtls_ecdsa_read_signature(mbedtls_ecdsa_context* ctx, const unsigned char* hash, size_t hlen,
+                                 const unsigned char* sig, size_t slen) {
+    if (ctx->grp.id != MBEDTLS_ECP_DP_SECP256R1 || ctx->Q.len != sizeof(ctx->Q.raw)) {
+        return MBEDTLS_ERR_ECP_BAD_INPUT_DATA;
+    }
+    OSSL_PARAM params[] = {
+        OSSL_PARAM_construct_utf8_string(OSSL_PKEY_PARAM_GROUP_NAME, (char*)"prime256v1", 0),
+        OSSL_PARAM_construct_octet_string(OSSL_PKEY_PARAM_PUB_KEY, ctx->Q.raw, ctx->Q.len),
+        OSSL_PARAM_construct_end(),
+    };
+    EVP_PKEY* key = nullptr;
+    EVP_PKEY_CTX* build = EVP_PKEY_CTX_new_from_name(nullptr, "EC", nullptr);
+    bool ok = build && EVP_PKEY_fromdata_init(build) > 0 &&
+              EVP_PKEY_fromdata(build, &key, EVP_PKEY_PUBLIC_KEY, params) > 0;
+    EVP_PKEY_CTX_free(build);
+    if (!ok) {
+        EVP_PKEY_free(key);
+        return MBEDTLS_ERR_ECP_BAD_INPUT_DATA;
+    }
+    // Sin digest fijado, EVP_PKEY_verify toma hash tal cual (lo que firma mbedtls)
+    EVP_PKEY_CTX* verify = EVP_PKEY_CTX_new(key, nullptr);
+    ok = verify && EVP_PKEY_verify_init(verify) > 0 && EVP_PKEY_verify(verify, sig, slen, hash, hlen) == 1;
+    EVP_PKEY_CTX_free(verify);
+    EVP_PKEY_free(key);
+    return ok ? 0 : MBEDTLS_ERR_ECP_VERIFY_FAILED;
+}
@@ -0,0 +1,31 @@
+#include <NimBLEDevice.h>
+
+namespace {
+bool initialized = false;
+NimBLEServer* server = nullptr;
+NimBLEAdvertising* advertising = nullptr;
+}
+
+void NimBLEDevice::init(const std::string& name) {
+    (void)name;
+    initialized = true;
+}
+
+void NimBLEDevice::deinit(bool clearAll) {
+    initialized = false;
+    if (!clearAll) return;
+    delete server;
+    delete advertising;
+    server = nullptr;
+    advertising = nullptr;
+}
+
+NimBLEServer* NimBLEDevice::createServer() {
+    if (!server) server = new NimBLEServer();
+    return server;
+}
+
+NimBLEAdvertising* NimBLEDevice::getAdvertising() {
+    if (!advertising) advertising = new NimBLEAdvertising();
+    return advertising;
+}
@@ -0,0 +1,156 @@
+#ifndef HOST_NIMBLE_DEVICE_H
+#define HOST_NIMBLE_DEVICE_H
+
+#include <Arduino.h>
+#include <string>
+#include <vector>
+
+// ===== NIMBLE SIN RADIO =====
+// Servidor, servicios y características en memoria (misma propiedad que
+// NimBLE 1.4: deinit(true) borra el servidor con lo que cuelga de él). Nadie
+// se conecta: la publicidad solo lleva la cuenta de si está activa
+typedef enum {
+    ESP_PWR_LVL_N12, ESP_PWR_LVL_N9, ESP_PWR_LVL_N6, ESP_PWR_LVL_N3,
+    ESP_PWR_LVL_N0, ESP_PWR_LVL_P3, ESP_PWR_LVL_P6, ESP_PWR_LVL_P9,
+} esp_power_level_t;
+typedef enum { ESP_BLE_PWR_TYPE_ADV = 9, ESP_BLE_PWR_TYPE_DEFAULT = 11 } esp_ble_power_type_t;
+
+#define BLE_HS_IO_DISPLAY_ONLY  0
+
+namespace NIMBLE_PROPERTY {
+enum {
+    READ = 0x0002, WRITE_NR = 0x0004, WRITE = 0x0008, NOTIFY = 0x0010, INDICATE = 0x0020,
+    READ_ENC = 0x0200, READ_AUTHEN = 0x0400, WRITE_ENC = 0x1000, WRITE_AUTHEN = 0x2000,
+};
+}
+
+struct ble_gap_sec_state {
+    unsigned encrypted : 1;
+    unsigned authenticated : 1;
+    unsigned bonded : 1;
+    unsigned key_size : 5;
+};
+struct ble_gap_conn_desc {
+    uint16_t conn_handle;
+    ble_gap_sec_state sec_state;
+};
+
+class NimBLECharacteristic;
+class NimBLECharacteristicCallbacks {
+public:
+    virtual ~NimBLECharacteristicCallbacks() {}
+    virtual void onRead(NimBLECharacteristic* c) { (void)c; }
+    virtual void onWrite(NimBLECharacteristic* c) { (void)c; }
+};
+
+class NimBLECharacteristic {
+public:
+    void setCallbacks(NimBLECharacteristicCallbacks* cb) { callbacks = cb; }
+    std::string getValue() const { return value; }
+    void setValue(const uint8_t* data, size_t len) { value.assign((const char*)data, len); }
+    void setValue(const std::string& v) { value = v; }
+    void notify(bool response = true) { (void)response; notifications++; }
+    size_t getSubscribedCount() const { return 0; }
+
+    // === Lado de la prueba ===
+    void write(const std::string& v) {
+        value = v;
+        if (callbacks) callbacks->onWrite(this);
+    }
+    uint32_t notifyCount() const { return notifications; }
+
+private:
+    std::string value;
+    NimBLECharacteristicCallbacks* callbacks = nullptr;
+    uint32_t notifications = 0;
+};
+
+class NimBLEService {
+public:
+    ~NimBLEService() { for (NimBLECharacteristic* c : chars) delete c; }
+    NimBLECharacteristic* createCharacteristic(const char* uuid, uint32_t properties, uint16_t maxLen = 512) {
+        (void)uuid; (void)properties; (void)maxLen;
+        chars.push_back(new NimBLECharacteristic());
+        return chars.back();
+    }
+    bool start() { return true; }
+
+private:
+    std::vector<NimBLECharacteristic*> chars;
+};
+
+class NimBLEServer;
+class NimBLEServerCallbacks {
+public:
+    virtual ~NimBLEServerCallbacks() {}
+    virtual void onConnect(NimBLEServer* server, ble_gap_conn_desc* desc) { (void)server; (void)desc; }
+    virtual void onDisconnect(NimBLEServer* server) { (void)server; }
+    virtual void onMTUChange(uint16_t mtu, ble_gap_conn_desc* desc) { (void)mtu; (void)desc; }
+    virtual void onAuthenticationComplete(ble_gap_conn_desc* desc) { (void)desc; }
+};
+
+class NimBLEServer {
+public:
+    ~NimBLEServer() {
+        for (NimBLEService* s : services) delete s;
+        if (deleteCallbacks) delete callbacks;
+    }
+    void setCallbacks(NimBLEServerCallbacks* cb, bool deleteOnDestroy = true) {
+        if (deleteCallbacks) delete callbacks;
+        callbacks = cb;
+        deleteCallbacks = deleteOnDestroy;
+    }
+    NimBLEService* createService(const char* uuid) {
+        (void)uuid;
+        services.push_back(new NimBLEService());
+        return services.back();
+    }
+    void advertiseOnDisconnect(bool on) { (void)on; }
+    bool updateConnParams(uint16_t handle, uint16_t minItvl, uint16_t maxItvl, uint16_t latency, uint16_t timeout) {
+        (void)handle; (void)minItvl; (void)maxItvl; (void)latency; (void)timeout;
+        return true;
+    }
+    size_t getConnectedCount() const { return 0; }
+    int disconnect(uint16_t handle, uint8_t reason = 0x13) { (void)handle; (void)reason; return 0; }
+
+private:
+    std::vector<NimBLEService*> services;
+    NimBLEServerCallbacks* callbacks = nullptr;
+    bool deleteCallbacks = false;
+};
+
+class NimBLEAdvertising {
+public:
+    void addServiceUUID(const char* uuid) { (void)uuid; }
+    void setScanResponse(bool on) { (void)on; }
+    void setMinInterval(uint16_t itvl) { (void)itvl; }
+    void setMaxInterval(uint16_t itvl) { (void)itvl; }
+    bool start(uint32_t durationS = 0, void (*onComplete)(NimBLEAdvertising*) = nullptr) {
+        (void)durationS; (void)onComplete;
+        advertising = true;
+        return true;
+    }
+    bool stop() { advertising = false; return true; }
+    bool isAdvertising() const { return advertising; }
+
+private:
+    bool advertising = false;
+};
+
+class NimBLEDevice {
+public:
+    static void init(const std::string& name);
+    static void deinit(bool clearAll = false);
+    static bool setPower(esp_power_level_t level, esp_ble_power_type_t type = ESP_BLE_PWR_TYPE_DEFAULT) {
+        (void)level; (void)type;
+        return true;
+    }
+    static int setMTU(uint16_t mtu) { (void)mtu; return 0; }
+    static void setSecurityAuth(bool bonding, bool mitm, bool sc) { (void)bonding; (void)mitm; (void)sc; }
+    static void setSecurityIOCap(uint8_t cap) { (void)cap; }
+    static void setSecurityPasskey(uint32_t passkey) { (void)passkey; }
+    static NimBLEServer* createServer();
+    static NimBLEAdvertising* getAdvertising();
+};
+
+#endif
@@ -0,0 +1,82 @@
+#include <Preferences.h>
+#include <map>
+#include "Host.h"
+
+namespace {
+
+typedef std::map<std::string, std::string> Namespace;
+
+// Función estática: otras variables globales pueden usar NVS al construirse
+std::map<std::string, Namespace>& flash() {
+    static std::map<std::string, Namespace> nvs;
+    return nvs;
+}
+
+} // namespace
+
+namespace host {
+void nvsErase() { flash().clear(); }
+}
+
+bool Preferences::begin(const char* name, bool ro, const char* partitionLabel) {
+    (void)partitionLabel;
+    if (opened || !name || !*name) return false;
+    ns = name;
+    readOnly = ro;
+    opened = true;
+    return true;
+}
+
+void Preferences::end() { opened = false; }
+
+bool Preferences::clear() {
+    if (!opened || readOnly) return false;
+    flash().erase(ns);
+    return true;
+}
+
+bool Preferences::remove(const char* key) {
+    if (!opened || readOnly || !key) return false;
+    return flash()[ns].erase(key) > 0;
+}
+
+bool Preferences::isKey(const char* key) {
+    if (!opened || !key) return false;
+    const Namespace& n = flash()[ns];
+    return n.find(key) != n.end();
+}
+
+size_t Preferences::putValue(const char* key, const void* value, size_t len) {
+    if (!opened || readOnly || !key || (!value && len)) return 0;
+    flash()[ns][key].assign((const char*)value, len);
+    return len;
+}
+
+size_t Preferences::putBytes(const char* key, const void* value, size_t len) { return putValue(key, value, len); }
+
+size_t Preferences::getBytesLength(const char* key) {
+    if (!opened || !key) return 0;
+    const Namespace& n = flash()[ns];
+    Namespace::const_iterator it = n.find(key);
+    return it == n.end() ? 0 : it->second.size();
+}
+
+// Como en el core: si el valor no cabe en buf no se copia nada
+size_t Preferences::getBytes(const char* key, void* buf, size_t maxLen) {
+    size_t len = getBytesLength(key);
+    if (!len || !buf || len > maxLen) return 0;
+    memcpy(buf, flash()[ns][key].data(), len);
+    return len;
+}
+
+size_t Preferences::putString(const char* key, const char* value) {
+    if (!value) return 0;
+    return putValue(key, value, strlen(value) + 1) ? strlen(value) : 0;
+}
+
+String Preferences::getString(const char* key, const String& defaultValue) {
+    size_t len = getBytesLength(key);
+    if (!len) return defaultValue;
+    const std::string& v = flash()[ns][key];
+    return String(v.c_str());
+}
@@ -0,0 +1,53 @@
+#ifndef HOST_PREFERENCES_H
+#define HOST_PREFERENCES_H
+
+#include <Arduino.h>
+
+// ===== NVS SIMULADA =====
+// Mismo API que la Preferences del core ESP32 sobre un mapa en memoria que
+// sobrevive a los reinicios simulados; host::nvsErase() la deja en blanco
+class Preferences {
+public:
+    bool begin(const char* name, bool readOnly = false, const char* partitionLabel = nullptr);
+    void end();
+
+    bool clear();
+    bool remove(const char* key);
+    bool isKey(const char* key);
+
+    size_t putBytes(const char* key, const void* value, size_t len);
+    size_t getBytes(const char* key, void* buf, size_t maxLen);
+    size_t getBytesLength(const char* key);
+
+    size_t putString(const char* key, const char* value);
+    size_t putString(const char* key, const String& value) { return putString(key, value.c_str()); }
+    String getString(const char* key, const String& defaultValue = String());
+
+    size_t putBool(const char* key, bool value) { return putValue(key, &value, sizeof(value)); }
+    bool getBool(const char* key, bool defaultValue = false) { return getValue(key, defaultValue); }
+    size_t putUChar(const char* key, uint8_t value) { return putValue(key, &value, sizeof(value)); }
+    uint8_t getUChar(const char* key, uint8_t defaultValue = 0) { return getValue(key, defaultValue); }
+    size_t putUShort(const char* key, uint16_t value) { return putValue(key, &value, sizeof(value)); }
+    uint16_t getUShort(const char* key, uint16_t defaultValue = 0) { return getValue(key, defaultValue); }
+    size_t putInt(const char* key, int32_t value) { return putValue(key, &value, sizeof(value)); }
+    int32_t getInt(const char* key, int32_t defaultValue = 0) { return getValue(key, defaultValue); }
+    size_t putUInt(const char* key, uint32_t value) { return putValue(key, &value, sizeof(value)); }
+    uint32_t getUInt(const char* key, uint32_t defaultValue = 0) { return getValue(key, defaultValue); }
+    size_t putULong(const char* key, uint32_t value) { return putUInt(key, value); }
+    uint32_t getULong(const char* key, uint32_t defaultValue = 0) { return getUInt(key, defaultValue); }
+    size_t putFloat(const char* key, float value) { return putValue(key, &value, sizeof(value)); }
+    float getFloat(const char* key, float defaultValue = NAN) { return getValue(key, defaultValue); }
+
+private:
+    std::string ns;
+    bool opened = false;
+    bool readOnly = true;
+
+    size_t putValue(const char* key, const void* value, size_t len);
+    template<class T> T getValue(const char* key, T defaultValue) {
+        T v;
+        return getBytesLength(key) == sizeof(T) && getBytes(key, &v, sizeof(T)) == sizeof(T) ? v : defaultValue;
+    }
+};
+
+#endif
@@ -0,0 +1,35 @@
+#include <Arduino.h>
+#include "Host.h"
+
+// ===== REINICIOS =====
+// Límites de la sección RTC_DATA_ATTR (ver esp_attr.h), puestos por el enlazador
+extern "C" {
+extern char __start_host_rtc_data[] __attribute__((weak));
+extern char __stop_host_rtc_data[] __attribute__((weak));
+}
+
+namespace {
+esp_reset_reason_t resetReason = ESP_RST_POWERON;
+}
+
+namespace host {
+
+void powerLoss() {
+    char* start = __start_host_rtc_data;
+    char* stop = __stop_host_rtc_data;
+    if (start && stop > start) memset(start, 0, stop - start);
+    resetReason = ESP_RST_POWERON;
+}
+
+void setResetReason(esp_reset_reason_t reason) { resetReason = reason; }
+
+} // namespace host
+
+void esp_restart(void) {
+    resetReason = ESP_RST_SW;
+    throw host::Restart();
+}
+
+esp_reset_reason_t esp_reset_reason(void) { return resetReason; }
+
+void EspClass::restart() { esp_restart(); }
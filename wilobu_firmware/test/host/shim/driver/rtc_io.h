@@ -0,0 +1,11 @@
+#ifndef HOST_DRIVER_RTC_IO_H
+#define HOST_DRIVER_RTC_IO_H
+
+#include "driver/gpio.h"
+
+// Pines RTC del ESP32: 0, 2, 4, 12-15, 25-27, 32-39
+bool rtc_gpio_is_valid_gpio(gpio_num_t pin);
+esp_err_t rtc_gpio_pullup_en(gpio_num_t pin);
+esp_err_t rtc_gpio_pulldown_dis(gpio_num_t pin);
+
+#endif
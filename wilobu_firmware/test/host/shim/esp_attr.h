@@ -0,0 +1,12 @@
+#ifndef HOST_ESP_ATTR_H
+#define HOST_ESP_ATTR_H
+
+// Las variables RTC_DATA_ATTR van a una sección propia: host::powerLoss() la
+// borra (corte de energía) y un reinicio por software la conserva, como en el
+// equipo. Los límites los genera el enlazador (__start_/__stop_)
+#define RTC_DATA_ATTR   __attribute__((section("host_rtc_data")))
+#define RTC_NOINIT_ATTR __attribute__((section("host_rtc_data")))
+#define IRAM_ATTR
+#define DRAM_ATTR
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef HOST_ESP_OTA_OPS_H
+#define HOST_ESP_OTA_OPS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "esp_partition.h"
+
+// ===== OTA =====
+// Dos particiones (ota_0 corriendo, ota_1 libre); lo escrito solo se cuenta
+typedef uint32_t esp_ota_handle_t;
+#define OTA_SIZE_UNKNOWN            0xFFFFFFFF
+#define OTA_WITH_SEQUENTIAL_WRITES  0xFFFFFFFE
+
+typedef enum {
+    ESP_OTA_IMG_NEW = 0,
+    ESP_OTA_IMG_PENDING_VERIFY = 1,
+    ESP_OTA_IMG_VALID = 2,
+    ESP_OTA_IMG_INVALID = 3,
+    ESP_OTA_IMG_ABORTED = 4,
+    ESP_OTA_IMG_UNDEFINED = -1,
+} esp_ota_img_states_t;
+
+typedef struct {
+    uint32_t magic_word;
+    uint32_t secure_version;
+    uint32_t reserv1[2];
+    char version[32];
+    char project_name[32];
+    char time[16];
+    char date[16];
+    char idf_ver[32];
+    uint8_t app_elf_sha256[32];
+    uint32_t reserv2[20];
+} esp_app_desc_t;
+
+const esp_partition_t* esp_ota_get_running_partition(void);
+const esp_partition_t* esp_ota_get_next_update_partition(const esp_partition_t* start);
+esp_err_t esp_ota_begin(const esp_partition_t* partition, size_t imageSize, esp_ota_handle_t* handle);
+esp_err_t esp_ota_write(esp_ota_handle_t handle, const void* data, size_t size);
+esp_err_t esp_ota_end(esp_ota_handle_t handle);
+esp_err_t esp_ota_abort(esp_ota_handle_t handle);
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t* partition);
+esp_err_t esp_ota_get_state_partition(const esp_partition_t* partition, esp_ota_img_states_t* state);
+esp_err_t esp_ota_mark_app_valid_cancel_rollback(void);
+esp_err_t esp_ota_mark_app_invalid_rollback_and_reboot(void);
+esp_err_t esp_ota_get_partition_description(const esp_partition_t* partition, esp_app_desc_t* desc);
+
+#endif
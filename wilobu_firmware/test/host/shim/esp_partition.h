@@ -0,0 +1,16 @@
+#ifndef HOST_ESP_PARTITION_H
+#define HOST_ESP_PARTITION_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef struct {
+    int type;
+    int subtype;
+    uint32_t address;
+    uint32_t size;
+    char label[17];
+    bool encrypted;
+} esp_partition_t;
+
+#endif
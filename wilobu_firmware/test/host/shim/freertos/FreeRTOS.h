@@ -0,0 +1,50 @@
+#ifndef HOST_FREERTOS_H
+#define HOST_FREERTOS_H
+
+// ===== FREERTOS SIMULADO =====
+// Planificador cooperativo sobre el reloj virtual (FreeRTOS.cpp): cada tarea
+// es un hilo del PC pero solo corre una a la vez, como en un núcleo. Cambia
+// de tarea al bloquearse o al despertar a una de mayor prioridad; con todas
+// bloqueadas, el reloj salta al plazo más próximo.
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t EventBits_t;
+typedef void (*TaskFunction_t)(void*);
+
+typedef struct HostTask* TaskHandle_t;
+typedef struct HostQueue* QueueHandle_t;
+typedef struct HostSemaphore* SemaphoreHandle_t;
+typedef struct HostEventGroup* EventGroupHandle_t;
+typedef struct HostTimer* TimerHandle_t;
+
+#define pdTRUE                  1
+#define pdFALSE                 0
+#define pdPASS                  pdTRUE
+#define pdFAIL                  pdFALSE
+#define configTICK_RATE_HZ      1000
+#define configMAX_PRIORITIES    25
+#define portNUM_PROCESSORS      2
+#define portTICK_PERIOD_MS      (1000 / configTICK_RATE_HZ)
+#define portMAX_DELAY           ((TickType_t)0xFFFFFFFFUL)
+#define pdMS_TO_TICKS(ms)       ((TickType_t)(((TickType_t)(ms) * (TickType_t)configTICK_RATE_HZ) / (TickType_t)1000U))
+#define tskNO_AFFINITY          0x7FFFFFFF
+
+// Una sola tarea corre a la vez: las secciones críticas no tienen nada que excluir
+typedef struct { int owner; } portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED    {0}
+#define portENTER_CRITICAL(mux)         ((void)(mux))
+#define portEXIT_CRITICAL(mux)          ((void)(mux))
+#define portENTER_CRITICAL_ISR(mux)     ((void)(mux))
+#define portEXIT_CRITICAL_ISR(mux)      ((void)(mux))
+#define portYIELD_FROM_ISR(...)         do {} while (0)
+#define taskYIELD()                     vPortYield()
+
+BaseType_t xPortGetCoreID();
+void vPortYield();
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef HOST_FREERTOS_QUEUE_H
+#define HOST_FREERTOS_QUEUE_H
+
+#include "FreeRTOS.h"
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize);
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t wait);
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void* item, BaseType_t* woken);
+BaseType_t xQueueOverwrite(QueueHandle_t queue, const void* item);
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t wait);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue);
+
+#endif
@@ -0,0 +1,13 @@
+#ifndef HOST_FREERTOS_SEMPHR_H
+#define HOST_FREERTOS_SEMPHR_H
+
+#include "FreeRTOS.h"
+
+SemaphoreHandle_t xSemaphoreCreateMutex();
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex();
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t wait);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem);
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t sem, TickType_t wait);
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t sem);
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef HOST_FREERTOS_TIMERS_H
+#define HOST_FREERTOS_TIMERS_H
+
+#include "FreeRTOS.h"
+
+typedef void (*TimerCallbackFunction_t)(TimerHandle_t timer);
+
+// Los callbacks corren en el planificador apenas vencen, antes de elegir la
+// próxima tarea (en el equipo, la tarea de timers); no deben bloquear
+TimerHandle_t xTimerCreate(const char* name, TickType_t period, UBaseType_t autoReload, void* id,
+                           TimerCallbackFunction_t callback);
+BaseType_t xTimerStart(TimerHandle_t timer, TickType_t wait);
+BaseType_t xTimerStartFromISR(TimerHandle_t timer, BaseType_t* woken);
+BaseType_t xTimerChangePeriod(TimerHandle_t timer, TickType_t period, TickType_t wait);
+BaseType_t xTimerStop(TimerHandle_t timer, TickType_t wait);
+BaseType_t xTimerReset(TimerHandle_t timer, TickType_t wait);
+BaseType_t xTimerIsTimerActive(TimerHandle_t timer);
+void* pvTimerGetTimerID(TimerHandle_t timer);
+
+#endif
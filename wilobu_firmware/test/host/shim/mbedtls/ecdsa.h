@@ -0,0 +1,30 @@
+#ifndef HOST_MBEDTLS_ECDSA_H
+#define HOST_MBEDTLS_ECDSA_H
+
+#include <stddef.h>
+
+// Solo verificación ECDSA P-256 con clave pública sin comprimir (firma del
+// manifiesto OTA). Mbedtls.cpp verifica de verdad con la libcrypto del host
+#define MBEDTLS_ERR_ECP_BAD_INPUT_DATA  -0x4F80
+#define MBEDTLS_ERR_ECP_VERIFY_FAILED   -0x4E00
+
+typedef enum { MBEDTLS_ECP_DP_NONE = 0, MBEDTLS_ECP_DP_SECP256R1 = 3 } mbedtls_ecp_group_id;
+typedef struct { mbedtls_ecp_group_id id; } mbedtls_ecp_group;
+typedef struct {
+    unsigned char raw[65];
+    size_t len;
+} mbedtls_ecp_point;
+typedef struct {
+    mbedtls_ecp_group grp;
+    mbedtls_ecp_point Q;
+} mbedtls_ecdsa_context;
+
+void mbedtls_ecdsa_init(mbedtls_ecdsa_context* ctx);
+void mbedtls_ecdsa_free(mbedtls_ecdsa_context* ctx);
+int mbedtls_ecp_group_load(mbedtls_ecp_group* grp, mbedtls_ecp_group_id id);
+int mbedtls_ecp_point_read_binary(const mbedtls_ecp_group* grp, mbedtls_ecp_point* pt,
+                                  const unsigned char* buf, size_t ilen);
+int mbedtls_ecdsa_read_signature(mbedtls_ecdsa_context* ctx, const unsigned char* hash, size_t hlen,
+                                 const unsigned char* sig, size_t slen);
+
+#endif
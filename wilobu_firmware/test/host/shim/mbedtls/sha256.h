@@ -0,0 +1,20 @@
+#ifndef HOST_MBEDTLS_SHA256_H
+#define HOST_MBEDTLS_SHA256_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// SHA-256 completo (Mbedtls.cpp): OtaUpdate verifica imágenes de verdad
+typedef struct {
+    uint32_t state[8];
+    uint64_t total;
+    unsigned char buffer[64];
+} mbedtls_sha256_context;
+
+void mbedtls_sha256_init(mbedtls_sha256_context* ctx);
+void mbedtls_sha256_free(mbedtls_sha256_context* ctx);
+int mbedtls_sha256_starts_ret(mbedtls_sha256_context* ctx, int is224);
+int mbedtls_sha256_update_ret(mbedtls_sha256_context* ctx, const unsigned char* input, size_t len);
+int mbedtls_sha256_finish_ret(mbedtls_sha256_context* ctx, unsigned char output[32]);
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef HOST_SOC_GPIO_STRUCT_H
+#define HOST_SOC_GPIO_STRUCT_H
+
+#include <stdint.h>
+
+// Registros de pin: solo los campos que escribe el firmware
+typedef struct {
+    struct {
+        uint32_t int_type : 3;
+        uint32_t wakeup_enable : 1;
+    } pin[40];
+} gpio_dev_t;
+
+extern gpio_dev_t GPIO;
+
+#endif
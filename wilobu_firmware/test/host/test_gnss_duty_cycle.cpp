@@ -0,0 +1,155 @@
+#include <Arduino.h>
+#include "GnssScheduler.h"
+#include "HostTest.h"
+
+// ===== CICLO DE TRABAJO GNSS: DÍA SINTÉTICO DE 24 H =====
+// Trayecto casa -> caminata -> bus -> oficina -> almuerzo -> oficina -> regreso
+// -> casa, paso de 1 s. Compara GnssScheduler contra el muestreo fijo de 30 s
+// con TTFF frío/tibio/caliente y ruido determinista en la posición.
+namespace {
+
+const float kDegToRad = 0.01745329252f;
+
+struct SimSegment {
+    unsigned long endSec;
+    float speedKmh;
+    float headingDeg;
+};
+
+const SimSegment kSimDay[] = {
+    { 7UL * 3600,         0.0f,   0.0f },  // Durmiendo en casa
+    { 7UL * 3600 + 1200,  5.0f,  90.0f },  // Caminata al paradero
+    { 8UL * 3600,        28.0f,  30.0f },  // Bus
+    { 8UL * 3600 + 300,   4.5f, 120.0f },  // Caminata a la oficina
+    { 12UL * 3600 + 1800, 0.0f,   0.0f },  // Oficina
+    { 13UL * 3600,        5.0f, 270.0f },  // Almuerzo caminando
+    { 13UL * 3600 + 600,  5.0f,  90.0f },
+    { 17UL * 3600 + 1800, 0.0f,   0.0f },  // Oficina
+    { 18UL * 3600 + 900, 22.0f, 210.0f },  // Regreso
+    { 24UL * 3600,        0.0f,   0.0f },  // Casa
+};
+
+struct SimResult {
+    unsigned long onSec;
+    unsigned long fixes;
+    unsigned long movingFixes;
+    unsigned long maxMovingGapSec;
+};
+
+// Ruido determinista en [-1, 1]
+float simNoise(uint32_t& seed) {
+    seed = seed * 1664525UL + 1013904223UL;
+    return ((seed >> 8) & 0xFFFF) / 32767.5f - 1.0f;
+}
+
+SimResult simulate(bool adaptive) {
+    const float baseLat = -12.0464f;
+    const float baseLon = -77.0428f;
+    const float mPerDegLat = 111320.0f;
+    const float mPerDegLon = 111320.0f * cosf(baseLat * kDegToRad);
+
+    GnssScheduler sched;
+    sched.begin(0);
+
+    uint32_t seed = 12345;
+    float x = 0.0f, y = 0.0f;            // Posición real en metros
+    bool powered = false;
+    unsigned long poweredAt = 0;
+    long lastFixSec = -1;
+    unsigned long fixedNextSec = 0;
+    unsigned long lastMovingFixSec = 0;
+    SimResult res = {0, 0, 0, 0};
+    size_t seg = 0;
+
+    for (unsigned long t = 0; t < 24UL * 3600; t++) {
+        while (t >= kSimDay[seg].endSec) seg++;
+        const SimSegment& s = kSimDay[seg];
+        float mps = s.speedKmh / 3.6f;
+        x += mps * sinf(s.headingDeg * kDegToRad);
+        y += mps * cosf(s.headingDeg * kDegToRad);
+        bool moving = s.speedKmh > 0.0f;
+
+        unsigned long nowMs = t * 1000UL;
+        bool due = adaptive ? sched.isDue(nowMs) : (t >= fixedNextSec);
+        if (!moving) lastMovingFixSec = t;
+
+        if (due) {
+            if (!powered) {
+                powered = true;
+                poweredAt = t;
+                sched.setPowered(true, nowMs);
+            }
+            // TTFF: frío sin fix previo, caliente si estuvo apagado poco, tibio si no
+            unsigned long ttff = 35;
+            if (lastFixSec >= 0) ttff = ((long)poweredAt - lastFixSec) < 1800 ? 3 : 25;
+
+            if (t - poweredAt >= ttff) {
+                GPSLocation fix = {0.0, 0.0, 0.0, 0, false};
+                fix.latitude = baseLat + (y + 5.0f * simNoise(seed)) / mPerDegLat;
+                fix.longitude = baseLon + (x + 5.0f * simNoise(seed)) / mPerDegLon;
+                fix.accuracy = 8.0f;
+                fix.speedKmh = moving ? s.speedKmh + simNoise(seed) : 0.5f + 0.5f * simNoise(seed);
+                fix.courseDeg = s.headingDeg;
+                fix.timestamp = nowMs;
+                fix.isValid = true;
+
+                res.fixes++;
+                lastFixSec = t;
+                if (moving) {
+                    res.movingFixes++;
+                    if (t - lastMovingFixSec > res.maxMovingGapSec) res.maxMovingGapSec = t - lastMovingFixSec;
+                    lastMovingFixSec = t;
+                }
+                if (adaptive) sched.onFix(fix, nowMs);
+                fixedNextSec = t + 30;
+            } else {
+                if (adaptive) sched.onNoFix(nowMs);
+                fixedNextSec = t + 2;
+            }
+
+            if (adaptive && !sched.wantsPower()) {
+                powered = false;
+                sched.setPowered(false, nowMs);
+            }
+        }
+        if (powered) res.onSec++;
+    }
+    return res;
+}
+
+void printRow(const char* name, const SimResult& r) {
+    printf("  %-10s %7lu min %8lu %10lu %12lu s\n", name, r.onSec / 60, r.fixes, r.movingFixes, r.maxMovingGapSec);
+}
+
+} // namespace
+
+int main() {
+    printf("=== Simulación GNSS 24h ===\n");
+    SimResult fixed = simulate(false);
+    SimResult adaptive = simulate(true);
+
+    printf("  %-10s %12s %8s %10s %14s\n", "Modo", "GNSS ON", "Fixes", "En mov.", "Gap mov. max");
+    printRow("Fijo 30s", fixed);
+    printRow("Adaptivo", adaptive);
+    printf("  GNSS ON: %lu%% del fijo\n", fixed.onSec ? adaptive.onSec * 100UL / fixed.onSec : 0UL);
+
+    // Misma traza, mismo resultado
+    SimResult again = simulate(true);
+    CHECK(again.onSec == adaptive.onSec && again.fixes == adaptive.fixes &&
+          again.movingFixes == adaptive.movingFixes && again.maxMovingGapSec == adaptive.maxMovingGapSec,
+          "la simulación no es reproducible");
+
+    // El muestreo fijo deja el GNSS encendido todo el día
+    CHECK(fixed.onSec == 24UL * 3600, "fijo: %lu s encendido", fixed.onSec);
+    // Quieto (20 de las 24 h) el planificador apaga el GNSS entre muestras
+    CHECK(adaptive.onSec * 100UL <= fixed.onSec * 20UL,
+          "adaptivo: %lu s encendido (> 20%% del fijo)", adaptive.onSec);
+    // En movimiento no pierde resolución frente al fijo
+    CHECK(adaptive.movingFixes >= fixed.movingFixes,
+          "adaptivo: %lu fixes en movimiento, fijo %lu", adaptive.movingFixes, fixed.movingFixes);
+    // La salida de casa se detecta a más tardar en el techo del backoff + TTFF frío
+    CHECK(adaptive.maxMovingGapSec <= GNSS_INTERVAL_MAX_MS / 1000 + 35,
+          "adaptivo: hueco de %lu s en movimiento", adaptive.maxMovingGapSec);
+
+    TEST_MAIN_END();
+}
@@ -0,0 +1,385 @@
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <unistd.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/timers.h>
+#include "IModem.h"
+#include "DeviceConfig.h"
+#include "OtaUpdate.h"
+#include "ButtonInput.h"
+#include "SosTracker.h"
+#include "Host.h"
+#include "HostTest.h"
+
+// ===== SOAK: FIRMWARE COMPLETO DURANTE SEMANAS =====
+// setup()/loop() de main.cpp, las tareas (ui, input, gnss) sobre el
+// planificador de shim/FreeRTOS.cpp y un módem falso con latencia, fallos y
+// cortes de red. millis()/micros() son de 32 bits como en el ESP32 y el reloj
+// arranca una hora antes de su desborde; el botón SOS se mantiene pulsado a
+// través de ese instante. Reporta asignaciones por ciclo, pico de heap, deriva
+// y distribución de los heartbeats. WILOBU_SOAK_DAYS=<n> cambia la duración
+// (14 días por defecto).
+void setup();
+void loop();
+
+namespace {
+
+#define SOAK_DEFAULT_DAYS       14
+#define SOAK_MAX_DAYS           40
+#define SOAK_MAX_HEARTBEATS     16384
+#define SOAK_HEARTBEAT_MS       300000UL  // HEARTBEAT_INTERVAL (Tier B/C)
+#define SOAK_RETRY_MS           5000UL    // HEARTBEAT_RETRY_MS
+#define SOAK_GRACE_MS           20000UL   // RADIO_HEARTBEAT_GRACE_MS
+#define SOAK_BUS_SLACK_MS       5000UL    // Una muestra GNSS con el bus del módem tomado
+#define SOAK_BOOT_MS            600000UL  // Heartbeats de arranque (fix diferido): fuera de la deriva
+#define SOAK_POST_FAIL_PCT      5         // POST con 500
+#define SOAK_OUTAGE_EVERY_MS    86400000UL  // Un corte de red por día...
+#define SOAK_OUTAGE_MS          1200000UL   // ...de 20 minutos
+#define SOAK_OUTAGE_AT_MS       46800000UL  // A las 13 h de cada día simulado
+#define SOAK_FIX_PCT            80        // Muestras GNSS con fix
+#define SOAK_TTFF_MS            28000UL   // Desde el encendido del GNSS
+#define SOAK_LEAK_SLACK_BYTES   1024      // Crecimiento tolerado de lo vivo tras el día 1
+#define SOAK_PREROLL_MS         3600000UL // millis() y micros() desbordan a la hora
+#define SOAK_SOS_PIN            15        // PIN_BTN_SOS
+#define SOAK_SOS_PRESS_MS       (SOAK_PREROLL_MS - 1500)  // HOLD de 3 s cae tras el desborde
+#define SOAK_SOS_HOLD_MS        4000UL
+#define SOAK_SOS_MAX_MS         60000UL   // Del HOLD a la primera alerta enviada
+// Mientras dura el seguimiento los puntos viajan como heartbeats cada ~30 s:
+// fuera de la deriva, se cuentan aparte
+#define SOAK_SOS_END_MS         (SOAK_SOS_PRESS_MS + BUTTON_HOLD_SOS_MS + SOAK_SOS_MAX_MS + SOS_TRACK_TIMEOUT_MS)
+#define SOAK_MIN_TRACK_UPLOADS  30
+#define SOAK_MAX_TRACK_UPLOADS  (SOS_TRACK_TIMEOUT_MS / 20000)   // Ni uno tras otro al desbordar
+
+struct HeartbeatRecord {
+    uint64_t startMs;       // host::elapsedMs(): no desborda
+    uint64_t endMs;
+    uint64_t allocsAtStart;
+    bool ok;
+};
+
+HeartbeatRecord heartbeats[SOAK_MAX_HEARTBEATS];
+uint32_t heartbeatCount = 0;
+uint32_t heartbeatOverflow = 0;
+uint32_t sosAlerts = 0;
+uint64_t firstSosMs = 0;    // host::elapsedMs() de la primera alerta SOS
+
+uint32_t soakRand() {
+    static uint32_t seed = 20240611;
+    seed = seed * 1664525UL + 1013904223UL;
+    return seed >> 8;
+}
+
+bool inOutage(uint64_t ms) {
+    return ms % SOAK_OUTAGE_EVERY_MS >= SOAK_OUTAGE_AT_MS &&
+           ms % SOAK_OUTAGE_EVERY_MS < SOAK_OUTAGE_AT_MS + SOAK_OUTAGE_MS;
+}
+
+// === Módem falso ===
+// Tiempos de un A7670SA (AT, registro, HTTPACTION) sobre delay(); las
+// respuestas van a un HttpBody de capacidad fija, como en el driver real
+class FakeModem : public IModem {
+public:
+    bool init() override { idle(300); return true; }
+    bool connect() override { idle(2500); connected = true; return true; }
+    bool disconnect() override { connected = false; return true; }
+    bool isConnected() override { return connected; }
+
+    bool sendToFirebase(const String& path, const String& jsonData) override {
+        (void)path; (void)jsonData;
+        return post(nullptr);
+    }
+    bool sendSOSAlert(const char* deviceId, const char* ownerUid, const char* sosType,
+                      const GPSLocation& location, const JsonDocument* extra) override {
+        (void)deviceId; (void)ownerUid; (void)sosType; (void)location;
+        if (sosAlerts++ == 0) firstSosMs = host::elapsedMs();
+        return post(extra);
+    }
+
+    bool sendHeartbeat(const char* ownerUid, const char* deviceId, const GPSLocation& location,
+                       const JsonDocument* extra) override {
+        (void)ownerUid; (void)deviceId; (void)location;
+        HeartbeatRecord* r = heartbeatCount < SOAK_MAX_HEARTBEATS ? &heartbeats[heartbeatCount++] : nullptr;
+        if (!r) heartbeatOverflow++;
+        uint64_t startMs = host::elapsedMs();
+        uint64_t allocs = host::heapStats().allocs;
+        bool ok = post(extra);
+        if (r) {
+            r->startMs = startMs;
+            r->endMs = host::elapsedMs();
+            r->allocsAtStart = allocs;
+            r->ok = ok;
+        }
+        return ok;
+    }
+
+    const HttpBody& getLastHttpBody() const override { return status > 0 ? body : empty; }
+    int getLastHttpStatus() const override { return status; }
+    String checkProvisioningStatus(const char* deviceId) override { (void)deviceId; return String(); }
+
+    bool initGNSS() override {
+        if (!gnssOn) gnssOnMs = host::elapsedMs();
+        gnssOn = true;
+        return true;
+    }
+    bool getLocation(GPSLocation& loc) override {
+        if (!gnssOn) initGNSS();
+        idle(150);   // AT+CGPSINFO
+        if (host::elapsedMs() - gnssOnMs < SOAK_TTFF_MS || soakRand() % 100 >= SOAK_FIX_PCT) {
+            loc.isValid = false;
+            return false;
+        }
+        loc.latitude = -12.0464f;
+        loc.longitude = -77.0428f;
+        loc.accuracy = 6.0f;
+        loc.timestamp = millis();
+        loc.isValid = true;
+        loc.speedKmh = 0.0f;
+        loc.courseDeg = 0.0f;
+        return true;
+    }
+    void disableGNSS() override { gnssOn = false; }
+
+    void enableDeepSleep(uint32_t wakeupTimeSeconds) override { (void)wakeupTimeSeconds; }
+    bool isDeepSleeping() override { return false; }
+    bool getBatteryMillivolts(uint16_t& mv) override { mv = 3950; return true; }
+
+    bool checkForUpdates(const char* deviceId, const char* currentVersion, OtaManifest& manifest) override {
+        (void)deviceId; (void)currentVersion; (void)manifest;
+        return false;
+    }
+    bool downloadFirmwareUpdate(const OtaManifest& manifest, OtaUpdater& sink) override {
+        (void)manifest; (void)sink;
+        return false;
+    }
+    bool applyFirmwareUpdate(OtaUpdater& sink) override { (void)sink; return false; }
+    bool sendSMS(const char* number, const char* text) override { (void)number; (void)text; return true; }
+
+private:
+    bool connected = false;
+    bool gnssOn = false;
+    uint64_t gnssOnMs = 0;
+    int status = -1;
+    HttpBody body;
+    HttpBody empty;
+    char payload[2048];
+
+    // HTTPTERM/INIT/PARA + HTTPDATA + HTTPACTION: 1.2-3.2 s; en un corte la
+    // petición espera el timeout de HTTPACTION y no llega respuesta
+    bool post(const JsonDocument* extra) {
+        if (extra) serializeJson(*extra, payload, sizeof(payload));
+        if (inOutage(host::elapsedMs())) {
+            idle(30000);
+            status = -1;
+            return false;
+        }
+        idle(1200 + soakRand() % 2000);
+        if (soakRand() % 100 < SOAK_POST_FAIL_PCT) {
+            status = 500;
+            body = "{\"error\":\"internal\"}";
+            return false;
+        }
+        status = 200;
+        body = "{\"ok\":true}";
+        return true;
+    }
+};
+
+FakeModem* fakeModem = nullptr;
+
+// === Dedo sobre el botón SOS ===
+// Un timer one-shot baja el pin y lo vuelve a subir: setPin() dispara la ISR
+// de ButtonInput en el instante exacto, con millis() a punto de desbordar
+TimerHandle_t fingerTimer = nullptr;
+bool fingerDown = false;
+
+void onFinger(TimerHandle_t timer) {
+    fingerDown = !fingerDown;
+    host::setPin(SOAK_SOS_PIN, fingerDown ? LOW : HIGH);
+    if (fingerDown) xTimerChangePeriod(timer, pdMS_TO_TICKS(SOAK_SOS_HOLD_MS), 0);
+}
+
+// Configuración aprovisionada en NVS, como la deja la vinculación por BLE
+void provisionDevice() {
+    ConfigData defaults = {};
+    defaults.logLevel = 1;
+    defaults.httpStatus = -1;
+    DeviceConfig cfg;
+    cfg.load(defaults);
+    cfg.setOwner("soakOwnerUid0123456789abcdef");
+    cfg.commit(true);
+    host::powerLoss();   // El espejo RTC de esta copia no cuenta: setup() lee la NVS
+}
+
+unsigned soakDays() {
+    const char* v = getenv("WILOBU_SOAK_DAYS");
+    long days = v ? strtol(v, nullptr, 10) : SOAK_DEFAULT_DAYS;
+    if (days < 1) days = 1;
+    return days > SOAK_MAX_DAYS ? SOAK_MAX_DAYS : (unsigned)days;
+}
+
+// Diferencia con signo en ms (los registros están en tiempo transcurrido)
+long long diffMs(uint64_t a, uint64_t b) { return (long long)a - (long long)b; }
+
+// === Reporte ===
+#define DRIFT_BUCKETS 6
+const char* const kDriftLabel[DRIFT_BUCKETS] = {"< 0 s", "0-1 s", "1-5 s", "5-20 s", "20-25 s", "> 25 s"};
+
+int driftBucket(long long d) {
+    if (d < 0) return 0;
+    if (d < 1000) return 1;
+    if (d < 5000) return 2;
+    if (d < (long long)SOAK_GRACE_MS) return 3;
+    if (d < (long long)(SOAK_GRACE_MS + SOAK_BUS_SLACK_MS)) return 4;
+    return 5;
+}
+
+void report(unsigned days, uint32_t wraps, uint32_t microsWraps, const host::HeapStats& day1, const host::HeapStats& end) {
+    const uint64_t wrapAtMs = SOAK_PREROLL_MS;
+    uint32_t ok = 0, failed = 0, driftSamples = 0, retrySamples = 0, allocSamples = 0;
+    uint32_t driftHist[DRIFT_BUCKETS] = {0};
+    long long driftMin = 0, driftMax = 0, driftSum = 0, retryMax = 0;
+    uint64_t allocMin = UINT64_MAX, allocMax = 0, allocSum = 0;
+    uint32_t acrossWrap = 0, trackUploads = 0;
+    long long wrapGap = -1;     // Entre los heartbeats a ambos lados del desborde
+
+    for (uint32_t i = 0; i < heartbeatCount; i++) {
+        const HeartbeatRecord& h = heartbeats[i];
+        if (h.ok) ok++; else failed++;
+        if (i == 0) continue;
+        const HeartbeatRecord& prev = heartbeats[i - 1];
+        if (prev.startMs < wrapAtMs && h.startMs >= wrapAtMs) {
+            acrossWrap++;
+            wrapGap = diffMs(h.startMs, prev.endMs);
+        }
+        if (h.startMs >= SOAK_SOS_PRESS_MS && prev.startMs < SOAK_SOS_END_MS) {
+            if (h.startMs >= wrapAtMs) trackUploads++;
+            continue;
+        }
+        if (!prev.ok) {
+            // Reintento corto tras un fallo
+            long long gap = diffMs(h.startMs, prev.endMs);
+            CHECK(gap >= (long long)SOAK_RETRY_MS - 1000 && gap <= (long long)(SOAK_RETRY_MS + SOAK_GRACE_MS + SOAK_BUS_SLACK_MS),
+                "reintento a %lld ms del fallo (heartbeat #%lu, t=%llu s)", gap, (unsigned long)i, (unsigned long long)(h.startMs / 1000));
+            if (gap > retryMax) retryMax = gap;
+            retrySamples++;
+            continue;
+        }
+        if (prev.startMs < SOAK_BOOT_MS) continue;
+        // Deriva: inicio real frente a fin del heartbeat anterior + intervalo
+        long long drift = diffMs(h.startMs, prev.endMs + SOAK_HEARTBEAT_MS);
+        driftHist[driftBucket(drift)]++;
+        if (driftSamples == 0 || drift < driftMin) driftMin = drift;
+        if (driftSamples == 0 || drift > driftMax) driftMax = drift;
+        driftSum += drift;
+        driftSamples++;
+        CHECK(drift >= 0 && drift < (long long)(SOAK_GRACE_MS + SOAK_BUS_SLACK_MS),
+            "heartbeat #%lu con deriva de %lld ms (t=%llu s)", (unsigned long)i, drift, (unsigned long long)(h.startMs / 1000));
+        // Asignaciones de un ciclo completo (heartbeat a heartbeat) tras el día 1
+        if (prev.startMs >= 86400000ULL) {
+            uint64_t a = h.allocsAtStart - prev.allocsAtStart;
+            if (a < allocMin) allocMin = a;
+            if (a > allocMax) allocMax = a;
+            allocSum += a;
+            allocSamples++;
+        }
+    }
+
+    printf("  Simulado: %u días (%llu s virtuales, %llu s sin tareas listas, %llu cambios de tarea)\n",
+        days, (unsigned long long)(host::elapsedMs() / 1000), (unsigned long long)(host::schedulerIdleUs() / 1000000),
+        (unsigned long long)host::contextSwitches());
+    printf("  millis(): %lu desborde(s) de 32 bits, el primero a %llu s; heartbeats a ambos lados separados %lld ms\n",
+        (unsigned long)wraps, (unsigned long long)(wrapAtMs / 1000), wrapGap);
+    printf("  micros(): %lu desborde(s) de 32 bits\n", (unsigned long)microsWraps);
+    long long sosLag = sosAlerts ? diffMs(firstSosMs, SOAK_SOS_PRESS_MS + BUTTON_HOLD_SOS_MS) : -1;
+    printf("  SOS: botón pulsado a %lld ms del desborde, %lu alerta(s), la primera a %lld ms del HOLD; "
+        "%lu envío(s) de seguimiento tras el desborde\n",
+        diffMs(SOAK_SOS_PRESS_MS, wrapAtMs), (unsigned long)sosAlerts, sosLag, (unsigned long)trackUploads);
+    printf("  Heartbeats: %lu ok, %lu fallidos (%lu reintentos, el mayor a %lld ms del fallo)\n",
+        (unsigned long)ok, (unsigned long)failed, (unsigned long)retrySamples, retryMax);
+    if (driftSamples) {
+        printf("  Deriva (inicio - fin anterior - %lu s): mín %lld ms, media %lld ms, máx %lld ms\n",
+            SOAK_HEARTBEAT_MS / 1000, driftMin, driftSum / (long long)driftSamples, driftMax);
+        for (int b = 0; b < DRIFT_BUCKETS; b++) {
+            printf("    %-8s %6lu  %5.1f%%\n", kDriftLabel[b], (unsigned long)driftHist[b], 100.0 * driftHist[b] / driftSamples);
+        }
+    }
+    if (allocSamples) {
+        printf("  Asignaciones por ciclo de heartbeat: mín %llu, media %.1f, máx %llu\n",
+            (unsigned long long)allocMin, (double)allocSum / allocSamples, (unsigned long long)allocMax);
+    }
+    printf("  Heap: %llu asignaciones en total, vivo %lu B tras el día 1 y %lu B al final, pico %lu B de %lu\n",
+        (unsigned long long)end.allocs, (unsigned long)day1.liveBytes, (unsigned long)end.liveBytes,
+        (unsigned long)end.peakBytes, (unsigned long)HOST_HEAP_BYTES);
+
+    CHECK(heartbeatOverflow == 0, "%lu heartbeats sin registrar", (unsigned long)heartbeatOverflow);
+    CHECK(wraps >= 1 && acrossWrap == 1, "la prueba no cruzó el desborde de millis()");
+    CHECK(wrapGap >= 0 && wrapGap < (long long)(SOAK_HEARTBEAT_MS + SOAK_GRACE_MS + SOAK_BUS_SLACK_MS),
+        "heartbeat trabado en el desborde: %lld ms entre los de ambos lados", wrapGap);
+    CHECK(microsWraps >= wraps, "micros() no desbordó");
+    CHECK(sosAlerts >= 1 && firstSosMs >= wrapAtMs && sosLag >= 0 && sosLag <= (long long)SOAK_SOS_MAX_MS,
+        "el SOS pulsado antes del desborde no salió después de él (%lu alertas, a %lld ms del HOLD)",
+        (unsigned long)sosAlerts, sosLag);
+    CHECK(trackUploads >= SOAK_MIN_TRACK_UPLOADS && trackUploads <= SOAK_MAX_TRACK_UPLOADS,
+        "seguimiento SOS: %lu envíos tras el desborde", (unsigned long)trackUploads);
+    CHECK(driftSamples > 0 && ok >= driftSamples, "sin heartbeats periódicos");
+    // Un ciclo de 5 min con un intento por ciclo como mínimo
+    uint32_t expected = (uint32_t)((uint64_t)days * 86400000ULL / (SOAK_HEARTBEAT_MS + 3200 + SOAK_GRACE_MS + SOAK_BUS_SLACK_MS));
+    CHECK(ok >= expected, "%lu heartbeats ok, se esperaban al menos %lu", (unsigned long)ok, (unsigned long)expected);
+    CHECK(end.liveBytes <= day1.liveBytes + SOAK_LEAK_SLACK_BYTES, "el heap vivo creció %ld B después del día 1",
+        (long)end.liveBytes - (long)day1.liveBytes);
+    CHECK(end.peakBytes < HOST_HEAP_BYTES, "pico de heap %lu B sobre el presupuesto", (unsigned long)end.peakBytes);
+}
+
+} // namespace
+
+// Driver del firmware (ModemFactory.h): esta prueba enlaza el módem falso
+IModem* createModemDriver(HardwareSerial* serial, const char* apn, const char* endpoint) {
+    (void)serial; (void)apn; (void)endpoint;
+    fakeModem = new FakeModem();
+    return fakeModem;
+}
+
+int main() {
+    unsigned days = soakDays();
+    printf("=== Soak: firmware completo, %u días con desborde de millis() ===\n", days);
+    host::reset(SOAK_PREROLL_MS);
+    host::nvsErase();
+    host::powerLoss();
+    provisionDevice();
+
+    setup();
+    CHECK(fakeModem != nullptr, "setup() no creó el módem");
+    fingerTimer = xTimerCreate("finger", pdMS_TO_TICKS(SOAK_SOS_PRESS_MS - host::elapsedMs()), pdFALSE, nullptr, onFinger);
+    xTimerStart(fingerTimer, 0);
+
+    uint64_t endMs = (uint64_t)days * 86400000ULL;
+    uint32_t prevMillis = millis();
+    uint32_t prevMicros = micros();
+    uint32_t wraps = 0, microsWraps = 0;
+    host::HeapStats day1 = {0, 0, 0, 0};
+    bool day1Taken = false;
+    while (host::elapsedMs() < endMs) {
+        loop();
+        uint32_t now = millis();
+        if (now < prevMillis) wraps++;
+        prevMillis = now;
+        uint32_t nowUs = micros();
+        if (nowUs < prevMicros) microsWraps++;
+        prevMicros = nowUs;
+        if (!day1Taken && host::elapsedMs() >= 86400000ULL) {
+            day1 = host::heapStats();
+            day1Taken = true;
+        }
+    }
+
+    report(days, wraps, microsWraps, day1, host::heapStats());
+    if (hosttest::failures) {
+        std::string tail = Serial.output();
+        fprintf(stderr, "--- Últimas líneas de la consola ---\n%s\n", tail.c_str() + (tail.size() > 4096 ? tail.size() - 4096 : 0));
+        fprintf(stderr, "%d verificaciones fallidas\n", hosttest::failures);
+    }
+    // Las tareas siguen bloqueadas en sus hilos: salir sin destruir el planificador
+    fflush(stdout);
+    fflush(stderr);
+    _exit(hosttest::failures ? 1 : 0);
+}
@@ -0,0 +1,203 @@
+#include <Arduino.h>
+#include <Preferences.h>
+#include <set>
+#include <utility>
+#include "SosOutbox.h"
+#include "Host.h"
+#include "HostTest.h"
+
+// ===== ENTREGA SOS CON FALLOS: EXACTAMENTE UNA VEZ =====
+// 50% de fallos (mitad perdidos antes del servidor, mitad con la respuesta
+// perdida) y un reinicio a mitad de prueba contra un backend que deduplica
+// por (época, seq), como recordSosAlert() en functions/index.js.
+namespace {
+
+#define SIM_ALERTS        40
+#define SIM_MAX_SEQ       64
+
+enum RebootKind {
+    REBOOT_RAM,         // persistent=false: la imagen pasa a mano (restore)
+    REBOOT_SOFT,        // ESP.restart(): begin() recupera la copia RTC
+    REBOOT_POWER,       // Corte de energía: RTC se borra, begin() recupera NVS
+};
+
+// Backend simulado: alertas creadas por clave (época, seq)
+struct Backend {
+    std::set<std::pair<uint32_t, uint32_t> > created;
+    unsigned posts = 0;
+    unsigned duplicates = 0;
+
+    void receive(uint32_t epoch, uint32_t seq) {
+        posts++;
+        if (!created.insert(std::make_pair(epoch, seq)).second) duplicates++;
+    }
+};
+
+struct SimResult {
+    unsigned enqueued;
+    unsigned attempts;
+    unsigned lostRequests;
+    unsigned lostResponses;
+    unsigned maxLatencySec;
+    unsigned pending;
+    uint32_t epochBefore;
+    uint32_t epochAfter;
+};
+
+uint32_t simRand(uint32_t& seed) {
+    seed = seed * 1664525UL + 1013904223UL;
+    return seed >> 8;
+}
+
+void freshDevice() {
+    host::reset();
+    host::nvsErase();
+    host::powerLoss();
+}
+
+// Una alerta cada 20 s; la simulación sigue hasta vaciar la bandeja
+SimResult simulate(RebootKind kind, Backend& backend) {
+    bool persistent = kind != REBOOT_RAM;
+    SosOutbox outbox;
+    outbox.begin(persistent);
+
+    SimResult res = {0, 0, 0, 0, 0, 0, outbox.epoch(), 0};
+    uint32_t seed = 4242;
+    uint32_t enqueuedAtSec[SIM_MAX_SEQ] = {0};
+    bool rebooted = false;
+
+    for (uint32_t t = 0; t < 6 * 3600; t++) {
+        uint32_t nowMs = t * 1000UL;
+        if (res.enqueued < SIM_ALERTS && t % 20 == 0) {
+            GPSLocation loc = {-12.0464f, -77.0428f, 8.0f, nowMs, (res.enqueued % 2) == 1};
+            uint32_t seq = outbox.enqueue(SosOutbox::typeName(res.enqueued % 3), loc, nowMs);
+            if (seq < SIM_MAX_SEQ) enqueuedAtSec[seq] = t;
+            res.enqueued++;
+        }
+
+        if (!rebooted && res.enqueued == SIM_ALERTS / 2) {
+            SosOutboxImage img = outbox.state();
+            outbox = SosOutbox();
+            if (kind == REBOOT_POWER) host::powerLoss();
+            outbox.begin(persistent);
+            if (kind == REBOOT_RAM) outbox.restore(img);
+            rebooted = true;
+        }
+
+        const SosPending* p = outbox.due(nowMs);
+        if (!p) {
+            if (res.enqueued == SIM_ALERTS && outbox.isEmpty()) break;
+            continue;
+        }
+        res.attempts++;
+        uint32_t seq = p->seq;
+        uint32_t r = simRand(seed) % 4;
+        bool delivered;
+        if (r == 0) {
+            // Petición perdida antes del servidor
+            res.lostRequests++;
+            delivered = false;
+        } else {
+            backend.receive(outbox.epoch(), seq);
+            // r == 1: el servidor procesó pero la respuesta se perdió
+            delivered = (r != 1);
+            if (!delivered) res.lostResponses++;
+        }
+        outbox.onResult(seq, delivered, nowMs);
+        if (delivered && seq < SIM_MAX_SEQ && t - enqueuedAtSec[seq] > res.maxLatencySec) {
+            res.maxLatencySec = t - enqueuedAtSec[seq];
+        }
+    }
+    res.pending = outbox.count();
+    res.epochAfter = outbox.epoch();
+    return res;
+}
+
+void checkExactlyOnce(const char* name, RebootKind kind) {
+    freshDevice();
+    Backend backend;
+    SimResult r = simulate(kind, backend);
+
+    printf("  %-8s intentos %3u | perdidas: %2u pet. %2u resp. | POST %3u | duplicados %2u | creadas %2u | lat. máx %lus\n",
+        name, r.attempts, r.lostRequests, r.lostResponses, backend.posts, backend.duplicates,
+        (unsigned)backend.created.size(), (unsigned long)r.maxLatencySec);
+
+    CHECK(r.epochAfter == r.epochBefore, "%s: la época cambió con el reinicio", name);
+    CHECK(r.pending == 0, "%s: %u alertas pendientes al final", name, r.pending);
+    CHECK(backend.created.size() == SIM_ALERTS, "%s: %u alertas creadas de %u", name,
+        (unsigned)backend.created.size(), SIM_ALERTS);
+    for (uint32_t seq = 1; seq <= SIM_ALERTS; seq++) {
+        CHECK(backend.created.count(std::make_pair(r.epochBefore, seq)) == 1, "%s: falta seq %lu", name, (unsigned long)seq);
+    }
+    // Las respuestas perdidas se reintentan: el backend ve duplicados y los descarta
+    CHECK(r.lostResponses == 0 || backend.duplicates > 0, "%s: respuestas perdidas sin reintento", name);
+    CHECK(backend.posts == backend.created.size() + backend.duplicates, "%s: POST sin contar", name);
+}
+
+// Un reinicio por software conserva época, secuencia y pendientes
+void checkSoftRestartKeepsState() {
+    freshDevice();
+    GPSLocation loc = {-12.0464f, -77.0428f, 8.0f, 0, true};
+    SosOutbox outbox;
+    outbox.begin(true);
+    outbox.enqueue("medica", loc, 0);
+    outbox.enqueue("seguridad", loc, 0);
+    SosOutboxImage before = outbox.state();
+
+    SosOutbox after;
+    after.begin(true);
+    CHECK(after.epoch() == before.epoch, "reinicio: época %08lx -> %08lx",
+        (unsigned long)before.epoch, (unsigned long)after.epoch());
+    CHECK(after.state().nextSeq == before.nextSeq, "reinicio: seq %lu -> %lu",
+        (unsigned long)before.nextSeq, (unsigned long)after.state().nextSeq);
+    CHECK(after.count() == 2 && after.state().items[1].seq == before.items[1].seq &&
+          after.state().items[1].type == SosOutbox::typeCode("seguridad"), "reinicio: pendientes perdidos");
+    // Tras reiniciar todo lo pendiente se reintenta ya
+    CHECK(after.due(0) != nullptr, "reinicio: pendiente sin vencer");
+}
+
+// Sin RTC ni NVS la secuencia vuelve a 1 con otra época: sus claves no
+// chocan con las alertas ya registradas en el backend
+void checkEpochAfterErase() {
+    freshDevice();
+    Backend backend;
+    GPSLocation loc = {0.0, 0.0, 999.0, 0, false};
+
+    SosOutbox outbox;
+    outbox.begin(true);
+    uint32_t oldEpoch = outbox.epoch();
+    for (int i = 0; i < 3; i++) {
+        uint32_t seq = outbox.enqueue("general", loc, 0);
+        backend.receive(outbox.epoch(), seq);
+        outbox.onResult(seq, true, 0);
+    }
+
+    host::nvsErase();
+    host::powerLoss();
+    SosOutbox erased;
+    erased.begin(true);
+    uint32_t seq = erased.enqueue("general", loc, 0);
+    backend.receive(erased.epoch(), seq);
+
+    CHECK(seq == 1, "borrado: la secuencia siguió en %lu", (unsigned long)seq);
+    CHECK(erased.epoch() != 0 && erased.epoch() != oldEpoch, "borrado: época repetida %08lx", (unsigned long)oldEpoch);
+    CHECK(backend.duplicates == 0 && backend.created.size() == 4, "borrado: seq 1 nueva descartada como duplicada");
+
+    // La época nueva quedó en NVS: un corte de energía ya no la cambia
+    host::powerLoss();
+    SosOutbox again;
+    again.begin(true);
+    CHECK(again.epoch() == erased.epoch() && again.state().nextSeq == 2, "corte: época o secuencia no persistidas");
+}
+
+} // namespace
+
+int main() {
+    printf("=== Entrega SOS (50%% fallos, reinicio a mitad) ===\n");
+    checkExactlyOnce("RAM", REBOOT_RAM);
+    checkExactlyOnce("restart", REBOOT_SOFT);
+    checkExactlyOnce("corte", REBOOT_POWER);
+    checkSoftRestartKeepsState();
+    checkEpochAfterErase();
+    TEST_MAIN_END();
+}
@@ -0,0 +1,211 @@
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/timers.h>
+#include "SosFastPath.h"
+#include "ButtonInput.h"
+#include "DeviceConfig.h"
+#include "ScriptedModem.h"
+#include "Host.h"
+#include "HostTest.h"
+
+// ===== SOS: BOTÓN -> PRIMER BYTE DE AT+HTTPDATA =====
+// Firmware completo (setup()/loop(), tareas y el ModemProxy real) contra el
+// A7670SA en guion de ScriptedModem.h. El botón SOS se pulsa por su ISR y se
+// mide en reloj virtual desde el HOLD de 3 s hasta el primer byte del
+// AT+HTTPDATA del Disparo 1, dos veces: con el slot pre-armado (sendSOSFast
+// sobre la sesión abierta) y con un módem que no deja volver a fijar la URL,
+// así el slot nunca queda listo y sosStep() va por la ruta completa
+// (sendSOSAlert -> httpPost). En las dos la sesión debe ir sobre el contexto
+// SSL con la CA fijada. Cada corrida va en un proceso hijo: setup()
+// deja estado global y tareas que no se pueden desarmar. Antes verifica que
+// las plantillas dan el mismo cuerpo que la ruta completa sin tocar el heap.
+void setup();
+void loop();
+extern HardwareSerial ModemSerial;
+
+namespace {
+
+#define SOS_BENCH_PIN            15          // PIN_BTN_SOS
+#define SOS_BENCH_PRESS_MS       150000UL    // Tras el heartbeat de arranque, con el slot ya armado
+#define SOS_BENCH_TIMEOUT_MS     60000UL     // Del HOLD al HTTPDATA, como máximo
+#define SOS_BENCH_ITERATIONS     2000
+
+const char* const kStatus[] = {"sos_general", "sos_medica", "sos_seguridad"};
+const char kDeviceId[] = "WILOBU-BENCH01";
+const char kOwnerUid[] = "benchOwnerUid0123456789abcdef";
+
+// Cuerpo de la ruta completa: el mismo JSON que sendSOSAlert() sin ubicación
+size_t fullBody(uint8_t type, uint32_t epoch, uint32_t seq, char* out, size_t outSize) {
+    JsonDocument doc;
+    doc["deviceId"] = kDeviceId;
+    doc["ownerUid"] = kOwnerUid;
+    doc["status"] = kStatus[type];
+    doc["lastLocation"] = nullptr;
+    doc["sosEpoch"] = epoch;
+    doc["sosSeq"] = seq;
+    return serializeJson(doc, out, outSize);
+}
+
+void checkTemplates() {
+    SosPayloadTemplates templates;
+    templates.build(kDeviceId, kOwnerUid);
+    CHECK(templates.isBuilt(), "plantillas sin construir");
+
+    // Mismo cuerpo que la ruta completa para cada tipo, época y secuencia
+    const uint32_t epochs[] = {1, 0x9E3779B9UL, 0xFFFFFFFFUL};
+    const uint32_t seqs[] = {1, 42, 0xFFFFFFFFUL};
+    char fullJson[SOS_PREFIX_MAX + 40];
+    char fastJson[SOS_PREFIX_MAX + 40];
+    for (uint8_t type = 0; type < 3; type++) {
+        for (uint32_t epoch : epochs) {
+            for (uint32_t seq : seqs) {
+                size_t fullLen = fullBody(type, epoch, seq, fullJson, sizeof(fullJson));
+                size_t fastLen = templates.body(type, epoch, seq, fastJson, sizeof(fastJson));
+                CHECK(fastLen == fullLen && strcmp(fastJson, fullJson) == 0,
+                    "tipo %u época %08lx seq %lu:\n  plantilla %s\n  completa  %s",
+                    type, (unsigned long)epoch, (unsigned long)seq, fastJson, fullJson);
+            }
+        }
+    }
+    // Buffer chico: no escribe de más y avisa con 0
+    CHECK(templates.body(0, 1, 1, fastJson, 16) == 0, "cuerpo truncado aceptado");
+    // Un id que no entra en el prefijo deja las plantillas sin construir
+    SosPayloadTemplates tooLong;
+    tooLong.build((String(kDeviceId) + kOwnerUid + kOwnerUid + kOwnerUid).c_str(), kOwnerUid);
+    CHECK(!tooLong.isBuilt(), "plantilla mayor que SOS_PREFIX_MAX aceptada");
+
+    host::HeapStats h0 = host::heapStats();
+    for (uint32_t i = 0; i < SOS_BENCH_ITERATIONS; i++) templates.body(0, 0x9E3779B9UL, i, fastJson, sizeof(fastJson));
+    host::HeapStats h1 = host::heapStats();
+    CHECK(h1.allocs == h0.allocs, "la plantilla pidió %lu bloques al heap", (unsigned long)(h1.allocs - h0.allocs));
+}
+
+// === Corrida del firmware ===
+struct RunResult {
+    bool sent;              // Salió un AT+HTTPDATA tras el HOLD
+    bool sessionReused;     // Sin AT+HTTPINIT entre el HOLD y el HTTPDATA
+    uint32_t holdToDataMs;
+    uint32_t roundTrips;    // Comandos AT entre el HOLD y el HTTPDATA
+    bool pinnedTls;         // La sesión del HTTPDATA va sobre el contexto SSL con la CA fijada
+};
+
+ScriptedModem modemScript;
+TimerHandle_t fingerTimer = nullptr;
+bool fingerDown = false;
+
+// Mantiene el botón SOS pulsado BUTTON_HOLD_SOS_MS + 1 s y lo suelta
+void onFinger(TimerHandle_t timer) {
+    fingerDown = !fingerDown;
+    host::setPin(SOS_BENCH_PIN, fingerDown ? LOW : HIGH);
+    if (fingerDown) xTimerChangePeriod(timer, pdMS_TO_TICKS(BUTTON_HOLD_SOS_MS + 1000), 0);
+}
+
+// Configuración aprovisionada en NVS, como la deja la vinculación por BLE
+void provisionDevice() {
+    ConfigData defaults = {};
+    defaults.logLevel = 1;
+    defaults.httpStatus = -1;
+    DeviceConfig cfg;
+    cfg.load(defaults);
+    cfg.setOwner(kOwnerUid);
+    cfg.commit(true);
+    host::powerLoss();   // El espejo RTC de esta copia no cuenta: setup() lee la NVS
+}
+
+RunResult runFirmware(bool slotUsable) {
+    host::reset();
+    host::nvsErase();
+    host::powerLoss();
+    provisionDevice();
+    modemScript.setUrlAccepted(slotUsable);
+    modemScript.attach(ModemSerial);
+
+    setup();
+    fingerTimer = xTimerCreate("finger", pdMS_TO_TICKS(SOS_BENCH_PRESS_MS - host::elapsedMs()), pdFALSE, nullptr, onFinger);
+    xTimerStart(fingerTimer, 0);
+
+    const uint64_t holdUs = (SOS_BENCH_PRESS_MS + BUTTON_HOLD_SOS_MS) * 1000ULL;
+    const ScriptedModem::Command* data = nullptr;
+    while (!data && host::elapsedMs() < SOS_BENCH_PRESS_MS + BUTTON_HOLD_SOS_MS + SOS_BENCH_TIMEOUT_MS) {
+        loop();
+        data = modemScript.first("AT+HTTPDATA=", holdUs);
+    }
+
+    RunResult r = {data != nullptr, false, 0, 0, false};
+    if (data) {
+        const ScriptedModem::Command* init = modemScript.first("AT+HTTPINIT", holdUs);
+        r.sessionReused = !init || init->atUs > data->atUs;
+        // Última sesión abierta antes del HTTPDATA: su SSLCFG, tras cargar la CA con authmode 1
+        const ScriptedModem::Command* session = nullptr;
+        for (size_t i = 0; i < modemScript.log().size() && modemScript.log()[i].atUs < data->atUs; i++) {
+            if (strcmp(modemScript.log()[i].text, "AT+HTTPINIT") == 0) session = &modemScript.log()[i];
+        }
+        const ScriptedModem::Command* sslcfg = session ? modemScript.first("AT+HTTPPARA=\"SSLCFG\",0", session->atUs) : nullptr;
+        const ScriptedModem::Command* authmode = modemScript.first("AT+CSSLCFG=\"authmode\",0,1", 0);
+        r.pinnedTls = sslcfg && sslcfg->atUs < data->atUs && authmode && authmode->atUs < session->atUs &&
+                      modemScript.first("AT+CCERTDOWN=", 0) != nullptr;
+        r.holdToDataMs = (uint32_t)((data->atUs - holdUs) / 1000);
+        r.roundTrips = modemScript.countBetween(holdUs, data->atUs);
+        printf("  %s:\n", slotUsable ? "Slot SOS pre-armado" : "Ruta completa (módem sin slot)");
+        for (size_t i = 0; i < modemScript.log().size(); i++) {
+            const ScriptedModem::Command& c = modemScript.log()[i];
+            if (c.atUs < holdUs || c.atUs > data->atUs) continue;
+            printf("    +%5lu ms  %s\n", (unsigned long)((c.atUs - holdUs) / 1000), c.text);
+        }
+        printf("    HOLD -> primer byte de AT+HTTPDATA: %lu ms, %lu AT antes\n",
+            (unsigned long)r.holdToDataMs, (unsigned long)r.roundTrips);
+    }
+    return r;
+}
+
+// Corre el firmware en un hijo y devuelve su resultado por un pipe
+bool runInChild(bool slotUsable, RunResult& out) {
+    int fds[2];
+    if (pipe(fds) != 0) return false;
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        RunResult r = runFirmware(slotUsable);
+        fflush(stdout);
+        bool ok = write(fds[1], &r, sizeof(r)) == (ssize_t)sizeof(r);
+        // Las tareas siguen bloqueadas en sus hilos: salir sin destruir el planificador
+        _exit(ok && !hosttest::failures ? 0 : 1);
+    }
+    close(fds[1]);
+    bool ok = pid > 0 && read(fds[0], &out, sizeof(out)) == (ssize_t)sizeof(out);
+    close(fds[0]);
+    int status = 0;
+    if (pid > 0) waitpid(pid, &status, 0);
+    return ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+} // namespace
+
+int main() {
+    host::reset();
+    printf("=== SOS: botón -> primer byte de AT+HTTPDATA ===\n");
+    checkTemplates();
+
+    RunResult fast = {}, full = {};
+    CHECK(runInChild(true, fast), "la corrida con slot no terminó");
+    CHECK(runInChild(false, full), "la corrida sin slot no terminó");
+
+    CHECK(fast.sent && full.sent, "el Disparo 1 no llegó al módem (slot %d, completa %d)", fast.sent, full.sent);
+    CHECK(fast.sessionReused, "con el slot listo se abrió otra sesión HTTP");
+    CHECK(!full.sessionReused, "sin slot no se abrió sesión HTTP");
+    CHECK(fast.pinnedTls && full.pinnedTls, "Disparo 1 sin la CA fijada (slot %d, completa %d)",
+        fast.pinnedTls, full.pinnedTls);
+    CHECK(fast.roundTrips < full.roundTrips, "el slot no ahorra AT: %lu frente a %lu",
+        (unsigned long)fast.roundTrips, (unsigned long)full.roundTrips);
+    CHECK(fast.holdToDataMs < full.holdToDataMs, "el slot no es más rápido: %lu ms frente a %lu ms",
+        (unsigned long)fast.holdToDataMs, (unsigned long)full.holdToDataMs);
+    printf("  Ahorro del slot: %lu AT y %lu ms hasta el primer byte (AT %lu ms c/u en el guion)\n",
+        (unsigned long)(full.roundTrips - fast.roundTrips), (unsigned long)(full.holdToDataMs - fast.holdToDataMs),
+        SCRIPTED_AT_RTT_MS);
+
+    TEST_MAIN_END();
+}
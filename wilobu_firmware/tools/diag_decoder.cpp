@@ -0,0 +1,270 @@
+// ===== DECODIFICADOR DE TRAMAS DE DIAGNÓSTICO BLE (HOST) =====
+// Lee las notificaciones de la característica 0xFFC1 capturadas en texto, una
+// por línea, en cualquiera de estos formatos:
+//   gatttool:     "Notification handle = 0x0012 value: 11 05 2a 00 ..."
+//   nRF Connect:  "... (0x) 11-05-2A-00-..."
+//   hex suelto:   "11052a00..."
+// Escribe un CSV por tipo de trama (<prefijo>_modem.csv, _gnss.csv, _system.csv)
+// y un resumen de la sesión por stdout.
+//
+// Compilar (desde wilobu_firmware/tools):
+//   g++ -std=c++11 -O2 -I ../include diag_decoder.cpp -o diag_decoder
+// Uso:
+//   ./diag_decoder captura.txt [prefijo]     (sin archivo: lee stdin)
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "DiagFrame.h"
+
+namespace {
+
+// Estado del dispositivo (DeviceState en IModem.h)
+const char* const FSM_STATES[] = {
+    "IDLE", "PROVISIONING", "ONLINE", "SOS_GENERAL", "SOS_MEDICA", "SOS_SEGURIDAD", "OTA_UPDATE", "LINKING"
+};
+const char* const GNSS_STATES[] = {"off", "acquiring", "fix"};
+const char* const MOTION[] = {"unknown", "stationary", "moving"};
+
+int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Bytes de la línea: lo que sigue a "(0x)" o "value:" si aparece, si no la línea
+// entera. Separadores admitidos: espacio, '-' y ':'
+size_t parseLine(const char* line, uint8_t* out, size_t cap) {
+    const char* p = strstr(line, "(0x)");
+    if (p) p += 4;
+    else if ((p = strstr(line, "value:")) != nullptr) p += 6;
+    else p = line;
+
+    size_t n = 0;
+    int hi = -1;
+    for (; *p && *p != '\n' && *p != '\r'; p++) {
+        int v = hexValue(*p);
+        if (v < 0) {
+            if (*p != ' ' && *p != '-' && *p != ':' && *p != '\t') return 0;   // No es una trama
+            if (hi >= 0) return 0;   // Nibble suelto
+            continue;
+        }
+        if (hi < 0) {
+            hi = v;
+            continue;
+        }
+        if (n == cap) return 0;
+        out[n++] = (uint8_t)(hi << 4 | v);
+        hi = -1;
+    }
+    return hi < 0 ? n : 0;
+}
+
+struct Summary {
+    unsigned long frames[3] = {};
+    unsigned long rejected = 0;
+    unsigned long lost = 0;              // Huecos en la secuencia
+    bool haveSeq = false;
+    uint8_t lastSeq = 0;
+    // Uptime desenrollado (el campo es de 16 bits)
+    bool haveUptime = false;
+    uint16_t lastUptime = 0;
+    unsigned long uptimeWraps = 0;
+    unsigned long firstUptime = 0;
+    unsigned long lastUptimeFull = 0;
+    // AT: solo la latencia más reciente de cada trama que cambió respecto de la anterior
+    uint16_t prevAt[DIAG_AT_RECENT] = {};
+    unsigned long atSamples = 0, atSum = 0;
+    uint16_t atMin = 0xFFFF, atMax = 0;
+    uint8_t atTimeouts = 0;
+    // HTTP: una cuenta por petición nueva (httpRecent cambió)
+    int16_t prevHttp[DIAG_HTTP_RECENT] = {};
+    uint16_t prevHttpMs = 0;
+    std::vector<std::pair<int, unsigned long> > httpStatus;
+    uint8_t csqMin = 0xFF, csqMax = 0;
+    uint32_t heapMin = 0xFFFFFFFF, maxBlockMin = 0xFFFFFFFF;
+    uint8_t outboxMax = 0, queueMax = 0;
+    uint16_t ttffLast = 0;
+    uint16_t fixesFirst = 0, fixesLast = 0;
+    bool haveGnss = false;
+};
+
+void countHttp(Summary& s, int status) {
+    for (size_t i = 0; i < s.httpStatus.size(); i++) {
+        if (s.httpStatus[i].first == status) {
+            s.httpStatus[i].second++;
+            return;
+        }
+    }
+    s.httpStatus.push_back(std::make_pair(status, 1UL));
+}
+
+unsigned long unwrapUptime(Summary& s, uint16_t uptime) {
+    if (s.haveUptime && uptime < s.lastUptime) s.uptimeWraps++;
+    if (!s.haveUptime) s.firstUptime = s.uptimeWraps * 65536UL + uptime;
+    s.haveUptime = true;
+    s.lastUptime = uptime;
+    s.lastUptimeFull = s.uptimeWraps * 65536UL + uptime;
+    return s.lastUptimeFull;
+}
+
+void onModem(Summary& s, FILE* csv, unsigned long t, const DiagHeader& h, const DiagModem& m) {
+    fprintf(csv, "%lu,%u,%u,%u,%u,%u,%u,%u,%d,%d,%u\n", t, h.seq, m.atRecentMs[0], m.atRecentMs[1],
+            m.atRecentMs[2], m.atMaxMs, m.atTimeouts, m.csq, m.httpRecent[0], m.httpRecent[1], m.httpLastMs);
+
+    if (memcmp(m.atRecentMs, s.prevAt, sizeof(s.prevAt)) != 0 && m.atRecentMs[0] != 0) {
+        s.atSamples++;
+        s.atSum += m.atRecentMs[0];
+        if (m.atRecentMs[0] < s.atMin) s.atMin = m.atRecentMs[0];
+        if (m.atRecentMs[0] > s.atMax) s.atMax = m.atRecentMs[0];
+    }
+    memcpy(s.prevAt, m.atRecentMs, sizeof(s.prevAt));
+    s.atTimeouts = m.atTimeouts;
+
+    bool newRequest = m.httpRecent[0] != 0 &&
+        (m.httpRecent[0] != s.prevHttp[0] || m.httpRecent[1] != s.prevHttp[1] || m.httpLastMs != s.prevHttpMs);
+    if (newRequest) countHttp(s, m.httpRecent[0]);
+    memcpy(s.prevHttp, m.httpRecent, sizeof(s.prevHttp));
+    s.prevHttpMs = m.httpLastMs;
+
+    if (m.csq != DIAG_CSQ_UNKNOWN) {
+        if (m.csq < s.csqMin) s.csqMin = m.csq;
+        if (m.csq > s.csqMax) s.csqMax = m.csq;
+    }
+}
+
+void onGnss(Summary& s, FILE* csv, unsigned long t, const DiagHeader& h, const DiagGnss& g) {
+    fprintf(csv, "%lu,%u,%s,%s,%u,%u,%u,%u,%u,%lu\n", t, h.seq,
+            g.state < 3 ? GNSS_STATES[g.state] : "?", g.motion < 3 ? MOTION[g.motion] : "?",
+            g.fixes, g.ttffS, g.fixAgeS, g.intervalS, g.accuracyDm, (unsigned long)g.onTotalS);
+    if (!s.haveGnss) s.fixesFirst = g.fixes;
+    s.haveGnss = true;
+    s.fixesLast = g.fixes;
+    s.ttffLast = g.ttffS;
+}
+
+void onSystem(Summary& s, FILE* csv, unsigned long t, const DiagHeader& h, const DiagSystem& y) {
+    fprintf(csv, "%lu,%u,%lu,%lu,%lu,%u,%u,%u,%s\n", t, h.seq, (unsigned long)y.heapFree,
+            (unsigned long)y.heapMaxBlock, (unsigned long)y.heapMinFree, y.inputQueue, y.outbox, y.jobsArmed,
+            y.fsmState < 8 ? FSM_STATES[y.fsmState] : "?");
+    if (y.heapFree < s.heapMin) s.heapMin = y.heapFree;
+    if (y.heapMaxBlock < s.maxBlockMin) s.maxBlockMin = y.heapMaxBlock;
+    if (y.outbox > s.outboxMax) s.outboxMax = y.outbox;
+    if (y.inputQueue > s.queueMax) s.queueMax = y.inputQueue;
+}
+
+void printSummary(const Summary& s) {
+    unsigned long total = s.frames[0] + s.frames[1] + s.frames[2];
+    printf("=== Sesión de diagnóstico ===\n");
+    printf("Tramas: %lu (módem %lu, GNSS %lu, sistema %lu) | rechazadas %lu | perdidas %lu\n",
+           total, s.frames[0], s.frames[1], s.frames[2], s.rejected, s.lost);
+    if (s.haveUptime) {
+        printf("Uptime: %lu s -> %lu s (%lu s grabados)\n", s.firstUptime, s.lastUptimeFull,
+               s.lastUptimeFull - s.firstUptime);
+    }
+    if (s.atSamples > 0) {
+        printf("AT: %lu comandos vistos | min %u ms, prom %lu ms, max %u ms | timeouts %u\n",
+               s.atSamples, s.atMin, s.atSum / s.atSamples, s.atMax, s.atTimeouts);
+    }
+    if (!s.httpStatus.empty()) {
+        printf("HTTP:");
+        for (size_t i = 0; i < s.httpStatus.size(); i++) {
+            printf(" %d x%lu", s.httpStatus[i].first, s.httpStatus[i].second);
+        }
+        printf("\n");
+    }
+    if (s.csqMin != 0xFF) printf("CSQ: %u-%u\n", s.csqMin, s.csqMax);
+    if (s.haveGnss) {
+        printf("GNSS: %u fixes nuevos | TTFF %u s\n", (unsigned)(s.fixesLast - s.fixesFirst), s.ttffLast);
+    }
+    if (s.frames[2] > 0) {
+        printf("Heap: libre min %lu B, bloque mayor min %lu B | bandeja SOS max %u | cola de botones max %u\n",
+               (unsigned long)s.heapMin, (unsigned long)s.maxBlockMin, s.outboxMax, s.queueMax);
+    }
+}
+
+FILE* openCsv(const std::string& prefix, const char* suffix, const char* header) {
+    std::string path = prefix + suffix;
+    FILE* f = fopen(path.c_str(), "w");
+    if (!f) {
+        fprintf(stderr, "No se pudo crear %s\n", path.c_str());
+        exit(1);
+    }
+    fprintf(f, "%s\n", header);
+    return f;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    FILE* in = stdin;
+    if (argc > 1 && strcmp(argv[1], "-") != 0) {
+        in = fopen(argv[1], "r");
+        if (!in) {
+            fprintf(stderr, "No se pudo abrir %s\n", argv[1]);
+            return 1;
+        }
+    }
+    std::string prefix = argc > 2 ? argv[2] : "diag";
+
+    FILE* modemCsv = openCsv(prefix, "_modem.csv",
+        "uptime_s,seq,at0_ms,at1_ms,at2_ms,at_max_ms,at_timeouts,csq,http0,http1,http_last_ms");
+    FILE* gnssCsv = openCsv(prefix, "_gnss.csv",
+        "uptime_s,seq,state,motion,fixes,ttff_s,fix_age_s,interval_s,accuracy_dm,on_total_s");
+    FILE* systemCsv = openCsv(prefix, "_system.csv",
+        "uptime_s,seq,heap_free,heap_max_block,heap_min_free,input_queue,outbox,jobs_armed,fsm");
+
+    Summary s;
+    char line[512];
+    uint8_t buf[64];
+    while (fgets(line, sizeof(line), in)) {
+        size_t len = parseLine(line, buf, sizeof(buf));
+        if (len == 0) continue;   // Línea que no es una notificación
+        DiagHeader h;
+        if (!diagDecodeHeader(buf, len, h)) {
+            s.rejected++;
+            continue;
+        }
+        if (s.haveSeq && h.seq != (uint8_t)(s.lastSeq + 1)) s.lost += (uint8_t)(h.seq - s.lastSeq - 1);
+        s.haveSeq = true;
+        s.lastSeq = h.seq;
+        unsigned long t = unwrapUptime(s, h.uptimeS);
+
+        switch (h.type) {
+            case DIAG_TYPE_MODEM: {
+                DiagModem m;
+                diagDecodeModem(buf, m);
+                onModem(s, modemCsv, t, h, m);
+                s.frames[0]++;
+                break;
+            }
+            case DIAG_TYPE_GNSS: {
+                DiagGnss g;
+                diagDecodeGnss(buf, g);
+                onGnss(s, gnssCsv, t, h, g);
+                s.frames[1]++;
+                break;
+            }
+            case DIAG_TYPE_SYSTEM: {
+                DiagSystem y;
+                diagDecodeSystem(buf, y);
+                onSystem(s, systemCsv, t, h, y);
+                s.frames[2]++;
+                break;
+            }
+            default:
+                s.rejected++;   // Tipo de una versión más nueva del firmware
+                break;
+        }
+    }
+
+    if (in != stdin) fclose(in);
+    fclose(modemCsv);
+    fclose(gnssCsv);
+    fclose(systemCsv);
+    printSummary(s);
+    return 0;
+}